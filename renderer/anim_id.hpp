@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+#include <renderer/common.hpp>
+
+namespace adttil
+{
+    // 32-bit FNV-1a of a clip name. The same value is produced at compile time from a literal,
+    // `"attack"_anim`, and at load time from file names, so lookups never hash strings per frame.
+    using AnimId = uint32_t;
+
+    constexpr AnimId anim_id(std::string_view name) noexcept
+    {
+        uint32_t hash = 0x811c9dc5;
+        for (char c : name)
+        {
+            hash = (hash ^ (unsigned char)c) * 0x01000193;
+        }
+        return hash;
+    }
+
+    namespace literals
+    {
+        consteval AnimId operator""_anim(const char* name, size_t size) noexcept
+        {
+            return anim_id({ name, size });
+        }
+    }
+
+    // Names seen at load time, for debug output and to reject two names with the same id.
+    class AnimNames
+    {
+    public:
+        static AnimId intern(std::string_view name)
+        {
+            const AnimId id = anim_id(name);
+            std::lock_guard lock{ mutex() };
+            auto [iter, inserted] = names().try_emplace(id, name);
+            if (not inserted && iter->second != name)
+            {
+                print_and_throw("animation names {} and {} share id {:#010x}", iter->second, name, id);
+            }
+            return id;
+        }
+
+        static std::string name(AnimId id)
+        {
+            std::lock_guard lock{ mutex() };
+            auto iter = names().find(id);
+            return iter == names().end() ? std::string{} : iter->second;
+        }
+
+    private:
+        static std::mutex& mutex()
+        {
+            static std::mutex instance;
+            return instance;
+        }
+
+        static std::unordered_map<AnimId, std::string>& names()
+        {
+            static std::unordered_map<AnimId, std::string> instance;
+            return instance;
+        }
+    };
+}
@@ -0,0 +1,2685 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <string>
+#include <string_view>
+#include <span>
+#include <unordered_map>
+#include <map>
+#include <filesystem>
+#include <fstream>
+#include <ranges>
+#include <algorithm>
+#include <numeric>
+#include <iterator>
+#include <utility>
+#include <memory>
+#include <optional>
+#include <cmath>
+#include <bit>
+#include <system_error>
+#include <chrono>
+
+#include <stb_image/stb_image.h>
+#include <imgui/imgui.h>
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+#include <renderer/worker_pool.hpp>
+#include <renderer/atlas_packer.hpp>
+#include <renderer/mapped_file.hpp>
+#include <renderer/asset_pack.hpp>
+#include <renderer/anim_id.hpp>
+#include <renderer/folder_watcher.hpp>
+#include <renderer/atlas_texture.hpp>
+#include <renderer/mip_chain.hpp>
+#include <renderer/pixel_format.hpp>
+#include <renderer/png_decoder.hpp>
+#include <renderer/frame_meta.hpp>
+#include <renderer/collision_mask.hpp>
+#include <renderer/distance_field.hpp>
+#include <renderer/task_scheduler.hpp>
+
+namespace adttil
+{
+    class AnimManager
+    {
+    public:
+        static constexpr uint32_t no_palette = UINT32_MAX;
+
+        // Placement of one source image in the atlas, in pixels within page `layer`. Only the alpha
+        // bounding box is stored: it starts at `offset` inside the original `source_size` image.
+        // Identical frames share the same atlas region.
+        struct Frame
+        {
+            Coord2   position;
+            Coord2   size;
+            Coord2   offset;
+            Coord2   source_size;
+            uint32_t layer;
+            // Palette of palette8 frames.
+            uint32_t palette = no_palette;
+        };
+
+        // Frames named `<clip>_<number>.png` form a clip, ordered by number. A name without a
+        // numeric suffix is a clip of one frame.
+        struct Clip
+        {
+            AnimId   id;
+            uint32_t first_frame;
+            uint32_t frame_count;
+            float    duration;
+            // Storage of the clip's pages, rgba8 unless AtlasOptions::compact_formats is set.
+            PixelFormat format = PixelFormat::rgba8;
+            uint32_t palette = no_palette;
+        };
+
+        // Rects of every frame back to back; those of frame table entry `f` are
+        // rects[first[f]] up to rects[first[f + 1]].
+        struct BoxTable
+        {
+            std::vector<uint32_t> first;
+            // (x0, y0, x1, y1) in pixels from the frame's pivot, y down.
+            std::vector<Vec4>     rects;
+
+            std::span<const Vec4> of(uint32_t frame) const noexcept
+            {
+                return std::span{ rects }.subspan(first[frame], first[frame + 1] - first[frame]);
+            }
+        };
+
+        // Per frame data in clip order, one array per field; a clip's frames are the range
+        // [first_frame, first_frame + frame_count) of every array.
+        struct FrameTable
+        {
+            // Normalized rect within the page as (u0, v0, u1, v1).
+            std::vector<Vec4>  uv_rects;
+            // Page, i.e. array layer of the atlas image.
+            std::vector<uint32_t> layers;
+            // Row of the palette image for palette8 frames, no_palette otherwise.
+            std::vector<uint32_t> palettes;
+            // Anchor in pixels from the top left of the trimmed rect, bottom center of the
+            // untrimmed image unless overridden.
+            std::vector<Vec2>  pivots;
+            std::vector<float> durations;
+            // Seconds from the start of the clip.
+            std::vector<float> start_times;
+            // frame_windup, frame_active, frame_recovery and frame_invincible bits.
+            std::vector<uint8_t> flags;
+            // Event raised when the frame is shown, the anim_id() of its name or zero.
+            std::vector<AnimId> events;
+            // Where the frame hits and where it can be hit.
+            BoxTable hitboxes;
+            BoxTable hurtboxes;
+            // Normalized rect of the frame's distance field on page field_layers[f] of
+            // distance_atlas(). It covers exactly the trimmed rect grown by
+            // distance_field_margin() pixels on each side, see DistanceField::covered_size(), so
+            // a quad grown that much maps onto it; empty without distance fields.
+            std::vector<Vec4>     field_rects;
+            std::vector<uint32_t> field_layers;
+        };
+
+        static constexpr float default_frame_duration = 1.0f / 12.0f;
+
+        // Atlas area changed since the last take_dirty_rects(), extrusion included.
+        using DirtyRect = AtlasTexture::Region;
+
+        // Everything needed to draw a frame with ImGui, e.g.
+        // `draw_list->AddImage(s.texture, at - s.pivot, at - s.pivot + s.size, s.uv0, s.uv1)`.
+        // ImGui blends straight alpha; draw premultiplied atlases with SpriteBatch instead.
+        struct Sprite
+        {
+            ImTextureID texture;
+            ImVec2      uv0;
+            ImVec2      uv1;
+            // Trimmed size in pixels.
+            ImVec2      size;
+            // Pivot in pixels from the top left of the trimmed rect.
+            ImVec2      pivot;
+            // Row of palette_atlas() for frames uploaded as palette indices. Their `texture` is
+            // null: ImGui cannot resolve indices, SpriteBatch draws them with palette_sprite.glsl.
+            uint32_t    palette;
+        };
+
+        // The atlas is baked to `atlas.cache` inside the folder. When the cached manifest still
+        // matches the PNGs and options, the cache is mapped and its pixels are used in place.
+        //
+        // Otherwise each file is read and inflated once, in parallel, keeping only the scanlines
+        // inside its alpha bounds. Identical files are dropped and the rects are packed from the
+        // probed sizes, then every remaining frame is converted from those scanlines straight
+        // into its slot on the page, and frames with identical pixels give theirs back before
+        // the cache is written again. With compact formats each clip's frames are also converted
+        // into scratch memory first to choose the clip's format, and clips of one format are
+        // packed onto the same pages.
+        //
+        // A `<clip>.meta` sidecar, see parse_frame_meta(), adds durations, pivots, boxes, phases
+        // and events to the clip's frames. Sidecars are compiled into the cache with the atlas.
+        AnimManager(const char* anim_folder_path, const AtlasOptions& options = {}, WorkerPool& pool = WorkerPool::shared())
+        : folder_{ anim_folder_path }
+        , options_{ options }
+        , pool_{ &pool }
+        {
+            load();
+        }
+
+        // Loads the PNGs stored under `folder` of `pack`, e.g. "anims/hero", the same way. A cache
+        // baked into the pack is used in place; packs are read only, so without one the atlas is
+        // built in memory. `pack` must outlive the manager.
+        AnimManager(const AssetPack& pack, std::string_view folder, const AtlasOptions& options = {}, WorkerPool& pool = WorkerPool::shared())
+        : folder_{ folder }
+        , options_{ options }
+        , pool_{ &pool }
+        , pack_{ &pack }
+        {
+            load();
+        }
+
+        // Loads `folder` like the constructor, as steps of a task on `scheduler`: the cache is
+        // mapped, or the PNGs read, on an I/O thread, decoding and packing run on the workers, and
+        // when `context` is given the atlas is uploaded on the render thread through `batcher`.
+        // Cancellation takes effect between those steps.
+        static Task<std::shared_ptr<AnimManager>> load_async(TaskScheduler& scheduler, std::filesystem::path folder, AtlasOptions options = {},
+            const VulkanContext* context = nullptr, SubmitBatcher* batcher = nullptr)
+        {
+            co_await scheduler.on(TaskQueue::io);
+            std::shared_ptr<AnimManager> anim{ new AnimManager{} };
+            anim->folder_ = std::move(folder);
+            anim->options_ = options;
+            anim->pool_ = &scheduler.pool();
+            anim->check_options();
+            auto start = std::chrono::steady_clock::now();
+            const std::vector<std::filesystem::path> files = anim->list_files();
+            const bool cached = anim->load_cache(files);
+            anim->timings_.probe = lap(start);
+            if (not cached)
+            {
+                std::vector<std::vector<std::byte>> contents(files.size());
+                for (size_t i = 0; i < files.size(); i++)
+                {
+                    anim->read_file(files[i], contents[i]);
+                }
+                anim->compile_meta();
+                anim->timings_.read = lap(start);
+
+                co_await scheduler.on(TaskQueue::worker);
+                start = std::chrono::steady_clock::now();
+                std::vector<Source> sources(files.size());
+                anim->manifest_.resize(files.size());
+                anim->pool_->parallel_for(files.size(), [&](size_t i)
+                {
+                    sources[i].storage = std::move(contents[i]);
+                    anim->manifest_[i] = anim->probe_source(files[i], sources[i].storage, sources[i]);
+                });
+                anim->timings_.read += lap(start);
+                anim->build(files, sources);
+            }
+
+            if (context)
+            {
+                co_await scheduler.on(TaskQueue::render);
+                anim->upload(*context, *batcher);
+            }
+            co_return anim;
+        }
+
+        // Applies PNGs and sidecars of the folder that were added, changed or removed, e.g. as
+        // reported by the poll() of a FolderWatcher on `{ ".png", ".meta" }`. New and changed
+        // frames are placed into free space of the existing pages and only their rects are marked
+        // dirty; the space of replaced frames is returned to the free list. When no page has room
+        // the whole atlas is rebuilt and every page is dirty. Returns true in that case. With
+        // compact formats the same happens when a frame does not fit the format or palette of its
+        // clip, or starts a new clip. Distance fields move the same way on their own pages, except
+        // that running out of room only packs the fields again. Changed `.meta` sidecars are
+        // compiled again and only touch the frame table. Packs never change, so a manager loaded
+        // from one ignores updates.
+        bool update(std::span<const std::filesystem::path> changed)
+        {
+            namespace fs = std::filesystem;
+
+            if (pack_)
+            {
+                return false;
+            }
+            std::vector<fs::path> paths;
+            bool sidecar_changed = false;
+            for (const fs::path& path : changed)
+            {
+                if (path.extension() == ".meta")
+                {
+                    sidecar_changed = true;
+                    continue;
+                }
+                paths.push_back(path);
+            }
+            if (sidecar_changed)
+            {
+                compile_meta();
+            }
+            // Without the CPU copy only single level RGBA8 pages can be patched, by decoding straight
+            // into the staging memory of their upload; otherwise the rebuild uploads everything again.
+            const bool in_place = not atlas_data_;
+            if (in_place && not paths.empty() && not patchable_in_place())
+            {
+                rebuild();
+                return true;
+            }
+
+            std::vector<Source> sources(paths.size());
+            std::vector<ManifestEntry> entries(paths.size());
+            std::vector<char> exists(paths.size());
+            pool_->parallel_for(paths.size(), [&](size_t i)
+            {
+                std::error_code error;
+                exists[i] = fs::is_regular_file(paths[i], error);
+                if (exists[i])
+                {
+                    entries[i] = load_source(paths[i], sources[i]);
+                }
+            });
+
+            report_invalid(paths, sources, exists);
+            // Slots are taken from the probed sizes, then every frame is decoded straight into its own.
+            std::vector<std::optional<std::pair<uint32_t, Coord2>>> slots(paths.size());
+            for (size_t i = 0; i < paths.size(); i++)
+            {
+                remove_frame(paths[i]);
+                if (not exists[i])
+                {
+                    continue;
+                }
+                manifest_.push_back(std::move(entries[i]));
+
+                Source& source = sources[i];
+                if (not source.valid)
+                {
+                    continue;
+                }
+                const bool empty = source.size.x() == 0 || source.size.y() == 0;
+                if (compact_data_)
+                {
+                    auto clip = clip_format(paths[i].stem().string());
+                    if (not clip)
+                    {
+                        rebuild();
+                        return true;
+                    }
+                    source.format = clip->first;
+                    source.palette = clip->second;
+                }
+                slots[i] = empty ? std::optional{ std::pair{ 0u, Coord2{ 0uz, 0uz } } } : free_list_.allocate(source.size, (uint32_t)source.format);
+                if (not slots[i])
+                {
+                    rebuild();
+                    return true;
+                }
+            }
+            if (in_place)
+            {
+                upload_sources_in_place(sources, slots);
+            }
+            else
+            {
+                pool_->parallel_for(paths.size(), [&](size_t i)
+                {
+                    if (not slots[i])
+                    {
+                        return;
+                    }
+                    // The whole slot is cleared first: its gutter may still hold pixels of a removed
+                    // frame, which would bleed into the mips.
+                    auto [layer, position] = *slots[i];
+                    Source& source = sources[i];
+                    const BitmapView target = page(layer);
+                    if (source.size.x() != 0 && source.size.y() != 0)
+                    {
+                        const BitmapRect dirty = slot_rect(position, source.size);
+                        for (size_t y = 0; y < dirty.size.y(); y++)
+                        {
+                            std::memset(&target[Coord2{ dirty.position.x(), dirty.position.y() + y }], 0, dirty.size.x() * sizeof(Color32));
+                        }
+                    }
+                    decode_source(source, BitmapView{ &target[position], source.size, atlas_size_.x() });
+                });
+            }
+
+            for (size_t i = 0; i < paths.size(); i++)
+            {
+                if (not slots[i])
+                {
+                    continue;
+                }
+                Source& source = sources[i];
+                auto [layer, position] = *slots[i];
+                if (not in_place && source.size.x() != 0 && source.size.y() != 0)
+                {
+                    const BitmapView target = page(layer);
+                    const Palette* palette = source.palette != no_palette ? &palettes_[source.palette] : nullptr;
+                    if (compact_data_ && not fits_format(BitmapView{ &target[position], source.size, atlas_size_.x() }, source.format, encoding(), options_.format_tolerance, palette))
+                    {
+                        rebuild();
+                        return true;
+                    }
+                    const BitmapRect dirty = slot_rect(position, source.size);
+                    extrude_edges(target, position, source.size, options_.extrude);
+                    build_mips(layer, dirty);
+                    if (compressed_data_)
+                    {
+                        for (size_t level = 0; level < mip_levels_; level++)
+                        {
+                            compress_rect(page(layer, level), level_rect(dirty, level), options_.compression, compressed_page(layer, level), *pool_);
+                        }
+                    }
+                    encode_slot(layer, dirty, source.palette);
+                    dirty_rects_.push_back({ layer, dirty });
+                }
+                frame_names_.push_back(paths[i].stem().string());
+                frames_.push_back({ position, source.size, source.offset, source.source_size, layer, source.palette });
+                if (options_.collision_threshold > 0)
+                {
+                    masks_.push_back(std::move(source.mask));
+                }
+                if (options_.distance_field_scale > 0)
+                {
+                    fields_.push_back(std::move(source.field));
+                    place_field();
+                }
+            }
+
+            std::ranges::sort(manifest_, {}, &ManifestEntry::name);
+            build_clips();
+            measure_efficiency();
+            // Without the pixels the cache cannot be written; the next load bakes it again.
+            if (atlas_data_)
+            {
+                save_cache();
+            }
+            return false;
+        }
+
+        std::vector<DirtyRect> take_dirty_rects()
+        {
+            return std::exchange(dirty_rects_, {});
+        }
+
+        // Creates the GPU atlas, one array layer and ImGui texture per page, and queues a copy of
+        // every page on `batcher` so it executes with the next flushed frame. The block compressed
+        // pages are used when baked and the device samples that format, RGBA8 otherwise. Compact
+        // pages get one image per run of pages sharing a format, falling back to RGBA8 the same
+        // way, plus the palette image. Unless `keep_cpu_copy` is set, the pixels are released
+        // right after staging. update() then decodes new frames straight into the staging memory
+        // of their upload while the pages have a single mip level, are uncompressed RGBA8 and use
+        // no compact formats; otherwise it rebuilds the whole atlas. Editors and hot reload should
+        // keep the copy.
+        void upload(const VulkanContext& context, SubmitBatcher& batcher, bool keep_cpu_copy = false)
+        {
+            gpu_context_ = context;
+            batcher_ = &batcher;
+            keep_cpu_copy_ = keep_cpu_copy;
+            dirty_rects_.clear();
+            if (page_count_ == 0 || not atlas_data_)
+            {
+                return;
+            }
+            std::vector<GpuPages> runs = gpu_page_runs(&context);
+            const bool reuse = runs.size() == gpu_.size() && std::ranges::equal(runs, gpu_, [&](const GpuPages& run, const GpuPages& current)
+            {
+                return run.first_layer == current.first_layer && run.layer_count == current.layer_count && run.format == current.format
+                    && current.atlas->extent().width == atlas_size_.x() && current.atlas->extent().height == atlas_size_.y()
+                    && current.atlas->mip_levels() == mip_levels_ && current.atlas->srgb() == srgb_view(run.format);
+            });
+            if (not reuse)
+            {
+                gpu_.clear();
+                for (GpuPages& run : runs)
+                {
+                    const VkComponentMapping components = run.format == VK_FORMAT_R8_UNORM ? mask_components(encoding()) : VkComponentMapping{};
+                    run.atlas = std::make_unique<AtlasTexture>(context, batcher, VkExtent2D{ (uint32_t)atlas_size_.x(), (uint32_t)atlas_size_.y() },
+                        run.layer_count, run.format, (uint32_t)mip_levels_, components, srgb_view(run.format));
+                }
+                gpu_ = std::move(runs);
+            }
+            for (const GpuPages& run : gpu_)
+            {
+                std::vector<DirtyRect> pages(run.layer_count);
+                for (uint32_t layer = 0; layer < run.layer_count; layer++)
+                {
+                    pages[layer] = { layer, { Coord2{ 0uz, 0uz }, atlas_size_ } };
+                }
+                run.atlas->upload(gpu_levels(run), pages);
+            }
+            upload_palettes(context, batcher);
+            mark_field_pages();
+            upload_fields(context, batcher);
+            if (not keep_cpu_copy)
+            {
+                release_cpu_copy();
+            }
+        }
+
+        // Called once per frame after upload(): frees finished staging buffers and uploads the
+        // rects changed by update().
+        void sync_gpu()
+        {
+            std::vector<DirtyRect> dirty = atlas_data_ && not gpu_.empty() ? take_dirty_rects() : std::vector<DirtyRect>{};
+            for (const GpuPages& run : gpu_)
+            {
+                std::vector<DirtyRect> rects;
+                for (const DirtyRect& rect : dirty)
+                {
+                    if (rect.layer >= run.first_layer && rect.layer < run.first_layer + run.layer_count)
+                    {
+                        rects.push_back({ rect.layer - run.first_layer, rect.rect });
+                    }
+                }
+                if (atlas_data_)
+                {
+                    run.atlas->upload(gpu_levels(run), rects);
+                }
+                else
+                {
+                    run.atlas->collect();
+                }
+            }
+            if (palettes_changed_ && batcher_)
+            {
+                upload_palettes(gpu_context_, *batcher_);
+            }
+            else if (palette_gpu_)
+            {
+                palette_gpu_->collect();
+            }
+            if (fields_changed_ && batcher_)
+            {
+                upload_fields(gpu_context_, *batcher_);
+            }
+            else if (field_gpu_)
+            {
+                field_gpu_->collect();
+            }
+        }
+
+        // Drops the GPU atlas. Waits for in flight frames, so call it from the render thread.
+        void release_gpu() noexcept
+        {
+            gpu_.clear();
+            palette_gpu_.reset();
+            field_gpu_.reset();
+            batcher_ = nullptr;
+        }
+
+        // Hands the GPU images over, retired at the pending serial, instead of waiting for in
+        // flight frames as release_gpu() does. The caller destroys them on the render thread once
+        // that serial is complete.
+        std::vector<std::unique_ptr<AtlasTexture>> take_gpu() noexcept
+        {
+            std::vector<std::unique_ptr<AtlasTexture>> textures;
+            for (GpuPages& run : gpu_)
+            {
+                textures.push_back(std::move(run.atlas));
+            }
+            gpu_.clear();
+            textures.push_back(std::move(palette_gpu_));
+            textures.push_back(std::move(field_gpu_));
+            std::erase(textures, nullptr);
+            for (const auto& texture : textures)
+            {
+                texture->retire();
+            }
+            batcher_ = nullptr;
+            return textures;
+        }
+
+        // Image holding page `layer`, at layer `layer - first_layer(layer)`.
+        const AtlasTexture* gpu_atlas(uint32_t layer = 0) const noexcept
+        {
+            const GpuPages* run = gpu_run(layer);
+            return run ? run->atlas.get() : nullptr;
+        }
+
+        // First page held by gpu_atlas(layer).
+        uint32_t first_layer(uint32_t layer) const noexcept
+        {
+            const GpuPages* run = gpu_run(layer);
+            return run ? run->first_layer : 0;
+        }
+
+        // Palettes as rows of 256 texels of a single layer, for
+        // texelFetch(palettes, ivec3(index, row, 0), 0) through array_view().
+        const AtlasTexture* palette_atlas() const noexcept
+        {
+            return palette_gpu_.get();
+        }
+
+        // R8 pages of the distance fields, see FrameTable::field_rects; SpriteStyle draws effects
+        // from them through distance_sprite.glsl.
+        const AtlasTexture* distance_atlas() const noexcept
+        {
+            return field_gpu_.get();
+        }
+
+        // Frame table entry `frame` ready to draw, or nothing before upload().
+        std::optional<Sprite> sprite(uint32_t frame) const noexcept
+        {
+            const GpuPages* run = frame < frames_.size() ? gpu_run(frame_table_.layers[frame]) : nullptr;
+            if (not run)
+            {
+                return std::nullopt;
+            }
+            const Vec4& uv = frame_table_.uv_rects[frame];
+            const Vec2& pivot = frame_table_.pivots[frame];
+            return Sprite{
+                run->atlas->texture(frame_table_.layers[frame] - run->first_layer),
+                ImVec2{ uv.x(), uv.y() },
+                ImVec2{ uv.z(), uv.w() },
+                ImVec2{ (float)frames_[frame].size.x(), (float)frames_[frame].size.y() },
+                ImVec2{ pivot.x(), pivot.y() },
+                run->format == VK_FORMAT_R8_UINT ? frame_table_.palettes[frame] : no_palette,
+            };
+        }
+
+        // A single frame of `color`, shown while the real animations stream in.
+        static AnimManager placeholder(Coord2 size = Coord2{ 8uz, 8uz }, Color32 color = Color32{ 255, 0, 255, 255 })
+        {
+            AnimManager anim;
+            anim.atlas_size_ = size;
+            anim.page_count_ = 1;
+            anim.mip_levels_ = 1;
+            anim.atlas_storage_.assign(size.x() * size.y(), color);
+            anim.atlas_data_ = anim.atlas_storage_.data();
+            anim.efficiency_ = 1.0;
+            anim.frames_.push_back({ Coord2{ 0uz, 0uz }, size, Coord2{ 0uz, 0uz }, size, 0 });
+            anim.frame_names_.push_back("placeholder");
+            anim.build_clips();
+            return anim;
+        }
+
+        // Pages are stored back to back, ready to be copied into the layers of one array image,
+        // one such run per mip level.
+        BitmapView page(size_t layer, size_t level = 0) const noexcept
+        {
+            const Coord2 size = mip_size(atlas_size_, level);
+            return { atlas_data_ + level_offset(atlas_size_, page_count_, level) + layer * size.x() * size.y(), size };
+        }
+
+        size_t page_count() const noexcept
+        {
+            return page_count_;
+        }
+
+        size_t mip_levels() const noexcept
+        {
+            return mip_levels_;
+        }
+
+        // Storage of page `layer` in the compact pages.
+        PixelFormat page_format(uint32_t layer) const noexcept
+        {
+            return layer < page_formats_.size() ? page_formats_[layer] : PixelFormat::rgba8;
+        }
+
+        // Colours of palette8 clips, indexed by Clip::palette, as baked; see set_palette().
+        std::span<const Palette> palettes() const noexcept
+        {
+            return palettes_;
+        }
+
+        // Recolours palette8 clip `clip` on the GPU, e.g. for a team colour or a hit flash:
+        // `colors[i]` replaces entry i of its palette row, whose indices the pages keep, and
+        // entries past the end keep the baked colour. Colours are straight alpha sRGB like the
+        // PNGs and are converted to encoding(). The swap reaches the GPU at the next sync_gpu()
+        // and carries over updates, rebuilds included. An empty `colors` restores the baked
+        // palette. Returns false for clips that are not palette8.
+        bool set_palette(AnimId clip, std::span<const Color32> colors)
+        {
+            const Clip* found = find_clip(clip);
+            if (not found || found->palette == no_palette)
+            {
+                return false;
+            }
+            if (colors.empty())
+            {
+                palette_swaps_.erase(clip);
+            }
+            else
+            {
+                std::vector<Color32> converted(colors.begin(), colors.begin() + std::min(colors.size(), Palette::max_colors));
+                convert_pixels(BitmapView{ converted.data(), Coord2{ converted.size(), 1uz } }, encoding());
+                palette_swaps_[clip] = std::move(converted);
+            }
+            palettes_changed_ = true;
+            return true;
+        }
+
+        // Encoding of the stored pixels. Premultiplied atlases need ONE, ONE_MINUS_SRC_ALPHA
+        // blending, unlike ImGui's default straight alpha state; SpriteBatch picks the blend from
+        // it. Linear ones are sampled through sRGB views, see AtlasTexture::srgb().
+        PixelEncoding encoding() const noexcept
+        {
+            return pixel_encoding(options_);
+        }
+
+        // RGBA8 size of every page and mip level.
+        size_t atlas_bytes() const noexcept
+        {
+            return level_offset(atlas_size_, page_count_, mip_levels_) * sizeof(Color32);
+        }
+
+        // Size of the block compressed pages and mip levels, zero without compression.
+        size_t compressed_bytes() const noexcept
+        {
+            return compressed_level_offset(atlas_size_, page_count_, mip_levels_, options_.compression);
+        }
+
+        // Size of the compact pages and mip levels, zero without compact formats.
+        size_t compact_bytes() const noexcept
+        {
+            return compact_offset(atlas_size_, page_formats_, mip_levels_);
+        }
+
+        // Device memory of the uploaded atlas, or what an upload is expected to take: on the device
+        // of an earlier upload when there was one, otherwise in the formats as baked.
+        size_t gpu_bytes() const
+        {
+            if (gpu_.empty())
+            {
+                return gpu_context_.physical_device != VK_NULL_HANDLE ? gpu_bytes(gpu_context_) : expected_gpu_bytes(gpu_page_runs(nullptr));
+            }
+            size_t total = (palette_gpu_ ? palette_gpu_->bytes() : 0) + (field_gpu_ ? field_gpu_->bytes() : 0);
+            for (const GpuPages& run : gpu_)
+            {
+                total += run.atlas->bytes();
+            }
+            return total;
+        }
+
+        // What an upload to the device of `context` takes, pages in a format it cannot sample
+        // counted at their RGBA8 size.
+        size_t gpu_bytes(const VulkanContext& context) const
+        {
+            return expected_gpu_bytes(gpu_page_runs(&context));
+        }
+
+        // Host memory held by this animation set, mapped cache pages included.
+        size_t memory_bytes() const noexcept
+        {
+            const size_t per_frame = sizeof(Frame) + sizeof(std::string) + sizeof(Vec4) + sizeof(Vec2) + sizeof(float) * 2 + sizeof(uint32_t) * 2;
+            return (atlas_data_ ? atlas_bytes() : 0) + (compressed_data_ ? compressed_bytes() : 0) + (compact_data_ ? compact_bytes() : 0)
+                + palette_bytes() + frames_.size() * per_frame + clips_.size() * sizeof(Clip);
+        }
+
+        // Extent of every page.
+        Coord2 atlas_size() const noexcept
+        {
+            return atlas_size_;
+        }
+
+        // Fraction of the atlas covered by frame pixels.
+        double efficiency() const noexcept
+        {
+            return efficiency_;
+        }
+
+        // Wall time of each stage of the last full load, zero for stages that did not run; on a
+        // cache hit only the probe does.
+        struct LoadTimings
+        {
+            // Listing the files and validating, then mapping, the cache.
+            std::chrono::nanoseconds probe{};
+            // Reading the PNGs and finding their trimmed rects.
+            std::chrono::nanoseconds read{};
+            // Choosing formats, dropping identical files and packing the rects.
+            std::chrono::nanoseconds pack{};
+            // Decoding and converting frames into their slots.
+            std::chrono::nanoseconds decode{};
+            // Dropping duplicate pixels, building mips and encoding the pages.
+            std::chrono::nanoseconds copy{};
+            std::chrono::nanoseconds save{};
+        };
+
+        const LoadTimings& load_timings() const noexcept
+        {
+            return timings_;
+        }
+
+        // Atlas placement of every frame, in frame table order.
+        std::span<const Frame> frames() const noexcept
+        {
+            return frames_;
+        }
+
+        // Solid pixels of every frame's trimmed rect, in frame table order, when
+        // AtlasOptions::collision_threshold is set. A frame drawn at `at` has its mask at
+        // `at - pivot`, rounded, for overlaps().
+        std::span<const CollisionMask> collision_masks() const noexcept
+        {
+            return masks_;
+        }
+
+        // Signed distance fields of every frame's trimmed rect, in frame table order, when
+        // AtlasOptions::distance_field_scale is set. For a frame drawn at `at`,
+        // `fields[f].distance(point - at + pivot)` measures how far `point` is from its outline.
+        std::span<const DistanceField> distance_fields() const noexcept
+        {
+            return fields_;
+        }
+
+        // Pixels by which the distance fields extend past each side of the trimmed rect.
+        float distance_field_margin() const noexcept
+        {
+            const size_t scale = options_.distance_field_scale;
+            return (float)(DistanceField::margin(scale, options_.distance_field_spread) * scale);
+        }
+
+        // Clips sorted by id.
+        std::span<const Clip> clips() const noexcept
+        {
+            return clips_;
+        }
+
+        const Clip* find_clip(AnimId id) const noexcept
+        {
+            auto iter = clip_index_.find(id);
+            return iter != clip_index_.end() ? &clips_[iter->second] : nullptr;
+        }
+
+        // Frame table index of frame `index` of `clip`, its last frame past the end. With
+        // find_clip() this reads any frame's table entries in constant time, e.g.
+        // `table.hitboxes.of(anim.clip_frame(*anim.find_clip("attack"_anim), 3))`.
+        static uint32_t clip_frame(const Clip& clip, uint32_t index) noexcept
+        {
+            return clip.first_frame + std::min(index, clip.frame_count - 1);
+        }
+
+        const FrameTable& frame_table() const noexcept
+        {
+            return frame_table_;
+        }
+
+        // Frame table index shown `time` seconds into `clip`.
+        uint32_t frame_at(const Clip& clip, float time, bool loop = true) const noexcept
+        {
+            if (clip.duration <= 0.0f)
+            {
+                return clip.first_frame;
+            }
+            time = loop ? std::fmod(std::max(time, 0.0f), clip.duration) : std::clamp(time, 0.0f, clip.duration);
+            const auto first = frame_table_.start_times.begin() + clip.first_frame;
+            const auto iter = std::upper_bound(first, first + clip.frame_count, time);
+            return clip.first_frame + (uint32_t)std::max<ptrdiff_t>(iter - first - 1, 0);
+        }
+
+    private:
+        AnimManager() = default;
+
+        // Reads the folder, or the pack folder, into an atlas; see the constructors.
+        // Rejects options the bake cannot honour before any work is shared out, so the error is
+        // raised on the loading thread rather than on a worker.
+        void check_options() const
+        {
+            if (options_.distance_field_scale > 0)
+            {
+                DistanceField::check_spread(options_.distance_field_spread);
+            }
+        }
+
+        void load()
+        {
+            check_options();
+            WorkerPool& pool = *pool_;
+            auto start = std::chrono::steady_clock::now();
+            const std::vector<std::filesystem::path> files = list_files();
+            const bool cached = load_cache(files);
+            timings_.probe = lap(start);
+            if (cached)
+            {
+                return;
+            }
+
+            compile_meta();
+            std::vector<Source> sources(files.size());
+            manifest_.resize(files.size());
+            pool.parallel_for(files.size(), [&](size_t i)
+            {
+                manifest_[i] = load_source(files[i], sources[i]);
+            });
+            timings_.read = lap(start);
+            build(files, sources);
+        }
+
+        // Reloads the folder from scratch. A GPU atlas of the same extent and page count is kept
+        // and fully rewritten, otherwise it is recreated.
+        void rebuild()
+        {
+            auto gpu = std::move(gpu_);
+            auto palette_gpu = std::move(palette_gpu_);
+            auto field_gpu = std::move(field_gpu_);
+            SubmitBatcher* batcher = std::exchange(batcher_, nullptr);
+            const VulkanContext context = gpu_context_;
+            const bool keep_cpu_copy = keep_cpu_copy_;
+            auto palette_swaps = std::move(palette_swaps_);
+            *this = pack_ ? AnimManager{ *pack_, folder_.generic_string(), options_, *pool_ } : AnimManager{ folder_.string().c_str(), options_, *pool_ };
+            palette_swaps_ = std::move(palette_swaps);
+            if (batcher)
+            {
+                gpu_ = std::move(gpu);
+                palette_gpu_ = std::move(palette_gpu);
+                field_gpu_ = std::move(field_gpu);
+                upload(context, *batcher, keep_cpu_copy);
+                return;
+            }
+            for (uint32_t layer = 0; layer < page_count_; layer++)
+            {
+                dirty_rects_.push_back({ layer, { Coord2{ 0uz, 0uz }, atlas_size_ } });
+            }
+        }
+
+        void release_cpu_copy() noexcept
+        {
+            atlas_data_ = nullptr;
+            atlas_storage_ = {};
+            compressed_data_ = nullptr;
+            compressed_storage_ = {};
+            compact_data_ = nullptr;
+            compact_storage_ = {};
+            cache_file_ = {};
+        }
+
+        // Moves the pixels a cache hit left in the mapping into owned storage and unmaps the
+        // cache, so the file can be replaced: Windows refuses to rename over a mapped file.
+        void detach_cache_file()
+        {
+            if (not cache_file_.is_open())
+            {
+                return;
+            }
+            if (atlas_data_)
+            {
+                atlas_storage_.assign(atlas_data_, atlas_data_ + atlas_bytes() / sizeof(Color32));
+                atlas_data_ = atlas_storage_.data();
+            }
+            if (compressed_data_)
+            {
+                compressed_storage_.assign(compressed_data_, compressed_data_ + compressed_bytes());
+                compressed_data_ = compressed_storage_.data();
+            }
+            if (compact_data_)
+            {
+                compact_storage_.assign(compact_data_, compact_data_ + compact_bytes());
+                compact_data_ = compact_storage_.data();
+            }
+            cache_file_ = {};
+        }
+
+        // Pixels before mip `level` of a chain of `pages` pages of `size`.
+        static size_t level_offset(Coord2 size, size_t pages, size_t level) noexcept
+        {
+            size_t offset = 0;
+            for (size_t i = 0; i < level; i++)
+            {
+                const Coord2 extent = mip_size(size, i);
+                offset += extent.x() * extent.y() * pages;
+            }
+            return offset;
+        }
+
+        static size_t compressed_level_offset(Coord2 size, size_t pages, size_t level, BlockFormat format) noexcept
+        {
+            if (format == BlockFormat::none)
+            {
+                return 0;
+            }
+            size_t offset = 0;
+            for (size_t i = 0; i < level; i++)
+            {
+                offset += compressed_size(mip_size(size, i), format) * pages;
+            }
+            return offset;
+        }
+
+        // Rect of level 0 scaled to `level`, rounded outwards.
+        static BitmapRect level_rect(BitmapRect rect, size_t level) noexcept
+        {
+            const size_t scale = 1uz << level;
+            const Coord2 low{ rect.position.x() >> level, rect.position.y() >> level };
+            const Coord2 high{ (rect.position.x() + rect.size.x() + scale - 1) >> level, (rect.position.y() + rect.size.y() + scale - 1) >> level };
+            return { low, Coord2{ high.x() - low.x(), high.y() - low.y() } };
+        }
+
+        // Space owned by a frame placed at `position`: content, extrusion, padding and alignment.
+        BitmapRect slot_rect(Coord2 position, Coord2 size) const noexcept
+        {
+            const size_t alignment = atlas_alignment(options_);
+            const size_t border = options_.extrude * 2 + options_.padding;
+            return { Coord2{ position.x() - options_.extrude, position.y() - options_.extrude },
+                Coord2{ align_up(size.x() + border, alignment), align_up(size.y() + border, alignment) } };
+        }
+
+        // Regenerates every mip level below the slot `rect` of level 0. Slots are aligned to the
+        // chain, so each mip texel only sees pixels of one frame and its gutter.
+        void build_mips(uint32_t layer, BitmapRect rect)
+        {
+            const PixelEncoding encoding = pixel_encoding(options_);
+            const float reference = options_.alpha_coverage_reference;
+            const float coverage = reference > 0.0f ? alpha_coverage(page(layer), rect, reference) : 0.0f;
+            for (size_t level = 1; level < mip_levels_; level++)
+            {
+                const BitmapRect target = level_rect(rect, level);
+                downsample_rect(page(layer, level - 1), page(layer, level), target, encoding);
+                if (reference > 0.0f)
+                {
+                    preserve_alpha_coverage(page(layer, level), target, coverage, reference, encoding);
+                }
+            }
+        }
+
+        void compress_pages()
+        {
+            if (options_.compression == BlockFormat::none)
+            {
+                return;
+            }
+            compressed_storage_.resize(compressed_bytes());
+            compressed_data_ = compressed_storage_.data();
+            for (size_t level = 0; level < mip_levels_; level++)
+            {
+                for (uint32_t layer = 0; layer < page_count_; layer++)
+                {
+                    compress_page(page(layer, level), options_.compression, compressed_page(layer, level), *pool_);
+                }
+            }
+        }
+
+        std::span<std::byte> compressed_page(uint32_t layer, size_t level = 0) const noexcept
+        {
+            const size_t size = compressed_size(mip_size(atlas_size_, level), options_.compression);
+            return { compressed_data_ + compressed_level_offset(atlas_size_, page_count_, level, options_.compression) + layer * size, size };
+        }
+
+        static bool uses_compact_formats(const AtlasOptions& options) noexcept
+        {
+            return options.compact_formats && options.compression == BlockFormat::none;
+        }
+
+        // Format and palette of the clip frame `name` belongs to, nothing for a new clip.
+        std::optional<std::pair<PixelFormat, uint32_t>> clip_format(std::string_view name) const noexcept
+        {
+            const std::string_view clip = parse_frame_name(name).first;
+            for (size_t i = 0; i < frames_.size(); i++)
+            {
+                if (parse_frame_name(frame_names_[i]).first == clip && frames_[i].size.x() > 0)
+                {
+                    return std::pair{ page_format(frames_[i].layer), frames_[i].palette };
+                }
+            }
+            return std::nullopt;
+        }
+
+        // Re-encodes the slot `rect` of every mip level into the compact page.
+        void encode_slot(uint32_t layer, BitmapRect rect, uint32_t palette)
+        {
+            if (not compact_data_)
+            {
+                return;
+            }
+            const Palette* colors = palette != no_palette ? &palettes_[palette] : nullptr;
+            for (size_t level = 0; level < mip_levels_; level++)
+            {
+                encode_rect(page(layer, level), level_rect(rect, level), page_formats_[layer], compact_page(layer, level), colors);
+            }
+        }
+
+        // Bytes before page `layer` of mip `level` when pages of `formats` are stored like the
+        // RGBA8 ones, a run per level.
+        static size_t compact_offset(Coord2 size, std::span<const PixelFormat> formats, size_t level, uint32_t layer = 0) noexcept
+        {
+            size_t offset = 0;
+            for (size_t i = 0; i < level; i++)
+            {
+                for (PixelFormat format : formats)
+                {
+                    offset += format_size(mip_size(size, i), format);
+                }
+            }
+            for (uint32_t page = 0; page < layer && page < formats.size(); page++)
+            {
+                offset += format_size(mip_size(size, level), formats[page]);
+            }
+            return offset;
+        }
+
+        std::span<std::byte> compact_page(uint32_t layer, size_t level = 0) const noexcept
+        {
+            return { compact_data_ + compact_offset(atlas_size_, page_formats_, level, layer), format_size(mip_size(atlas_size_, level), page_formats_[layer]) };
+        }
+
+        size_t palette_bytes() const noexcept
+        {
+            return palettes_.size() * Palette::max_colors * sizeof(Color32);
+        }
+
+        // Uploads every palette as one row of 256 texels of an RGBA8 image, with the swaps of
+        // set_palette() applied.
+        void upload_palettes(const VulkanContext& context, SubmitBatcher& batcher)
+        {
+            palettes_changed_ = false;
+            if (palettes_.empty())
+            {
+                palette_gpu_.reset();
+                return;
+            }
+            const VkExtent2D extent{ (uint32_t)Palette::max_colors, (uint32_t)palettes_.size() };
+            if (not palette_gpu_ || palette_gpu_->extent().width != extent.width || palette_gpu_->extent().height != extent.height)
+            {
+                palette_gpu_.reset();
+                palette_gpu_ = std::make_unique<AtlasTexture>(context, batcher, extent, 1, VK_FORMAT_R8G8B8A8_UNORM, 1, VkComponentMapping{}, encoding().linear);
+            }
+            std::vector<Color32> rows(Palette::max_colors * palettes_.size(), Color32{ 0, 0, 0, 0 });
+            for (size_t row = 0; row < palettes_.size(); row++)
+            {
+                std::ranges::copy(palettes_[row].colors(), rows.begin() + row * Palette::max_colors);
+            }
+            for (const auto& [id, colors] : palette_swaps_)
+            {
+                const Clip* clip = find_clip(id);
+                if (clip && clip->palette < palettes_.size())
+                {
+                    std::ranges::copy(colors, rows.begin() + clip->palette * Palette::max_colors);
+                }
+            }
+            const void* levels[] = { rows.data() };
+            const DirtyRect all{ 0, { Coord2{ 0uz, 0uz }, Coord2{ (size_t)extent.width, (size_t)extent.height } } };
+            palette_gpu_->upload(levels, std::span{ &all, 1 });
+        }
+
+        // Pages sharing one image: all of them, or each run of pages of one compact format.
+        struct GpuPages
+        {
+            uint32_t first_layer;
+            uint32_t layer_count;
+            VkFormat format;
+            std::unique_ptr<AtlasTexture> atlas;
+        };
+
+        // Whether pages of `format` are sampled through an sRGB view, for linear encodings.
+        bool srgb_view(VkFormat format) const noexcept
+        {
+            return encoding().linear && AtlasTexture::srgb_format(format) != VK_FORMAT_UNDEFINED;
+        }
+
+        // Image formats the pages upload as; formats the device of `context` cannot sample, or
+        // not through the sRGB view a linear encoding needs, fall back to RGBA8. Without a
+        // context every baked format is assumed supported.
+        std::vector<GpuPages> gpu_page_runs(const VulkanContext* context) const
+        {
+            std::vector<GpuPages> runs;
+            for (uint32_t layer = 0; layer < page_count_; layer++)
+            {
+                VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+                if (compact_data_)
+                {
+                    format = vk_format(page_formats_[layer]);
+                }
+                else if (compressed_data_)
+                {
+                    format = vk_format(options_.compression);
+                }
+                if (context && (not AtlasTexture::supports(*context, format)
+                    || (srgb_view(format) && not AtlasTexture::supports(*context, AtlasTexture::srgb_format(format)))))
+                {
+                    format = VK_FORMAT_R8G8B8A8_UNORM;
+                }
+                if (runs.empty() || runs.back().format != format)
+                {
+                    runs.push_back({ layer, 0, format });
+                }
+                runs.back().layer_count++;
+            }
+            return runs;
+        }
+
+        // Device memory `runs` take once created, with the palette and distance field images.
+        size_t expected_gpu_bytes(std::span<const GpuPages> runs) const
+        {
+            size_t total = field_page_size_.x() * field_page_size_.y() * field_page_count_;
+            if (compact_data_)
+            {
+                total += palette_bytes();
+            }
+            for (const GpuPages& run : runs)
+            {
+                if (run.format == VK_FORMAT_R8G8B8A8_UNORM)
+                {
+                    total += level_offset(atlas_size_, run.layer_count, mip_levels_) * sizeof(Color32);
+                }
+                else if (compact_data_)
+                {
+                    total += compact_offset(atlas_size_, std::span{ page_formats_ }.subspan(run.first_layer, run.layer_count), mip_levels_);
+                }
+                else
+                {
+                    total += compressed_level_offset(atlas_size_, run.layer_count, mip_levels_, options_.compression);
+                }
+            }
+            return total;
+        }
+
+        const GpuPages* gpu_run(uint32_t layer) const noexcept
+        {
+            auto iter = std::ranges::find_if(gpu_, [&](const GpuPages& run){ return layer >= run.first_layer && layer < run.first_layer + run.layer_count; });
+            return iter != gpu_.end() ? &*iter : nullptr;
+        }
+
+        // Start of every mip level of `run` in the format of its image.
+        std::vector<const void*> gpu_levels(const GpuPages& run) const
+        {
+            std::vector<const void*> levels(mip_levels_);
+            for (size_t level = 0; level < mip_levels_; level++)
+            {
+                if (run.format == VK_FORMAT_R8G8B8A8_UNORM)
+                {
+                    levels[level] = page(run.first_layer, level).data();
+                }
+                else if (compact_data_)
+                {
+                    levels[level] = compact_page(run.first_layer, level).data();
+                }
+                else
+                {
+                    levels[level] = compressed_page(run.first_layer, level).data();
+                }
+            }
+            return levels;
+        }
+
+        // A probed frame. The compressed file, in `storage` or the pack mapping, is kept to spot
+        // identical files, and the trimmed rect, inflated by the probe and still in the file's
+        // pixel format, until decode_source() writes it into its slot.
+        struct Source
+        {
+            std::vector<std::byte>     storage;
+            std::span<const std::byte> file;
+            PngDecoder                 trimmed;
+            Coord2                     size;
+            Coord2                     offset;
+            Coord2                     source_size;
+            uint64_t                   file_hash = 0;
+            // Of the decoded pixels.
+            uint64_t                   hash = 0;
+            size_t                     unique = 0;
+            PixelFormat                format = PixelFormat::rgba8;
+            uint32_t                   palette = no_palette;
+            CollisionMask              mask;
+            DistanceField              field;
+            bool                       valid = false;
+
+            void release_file() noexcept
+            {
+                storage = {};
+                file = {};
+                trimmed = {};
+            }
+        };
+
+        struct ManifestEntry
+        {
+            std::string name;
+            uint64_t    size;
+            int64_t     mtime;
+            uint64_t    hash;
+        };
+
+        // Baked layout: header, source records, frame records, free rects, string table, page
+        // formats, palettes, sidecar records, compiled sidecar rules, collision masks, distance
+        // fields and their free rects, then the RGBA8 pixels page aligned so the mapping can be handed to
+        // an upload without copying, followed by the block compressed or compact pages, also page
+        // aligned, when enabled.
+        static constexpr char     cache_magic[8] = "ADTATLS";
+        static constexpr uint32_t cache_version = 11;
+        static constexpr uint64_t cache_pixel_alignment = 4096;
+
+        struct CacheHeader
+        {
+            char     magic[8];
+            uint32_t version;
+            uint32_t source_count;
+            uint32_t frame_count;
+            uint32_t width;
+            uint32_t height;
+            uint32_t page_count;
+            uint32_t mip_levels;
+            uint64_t options_hash;
+            double   efficiency;
+            uint64_t sources_offset;
+            uint64_t frames_offset;
+            uint64_t free_rects_offset;
+            uint64_t free_rect_count;
+            uint64_t strings_offset;
+            uint64_t strings_size;
+            uint64_t pixels_offset;
+            uint64_t compressed_offset;
+            uint64_t compressed_size;
+            // Zero or page_count formats.
+            uint64_t page_formats_offset;
+            uint64_t page_format_count;
+            uint64_t palettes_offset;
+            uint64_t palette_count;
+            uint64_t compact_offset;
+            uint64_t compact_size;
+            // CacheSource records of the `.meta` files.
+            uint64_t sidecars_offset;
+            uint64_t sidecar_count;
+            uint64_t meta_rules_offset;
+            uint64_t meta_rule_count;
+            // Mask rows of every frame in frame order, empty without collision masks.
+            uint64_t mask_words_offset;
+            uint64_t mask_word_count;
+            // Distance field texels of every frame in frame order, empty without fields.
+            uint64_t field_texels_offset;
+            uint64_t field_texel_count;
+            // Extent of the field pages and their free space, see CacheFrame::field_layer.
+            uint32_t field_width;
+            uint32_t field_height;
+            uint32_t field_page_count;
+            uint64_t field_free_rects_offset;
+            uint64_t field_free_rect_count;
+        };
+
+        struct CacheSource
+        {
+            uint64_t size;
+            int64_t  mtime;
+            uint64_t hash;
+            uint32_t name_offset;
+            uint32_t name_length;
+        };
+
+        struct CacheFrame
+        {
+            uint32_t position[2];
+            uint32_t size[2];
+            uint32_t offset[2];
+            uint32_t source_size[2];
+            uint32_t layer;
+            uint32_t palette;
+            uint32_t name_offset;
+            uint32_t name_length;
+            // Slot of the distance field, when there is one.
+            uint32_t field_position[2];
+            uint32_t field_layer;
+        };
+
+        struct CacheFreeRect
+        {
+            uint32_t layer;
+            uint32_t position[2];
+            uint32_t size[2];
+        };
+
+        struct CachePalette
+        {
+            uint32_t size;
+            // Color32 texels.
+            uint32_t colors[Palette::max_colors];
+        };
+
+        struct CacheMetaRule
+        {
+            uint32_t clip;
+            uint32_t first;
+            uint32_t last;
+            uint32_t kind;
+            uint32_t bits;
+            float    values[4];
+            uint32_t event_offset;
+            uint32_t event_length;
+        };
+
+        static uint64_t hash_options(const AtlasOptions& options) noexcept
+        {
+            const uint64_t values[] = { options.padding, options.extrude, options.power_of_two, options.square, options.max_size, options.max_pages,
+                (uint64_t)options.compression, options.mip_levels, options.premultiply_alpha, options.linear_color,
+                std::bit_cast<uint32_t>(options.alpha_coverage_reference), options.compact_formats, (uint64_t)options.format_tolerance,
+                (uint64_t)options.collision_threshold, options.distance_field_scale, std::bit_cast<uint32_t>(options.distance_field_spread) };
+            return hash_bytes(values, sizeof(values));
+        }
+
+        // Files of the folder with `extension`, sorted; pack entries directly inside the pack folder.
+        std::vector<std::filesystem::path> list_files(std::string_view extension = ".png") const
+        {
+            namespace fs = std::filesystem;
+
+            if (pack_)
+            {
+                const std::string prefix = folder_.generic_string() + '/';
+                return pack_->entries_with_prefix(prefix)
+                    | std::views::filter([&](const AssetPack::Entry& entry){
+                        return entry.name.ends_with(extension) && entry.name.find('/', prefix.size()) == std::string_view::npos; })
+                    | std::views::transform([](const AssetPack::Entry& entry){ return fs::path{ entry.name }; })
+                    | std::ranges::to<std::vector>();
+            }
+            auto files = fs::directory_iterator(folder_)
+                        | std::views::filter([&](auto& file){ return file.path().extension() == extension ;})
+                        | std::views::transform([](auto& file){ return file.path(); })
+                        | std::ranges::to<std::vector>();
+            std::ranges::sort(files);
+            return files;
+        }
+
+        const AssetPack::Entry* pack_entry(const std::filesystem::path& path) const noexcept
+        {
+            return pack_ ? pack_->find(path.generic_string()) : nullptr;
+        }
+
+        int64_t modified_time(const std::filesystem::path& path) const noexcept
+        {
+            if (pack_)
+            {
+                const AssetPack::Entry* entry = pack_entry(path);
+                return entry ? entry->mtime : 0;
+            }
+            std::error_code error;
+            return (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        }
+
+        uint64_t file_size(const std::filesystem::path& path) const noexcept
+        {
+            if (pack_)
+            {
+                const AssetPack::Entry* entry = pack_entry(path);
+                return entry ? entry->size : UINT64_MAX;
+            }
+            std::error_code error;
+            return std::filesystem::file_size(path, error);
+        }
+
+        // Hash of the file content; packs store it, loose files are read again.
+        uint64_t content_hash(const std::filesystem::path& path) const
+        {
+            if (const AssetPack::Entry* entry = pack_entry(path))
+            {
+                return entry->hash;
+            }
+            std::vector<std::byte> storage;
+            const std::span<const std::byte> content = read_file(path, storage);
+            return hash_bytes(content.data(), content.size());
+        }
+
+        std::filesystem::path cache_path() const
+        {
+            return folder_ / "atlas.cache";
+        }
+
+        bool load_cache(std::span<const std::filesystem::path> files)
+        {
+            // A pack maps the cache in place when it is stored uncompressed, as pack_builder does.
+            MappedFile file;
+            std::span<std::byte> bytes;
+            if (pack_)
+            {
+                const AssetPack::Entry* entry = pack_entry(cache_path());
+                bytes = entry && entry->compression == PackCompression::none ? entry->stored : std::span<std::byte>{};
+            }
+            else
+            {
+                file = MappedFile{ cache_path() };
+                bytes = file.bytes();
+            }
+            if (bytes.size() < sizeof(CacheHeader))
+            {
+                return false;
+            }
+            CacheHeader header;
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            const auto fits = [&](uint64_t offset, uint64_t size){ return offset <= bytes.size() && size <= bytes.size() - offset; };
+            const std::vector<std::filesystem::path> sidecars = list_files(".meta");
+            if (std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0
+                || header.version != cache_version
+                || header.options_hash != hash_options(options_)
+                || header.source_count != files.size()
+                || header.sidecar_count != sidecars.size()
+                || not fits(header.sources_offset, (uint64_t)header.source_count * sizeof(CacheSource))
+                || not fits(header.frames_offset, (uint64_t)header.frame_count * sizeof(CacheFrame))
+                || not fits(header.free_rects_offset, header.free_rect_count * sizeof(CacheFreeRect))
+                || not fits(header.strings_offset, header.strings_size)
+                || header.mip_levels == 0 || header.mip_levels > 32
+                || not fits(header.pixels_offset, level_offset(Coord2{ (size_t)header.width, (size_t)header.height }, header.page_count, header.mip_levels) * sizeof(Color32))
+                || not fits(header.compressed_offset, header.compressed_size)
+                || header.compressed_size != compressed_level_offset(Coord2{ (size_t)header.width, (size_t)header.height },
+                    header.page_count, header.mip_levels, options_.compression)
+                || (header.page_format_count != 0 && header.page_format_count != header.page_count)
+                || (header.page_format_count != 0) != uses_compact_formats(options_)
+                || not fits(header.page_formats_offset, header.page_format_count * sizeof(uint32_t))
+                || not fits(header.palettes_offset, header.palette_count * sizeof(CachePalette))
+                || not fits(header.compact_offset, header.compact_size)
+                || not fits(header.sidecars_offset, header.sidecar_count * sizeof(CacheSource))
+                || not fits(header.meta_rules_offset, header.meta_rule_count * sizeof(CacheMetaRule))
+                || not fits(header.mask_words_offset, header.mask_word_count * sizeof(uint64_t))
+                || not fits(header.field_texels_offset, header.field_texel_count)
+                || not fits(header.field_free_rects_offset, header.field_free_rect_count * sizeof(CacheFreeRect)))
+            {
+                return false;
+            }
+
+            // Every frame must lie on a page and inside its source image; masks and fields take a
+            // size given by the frame's and the options.
+            const size_t field_scale = options_.distance_field_scale;
+            const float field_spread = options_.distance_field_spread;
+            uint64_t mask_words = 0, field_texels = 0;
+            for (size_t i = 0; i < header.frame_count; i++)
+            {
+                CacheFrame frame;
+                std::memcpy(&frame, bytes.data() + header.frames_offset + i * sizeof(CacheFrame), sizeof(frame));
+                const bool empty = frame.size[0] == 0 || frame.size[1] == 0;
+                if (not empty && (frame.layer >= header.page_count
+                    || (uint64_t)frame.position[0] + frame.size[0] > header.width
+                    || (uint64_t)frame.position[1] + frame.size[1] > header.height
+                    || (uint64_t)frame.offset[0] + frame.size[0] > frame.source_size[0]
+                    || (uint64_t)frame.offset[1] + frame.size[1] > frame.source_size[1]))
+                {
+                    return false;
+                }
+                const Coord2 size{ (size_t)frame.size[0], (size_t)frame.size[1] };
+                mask_words += options_.collision_threshold > 0 ? CollisionMask::row_words(size.x()) * size.y() : 0;
+                const Coord2 field_size = DistanceField::field_size(size, field_scale, field_spread);
+                field_texels += field_size.x() * field_size.y();
+                if (field_size.x() != 0 && (frame.field_layer >= header.field_page_count
+                    || (uint64_t)frame.field_position[0] + field_size.x() > header.field_width
+                    || (uint64_t)frame.field_position[1] + field_size.y() > header.field_height))
+                {
+                    return false;
+                }
+            }
+            if (mask_words != header.mask_word_count || field_texels != header.field_texel_count)
+            {
+                return false;
+            }
+
+            std::vector<PixelFormat> page_formats(header.page_format_count);
+            for (size_t i = 0; i < page_formats.size(); i++)
+            {
+                uint32_t format;
+                std::memcpy(&format, bytes.data() + header.page_formats_offset + i * sizeof(uint32_t), sizeof(format));
+                if (format > (uint32_t)PixelFormat::palette8)
+                {
+                    return false;
+                }
+                page_formats[i] = (PixelFormat)format;
+            }
+            if (header.compact_size != compact_offset(Coord2{ (size_t)header.width, (size_t)header.height }, page_formats, header.mip_levels))
+            {
+                return false;
+            }
+
+            const auto* strings = (const char*)bytes.data() + header.strings_offset;
+            const auto string = [&](uint32_t offset, uint32_t length)
+            {
+                return (uint64_t)offset + length <= header.strings_size ? std::string_view{ strings + offset, length } : std::string_view{};
+            };
+
+            // A touched but unchanged file only costs a rehash, not a rebuild. Its new mtime is
+            // written back below, so the next load skips the rehash.
+            std::vector<std::pair<uint64_t, CacheSource>> touched;
+            const auto read_manifest = [&](uint64_t offset, std::span<const std::filesystem::path> paths, std::vector<ManifestEntry>& manifest)
+            {
+                manifest.resize(paths.size());
+                for (size_t i = 0; i < paths.size(); i++)
+                {
+                    CacheSource source;
+                    std::memcpy(&source, bytes.data() + offset + i * sizeof(CacheSource), sizeof(source));
+                    if (string(source.name_offset, source.name_length) != paths[i].filename().string()
+                        || file_size(paths[i]) != source.size)
+                    {
+                        return false;
+                    }
+                    const int64_t mtime = modified_time(paths[i]);
+                    if (mtime != source.mtime)
+                    {
+                        if (content_hash(paths[i]) != source.hash)
+                        {
+                            return false;
+                        }
+                        source.mtime = mtime;
+                        touched.emplace_back(offset + i * sizeof(CacheSource), source);
+                    }
+                    manifest[i] = { paths[i].filename().string(), source.size, source.mtime, source.hash };
+                }
+                return true;
+            };
+            std::vector<ManifestEntry> manifest, sidecar_manifest;
+            if (not read_manifest(header.sources_offset, files, manifest) || not read_manifest(header.sidecars_offset, sidecars, sidecar_manifest))
+            {
+                return false;
+            }
+            std::vector<FrameMetaRule> meta_rules(header.meta_rule_count);
+            for (size_t i = 0; i < meta_rules.size(); i++)
+            {
+                CacheMetaRule rule;
+                std::memcpy(&rule, bytes.data() + header.meta_rules_offset + i * sizeof(CacheMetaRule), sizeof(rule));
+                if (rule.kind > (uint32_t)FrameMetaKind::event)
+                {
+                    return false;
+                }
+                meta_rules[i] = { rule.clip, rule.first, rule.last, (FrameMetaKind)rule.kind, rule.bits,
+                    { rule.values[0], rule.values[1], rule.values[2], rule.values[3] }, std::string{ string(rule.event_offset, rule.event_length) } };
+            }
+            manifest_ = std::move(manifest);
+            sidecars_ = std::move(sidecar_manifest);
+            meta_rules_ = std::move(meta_rules);
+
+            std::vector<std::vector<BitmapRect>> free_rects(header.page_count);
+            for (size_t i = 0; i < header.free_rect_count; i++)
+            {
+                CacheFreeRect rect;
+                std::memcpy(&rect, bytes.data() + header.free_rects_offset + i * sizeof(CacheFreeRect), sizeof(rect));
+                if (rect.layer < free_rects.size())
+                {
+                    free_rects[rect.layer].push_back({ Coord2{ (size_t)rect.position[0], (size_t)rect.position[1] },
+                        Coord2{ (size_t)rect.size[0], (size_t)rect.size[1] } });
+                }
+            }
+            std::vector<uint32_t> page_groups(page_formats.size());
+            std::ranges::transform(page_formats, page_groups.begin(), [](PixelFormat format){ return (uint32_t)format; });
+            free_list_ = AtlasFreeList{ std::move(free_rects), options_, std::move(page_groups) };
+
+            std::vector<std::vector<BitmapRect>> field_free_rects(header.field_page_count);
+            for (size_t i = 0; i < header.field_free_rect_count; i++)
+            {
+                CacheFreeRect rect;
+                std::memcpy(&rect, bytes.data() + header.field_free_rects_offset + i * sizeof(CacheFreeRect), sizeof(rect));
+                if (rect.layer < field_free_rects.size())
+                {
+                    field_free_rects[rect.layer].push_back({ Coord2{ (size_t)rect.position[0], (size_t)rect.position[1] },
+                        Coord2{ (size_t)rect.size[0], (size_t)rect.size[1] } });
+                }
+            }
+            field_free_list_ = AtlasFreeList{ std::move(field_free_rects), field_atlas_options() };
+            field_page_size_ = Coord2{ (size_t)header.field_width, (size_t)header.field_height };
+            field_page_count_ = header.field_page_count;
+
+            palettes_.resize(header.palette_count);
+            for (size_t i = 0; i < palettes_.size(); i++)
+            {
+                CachePalette palette;
+                std::memcpy(&palette, bytes.data() + header.palettes_offset + i * sizeof(CachePalette), sizeof(palette));
+                std::vector<Color32> colors(std::min<size_t>(palette.size, Palette::max_colors));
+                std::memcpy(colors.data(), palette.colors, colors.size() * sizeof(Color32));
+                palettes_[i].assign(colors);
+            }
+
+            mask_words = 0;
+            field_texels = 0;
+            frames_.resize(header.frame_count);
+            for (size_t i = 0; i < frames_.size(); i++)
+            {
+                CacheFrame frame;
+                std::memcpy(&frame, bytes.data() + header.frames_offset + i * sizeof(CacheFrame), sizeof(frame));
+                frames_[i] = {
+                    Coord2{ (size_t)frame.position[0], (size_t)frame.position[1] },
+                    Coord2{ (size_t)frame.size[0], (size_t)frame.size[1] },
+                    Coord2{ (size_t)frame.offset[0], (size_t)frame.offset[1] },
+                    Coord2{ (size_t)frame.source_size[0], (size_t)frame.source_size[1] },
+                    frame.layer,
+                    frame.palette < palettes_.size() ? frame.palette : no_palette,
+                };
+                frame_names_.emplace_back(string(frame.name_offset, frame.name_length));
+                if (options_.collision_threshold > 0)
+                {
+                    const Coord2 size = frames_[i].size;
+                    std::vector<uint64_t> words(CollisionMask::row_words(size.x()) * size.y());
+                    std::memcpy(words.data(), bytes.data() + header.mask_words_offset + mask_words * sizeof(uint64_t), words.size() * sizeof(uint64_t));
+                    mask_words += words.size();
+                    masks_.emplace_back(size, words);
+                }
+                if (field_scale > 0)
+                {
+                    const Coord2 size = DistanceField::field_size(frames_[i].size, field_scale, field_spread);
+                    const auto* texels = (const uint8_t*)bytes.data() + header.field_texels_offset + field_texels;
+                    field_texels += size.x() * size.y();
+                    fields_.emplace_back(frames_[i].size, field_scale, field_spread, std::span{ texels, size.x() * size.y() });
+                    field_positions_.push_back(Coord2{ (size_t)frame.field_position[0], (size_t)frame.field_position[1] });
+                    field_layers_.push_back(frame.field_layer);
+                }
+            }
+
+            atlas_size_ = Coord2{ (size_t)header.width, (size_t)header.height };
+            page_count_ = header.page_count;
+            mip_levels_ = header.mip_levels;
+            efficiency_ = header.efficiency;
+            atlas_data_ = (Color32*)(bytes.data() + header.pixels_offset);
+            compressed_data_ = header.compressed_size ? bytes.data() + header.compressed_offset : nullptr;
+            page_formats_ = std::move(page_formats);
+            compact_data_ = page_formats_.empty() ? nullptr : bytes.data() + header.compact_offset;
+            cache_file_ = std::move(file);
+            build_clips();
+            refresh_cache_sources(touched);
+            return true;
+        }
+
+        // Overwrites the given source records of the cache in place. Only mtimes change, so the
+        // records already read from the mapping stay valid.
+        void refresh_cache_sources(std::span<const std::pair<uint64_t, CacheSource>> records) const
+        {
+            if (records.empty() || pack_)
+            {
+                return;
+            }
+            std::fstream file{ cache_path(), std::ios::binary | std::ios::in | std::ios::out };
+            for (const auto& [offset, source] : records)
+            {
+                file.seekp((std::streamoff)offset);
+                file.write((const char*)&source, sizeof(source));
+            }
+            if (not file)
+            {
+                std::println("failed to refresh atlas cache {}", cache_path().string());
+            }
+        }
+
+        // Names the files that could not be decoded; their frames are left out. Files marked as
+        // missing in `exists`, when given, were removed rather than broken.
+        static void report_invalid(std::span<const std::filesystem::path> files, std::span<const Source> sources, std::span<const char> exists = {})
+        {
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                if (not sources[i].valid && (exists.empty() || exists[i]))
+                {
+                    std::println("failed to load {}", files[i].string());
+                }
+            }
+        }
+
+        void save_cache()
+        {
+            if (pack_)
+            {
+                return;
+            }
+            std::string strings;
+            const auto add_string = [&](std::string_view value)
+            {
+                const auto offset = (uint32_t)strings.size();
+                strings += value;
+                return std::pair{ offset, (uint32_t)value.size() };
+            };
+
+            std::vector<CacheSource> sources, sidecars;
+            for (const ManifestEntry& entry : manifest_)
+            {
+                auto [offset, length] = add_string(entry.name);
+                sources.push_back({ entry.size, entry.mtime, entry.hash, offset, length });
+            }
+            for (const ManifestEntry& entry : sidecars_)
+            {
+                auto [offset, length] = add_string(entry.name);
+                sidecars.push_back({ entry.size, entry.mtime, entry.hash, offset, length });
+            }
+            std::vector<uint64_t> mask_words;
+            for (const CollisionMask& mask : masks_)
+            {
+                mask_words.insert(mask_words.end(), mask.words().begin(), mask.words().end());
+            }
+            std::vector<uint8_t> field_texels;
+            for (const DistanceField& field : fields_)
+            {
+                field_texels.insert(field_texels.end(), field.texels().begin(), field.texels().end());
+            }
+            std::vector<CacheMetaRule> meta_rules(meta_rules_.size());
+            for (size_t i = 0; i < meta_rules.size(); i++)
+            {
+                const FrameMetaRule& rule = meta_rules_[i];
+                auto [offset, length] = add_string(rule.event);
+                meta_rules[i] = { rule.clip, rule.first, rule.last, (uint32_t)rule.kind, rule.bits,
+                    { rule.values[0], rule.values[1], rule.values[2], rule.values[3] }, offset, length };
+            }
+
+            std::vector<CacheFrame> frames(frames_.size());
+            for (size_t index = 0; index < frames_.size(); index++)
+            {
+                const Frame& frame = frames_[index];
+                auto [offset, length] = add_string(frame_names_[index]);
+                const Coord2 field_position = index < field_positions_.size() ? field_positions_[index] : Coord2{ 0uz, 0uz };
+                frames[index] = {
+                    { (uint32_t)frame.position.x(), (uint32_t)frame.position.y() },
+                    { (uint32_t)frame.size.x(), (uint32_t)frame.size.y() },
+                    { (uint32_t)frame.offset.x(), (uint32_t)frame.offset.y() },
+                    { (uint32_t)frame.source_size.x(), (uint32_t)frame.source_size.y() },
+                    frame.layer, frame.palette, offset, length,
+                    { (uint32_t)field_position.x(), (uint32_t)field_position.y() },
+                    index < field_layers_.size() ? field_layers_[index] : 0,
+                };
+            }
+
+            const auto free_rect_records = [](const AtlasFreeList& list)
+            {
+                std::vector<CacheFreeRect> records;
+                for (size_t layer = 0; layer < list.pages().size(); layer++)
+                {
+                    for (const BitmapRect& rect : list.pages()[layer])
+                    {
+                        records.push_back({ (uint32_t)layer,
+                            { (uint32_t)rect.position.x(), (uint32_t)rect.position.y() },
+                            { (uint32_t)rect.size.x(), (uint32_t)rect.size.y() } });
+                    }
+                }
+                return records;
+            };
+            const std::vector<CacheFreeRect> free_rects = free_rect_records(free_list_);
+            const std::vector<CacheFreeRect> field_free_rects = free_rect_records(field_free_list_);
+
+            std::vector<uint32_t> page_formats(page_formats_.size());
+            std::ranges::transform(page_formats_, page_formats.begin(), [](PixelFormat format){ return (uint32_t)format; });
+            std::vector<CachePalette> palettes(palettes_.size());
+            for (size_t i = 0; i < palettes.size(); i++)
+            {
+                palettes[i].size = (uint32_t)palettes_[i].size();
+                std::memcpy(palettes[i].colors, palettes_[i].colors().data(), palettes_[i].size() * sizeof(Color32));
+            }
+
+            CacheHeader header = {};
+            std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+            header.version = cache_version;
+            header.source_count = (uint32_t)sources.size();
+            header.frame_count = (uint32_t)frames.size();
+            header.width = (uint32_t)atlas_size_.x();
+            header.height = (uint32_t)atlas_size_.y();
+            header.page_count = (uint32_t)page_count_;
+            header.mip_levels = (uint32_t)mip_levels_;
+            header.options_hash = hash_options(options_);
+            header.efficiency = efficiency_;
+            header.sources_offset = sizeof(CacheHeader);
+            header.frames_offset = header.sources_offset + sources.size() * sizeof(CacheSource);
+            header.free_rects_offset = header.frames_offset + frames.size() * sizeof(CacheFrame);
+            header.free_rect_count = free_rects.size();
+            header.strings_offset = header.free_rects_offset + free_rects.size() * sizeof(CacheFreeRect);
+            header.strings_size = strings.size();
+            header.page_formats_offset = header.strings_offset + strings.size();
+            header.page_format_count = page_formats.size();
+            header.palettes_offset = header.page_formats_offset + page_formats.size() * sizeof(uint32_t);
+            header.palette_count = palettes.size();
+            header.sidecars_offset = header.palettes_offset + palettes.size() * sizeof(CachePalette);
+            header.sidecar_count = sidecars.size();
+            header.meta_rules_offset = header.sidecars_offset + sidecars.size() * sizeof(CacheSource);
+            header.meta_rule_count = meta_rules.size();
+            header.mask_words_offset = header.meta_rules_offset + meta_rules.size() * sizeof(CacheMetaRule);
+            header.mask_word_count = mask_words.size();
+            header.field_texels_offset = header.mask_words_offset + mask_words.size() * sizeof(uint64_t);
+            header.field_texel_count = field_texels.size();
+            header.field_width = (uint32_t)field_page_size_.x();
+            header.field_height = (uint32_t)field_page_size_.y();
+            header.field_page_count = (uint32_t)field_page_count_;
+            header.field_free_rects_offset = header.field_texels_offset + field_texels.size();
+            header.field_free_rect_count = field_free_rects.size();
+            const uint64_t tables_end = header.field_free_rects_offset + field_free_rects.size() * sizeof(CacheFreeRect);
+            header.pixels_offset = align_up(tables_end, cache_pixel_alignment);
+            header.compressed_offset = align_up(header.pixels_offset + atlas_bytes(), cache_pixel_alignment);
+            header.compressed_size = compressed_data_ ? compressed_bytes() : 0;
+            header.compact_offset = align_up(header.compressed_offset + header.compressed_size, cache_pixel_alignment);
+            header.compact_size = compact_data_ ? compact_bytes() : 0;
+
+            // Written beside the target and renamed over it, so a crash never leaves a torn cache.
+            const std::filesystem::path path = cache_path();
+            std::filesystem::path temp_path = path;
+            temp_path += ".tmp";
+            {
+                std::ofstream file{ temp_path, std::ios::binary | std::ios::trunc };
+                file.write((const char*)&header, sizeof(header));
+                file.write((const char*)sources.data(), sources.size() * sizeof(CacheSource));
+                file.write((const char*)frames.data(), frames.size() * sizeof(CacheFrame));
+                file.write((const char*)free_rects.data(), free_rects.size() * sizeof(CacheFreeRect));
+                file.write(strings.data(), strings.size());
+                file.write((const char*)page_formats.data(), page_formats.size() * sizeof(uint32_t));
+                file.write((const char*)palettes.data(), palettes.size() * sizeof(CachePalette));
+                file.write((const char*)sidecars.data(), sidecars.size() * sizeof(CacheSource));
+                file.write((const char*)meta_rules.data(), meta_rules.size() * sizeof(CacheMetaRule));
+                file.write((const char*)mask_words.data(), mask_words.size() * sizeof(uint64_t));
+                file.write((const char*)field_texels.data(), field_texels.size());
+                file.write((const char*)field_free_rects.data(), field_free_rects.size() * sizeof(CacheFreeRect));
+                const std::vector<char> zeros(header.pixels_offset - tables_end);
+                file.write(zeros.data(), zeros.size());
+                file.write((const char*)atlas_data_, atlas_bytes());
+                const std::vector<char> gap(header.compressed_offset - header.pixels_offset - atlas_bytes());
+                file.write(gap.data(), gap.size());
+                file.write((const char*)compressed_data_, header.compressed_size);
+                const std::vector<char> compact_gap(header.compact_offset - header.compressed_offset - header.compressed_size);
+                file.write(compact_gap.data(), compact_gap.size());
+                file.write((const char*)compact_data_, header.compact_size);
+                if (not file)
+                {
+                    std::println("failed to write atlas cache {}", temp_path.string());
+                    return;
+                }
+            }
+            detach_cache_file();
+            std::error_code error;
+            std::filesystem::rename(temp_path, path, error);
+            if (error)
+            {
+                std::println("failed to write atlas cache {}: {}", path.string(), error.message());
+            }
+        }
+
+        // Splits `attack_003` into clip `attack` and number 3.
+        static std::pair<std::string_view, uint32_t> parse_frame_name(std::string_view name) noexcept
+        {
+            const size_t split = name.rfind('_');
+            if (split == std::string_view::npos || split + 1 == name.size()
+                || not std::ranges::all_of(name.substr(split + 1), [](char c){ return c >= '0' && c <= '9'; }))
+            {
+                return { name, 0 };
+            }
+            uint32_t number = 0;
+            for (char c : name.substr(split + 1))
+            {
+                number = number * 10 + (uint32_t)(c - '0');
+            }
+            return { name.substr(0, split), number };
+        }
+
+        // Orders frames by clip id and number, then derives the clip list and frame table, with
+        // the sidecar rules applied.
+        void build_clips()
+        {
+            struct Key
+            {
+                AnimId   clip;
+                uint32_t number;
+                uint32_t frame;
+            };
+            std::vector<Key> keys(frames_.size());
+            for (size_t i = 0; i < frames_.size(); i++)
+            {
+                auto [clip, number] = parse_frame_name(frame_names_[i]);
+                keys[i] = { AnimNames::intern(clip), number, (uint32_t)i };
+            }
+            std::ranges::sort(keys, {}, [](const Key& key){ return std::pair{ key.clip, key.number }; });
+
+            std::vector<Frame> frames(frames_.size());
+            std::vector<std::string> names(frames_.size());
+            std::vector<CollisionMask> masks(masks_.size());
+            std::vector<DistanceField> fields(fields_.size());
+            // Slots are only reordered when every field has one, see pack_fields().
+            const bool placed = field_positions_.size() == fields_.size();
+            std::vector<Coord2> field_positions(placed ? fields_.size() : 0);
+            std::vector<uint32_t> field_layers(placed ? fields_.size() : 0);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                frames[i] = frames_[keys[i].frame];
+                names[i] = std::move(frame_names_[keys[i].frame]);
+                if (not masks.empty())
+                {
+                    masks[i] = std::move(masks_[keys[i].frame]);
+                }
+                if (not fields.empty())
+                {
+                    fields[i] = std::move(fields_[keys[i].frame]);
+                }
+                if (not field_positions.empty())
+                {
+                    field_positions[i] = field_positions_[keys[i].frame];
+                    field_layers[i] = field_layers_[keys[i].frame];
+                }
+            }
+            frames_ = std::move(frames);
+            frame_names_ = std::move(names);
+            masks_ = std::move(masks);
+            fields_ = std::move(fields);
+            field_positions_ = std::move(field_positions);
+            field_layers_ = std::move(field_layers);
+
+            const Vec2 atlas_extent{ (float)std::max(atlas_size_.x(), 1uz), (float)std::max(atlas_size_.y(), 1uz) };
+            frame_table_ = {};
+            clips_.clear();
+            for (size_t i = 0; i < frames_.size(); i++)
+            {
+                const Frame& frame = frames_[i];
+                if (clips_.empty() || clips_.back().id != keys[i].clip)
+                {
+                    clips_.push_back({ keys[i].clip, (uint32_t)i, 0, 0.0f });
+                }
+                Clip& clip = clips_.back();
+                if (frame.size.x() > 0)
+                {
+                    // Empty frames have no page.
+                    clip.format = page_format(frame.layer);
+                    clip.palette = frame.palette;
+                }
+                frame_table_.uv_rects.push_back(Vec4{
+                    frame.position.x() / atlas_extent.x(),
+                    frame.position.y() / atlas_extent.y(),
+                    (frame.position.x() + frame.size.x()) / atlas_extent.x(),
+                    (frame.position.y() + frame.size.y()) / atlas_extent.y(),
+                });
+                frame_table_.layers.push_back(frame.layer);
+                frame_table_.palettes.push_back(frame.palette);
+                frame_table_.pivots.push_back(Vec2{
+                    (float)frame.source_size.x() * 0.5f - (float)frame.offset.x(),
+                    (float)frame.source_size.y() - (float)frame.offset.y(),
+                });
+                frame_table_.durations.push_back(default_frame_duration);
+                clip.frame_count++;
+            }
+
+            clip_index_.clear();
+            for (size_t i = 0; i < clips_.size(); i++)
+            {
+                clip_index_.emplace(clips_[i].id, (uint32_t)i);
+            }
+            apply_meta();
+            if (field_positions_.size() != fields_.size() || fields_.empty())
+            {
+                pack_fields();
+            }
+            fill_field_columns();
+            frame_table_.start_times.resize(frames_.size());
+            for (Clip& clip : clips_)
+            {
+                for (uint32_t i = clip.first_frame; i < clip.first_frame + clip.frame_count; i++)
+                {
+                    frame_table_.start_times[i] = clip.duration;
+                    clip.duration += frame_table_.durations[i];
+                }
+            }
+        }
+
+        // Expands meta_rules_ into the per frame tables. Boxes are gathered in image pixels and
+        // moved to the final pivots at the end, so the order of pivot and box lines is free.
+        void apply_meta()
+        {
+            FrameTable& table = frame_table_;
+            table.flags.assign(frames_.size(), 0);
+            table.events.assign(frames_.size(), 0);
+            std::vector<std::pair<uint32_t, Vec4>> hitboxes, hurtboxes;
+            for (const FrameMetaRule& rule : meta_rules_)
+            {
+                const Clip* clip = find_clip(rule.clip);
+                if (not clip || rule.first >= clip->frame_count)
+                {
+                    continue;
+                }
+                const AnimId event = rule.kind == FrameMetaKind::event ? AnimNames::intern(rule.event) : 0;
+                const auto [x, y, w, h] = rule.values;
+                for (uint32_t i = clip_frame(*clip, rule.first); i <= clip_frame(*clip, rule.last); i++)
+                {
+                    switch (rule.kind)
+                    {
+                    case FrameMetaKind::duration:
+                        table.durations[i] = x;
+                        break;
+                    case FrameMetaKind::pivot:
+                        table.pivots[i] = Vec2{ x - (float)frames_[i].offset.x(), y - (float)frames_[i].offset.y() };
+                        break;
+                    case FrameMetaKind::flags:
+                        table.flags[i] |= (uint8_t)rule.bits;
+                        break;
+                    case FrameMetaKind::hitbox:
+                        hitboxes.push_back({ i, Vec4{ x, y, x + w, y + h } });
+                        break;
+                    case FrameMetaKind::hurtbox:
+                        hurtboxes.push_back({ i, Vec4{ x, y, x + w, y + h } });
+                        break;
+                    case FrameMetaKind::event:
+                        table.events[i] = event;
+                        break;
+                    }
+                }
+            }
+
+            const auto fill = [&](BoxTable& boxes, std::vector<std::pair<uint32_t, Vec4>>& rects)
+            {
+                std::ranges::stable_sort(rects, {}, &std::pair<uint32_t, Vec4>::first);
+                boxes.first.assign(frames_.size() + 1, 0);
+                boxes.rects.clear();
+                for (const auto& [frame, rect] : rects)
+                {
+                    const Vec2 pivot{ (float)frames_[frame].offset.x() + table.pivots[frame].x(), (float)frames_[frame].offset.y() + table.pivots[frame].y() };
+                    boxes.rects.push_back(Vec4{ rect.x() - pivot.x(), rect.y() - pivot.y(), rect.z() - pivot.x(), rect.w() - pivot.y() });
+                    boxes.first[frame + 1]++;
+                }
+                std::partial_sum(boxes.first.begin(), boxes.first.end(), boxes.first.begin());
+            };
+            fill(table.hitboxes, hitboxes);
+            fill(table.hurtboxes, hurtboxes);
+        }
+
+        // Fields sit one texel of padding apart, on pages up to the atlas' own maximum size.
+        static AtlasOptions field_atlas_options() noexcept
+        {
+            AtlasOptions options;
+            options.padding = 1;
+            options.extrude = 0;
+            return options;
+        }
+
+        // Slot of a field at `position`, its padding included; the rect its upload rewrites.
+        static BitmapRect field_slot_rect(Coord2 position, Coord2 size) noexcept
+        {
+            return { position, Coord2{ size.x() + 1, size.y() + 1 } };
+        }
+
+        // Packs every distance field onto fresh R8 pages, all of them dirty.
+        void pack_fields()
+        {
+            if (fields_.empty())
+            {
+                field_positions_.clear();
+                field_layers_.clear();
+                field_free_list_ = {};
+                if (field_page_count_ != 0)
+                {
+                    field_page_count_ = 0;
+                    fields_changed_ = true;
+                }
+                return;
+            }
+            const AtlasOptions options = field_atlas_options();
+            const auto sizes = fields_ | std::views::transform(&DistanceField::size) | std::ranges::to<std::vector>();
+            AtlasLayout layout;
+            if (not pack_atlas(sizes, options, layout))
+            {
+                print_and_throw("{} distance fields do not fit into {}x{} pages", sizes.size(), options.max_size, options.max_size);
+            }
+            field_positions_ = std::move(layout.positions);
+            field_layers_ = std::move(layout.layers);
+            field_free_list_ = AtlasFreeList{ std::move(layout.free_rects), options };
+            field_page_size_ = layout.size;
+            field_page_count_ = layout.page_count;
+            mark_field_pages();
+        }
+
+        // Gives the field update() just appended a slot from the free list and marks it dirty.
+        // Without room the slots are dropped, so build_clips() packs every field again.
+        void place_field()
+        {
+            if (field_positions_.size() + 1 != fields_.size())
+            {
+                return;
+            }
+            const Coord2 size = fields_.back().size();
+            const bool empty = size.x() == 0 || size.y() == 0;
+            auto slot = empty ? std::optional{ std::pair{ 0u, Coord2{ 0uz, 0uz } } } : field_free_list_.allocate(size);
+            if (not slot)
+            {
+                field_positions_.clear();
+                field_layers_.clear();
+                return;
+            }
+            field_layers_.push_back(slot->first);
+            field_positions_.push_back(slot->second);
+            if (not empty)
+            {
+                field_dirty_.push_back({ slot->first, field_slot_rect(slot->second, size) });
+                fields_changed_ = true;
+            }
+        }
+
+        // Returns the slot of the field at `index` to the free list. It is uploaded as zeros, so
+        // a field placed beside it later never filters texels of this one.
+        void release_field(size_t index)
+        {
+            if (field_positions_.size() != fields_.size())
+            {
+                return;
+            }
+            const Coord2 size = fields_[index].size();
+            if (size.x() != 0 && size.y() != 0)
+            {
+                field_free_list_.release(field_layers_[index], field_positions_[index], size);
+                field_dirty_.push_back({ field_layers_[index], field_slot_rect(field_positions_[index], size) });
+                fields_changed_ = true;
+            }
+            field_positions_.erase(field_positions_.begin() + index);
+            field_layers_.erase(field_layers_.begin() + index);
+        }
+
+        void mark_field_pages()
+        {
+            field_dirty_.clear();
+            for (uint32_t layer = 0; layer < field_page_count_; layer++)
+            {
+                field_dirty_.push_back({ layer, { Coord2{ 0uz, 0uz }, field_page_size_ } });
+            }
+            fields_changed_ = true;
+        }
+
+        // The frame table's field columns, from the slots.
+        void fill_field_columns()
+        {
+            const Vec2 extent{ (float)std::max(field_page_size_.x(), 1uz), (float)std::max(field_page_size_.y(), 1uz) };
+            for (size_t i = 0; i < fields_.size(); i++)
+            {
+                // The rect ends where the grown sprite does, which may be inside the last texel.
+                const Coord2 position = field_positions_[i];
+                const Vec2 size = fields_[i].covered_size();
+                frame_table_.field_rects.push_back(Vec4{ position.x() / extent.x(), position.y() / extent.y(),
+                    (position.x() + size.x()) / extent.x(), (position.y() + size.y()) / extent.y() });
+                frame_table_.field_layers.push_back(field_layers_[i]);
+            }
+        }
+
+        // Whether update() can decode new frames of a manager without a CPU copy straight into the
+        // staging memory of their upload: AtlasTexture::upload_in_place() only covers level 0 of
+        // uncompressed images, and compact pages would need their clip's format checked.
+        bool patchable_in_place() const noexcept
+        {
+            return batcher_ && not gpu_.empty() && mip_levels_ == 1 && page_formats_.empty()
+                && std::ranges::all_of(gpu_, [](const GpuPages& run){ return run.format == VK_FORMAT_R8G8B8A8_UNORM; });
+        }
+
+        // Decodes the probed sources of update() straight into the staging memory of their slots,
+        // cleared and with extruded edges, and queues the uploads.
+        void upload_sources_in_place(std::span<Source> sources, std::span<const std::optional<std::pair<uint32_t, Coord2>>> slots)
+        {
+            for (size_t i = 0; i < sources.size(); i++)
+            {
+                if (slots[i] && (sources[i].size.x() == 0 || sources[i].size.y() == 0))
+                {
+                    decode_source(sources[i], BitmapView{ nullptr, sources[i].size });
+                }
+            }
+            for (const GpuPages& run : gpu_)
+            {
+                std::vector<DirtyRect> regions;
+                std::vector<size_t> members;
+                for (size_t i = 0; i < sources.size(); i++)
+                {
+                    const uint32_t layer = slots[i] ? slots[i]->first : 0;
+                    if (slots[i] && sources[i].size.x() != 0 && sources[i].size.y() != 0
+                        && layer >= run.first_layer && layer < run.first_layer + run.layer_count)
+                    {
+                        regions.push_back({ layer - run.first_layer, slot_rect(slots[i]->second, sources[i].size) });
+                        members.push_back(i);
+                    }
+                }
+                run.atlas->upload_in_place(regions, [&](size_t index, std::span<std::byte> texels)
+                {
+                    Source& source = sources[members[index]];
+                    const BitmapRect& rect = regions[index].rect;
+                    const Coord2 position{ slots[members[index]]->second.x() - rect.position.x(), slots[members[index]]->second.y() - rect.position.y() };
+                    const BitmapView target{ (Color32*)texels.data(), rect.size };
+                    std::ranges::fill(texels, std::byte{ 0 });
+                    decode_source(source, BitmapView{ &target[position], source.size, rect.size.x() });
+                    extrude_edges(target, position, source.size, options_.extrude);
+                });
+            }
+        }
+
+        // Uploads the dirty field rects, or every page when the image is created again; padding
+        // and unused space read as far outside.
+        void upload_fields(const VulkanContext& context, SubmitBatcher& batcher)
+        {
+            fields_changed_ = false;
+            if (field_page_count_ == 0)
+            {
+                field_gpu_.reset();
+                field_dirty_.clear();
+                return;
+            }
+            const VkExtent2D extent{ (uint32_t)field_page_size_.x(), (uint32_t)field_page_size_.y() };
+            if (not field_gpu_ || field_gpu_->extent().width != extent.width || field_gpu_->extent().height != extent.height
+                || field_gpu_->layer_count() != field_page_count_)
+            {
+                field_gpu_.reset();
+                field_gpu_ = std::make_unique<AtlasTexture>(context, batcher, extent, (uint32_t)field_page_count_, VK_FORMAT_R8_UNORM);
+                mark_field_pages();
+                fields_changed_ = false;
+            }
+            const std::vector<DirtyRect> regions = std::exchange(field_dirty_, {});
+            field_gpu_->upload_in_place(regions, [&](size_t index, std::span<std::byte> texels)
+            {
+                const DirtyRect& region = regions[index];
+                const Coord2 low = region.rect.position;
+                const Coord2 high{ low.x() + region.rect.size.x(), low.y() + region.rect.size.y() };
+                std::ranges::fill(texels, std::byte{ 0 });
+                for (size_t i = 0; i < fields_.size(); i++)
+                {
+                    const DistanceField& field = fields_[i];
+                    const Coord2 position = field_positions_[i];
+                    const size_t x0 = std::max(position.x(), low.x()), x1 = std::min(position.x() + field.size().x(), high.x());
+                    const size_t y0 = std::max(position.y(), low.y()), y1 = std::min(position.y() + field.size().y(), high.y());
+                    if (field_layers_[i] != region.layer || x0 >= x1 || y0 >= y1)
+                    {
+                        continue;
+                    }
+                    for (size_t y = y0; y < y1; y++)
+                    {
+                        std::memcpy(texels.data() + (y - low.y()) * region.rect.size.x() + (x0 - low.x()),
+                            field.texels().data() + (y - position.y()) * field.size().x() + (x0 - position.x()), x1 - x0);
+                    }
+                }
+            });
+        }
+
+        // Reads and parses every `<clip>.meta` of the folder into sidecars_ and meta_rules_.
+        void compile_meta()
+        {
+            sidecars_.clear();
+            meta_rules_.clear();
+            std::vector<std::byte> storage;
+            for (const std::filesystem::path& path : list_files(".meta"))
+            {
+                const std::span<const std::byte> bytes = read_file(path, storage);
+                const AssetPack::Entry* packed = pack_entry(path);
+                sidecars_.push_back({ path.filename().string(), bytes.size(), modified_time(path),
+                    packed ? packed->hash : hash_bytes(bytes.data(), bytes.size()) });
+                std::ranges::move(parse_frame_meta({ (const char*)bytes.data(), bytes.size() }, AnimNames::intern(path.stem().string()), path.string()),
+                    std::back_inserter(meta_rules_));
+            }
+        }
+
+        // Reads and probes one PNG.
+        ManifestEntry load_source(const std::filesystem::path& path, Source& source) const
+        {
+            return probe_source(path, read_file(path, source.storage), source);
+        }
+
+        // Finds the size and trimmed rect of the image in `bytes`, so frames are packed before
+        // their pixels are written anywhere. The file is inflated once, here; only the scanlines
+        // of the trimmed rect are kept for decode_pixels(). `bytes` must outlive `source`.
+        ManifestEntry probe_source(const std::filesystem::path& path, std::span<const std::byte> bytes, Source& source) const
+        {
+            const AssetPack::Entry* packed = pack_entry(path);
+            ManifestEntry entry{ path.filename().string(), bytes.size(), modified_time(path),
+                packed ? packed->hash : hash_bytes(bytes.data(), bytes.size()) };
+            thread_local PngDecoder decoder;
+            if (not decoder.open(bytes))
+            {
+                // Files PngDecoder leaves out are decoded by stb_image.
+                int w, h, c;
+                auto pixels = bytes.empty() ? nullptr : (Color32*)stbi_load_from_memory((const stbi_uc*)bytes.data(), (int)bytes.size(), &w, &h, &c, 4);
+                if (not pixels)
+                {
+                    return entry;
+                }
+                decoder.assign(BitmapView{ pixels, Coord2{ (size_t)w, (size_t)h } });
+                stbi_image_free(pixels);
+            }
+            source.source_size = decoder.size();
+            const BitmapRect bounds = decoder.alpha_bounds();
+            decoder.crop(bounds, source.trimmed);
+            source.valid = true;
+            source.offset = bounds.position;
+            source.size = bounds.size;
+            source.file = bytes;
+            source.file_hash = entry.hash;
+            return entry;
+        }
+
+        // Writes the trimmed rect of a probed source into `target`, which has its size, in the
+        // atlas encoding.
+        void decode_pixels(const Source& source, BitmapView target) const
+        {
+            if (source.size.x() == 0 || source.size.y() == 0)
+            {
+                return;
+            }
+            source.trimmed.read({ Coord2{ 0uz, 0uz }, source.size }, target);
+            convert_pixels(target, pixel_encoding(options_));
+        }
+
+        // Decodes a probed source straight into `target`, usually its slot on an atlas page, and
+        // derives the hash, mask and field from the pixels there. The file is released.
+        void decode_source(Source& source, BitmapView target) const
+        {
+            decode_pixels(source, target);
+            if (options_.collision_threshold > 0)
+            {
+                source.mask = CollisionMask{ target, (uint8_t)std::min(options_.collision_threshold, 255) };
+            }
+            if (options_.distance_field_scale > 0)
+            {
+                source.field = DistanceField{ target, options_.distance_field_scale, options_.distance_field_spread };
+            }
+            source.hash = hash_pixels(target);
+            source.release_file();
+        }
+
+        // Picks the format of every clip from all of its frames, clips in parallel. A clip's frames
+        // are decoded into scratch memory for this and dropped again before the next clip, so at
+        // most one clip per worker is held besides the atlas and the probed scanlines.
+        void choose_formats(std::span<const std::filesystem::path> files, std::span<Source> sources)
+        {
+            std::map<std::string, std::vector<size_t>> clips;
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                if (sources[i].valid)
+                {
+                    clips[std::string{ parse_frame_name(files[i].stem().string()).first }].push_back(i);
+                }
+            }
+            auto members = clips | std::views::values | std::ranges::to<std::vector>();
+            std::vector<FormatChoice> choices(members.size());
+            pool_->parallel_for(members.size(), [&](size_t clip)
+            {
+                size_t texels = 0;
+                for (size_t i : members[clip])
+                {
+                    texels += sources[i].size.x() * sources[i].size.y();
+                }
+                std::vector<Color32> pixels(texels);
+                std::vector<BitmapView> views;
+                texels = 0;
+                for (size_t i : members[clip])
+                {
+                    views.push_back({ pixels.data() + texels, sources[i].size });
+                    decode_pixels(sources[i], views.back());
+                    texels += sources[i].size.x() * sources[i].size.y();
+                }
+                choices[clip] = choose_format(views, pixel_encoding(options_), options_.format_tolerance);
+            });
+            for (size_t clip = 0; clip < members.size(); clip++)
+            {
+                uint32_t palette = no_palette;
+                if (choices[clip].format == PixelFormat::palette8)
+                {
+                    palette = (uint32_t)palettes_.size();
+                    palettes_.push_back(std::move(choices[clip].palette));
+                }
+                for (size_t i : members[clip])
+                {
+                    sources[i].format = choices[clip].format;
+                    sources[i].palette = palette;
+                }
+            }
+        }
+
+        // Packs probed sources into a fresh atlas, decodes each straight into its slot, then
+        // writes the cache.
+        void build(std::span<const std::filesystem::path> files, std::span<Source> sources)
+        {
+            const AtlasOptions& options = options_;
+            WorkerPool& pool = *pool_;
+            auto start = std::chrono::steady_clock::now();
+            const bool compact = uses_compact_formats(options);
+            if (compact)
+            {
+                choose_formats(files, sources);
+            }
+
+            // Identical files decode to identical frames, so they get no slot of their own.
+            std::unordered_multimap<uint64_t, size_t> unique_by_file;
+            for (size_t i = 0; i < sources.size(); i++)
+            {
+                Source& source = sources[i];
+                source.unique = i;
+                if (not source.valid)
+                {
+                    continue;
+                }
+                auto [first, last] = unique_by_file.equal_range(source.file_hash);
+                auto same = std::ranges::find_if(first, last, [&](const auto& entry){
+                    const Source& other = sources[entry.second];
+                    return other.format == source.format && other.palette == source.palette && std::ranges::equal(other.file, source.file);
+                });
+                if (same != last)
+                {
+                    source.unique = same->second;
+                    source.release_file();
+                    continue;
+                }
+                unique_by_file.emplace(source.file_hash, i);
+            }
+
+            auto sizes = std::views::iota(0uz, sources.size())
+                        | std::views::transform([&](size_t i){ return sources[i].valid && sources[i].unique == i ? sources[i].size : Coord2{ 0uz, 0uz }; })
+                        | std::ranges::to<std::vector>();
+            const auto groups = sources | std::views::transform([](const Source& source){ return (uint32_t)source.format; }) | std::ranges::to<std::vector>();
+            AtlasLayout layout;
+            if (not (compact ? pack_atlas_groups(sizes, groups, options, layout) : pack_atlas(sizes, options, layout)))
+            {
+                print_and_throw("{} frames do not fit into a {}x{} atlas", sizes.size(), options.max_size, options.max_size);
+            }
+            timings_.pack = lap(start);
+
+            atlas_size_ = layout.size;
+            page_count_ = layout.page_count;
+            mip_levels_ = std::clamp(options.mip_levels, 1uz, (size_t)std::bit_width(std::min(atlas_size_.x(), atlas_size_.y())));
+            free_list_ = AtlasFreeList{ std::move(layout.free_rects), options, layout.page_groups };
+            atlas_storage_.resize(level_offset(atlas_size_, page_count_, mip_levels_));
+            atlas_data_ = atlas_storage_.data();
+            if (compact)
+            {
+                page_formats_.resize(page_count_, PixelFormat::rgba8);
+                std::ranges::transform(layout.page_groups, page_formats_.begin(), [](uint32_t group){ return (PixelFormat)group; });
+                compact_storage_.resize(compact_bytes());
+                compact_data_ = compact_storage_.data();
+            }
+            const auto slot = [&](size_t i)
+            {
+                return BitmapView{ &page(layout.layers[i])[layout.positions[i]], sources[i].size, atlas_size_.x() };
+            };
+            pool.parallel_for(sources.size(), [&](size_t i)
+            {
+                if (sources[i].valid && sources[i].unique == i)
+                {
+                    decode_source(sources[i], slot(i));
+                }
+            });
+            timings_.decode = lap(start);
+
+            // Files that differ but decode to the same pixels share the first slot; the others go
+            // back to the free list, cleared so the page reads as if they had never been there.
+            std::unordered_multimap<uint64_t, size_t> unique_by_hash;
+            for (size_t i = 0; i < sources.size(); i++)
+            {
+                Source& source = sources[i];
+                if (not source.valid || source.unique != i || source.size.x() == 0 || source.size.y() == 0)
+                {
+                    continue;
+                }
+                auto [first, last] = unique_by_hash.equal_range(source.hash);
+                auto same = std::ranges::find_if(first, last, [&](const auto& entry){
+                    const Source& other = sources[entry.second];
+                    return other.format == source.format && other.palette == source.palette && equal_pixels(slot(entry.second), slot(i));
+                });
+                if (same == last)
+                {
+                    unique_by_hash.emplace(source.hash, i);
+                    continue;
+                }
+                const BitmapView pixels = slot(i);
+                for (size_t y = 0; y < pixels.height(); y++)
+                {
+                    std::memset(&pixels[Coord2{ 0uz, y }], 0, pixels.width() * sizeof(Color32));
+                }
+                free_list_.release(layout.layers[i], layout.positions[i], source.size);
+                source.unique = same->second;
+            }
+            for (size_t i = 0; i < sources.size(); i++)
+            {
+                sources[i].unique = sources[sources[i].unique].unique;
+            }
+
+            pool.parallel_for(sources.size(), [&](size_t i)
+            {
+                const Source& source = sources[i];
+                if (not source.valid || source.unique != i || source.size.x() == 0 || source.size.y() == 0)
+                {
+                    return;
+                }
+                extrude_edges(page(layout.layers[i]), layout.positions[i], source.size, options.extrude);
+                build_mips(layout.layers[i], slot_rect(layout.positions[i], source.size));
+                encode_slot(layout.layers[i], slot_rect(layout.positions[i], source.size), source.palette);
+            });
+            compress_pages();
+
+            report_invalid(files, sources);
+            for (size_t i = 0; i < files.size(); i++)
+            {
+                const Source& source = sources[i];
+                if (not source.valid)
+                {
+                    continue;
+                }
+                // Duplicates were never decoded; they take the mask and field of their twin.
+                const Source& decoded = sources[source.unique];
+                frame_names_.push_back(files[i].stem().string());
+                frames_.push_back({ layout.positions[source.unique], source.size, source.offset, source.source_size, layout.layers[source.unique], source.palette });
+                if (options.collision_threshold > 0)
+                {
+                    masks_.push_back(decoded.mask);
+                }
+                if (options.distance_field_scale > 0)
+                {
+                    fields_.push_back(decoded.field);
+                }
+            }
+            build_clips();
+            measure_efficiency();
+            timings_.copy = lap(start);
+
+            save_cache();
+            timings_.save = lap(start);
+        }
+
+        static std::chrono::nanoseconds lap(std::chrono::steady_clock::time_point& start) noexcept
+        {
+            const auto now = std::chrono::steady_clock::now();
+            return now - std::exchange(start, now);
+        }
+
+        // Drops the frame and manifest entry of `path`. The atlas space is released unless a
+        // duplicate frame still shares it.
+        void remove_frame(const std::filesystem::path& path)
+        {
+            std::erase_if(manifest_, [&](const ManifestEntry& entry){ return entry.name == path.filename().string(); });
+            auto name = std::ranges::find(frame_names_, path.stem().string());
+            if (name == frame_names_.end())
+            {
+                return;
+            }
+            const size_t index = name - frame_names_.begin();
+            const Frame frame = frames_[index];
+            frames_.erase(frames_.begin() + index);
+            frame_names_.erase(name);
+            if (not masks_.empty())
+            {
+                masks_.erase(masks_.begin() + index);
+            }
+            if (not fields_.empty())
+            {
+                release_field(index);
+                fields_.erase(fields_.begin() + index);
+            }
+            // Empty frames own no space; they all sit at the origin of page 0.
+            if (frame.size.x() == 0 || frame.size.y() == 0)
+            {
+                return;
+            }
+            const bool shared = std::ranges::any_of(frames_, [&](const Frame& other){
+                return other.layer == frame.layer && other.position.x() == frame.position.x() && other.position.y() == frame.position.y()
+                    && other.size.x() == frame.size.x() && other.size.y() == frame.size.y();
+            });
+            if (not shared)
+            {
+                free_list_.release(frame.layer, frame.position, frame.size);
+            }
+        }
+
+        // Recomputes efficiency() after frames were added or removed in place, counting the
+        // slot of duplicate frames once, as pack_atlas() does.
+        void measure_efficiency()
+        {
+            std::vector<const Frame*> slots;
+            for (const Frame& frame : frames_)
+            {
+                if (frame.size.x() != 0 && frame.size.y() != 0)
+                {
+                    slots.push_back(&frame);
+                }
+            }
+            const auto key = [](const Frame* frame){ return std::array{ (size_t)frame->layer, frame->position.y(), frame->position.x() }; };
+            std::ranges::sort(slots, {}, key);
+            const auto [first, last] = std::ranges::unique(slots, {}, key);
+            slots.erase(first, last);
+            size_t used = 0;
+            for (const Frame* frame : slots)
+            {
+                used += frame->size.x() * frame->size.y();
+            }
+            const size_t total = atlas_size_.x() * atlas_size_.y() * page_count_;
+            efficiency_ = total ? (double)used / (double)total : 0.0;
+        }
+
+        // Content of `path`: straight from the pack mapping when stored uncompressed, otherwise
+        // read or decompressed into `storage`.
+        std::span<const std::byte> read_file(const std::filesystem::path& path, std::vector<std::byte>& storage) const
+        {
+            if (pack_)
+            {
+                const AssetPack::Entry* entry = pack_entry(path);
+                return entry ? pack_->read(*entry, storage) : std::span<const std::byte>{};
+            }
+            std::ifstream file{ path, std::ios::binary | std::ios::ate };
+            if (not file)
+            {
+                return {};
+            }
+            storage.resize((size_t)file.tellg());
+            file.seekg(0);
+            file.read((char*)storage.data(), storage.size());
+            return storage;
+        }
+
+        std::filesystem::path folder_;
+        AtlasOptions options_;
+        WorkerPool* pool_ = nullptr;
+        // Source of the PNGs and cache instead of the file system, see the pack constructor.
+        const AssetPack* pack_ = nullptr;
+        std::vector<ManifestEntry> manifest_;
+        // `.meta` files and the rules compiled from them, in file order.
+        std::vector<ManifestEntry> sidecars_;
+        std::vector<FrameMetaRule> meta_rules_;
+        AtlasFreeList free_list_;
+        std::vector<DirtyRect> dirty_rects_;
+
+        // Points into atlas_storage_ after a rebuild or into cache_file_ after a cache hit. Null
+        // once upload() dropped the CPU copy.
+        Color32* atlas_data_ = nullptr;
+        std::vector<Color32> atlas_storage_;
+        // Block compressed pages in options_.compression, in atlas_storage_'s or the mapping's
+        // place; null without compression.
+        std::byte* compressed_data_ = nullptr;
+        std::vector<std::byte> compressed_storage_;
+        // Compact pages, one PixelFormat per page in page_formats_, stored like the block
+        // compressed ones; null without compact formats.
+        std::byte* compact_data_ = nullptr;
+        std::vector<std::byte> compact_storage_;
+        std::vector<PixelFormat> page_formats_;
+        std::vector<Palette> palettes_;
+        // Colours set_palette() swapped in per clip, and whether palette_gpu_ lags behind them.
+        std::unordered_map<AnimId, std::vector<Color32>> palette_swaps_;
+        bool palettes_changed_ = false;
+        MappedFile cache_file_;
+        Coord2 atlas_size_;
+        size_t page_count_ = 0;
+        size_t mip_levels_ = 1;
+        double efficiency_ = 0.0;
+        LoadTimings timings_;
+        std::vector<Frame> frames_;
+        std::vector<std::string> frame_names_;
+        // One per frame when AtlasOptions::collision_threshold is set.
+        std::vector<CollisionMask> masks_;
+        // One per frame when AtlasOptions::distance_field_scale is set, on R8 pages of their
+        // own at field_layers_ and field_positions_. Fields keep their slot across updates, new
+        // ones take space from field_free_list_; fields_changed_ until the slot rects in
+        // field_dirty_ are uploaded.
+        std::vector<DistanceField> fields_;
+        std::vector<Coord2> field_positions_;
+        std::vector<uint32_t> field_layers_;
+        AtlasFreeList field_free_list_;
+        std::vector<DirtyRect> field_dirty_;
+        Coord2 field_page_size_;
+        size_t field_page_count_ = 0;
+        bool fields_changed_ = false;
+        std::vector<Clip> clips_;
+        std::unordered_map<AnimId, uint32_t> clip_index_;
+        FrameTable frame_table_;
+
+        VulkanContext gpu_context_ = {};
+        SubmitBatcher* batcher_ = nullptr;
+        bool keep_cpu_copy_ = false;
+        std::vector<GpuPages> gpu_;
+        std::unique_ptr<AtlasTexture> palette_gpu_;
+        std::unique_ptr<AtlasTexture> field_gpu_;
+    };
+}
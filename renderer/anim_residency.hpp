@@ -0,0 +1,309 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <optional>
+#include <functional>
+#include <filesystem>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <ranges>
+
+#include <renderer/common.hpp>
+#include <renderer/worker_pool.hpp>
+#include <renderer/anim_manager.hpp>
+
+namespace adttil
+{
+    struct AnimBudget
+    {
+        size_t cpu_bytes = 256uz << 20;
+        // Counted as the atlas size each resident set occupies once uploaded, compressed or RGBA8.
+        size_t gpu_bytes = 256uz << 20;
+    };
+
+    // Streams animation sets, one sub folder of `root` each (e.g. one per character), in and out
+    // of memory. Sets load on first use on the worker pool; when the resident sets exceed the
+    // CPU or GPU budget the least recently used ones are released, also off the calling thread.
+    class AnimResidency : NoMoveable
+    {
+    public:
+        using SetId = uint32_t;
+
+        AnimResidency(const std::filesystem::path& root, const AnimBudget& budget = {},
+            const AtlasOptions& options = {}, WorkerPool& pool = WorkerPool::shared())
+        : budget_{ budget }
+        , options_{ options }
+        , pool_{ pool }
+        , placeholder_{ AnimManager::placeholder() }
+        {
+            namespace fs = std::filesystem;
+            auto folders = fs::directory_iterator(root)
+                        | std::views::filter([](auto& entry){ return entry.is_directory(); })
+                        | std::views::transform([](auto& entry){ return entry.path(); })
+                        | std::ranges::to<std::vector>();
+            std::ranges::sort(folders);
+            sets_.resize(folders.size());
+            for (size_t i = 0; i < folders.size(); i++)
+            {
+                sets_[i].path = folders[i];
+                sets_[i].name = folders[i].filename().string();
+            }
+        }
+
+        // Loads still in flight reference this object and are waited for.
+        ~AnimResidency() noexcept
+        {
+            std::unique_lock lock{ mutex_ };
+            idle_.wait(lock, [&]{ return loading_ == 0; });
+        }
+
+        std::optional<SetId> find_set(std::string_view name) const
+        {
+            auto iter = std::ranges::find(sets_, name, &Set::name);
+            return iter == sets_.end() ? std::nullopt : std::optional{ (SetId)(iter - sets_.begin()) };
+        }
+
+        size_t set_count() const noexcept
+        {
+            return sets_.size();
+        }
+
+        // Marks the set as used on `frame`. Returns it when resident; otherwise starts loading it
+        // and returns null, in which case placeholder() should be drawn until a later frame.
+        const AnimManager* acquire(SetId id, uint64_t frame)
+        {
+            Set& set = sets_[id];
+            set.last_used = frame;
+            if (set.state == State::unloaded)
+            {
+                start_load(id);
+            }
+            return set.state == State::resident ? set.anim.get() : nullptr;
+        }
+
+        // Starts loading without marking the set as used, e.g. for the next level's roster.
+        void prefetch(SetId id)
+        {
+            if (sets_[id].state == State::unloaded)
+            {
+                start_load(id);
+            }
+        }
+
+        const AnimManager& placeholder() const noexcept
+        {
+            return placeholder_;
+        }
+
+        // Why the last load of the set failed, empty unless it did. A failed set is not loaded
+        // again by acquire() until retry() is called, e.g. after its files were fixed.
+        std::string_view error(SetId id) const noexcept
+        {
+            return sets_[id].error;
+        }
+
+        void retry(SetId id)
+        {
+            Set& set = sets_[id];
+            if (set.state == State::failed)
+            {
+                set.state = State::unloaded;
+                set.error.clear();
+            }
+        }
+
+        // Called once per frame: makes finished loads resident, then releases the least recently
+        // used sets while over budget. Sets used on `frame` itself are never released.
+        void update(uint64_t frame)
+        {
+            {
+                std::lock_guard lock{ mutex_ };
+                for (Loaded& loaded : loaded_)
+                {
+                    Set& set = sets_[loaded.id];
+                    if (not loaded.anim)
+                    {
+                        set.state = State::failed;
+                        set.error = std::move(loaded.error);
+                        continue;
+                    }
+                    set.anim = std::move(loaded.anim);
+                    set.state = State::resident;
+                    if (batcher_)
+                    {
+                        set.anim->upload(gpu_context_, *batcher_);
+                    }
+                    set.cpu_bytes = set.anim->memory_bytes();
+                    set.gpu_bytes = set.anim->gpu_bytes();
+                    cpu_bytes_ += set.cpu_bytes;
+                    gpu_bytes_ += set.gpu_bytes;
+                }
+                loaded_.clear();
+            }
+
+            while (cpu_bytes_ > budget_.cpu_bytes || gpu_bytes_ > budget_.gpu_bytes)
+            {
+                auto resident = std::views::iota(0uz, sets_.size())
+                    | std::views::filter([&](size_t i){ return sets_[i].state == State::resident && sets_[i].last_used < frame; });
+                auto victim = std::ranges::min_element(resident, {}, [&](size_t i){ return sets_[i].last_used; });
+                if (victim == resident.end())
+                {
+                    break;
+                }
+                evict((SetId)*victim);
+            }
+        }
+
+        // Uploads the placeholder. Sets becoming resident from now on are uploaded on update() and
+        // their CPU pixels dropped; the GPU atlases of evicted sets are freed by sync_gpu() once
+        // the frames that may still sample them have finished.
+        void set_gpu(const VulkanContext& context, SubmitBatcher& batcher)
+        {
+            gpu_context_ = context;
+            batcher_ = &batcher;
+            placeholder_.upload(context, batcher);
+        }
+
+        // Called once per frame after submit: frees finished staging buffers of the resident sets
+        // and the GPU atlases of evicted sets the GPU is done with.
+        void sync_gpu()
+        {
+            placeholder_.sync_gpu();
+            for (Set& set : sets_)
+            {
+                if (set.state == State::resident)
+                {
+                    set.anim->sync_gpu();
+                }
+            }
+            while (not retired_.empty() && batcher_->is_complete(retired_.front().serial))
+            {
+                retired_.pop_front();
+            }
+        }
+
+        // Called on eviction before the set is released, so GPU copies can be dropped.
+        void set_evict_callback(std::function<void(SetId)> callback)
+        {
+            evict_callback_ = std::move(callback);
+        }
+
+        size_t cpu_bytes() const noexcept
+        {
+            return cpu_bytes_;
+        }
+
+        size_t gpu_bytes() const noexcept
+        {
+            return gpu_bytes_;
+        }
+
+    private:
+        enum class State
+        {
+            unloaded,
+            loading,
+            resident,
+            failed,
+        };
+
+        struct Set
+        {
+            std::filesystem::path        path;
+            std::string                  name;
+            State                        state = State::unloaded;
+            std::shared_ptr<AnimManager> anim;
+            uint64_t                     last_used = 0;
+            size_t                       cpu_bytes = 0;
+            size_t                       gpu_bytes = 0;
+            std::string                  error;
+        };
+
+        struct Retired
+        {
+            uint64_t                                   serial;
+            std::vector<std::unique_ptr<AtlasTexture>> textures;
+        };
+
+        struct Loaded
+        {
+            SetId                        id;
+            std::shared_ptr<AnimManager> anim;
+            std::string                  error;
+        };
+
+        void start_load(SetId id)
+        {
+            sets_[id].state = State::loading;
+            {
+                std::lock_guard lock{ mutex_ };
+                ++loading_;
+            }
+            pool_.submit([this, id, path = sets_[id].path]
+            {
+                std::shared_ptr<AnimManager> anim;
+                std::string error;
+                try
+                {
+                    anim = std::make_shared<AnimManager>(path.string().c_str(), options_, pool_);
+                }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                }
+                catch (...)
+                {
+                    error = "unknown error";
+                }
+                std::lock_guard lock{ mutex_ };
+                loaded_.push_back({ id, std::move(anim), std::move(error) });
+                if (--loading_ == 0)
+                {
+                    idle_.notify_all();
+                }
+            });
+        }
+
+        void evict(SetId id)
+        {
+            Set& set = sets_[id];
+            if (evict_callback_)
+            {
+                evict_callback_(id);
+            }
+            cpu_bytes_ -= set.cpu_bytes;
+            gpu_bytes_ -= set.gpu_bytes;
+            set.state = State::unloaded;
+            // ImGui descriptors and Vulkan objects are not freed from workers, nor while the
+            // frames that may sample them are in flight; sync_gpu() frees them later.
+            auto textures = set.anim->take_gpu();
+            if (not textures.empty())
+            {
+                retired_.push_back({ batcher_->pending_serial(), std::move(textures) });
+            }
+            // Unmapping and freeing a large atlas is left to a worker.
+            pool_.submit([anim = std::move(set.anim)]() mutable { anim.reset(); });
+        }
+
+        AnimBudget budget_;
+        AtlasOptions options_;
+        WorkerPool& pool_;
+        AnimManager placeholder_;
+        std::vector<Set> sets_;
+        size_t cpu_bytes_ = 0;
+        size_t gpu_bytes_ = 0;
+        std::function<void(SetId)> evict_callback_;
+        VulkanContext gpu_context_ = {};
+        SubmitBatcher* batcher_ = nullptr;
+        std::deque<Retired> retired_;
+
+        std::mutex mutex_;
+        std::condition_variable idle_;
+        std::vector<Loaded> loaded_;
+        size_t loading_ = 0;
+    };
+}
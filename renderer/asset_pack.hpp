@@ -0,0 +1,383 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include <renderer/common.hpp>
+#include <renderer/mapped_file.hpp>
+
+namespace adttil
+{
+    enum class PackCompression : uint32_t
+    {
+        none,
+        // LZ4 block layout: sequences of literals plus a match of at least 4 bytes within 64 KiB.
+        lz,
+    };
+
+    namespace detail
+    {
+        inline constexpr size_t lz_min_match = 4;
+        inline constexpr size_t lz_hash_bits = 14;
+
+        inline uint32_t read_u32(const std::byte* at) noexcept
+        {
+            uint32_t value;
+            std::memcpy(&value, at, sizeof(value));
+            return value;
+        }
+
+        // Lengths past the 4-bit token field continue in bytes of 255 ended by a smaller one.
+        inline void write_length(std::vector<std::byte>& out, size_t length)
+        {
+            for (; length >= 255; length -= 255)
+            {
+                out.push_back((std::byte)255);
+            }
+            out.push_back((std::byte)length);
+        }
+
+        inline bool read_length(std::span<const std::byte> in, size_t& at, size_t& length) noexcept
+        {
+            for (uint8_t next = 255; next == 255;)
+            {
+                if (at == in.size())
+                {
+                    return false;
+                }
+                next = (uint8_t)in[at++];
+                length += next;
+            }
+            return true;
+        }
+    }
+
+    // Greedy single probe compressor, fast enough to run over every asset at build time.
+    inline std::vector<std::byte> lz_compress(std::span<const std::byte> in)
+    {
+        std::vector<std::byte> out;
+        out.reserve(in.size() / 2 + 16);
+        std::vector<uint32_t> table(1uz << detail::lz_hash_bits, UINT32_MAX);
+        const auto emit = [&](size_t anchor, size_t literals, size_t offset, size_t match)
+        {
+            const size_t match_code = match ? match - detail::lz_min_match : 0;
+            out.push_back((std::byte)(std::min(literals, 15uz) << 4 | std::min(match_code, 15uz)));
+            if (literals >= 15)
+            {
+                detail::write_length(out, literals - 15);
+            }
+            out.insert(out.end(), in.begin() + anchor, in.begin() + anchor + literals);
+            if (match)
+            {
+                out.push_back((std::byte)(offset & 0xff));
+                out.push_back((std::byte)(offset >> 8));
+                if (match_code >= 15)
+                {
+                    detail::write_length(out, match_code - 15);
+                }
+            }
+        };
+
+        size_t at = 0, anchor = 0;
+        while (at + detail::lz_min_match <= in.size())
+        {
+            const uint32_t sequence = detail::read_u32(in.data() + at);
+            const uint32_t hash = (sequence * 2654435761u) >> (32 - detail::lz_hash_bits);
+            const uint32_t candidate = std::exchange(table[hash], (uint32_t)at);
+            if (candidate == UINT32_MAX || at - candidate > 0xffff || detail::read_u32(in.data() + candidate) != sequence)
+            {
+                at++;
+                continue;
+            }
+            size_t match = detail::lz_min_match;
+            while (at + match < in.size() && in[candidate + match] == in[at + match])
+            {
+                match++;
+            }
+            emit(anchor, at - anchor, at - candidate, match);
+            at += match;
+            anchor = at;
+        }
+        emit(anchor, in.size() - anchor, 0, 0);
+        return out;
+    }
+
+    // Decodes into `out`, which must be exactly the original size. False on malformed input.
+    inline bool lz_decompress(std::span<const std::byte> in, std::span<std::byte> out) noexcept
+    {
+        size_t at = 0, written = 0;
+        while (at < in.size())
+        {
+            const auto token = (uint8_t)in[at++];
+            size_t literals = token >> 4;
+            if (literals == 15 && not detail::read_length(in, at, literals))
+            {
+                return false;
+            }
+            if (literals > in.size() - at || literals > out.size() - written)
+            {
+                return false;
+            }
+            if (literals)
+            {
+                std::memcpy(out.data() + written, in.data() + at, literals);
+            }
+            at += literals;
+            written += literals;
+            if (at == in.size())
+            {
+                break;
+            }
+
+            if (in.size() - at < 2)
+            {
+                return false;
+            }
+            const size_t offset = (size_t)in[at] | (size_t)in[at + 1] << 8;
+            at += 2;
+            size_t match = token & 15;
+            if (match == 15 && not detail::read_length(in, at, match))
+            {
+                return false;
+            }
+            match += detail::lz_min_match;
+            if (offset == 0 || offset > written || match > out.size() - written)
+            {
+                return false;
+            }
+            // Overlapping matches repeat the bytes just written, so copy forwards one at a time.
+            for (size_t i = 0; i < match; i++, written++)
+            {
+                out[written] = out[written - offset];
+            }
+        }
+        return written == out.size();
+    }
+
+    // Read only archive of many files in one mapping: a header, an index sorted by name, the name
+    // table, then the payloads, each starting on a 4 KiB boundary so uncompressed entries, such as
+    // baked atlas caches, can be used in place. Opening a pack costs one mapping; each entry
+    // faults in only the pages it touches.
+    class AssetPack
+    {
+    public:
+        struct Entry
+        {
+            std::string_view     name;
+            uint64_t             size;
+            // Hash of the uncompressed content, see hash_bytes().
+            uint64_t             hash;
+            // Modification time of the packed file.
+            int64_t              mtime;
+            PackCompression      compression;
+            // Payload as stored, compressed or not.
+            std::span<std::byte> stored;
+        };
+
+        static constexpr uint64_t payload_alignment = 4096;
+
+        AssetPack() = default;
+
+        // Maps the pack at `path`. A missing or malformed pack leaves it closed.
+        explicit AssetPack(const std::filesystem::path& path)
+        : file_{ path }
+        {
+            const std::span<std::byte> bytes = file_.bytes();
+            Header header;
+            if (bytes.size() < sizeof(header))
+            {
+                return;
+            }
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            const auto fits = [&](uint64_t offset, uint64_t size){ return offset <= bytes.size() && size <= bytes.size() - offset; };
+            if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version
+                || not fits(header.index_offset, (uint64_t)header.entry_count * sizeof(IndexEntry))
+                || not fits(header.names_offset, header.names_size))
+            {
+                return;
+            }
+            std::vector<Entry> entries(header.entry_count);
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                IndexEntry entry;
+                std::memcpy(&entry, bytes.data() + header.index_offset + i * sizeof(IndexEntry), sizeof(entry));
+                if ((uint64_t)entry.name_offset + entry.name_length > header.names_size || not fits(entry.offset, entry.stored_size)
+                    || entry.compression > (uint32_t)PackCompression::lz
+                    || (entry.compression == (uint32_t)PackCompression::none && entry.stored_size != entry.size))
+                {
+                    return;
+                }
+                entries[i] = {
+                    std::string_view{ (const char*)bytes.data() + header.names_offset + entry.name_offset, entry.name_length },
+                    entry.size, entry.hash, entry.mtime, (PackCompression)entry.compression,
+                    bytes.subspan(entry.offset, entry.stored_size),
+                };
+            }
+            if (not std::ranges::is_sorted(entries, {}, &Entry::name))
+            {
+                return;
+            }
+            entries_ = std::move(entries);
+            open_ = true;
+        }
+
+        bool is_open() const noexcept
+        {
+            return open_;
+        }
+
+        // Every entry, sorted by name.
+        std::span<const Entry> entries() const noexcept
+        {
+            return entries_;
+        }
+
+        const Entry* find(std::string_view name) const noexcept
+        {
+            auto iter = std::ranges::lower_bound(entries_, name, {}, &Entry::name);
+            return iter != entries_.end() && iter->name == name ? &*iter : nullptr;
+        }
+
+        // Entries whose name starts with `prefix`, e.g. the files of folder "anims/hero/".
+        std::span<const Entry> entries_with_prefix(std::string_view prefix) const noexcept
+        {
+            auto first = std::ranges::lower_bound(entries_, prefix, {}, &Entry::name);
+            auto last = std::find_if(first, entries_.end(), [&](const Entry& entry){ return not entry.name.starts_with(prefix); });
+            return { first, last };
+        }
+
+        // Content of `entry`: the mapping itself when stored uncompressed, otherwise decoded
+        // into `storage`. Empty when a compressed entry is corrupt.
+        std::span<const std::byte> read(const Entry& entry, std::vector<std::byte>& storage) const
+        {
+            if (entry.compression == PackCompression::none)
+            {
+                return entry.stored;
+            }
+            storage.resize(entry.size);
+            if (not lz_decompress(entry.stored, storage))
+            {
+                storage.clear();
+            }
+            return storage;
+        }
+
+        struct Input
+        {
+            std::string            name;
+            std::vector<std::byte> content;
+            int64_t                mtime = 0;
+            // Compressed only when that actually saves space.
+            bool                   compress = false;
+        };
+
+        // Writes `inputs` as a pack at `path`, through a temporary file renamed over the target.
+        static bool write(const std::filesystem::path& path, std::span<Input> inputs)
+        {
+            std::ranges::sort(inputs, {}, &Input::name);
+            std::string names;
+            std::vector<IndexEntry> index(inputs.size());
+            std::vector<std::vector<std::byte>> compressed(inputs.size());
+            for (size_t i = 0; i < inputs.size(); i++)
+            {
+                const Input& input = inputs[i];
+                if (input.compress)
+                {
+                    compressed[i] = lz_compress(input.content);
+                    if (compressed[i].size() >= input.content.size())
+                    {
+                        compressed[i] = {};
+                    }
+                }
+                const bool packed = not compressed[i].empty();
+                index[i] = { 0, packed ? compressed[i].size() : input.content.size(), input.content.size(),
+                    hash_bytes(input.content.data(), input.content.size()), input.mtime,
+                    (uint32_t)names.size(), (uint32_t)input.name.size(),
+                    (uint32_t)(packed ? PackCompression::lz : PackCompression::none), 0 };
+                names += input.name;
+            }
+
+            Header header = {};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.entry_count = (uint32_t)inputs.size();
+            header.index_offset = sizeof(Header);
+            header.names_offset = header.index_offset + index.size() * sizeof(IndexEntry);
+            header.names_size = names.size();
+            uint64_t offset = header.names_offset + names.size();
+            for (IndexEntry& entry : index)
+            {
+                entry.offset = (offset + payload_alignment - 1) / payload_alignment * payload_alignment;
+                offset = entry.offset + entry.stored_size;
+            }
+
+            std::filesystem::path temp_path = path;
+            temp_path += ".tmp";
+            {
+                std::ofstream file{ temp_path, std::ios::binary | std::ios::trunc };
+                file.write((const char*)&header, sizeof(header));
+                file.write((const char*)index.data(), index.size() * sizeof(IndexEntry));
+                file.write(names.data(), names.size());
+                uint64_t written = header.names_offset + names.size();
+                const std::vector<char> zeros(payload_alignment);
+                for (size_t i = 0; i < inputs.size(); i++)
+                {
+                    file.write(zeros.data(), index[i].offset - written);
+                    const std::span<const std::byte> payload = compressed[i].empty() ? std::span<const std::byte>{ inputs[i].content } : compressed[i];
+                    file.write((const char*)payload.data(), payload.size());
+                    written = index[i].offset + payload.size();
+                }
+                if (not file)
+                {
+                    std::println("failed to write asset pack {}", temp_path.string());
+                    return false;
+                }
+            }
+            std::error_code error;
+            std::filesystem::rename(temp_path, path, error);
+            if (error)
+            {
+                std::println("failed to write asset pack {}: {}", path.string(), error.message());
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        static constexpr char     magic[8] = "ADTPACK";
+        static constexpr uint32_t version = 1;
+
+        struct Header
+        {
+            char     magic[8];
+            uint32_t version;
+            uint32_t entry_count;
+            uint64_t index_offset;
+            uint64_t names_offset;
+            uint64_t names_size;
+        };
+
+        struct IndexEntry
+        {
+            uint64_t offset;
+            uint64_t stored_size;
+            uint64_t size;
+            uint64_t hash;
+            int64_t  mtime;
+            uint32_t name_offset;
+            uint32_t name_length;
+            uint32_t compression;
+            uint32_t reserved;
+        };
+
+        MappedFile file_;
+        std::vector<Entry> entries_;
+        bool open_ = false;
+    };
+}
@@ -0,0 +1,454 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <optional>
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+#include <renderer/stb_libs.hpp>
+#include <renderer/block_compress.hpp>
+#include <renderer/pixel_convert.hpp>
+
+namespace adttil
+{
+    struct AtlasOptions
+    {
+        // Empty pixels between neighbouring rects.
+        size_t padding = 2;
+        // Border pixels repeated outwards around every rect so filtering never samples a neighbour.
+        size_t extrude = 1;
+        bool   power_of_two = true;
+        bool   square = false;
+        // Largest page extent tried, 4096 is the minimum maxImageDimension2D guaranteed by Vulkan.
+        // Content that does not fit spills onto further pages of this size.
+        size_t max_size = 4096;
+        size_t max_pages = 64;
+        // Block compressed copy of every page baked next to the RGBA8 pixels. Rects, with their
+        // extrusion and padding, are then placed on 4x4 block boundaries so no block mixes frames.
+        BlockFormat compression = BlockFormat::none;
+        // Levels of the mip chain, 1 for none. Rects are aligned to 2^(mip_levels - 1) pixels,
+        // times the block extent when compressed, so every texel or block of every level covers
+        // a single rect and its gutter, and no level bleeds between frames.
+        size_t mip_levels = 1;
+        // Load time conversion of the straight alpha sRGB source pixels. Converted pixels are what
+        // the cache stores and what gets uploaded, so shaders sample them as is.
+        bool   premultiply_alpha = false;
+        // Colour stays sRGB encoded, as 8 bits of linear light band in the darks; the pages get
+        // sRGB views so shaders sample linear light, and mips and premultiplication are done in
+        // linear light. Compact formats without an sRGB twin are skipped.
+        bool   linear_color = false;
+        // Alpha test reference in (0, 1) whose coverage every mip level keeps, 0 to disable.
+        float  alpha_coverage_reference = 0.0f;
+        // Stores every clip in the narrowest PixelFormat its content allows, see choose_format();
+        // clips of one format share pages. Ignored with block compression.
+        bool   compact_formats = false;
+        // Largest per channel error a lossy compact format may introduce, 0 for lossless only.
+        int    format_tolerance = 0;
+        // Alpha from which a pixel is solid in the CollisionMask baked for every frame, 0 for no
+        // masks.
+        int    collision_threshold = 0;
+        // Sprite pixels per texel of the DistanceField baked for every frame, 0 for no fields.
+        size_t distance_field_scale = 0;
+        // Pixels from the edge at which the fields saturate, and their margin around each frame;
+        // must be positive when fields are baked.
+        float  distance_field_spread = 8.0f;
+    };
+
+    inline PixelEncoding pixel_encoding(const AtlasOptions& options) noexcept
+    {
+        return { options.premultiply_alpha, options.linear_color };
+    }
+
+    // Granularity of rect positions and extents in pixels.
+    inline size_t atlas_alignment(const AtlasOptions& options) noexcept
+    {
+        const size_t block = options.compression == BlockFormat::none ? 1 : block_extent;
+        return block << (std::max(options.mip_levels, 1uz) - 1);
+    }
+
+    inline size_t align_up(size_t value, size_t alignment) noexcept
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    struct AtlasLayout
+    {
+        // Extent shared by every page.
+        Coord2                size;
+        size_t                page_count = 0;
+        // Top left corner of the content of each rect within its page, excluding extrusion and
+        // padding.
+        std::vector<Coord2>   positions;
+        std::vector<uint32_t> layers;
+        // Content area over the area of all pages.
+        double                efficiency = 0.0;
+        // Space left above the skyline of each page, for later incremental additions.
+        std::vector<std::vector<BitmapRect>> free_rects;
+        // Group of the rects on each page, filled by pack_atlas_groups() only.
+        std::vector<uint32_t> page_groups;
+    };
+
+    // Empty area of a page as one rect per skyline segment.
+    inline std::vector<BitmapRect> skyline_free_rects(const stbrp_context& context)
+    {
+        std::vector<BitmapRect> rects;
+        for (const stbrp_node* node = context.active_head; node && node->next; node = node->next)
+        {
+            if (node->y < context.height && node->next->x > node->x)
+            {
+                rects.push_back({ Coord2{ (size_t)node->x, (size_t)node->y },
+                    Coord2{ (size_t)(node->next->x - node->x), (size_t)(context.height - node->y) } });
+            }
+        }
+        return rects;
+    }
+
+    // Packs `sizes` with stb_rect_pack, growing a single page from the smallest extent that could
+    // hold the total area until everything fits. Past `max_size` the rects are spread over pages of
+    // `max_size`, filled one after another. Returns false when a rect fits no page or more than
+    // `max_pages` would be needed.
+    inline bool pack_atlas(std::span<const Coord2> sizes, const AtlasOptions& options, AtlasLayout& out)
+    {
+        const size_t border = options.extrude * 2 + options.padding;
+        const size_t alignment = atlas_alignment(options);
+        std::vector<stbrp_rect> rects(sizes.size());
+        size_t area = 0;
+        size_t min_width = 1;
+        size_t min_height = 1;
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            const bool empty = sizes[i].x() == 0 || sizes[i].y() == 0;
+            rects[i].id = (int)i;
+            rects[i].w = empty ? 0 : (int)align_up(sizes[i].x() + border, alignment);
+            rects[i].h = empty ? 0 : (int)align_up(sizes[i].y() + border, alignment);
+            area += (size_t)rects[i].w * rects[i].h;
+            min_width = std::max(min_width, (size_t)rects[i].w);
+            min_height = std::max(min_height, (size_t)rects[i].h);
+        }
+
+        const auto round = [&](size_t extent)
+        {
+            return options.power_of_two ? std::bit_ceil(extent) : align_up(extent, alignment);
+        };
+        const auto grow = [&](size_t extent)
+        {
+            return options.power_of_two ? extent * 2 : align_up(extent + std::max(extent / 8, 1uz), alignment);
+        };
+
+        size_t width = round(std::max(min_width, (size_t)std::ceil(std::sqrt((double)area))));
+        size_t height = round(std::max(min_height, (area + width - 1) / width));
+        if (options.square)
+        {
+            width = height = std::max(width, height);
+        }
+
+        out.positions.resize(sizes.size());
+        out.layers.resize(sizes.size());
+        out.free_rects.clear();
+        const auto place = [&](std::span<const stbrp_rect> packed, uint32_t layer)
+        {
+            for (const stbrp_rect& rect : packed)
+            {
+                out.positions[rect.id] = Coord2{ rect.x + options.extrude, rect.y + options.extrude };
+                out.layers[rect.id] = layer;
+            }
+        };
+        const auto finish = [&](size_t page_count)
+        {
+            size_t used = 0;
+            for (const Coord2& size : sizes)
+            {
+                used += size.x() * size.y();
+            }
+            out.size = Coord2{ width, height };
+            out.page_count = page_count;
+            out.efficiency = (double)used / (double)(width * height * page_count);
+            return true;
+        };
+
+        std::vector<stbrp_node> nodes;
+        while (width <= options.max_size && height <= options.max_size)
+        {
+            nodes.resize(width);
+            stbrp_context context;
+            stbrp_init_target(&context, (int)width, (int)height, nodes.data(), (int)nodes.size());
+            if (stbrp_pack_rects(&context, rects.data(), (int)rects.size()))
+            {
+                place(rects, 0);
+                out.free_rects.push_back(skyline_free_rects(context));
+                return finish(1);
+            }
+
+            if (options.square)
+            {
+                width = height = grow(width);
+            }
+            else if (height <= width)
+            {
+                height = grow(height);
+            }
+            else
+            {
+                width = grow(width);
+            }
+        }
+
+        width = height = options.power_of_two ? std::bit_floor(options.max_size) : options.max_size / alignment * alignment;
+        nodes.resize(width);
+        size_t page_count = 0;
+        while (not rects.empty())
+        {
+            if (page_count == options.max_pages)
+            {
+                return false;
+            }
+            stbrp_context context;
+            stbrp_init_target(&context, (int)width, (int)height, nodes.data(), (int)nodes.size());
+            stbrp_pack_rects(&context, rects.data(), (int)rects.size());
+            auto unpacked = std::ranges::partition(rects, [](const stbrp_rect& rect){ return rect.was_packed != 0; });
+            if (unpacked.begin() == rects.begin())
+            {
+                return false;
+            }
+            place({ rects.begin(), unpacked.begin() }, (uint32_t)page_count++);
+            out.free_rects.push_back(skyline_free_rects(context));
+            rects.erase(rects.begin(), unpacked.begin());
+        }
+        return finish(page_count);
+    }
+
+    // Packs each group of rects onto pages of its own, groups in ascending order, so no page mixes
+    // groups. Every page takes the largest extent of any group; what this adds to the pages of
+    // smaller groups is free space.
+    inline bool pack_atlas_groups(std::span<const Coord2> sizes, std::span<const uint32_t> groups, const AtlasOptions& options, AtlasLayout& out)
+    {
+        out = {};
+        out.positions.resize(sizes.size());
+        out.layers.resize(sizes.size());
+        std::vector<Coord2> page_sizes;
+        const uint32_t group_count = groups.empty() ? 0 : std::ranges::max(groups) + 1;
+        for (uint32_t group = 0; group < group_count; group++)
+        {
+            std::vector<Coord2> group_sizes(sizes.size());
+            bool empty = true;
+            for (size_t i = 0; i < sizes.size(); i++)
+            {
+                if (groups[i] == group && sizes[i].x() > 0 && sizes[i].y() > 0)
+                {
+                    group_sizes[i] = sizes[i];
+                    empty = false;
+                }
+            }
+            if (empty)
+            {
+                continue;
+            }
+            AtlasLayout layout;
+            if (not pack_atlas(group_sizes, options, layout) || out.page_count + layout.page_count > options.max_pages)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < sizes.size(); i++)
+            {
+                if (groups[i] == group)
+                {
+                    out.positions[i] = layout.positions[i];
+                    out.layers[i] = (uint32_t)out.page_count + layout.layers[i];
+                }
+            }
+            for (auto& rects : layout.free_rects)
+            {
+                out.free_rects.push_back(std::move(rects));
+                out.page_groups.push_back(group);
+                page_sizes.push_back(layout.size);
+            }
+            out.size = Coord2{ std::max(out.size.x(), layout.size.x()), std::max(out.size.y(), layout.size.y()) };
+            out.page_count += layout.page_count;
+        }
+        if (out.page_count == 0)
+        {
+            return pack_atlas(sizes, options, out);
+        }
+
+        size_t used = 0;
+        for (const Coord2& size : sizes)
+        {
+            used += size.x() * size.y();
+        }
+        for (size_t page = 0; page < out.page_count; page++)
+        {
+            const Coord2 size = page_sizes[page];
+            std::vector<BitmapRect>& rects = out.free_rects[page];
+            if (out.size.x() > size.x())
+            {
+                rects.push_back({ Coord2{ size.x(), 0uz }, Coord2{ out.size.x() - size.x(), out.size.y() } });
+            }
+            if (out.size.y() > size.y())
+            {
+                rects.push_back({ Coord2{ 0uz, size.y() }, Coord2{ size.x(), out.size.y() - size.y() } });
+            }
+        }
+        out.efficiency = (double)used / (double)(out.size.x() * out.size.y() * out.page_count);
+        return true;
+    }
+
+    // Free space of the pages of an existing layout, so single rects can be added, moved or
+    // removed without repacking everything. Allocation is best short side fit with a guillotine
+    // split; released rects are merged back with neighbours that share a full edge.
+    class AtlasFreeList
+    {
+    public:
+        AtlasFreeList() = default;
+
+        // `page_groups` restricts allocations to the pages of the requested group, see
+        // pack_atlas_groups(); empty when every page takes any rect.
+        AtlasFreeList(std::vector<std::vector<BitmapRect>> pages, const AtlasOptions& options, std::vector<uint32_t> page_groups = {})
+        : pages_{ std::move(pages) }
+        , page_groups_{ std::move(page_groups) }
+        , border_{ options.extrude * 2 + options.padding }
+        , extrude_{ options.extrude }
+        , alignment_{ atlas_alignment(options) }
+        {}
+
+        // Free rects of every page, with padding and extrusion included.
+        const std::vector<std::vector<BitmapRect>>& pages() const noexcept
+        {
+            return pages_;
+        }
+
+        // Returns the layer and content position for a rect of `size`, or nothing when no page
+        // of `group` has room.
+        std::optional<std::pair<uint32_t, Coord2>> allocate(Coord2 size, uint32_t group = 0)
+        {
+            const size_t w = align_up(size.x() + border_, alignment_);
+            const size_t h = align_up(size.y() + border_, alignment_);
+            size_t best_page = 0, best_index = 0, best_fit = SIZE_MAX;
+            for (size_t page = 0; page < pages_.size(); page++)
+            {
+                if (page < page_groups_.size() && page_groups_[page] != group)
+                {
+                    continue;
+                }
+                for (size_t i = 0; i < pages_[page].size(); i++)
+                {
+                    const BitmapRect& rect = pages_[page][i];
+                    if (rect.size.x() >= w && rect.size.y() >= h)
+                    {
+                        const size_t fit = std::min(rect.size.x() - w, rect.size.y() - h);
+                        if (fit < best_fit)
+                        {
+                            best_fit = fit;
+                            best_page = page;
+                            best_index = i;
+                        }
+                    }
+                }
+            }
+            if (best_fit == SIZE_MAX)
+            {
+                return std::nullopt;
+            }
+
+            std::vector<BitmapRect>& rects = pages_[best_page];
+            const BitmapRect rect = rects[best_index];
+            rects.erase(rects.begin() + best_index);
+            const size_t right = rect.size.x() - w;
+            const size_t below = rect.size.y() - h;
+            // Split along the shorter leftover so the larger piece stays as square as possible.
+            if (right < below)
+            {
+                push(best_page, { Coord2{ rect.position.x() + w, rect.position.y() }, Coord2{ right, h } });
+                push(best_page, { Coord2{ rect.position.x(), rect.position.y() + h }, Coord2{ rect.size.x(), below } });
+            }
+            else
+            {
+                push(best_page, { Coord2{ rect.position.x() + w, rect.position.y() }, Coord2{ right, rect.size.y() } });
+                push(best_page, { Coord2{ rect.position.x(), rect.position.y() + h }, Coord2{ w, below } });
+            }
+            return std::pair{ (uint32_t)best_page, Coord2{ rect.position.x() + extrude_, rect.position.y() + extrude_ } };
+        }
+
+        // Gives back the space of a rect placed by allocate() or by the original layout.
+        void release(uint32_t layer, Coord2 position, Coord2 size)
+        {
+            if (size.x() == 0 || size.y() == 0 || layer >= pages_.size())
+            {
+                return;
+            }
+            BitmapRect rect{ Coord2{ position.x() - extrude_, position.y() - extrude_ },
+                Coord2{ align_up(size.x() + border_, alignment_), align_up(size.y() + border_, alignment_) } };
+            std::vector<BitmapRect>& rects = pages_[layer];
+            for (bool merged = true; merged;)
+            {
+                merged = false;
+                for (size_t i = 0; i < rects.size(); i++)
+                {
+                    const BitmapRect& other = rects[i];
+                    const bool column = other.position.x() == rect.position.x() && other.size.x() == rect.size.x()
+                        && (other.position.y() + other.size.y() == rect.position.y() || rect.position.y() + rect.size.y() == other.position.y());
+                    const bool row = other.position.y() == rect.position.y() && other.size.y() == rect.size.y()
+                        && (other.position.x() + other.size.x() == rect.position.x() || rect.position.x() + rect.size.x() == other.position.x());
+                    if (column || row)
+                    {
+                        const Coord2 low{ std::min(rect.position.x(), other.position.x()), std::min(rect.position.y(), other.position.y()) };
+                        rect.size = column ? Coord2{ rect.size.x(), rect.size.y() + other.size.y() } : Coord2{ rect.size.x() + other.size.x(), rect.size.y() };
+                        rect.position = low;
+                        rects.erase(rects.begin() + i);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+            rects.push_back(rect);
+        }
+
+    private:
+        void push(size_t page, BitmapRect rect)
+        {
+            if (rect.size.x() > 0 && rect.size.y() > 0)
+            {
+                pages_[page].push_back(rect);
+            }
+        }
+
+        std::vector<std::vector<BitmapRect>> pages_;
+        std::vector<uint32_t> page_groups_;
+        size_t border_ = 0;
+        size_t extrude_ = 0;
+        size_t alignment_ = 1;
+    };
+
+    // Repeats the outermost pixels of the `size` rect at `position` outwards by `amount` pixels,
+    // corners included. The surrounding pixels must lie inside `atlas`.
+    inline void extrude_edges(BitmapView atlas, Coord2 position, Coord2 size, size_t amount)
+    {
+        if (amount == 0 || size.x() == 0 || size.y() == 0)
+        {
+            return;
+        }
+
+        const size_t x0 = position.x();
+        const size_t y0 = position.y();
+        const size_t x1 = x0 + size.x() - 1;
+        const size_t y1 = y0 + size.y() - 1;
+        for (size_t y = y0; y <= y1; y++)
+        {
+            for (size_t i = 1; i <= amount; i++)
+            {
+                atlas[Coord2{ x0 - i, y }] = atlas[Coord2{ x0, y }];
+                atlas[Coord2{ x1 + i, y }] = atlas[Coord2{ x1, y }];
+            }
+        }
+        for (size_t i = 1; i <= amount; i++)
+        {
+            for (size_t x = x0 - amount; x <= x1 + amount; x++)
+            {
+                atlas[Coord2{ x, y0 - i }] = atlas[Coord2{ x, y0 }];
+                atlas[Coord2{ x, y1 + i }] = atlas[Coord2{ x, y1 }];
+            }
+        }
+    }
+}
@@ -0,0 +1,475 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <span>
+#include <algorithm>
+#include <cstring>
+
+#include <imgui/imgui.h>
+#include <imgui/imgui_impl_vulkan.h>
+
+#include <renderer/common.hpp>
+#include <renderer/gpu_resource.hpp>
+#include <renderer/submit_batcher.hpp>
+#include <renderer/bitmap.hpp>
+
+namespace adttil
+{
+    // GPU copy of atlas pages: one 2D array image with a layer per page, plus a 2D view and an
+    // ImGui texture per layer. Uploads are staged, recorded into one command buffer with one copy
+    // per page and added to the SubmitBatcher, so they run ahead of the frame that flushes them.
+    // Pages are texels in row major order or, for BC formats, 4x4 blocks. Integer formats, such as
+    // palette indices, get a nearest sampler and no ImGui textures.
+    // Pages holding sRGB encoded colour that shaders should read as linear light can ask for an
+    // sRGB array view; the bytes stay the same and the ImGui textures keep the UNORM format,
+    // since ImGui writes what it samples straight to the UNORM swapchain.
+    class AtlasTexture : NoMoveable
+    {
+    public:
+        struct Region
+        {
+            uint32_t   layer;
+            BitmapRect rect;
+        };
+
+        // `components` swizzles every view, e.g. to draw R8 masks white. With `srgb_view` and an
+        // sRGB twin of `format`, array_view() decodes to linear light when sampled.
+        AtlasTexture(const VulkanContext& context, SubmitBatcher& batcher, VkExtent2D extent, uint32_t layers,
+            VkFormat format = VK_FORMAT_R8G8B8A8_UNORM, uint32_t mip_levels = 1, VkComponentMapping components = {}, bool srgb_view = false)
+        : context_{ context }
+        , batcher_{ batcher }
+        {
+            switch (format)
+            {
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+                block_extent_ = 4;
+                block_bytes_ = 16;
+                break;
+            case VK_FORMAT_B4G4R4A4_UNORM_PACK16:
+            case VK_FORMAT_R5G6B5_UNORM_PACK16:
+                block_bytes_ = 2;
+                break;
+            case VK_FORMAT_R8_UNORM:
+                block_bytes_ = 1;
+                break;
+            case VK_FORMAT_R8_UINT:
+                block_bytes_ = 1;
+                integer_ = true;
+                break;
+            default:
+                break;
+            }
+
+            VkResult result;
+
+            set_and_check(result, create_resources(extent, layers, format, mip_levels, components, srgb_view ? srgb_format(format) : VK_FORMAT_UNDEFINED));
+            OptianalGuard _{ result, [&]{ destroy_resources(); } };
+        }
+
+        // Waits for every submission that may still read the image or the staging buffers: up to
+        // the serial given to retire(), or else every one flushed so far.
+        ~AtlasTexture() noexcept
+        {
+            const uint64_t last_use = retired_serial_ ? retired_serial_ : batcher_.pending_serial() - 1;
+            if (last_use == batcher_.pending_serial()
+                || std::ranges::any_of(uploads_, [&](const Upload& upload){ return upload.serial == batcher_.pending_serial(); }))
+            {
+                batcher_.flush();
+            }
+            batcher_.wait_for(last_use);
+            collect();
+            destroy_resources();
+        }
+
+        // Sampling and transfer support for `format` with optimal tiling.
+        static bool supports(const VulkanContext& context, VkFormat format)
+        {
+            VkFormatProperties properties = {};
+            vkGetPhysicalDeviceFormatProperties(context.physical_device, format, &properties);
+            const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+            return (properties.optimalTilingFeatures & required) == required;
+        }
+
+        // The sRGB format with the same layout as `format`, or VK_FORMAT_UNDEFINED.
+        static VkFormat srgb_format(VkFormat format) noexcept
+        {
+            switch (format)
+            {
+            case VK_FORMAT_R8G8B8A8_UNORM:
+                return VK_FORMAT_R8G8B8A8_SRGB;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+                return VK_FORMAT_BC7_SRGB_BLOCK;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+                return VK_FORMAT_BC3_SRGB_BLOCK;
+            default:
+                return VK_FORMAT_UNDEFINED;
+            }
+        }
+
+        // Copies `regions`, given in level 0 pixels, of every mip level to the image. `levels[i]`
+        // holds the pages of level i back to back. For block formats the regions are widened to
+        // whole blocks of each level.
+        void upload(std::span<const void* const> levels, std::span<const Region> regions)
+        {
+            collect();
+            std::vector<LevelRegion> sorted;
+            for (const Region& region : regions)
+            {
+                for (uint32_t level = 0; level < std::min<size_t>(levels.size(), image_.mip_levels); level++)
+                {
+                    const Coord2 extent = level_extent(level);
+                    const auto low = [&](size_t value){ return (value >> level) / block_extent_ * block_extent_; };
+                    const auto high = [&](size_t value){ return blocks((value + (1uz << level) - 1) >> level) * block_extent_; };
+                    const size_t x0 = low(region.rect.position.x());
+                    const size_t y0 = low(region.rect.position.y());
+                    const size_t x1 = std::min(extent.x(), high(region.rect.position.x() + region.rect.size.x()));
+                    const size_t y1 = std::min(extent.y(), high(region.rect.position.y() + region.rect.size.y()));
+                    if (x1 > x0 && y1 > y0)
+                    {
+                        sorted.push_back({ region.layer, level, { Coord2{ x0, y0 }, Coord2{ x1 - x0, y1 - y0 } } });
+                    }
+                }
+            }
+            VkDeviceSize size = 0;
+            for (const LevelRegion& region : sorted)
+            {
+                size += blocks(region.rect.size.x()) * blocks(region.rect.size.y()) * block_bytes_;
+            }
+            if (size == 0)
+            {
+                return;
+            }
+
+            Upload upload = begin_upload(size);
+
+            // Regions are staged page by page so each page gets a single copy command.
+            std::ranges::stable_sort(sorted, {}, &LevelRegion::layer);
+            std::vector<VkBufferImageCopy> copies;
+            copies.reserve(sorted.size());
+            auto* staging = (unsigned char*)upload.staging.mapped;
+            VkDeviceSize offset = 0;
+            for (const LevelRegion& region : sorted)
+            {
+                const Coord2 extent = level_extent(region.level);
+                const size_t page_pitch = blocks(extent.x()) * block_bytes_;
+                const size_t page_bytes = page_pitch * blocks(extent.y());
+                const auto* page = (const unsigned char*)levels[region.level] + region.layer * page_bytes;
+                const size_t row_bytes = blocks(region.rect.size.x()) * block_bytes_;
+                const size_t rows = blocks(region.rect.size.y());
+                for (size_t y = 0; y < rows; y++)
+                {
+                    const size_t source = (region.rect.position.y() / block_extent_ + y) * page_pitch + region.rect.position.x() / block_extent_ * block_bytes_;
+                    std::memcpy(staging + offset + y * row_bytes, page + source, row_bytes);
+                }
+
+                VkBufferImageCopy copy = {};
+                copy.bufferOffset = offset;
+                copy.bufferRowLength = (uint32_t)(blocks(region.rect.size.x()) * block_extent_);
+                copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, region.level, region.layer, 1 };
+                copy.imageOffset = { (int32_t)region.rect.position.x(), (int32_t)region.rect.position.y(), 0 };
+                copy.imageExtent = { (uint32_t)region.rect.size.x(), (uint32_t)region.rect.size.y(), 1 };
+                copies.push_back(copy);
+                offset += row_bytes * rows;
+            }
+            end_upload(upload, copies);
+        }
+
+        // Like upload() for level 0 of uncompressed formats, except that nothing is copied:
+        // `fill(i, texels)` writes regions[i] straight into the mapped staging buffer, rows of
+        // rect.size.x() texels back to back, e.g. by decoding the frame into it.
+        template<class F>
+        void upload_in_place(std::span<const Region> regions, F&& fill)
+        {
+            collect();
+            VkDeviceSize size = 0;
+            for (const Region& region : regions)
+            {
+                size += region.rect.size.x() * region.rect.size.y() * block_bytes_;
+            }
+            if (size == 0 || block_extent_ != 1)
+            {
+                return;
+            }
+
+            Upload upload = begin_upload(size);
+            auto* staging = (std::byte*)upload.staging.mapped;
+            std::vector<VkBufferImageCopy> copies;
+            copies.reserve(regions.size());
+            VkDeviceSize offset = 0;
+            for (size_t i = 0; i < regions.size(); i++)
+            {
+                const Region& region = regions[i];
+                const size_t bytes = region.rect.size.x() * region.rect.size.y() * block_bytes_;
+                if (bytes == 0)
+                {
+                    continue;
+                }
+                fill(i, std::span<std::byte>{ staging + offset, bytes });
+
+                VkBufferImageCopy copy = {};
+                copy.bufferOffset = offset;
+                copy.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, region.layer, 1 };
+                copy.imageOffset = { (int32_t)region.rect.position.x(), (int32_t)region.rect.position.y(), 0 };
+                copy.imageExtent = { (uint32_t)region.rect.size.x(), (uint32_t)region.rect.size.y(), 1 };
+                copies.push_back(copy);
+                offset += bytes;
+            }
+            std::ranges::stable_sort(copies, {}, [](const VkBufferImageCopy& copy){ return copy.imageSubresource.baseArrayLayer; });
+            end_upload(upload, copies);
+        }
+
+        // Releases staging buffers and command buffers of uploads the GPU has finished.
+        void collect()
+        {
+            while (not uploads_.empty() && batcher_.is_complete(uploads_.front().serial))
+            {
+                Upload& upload = uploads_.front();
+                vkFreeCommandBuffers(context_.device, command_pool_, 1, &upload.command_buffer);
+                destroy_buffer(context_, upload.staging);
+                uploads_.pop_front();
+            }
+        }
+
+        // Promises that no work after the pending serial uses the image, which is returned. Once
+        // that serial is complete the destructor no longer waits.
+        uint64_t retire() noexcept
+        {
+            return retired_serial_ = batcher_.pending_serial();
+        }
+
+        VkExtent2D extent() const noexcept
+        {
+            return image_.extent;
+        }
+
+        VkFormat format() const noexcept
+        {
+            return image_.format;
+        }
+
+        uint32_t mip_levels() const noexcept
+        {
+            return image_.mip_levels;
+        }
+
+        // Device memory of the image, ignoring alignment.
+        size_t bytes() const noexcept
+        {
+            size_t total = 0;
+            for (uint32_t level = 0; level < image_.mip_levels; level++)
+            {
+                const Coord2 extent = level_extent(level);
+                total += blocks(extent.x()) * blocks(extent.y()) * block_bytes_ * image_.layers;
+            }
+            return total;
+        }
+
+        uint32_t layer_count() const noexcept
+        {
+            return image_.layers;
+        }
+
+        // View over every layer, for shaders sampling sampler2DArray; sRGB when asked for.
+        VkImageView array_view() const noexcept
+        {
+            return array_view_;
+        }
+
+        // Whether array_view() decodes sRGB.
+        bool srgb() const noexcept
+        {
+            return srgb_;
+        }
+
+        VkSampler sampler() const noexcept
+        {
+            return sampler_;
+        }
+
+        // Descriptor set registered with the ImGui Vulkan backend for one layer, null for integer
+        // formats.
+        ImTextureID texture(uint32_t layer) const noexcept
+        {
+            return layer < textures_.size() ? (ImTextureID)textures_[layer] : nullptr;
+        }
+
+    private:
+        struct LevelRegion
+        {
+            uint32_t   layer;
+            uint32_t   level;
+            BitmapRect rect;
+        };
+
+        struct Upload
+        {
+            GpuBuffer       staging;
+            VkCommandBuffer command_buffer;
+            uint64_t        serial;
+        };
+
+        size_t blocks(size_t texels) const noexcept
+        {
+            return (texels + block_extent_ - 1) / block_extent_;
+        }
+
+        // Staging buffer of `size` bytes and a command buffer to copy from it.
+        Upload begin_upload(VkDeviceSize size)
+        {
+            Upload upload = {};
+            check_vk_result(create_buffer(context_, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, upload.staging));
+
+            VkCommandBufferAllocateInfo alloc_info = {};
+            alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            alloc_info.commandPool = command_pool_;
+            alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            alloc_info.commandBufferCount = 1;
+            check_vk_result(vkAllocateCommandBuffers(context_.device, &alloc_info, &upload.command_buffer));
+            return upload;
+        }
+
+        // Records `copies`, sorted by layer so each page gets a single copy command, and hands
+        // the command buffer to the batcher.
+        void end_upload(Upload& upload, std::span<const VkBufferImageCopy> copies)
+        {
+            flush_buffer(context_, upload.staging);
+
+            VkCommandBufferBeginInfo begin_info = {};
+            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            check_vk_result(vkBeginCommandBuffer(upload.command_buffer, &begin_info));
+            image_barrier(upload.command_buffer, image_.image,
+                initialized_ ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            for (size_t first = 0; first < copies.size();)
+            {
+                size_t last = first + 1;
+                while (last < copies.size() && copies[last].imageSubresource.baseArrayLayer == copies[first].imageSubresource.baseArrayLayer)
+                {
+                    ++last;
+                }
+                vkCmdCopyBufferToImage(upload.command_buffer, upload.staging.buffer, image_.image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)(last - first), copies.data() + first);
+                first = last;
+            }
+            image_barrier(upload.command_buffer, image_.image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+            check_vk_result(vkEndCommandBuffer(upload.command_buffer));
+
+            batcher_.add(context_.queue, upload.command_buffer);
+            upload.serial = batcher_.pending_serial();
+            uploads_.push_back(upload);
+            initialized_ = true;
+        }
+
+        Coord2 level_extent(uint32_t level) const noexcept
+        {
+            return Coord2{ std::max<size_t>(image_.extent.width >> level, 1), std::max<size_t>(image_.extent.height >> level, 1) };
+        }
+
+        VkResult create_resources(VkExtent2D extent, uint32_t layers, VkFormat format, uint32_t mip_levels, VkComponentMapping components,
+            VkFormat array_format)
+        {
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_resources(); } };
+
+            set_and_check(result, create_image(context_, extent, format,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, mip_levels, layers, VK_IMAGE_VIEW_TYPE_2D_ARRAY, image_,
+                array_format != VK_FORMAT_UNDEFINED ? VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT : 0));
+            array_view_ = image_.view;
+            srgb_ = array_format != VK_FORMAT_UNDEFINED;
+            if (srgb_ || components.r || components.g || components.b || components.a)
+            {
+                VkImageViewCreateInfo view_info = {};
+                view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                view_info.image = image_.image;
+                view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+                view_info.format = array_format != VK_FORMAT_UNDEFINED ? array_format : format;
+                view_info.components = components;
+                view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, layers };
+                array_view_ = VK_NULL_HANDLE;
+                set_and_check(result, vkCreateImageView(context_.device, &view_info, context_.allocator, &array_view_));
+            }
+            set_and_check(result, create_sampler(context_, integer_ ? VK_FILTER_NEAREST : VK_FILTER_LINEAR,
+                mip_levels > 1 && not integer_ ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST, sampler_));
+
+            VkCommandPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            pool_info.queueFamilyIndex = context_.queue_family;
+            set_and_check(result, vkCreateCommandPool(context_.device, &pool_info, context_.allocator, &command_pool_));
+
+            if (integer_)
+            {
+                return result;
+            }
+            layer_views_.resize(layers, VK_NULL_HANDLE);
+            textures_.resize(layers, VK_NULL_HANDLE);
+            for (uint32_t layer = 0; layer < layers; layer++)
+            {
+                VkImageViewCreateInfo view_info = {};
+                view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                view_info.image = image_.image;
+                view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                view_info.format = image_.format;
+                view_info.components = components;
+                view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, layer, 1 };
+                set_and_check(result, vkCreateImageView(context_.device, &view_info, context_.allocator, &layer_views_[layer]));
+                textures_[layer] = ImGui_ImplVulkan_AddTexture(sampler_, layer_views_[layer], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                if (not textures_[layer])
+                {
+                    result = VK_ERROR_OUT_OF_POOL_MEMORY;
+                    check_vk_result(result);
+                }
+            }
+            return result;
+        }
+
+        void destroy_resources() noexcept
+        {
+            for (VkDescriptorSet texture : textures_)
+            {
+                if (texture)
+                {
+                    ImGui_ImplVulkan_RemoveTexture(texture);
+                }
+            }
+            for (VkImageView view : layer_views_)
+            {
+                vkDestroyImageView(context_.device, view, context_.allocator);
+            }
+            textures_.clear();
+            layer_views_.clear();
+            if (array_view_ != image_.view)
+            {
+                vkDestroyImageView(context_.device, array_view_, context_.allocator);
+            }
+            array_view_ = VK_NULL_HANDLE;
+            vkDestroyCommandPool(context_.device, command_pool_, context_.allocator);
+            vkDestroySampler(context_.device, sampler_, context_.allocator);
+            destroy_image(context_, image_);
+        }
+
+        VulkanContext context_;
+        SubmitBatcher& batcher_;
+        GpuImage image_;
+        VkImageView array_view_ = VK_NULL_HANDLE;
+        VkSampler sampler_ = VK_NULL_HANDLE;
+        VkCommandPool command_pool_ = VK_NULL_HANDLE;
+        std::vector<VkImageView> layer_views_;
+        std::vector<VkDescriptorSet> textures_;
+        std::deque<Upload> uploads_;
+        uint64_t retired_serial_ = 0;
+        size_t block_extent_ = 1;
+        size_t block_bytes_ = sizeof(Color32);
+        bool integer_ = false;
+        bool srgb_ = false;
+        bool initialized_ = false;
+    };
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include <ranges>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include <renderer/common.hpp>
+
+namespace adttil
+{
+    class BitmapView
+    {
+    public:
+        constexpr BitmapView(Color32* data, Coord2 size, size_t row_align) noexcept
+        : data_{ data }
+        , size_{ size }
+        , row_align_{ row_align }
+        {}
+
+        constexpr BitmapView(Color32* data, Coord2 size) noexcept
+        : BitmapView{ data, size, size.x() }
+        {}
+
+        constexpr Color32* data()const noexcept
+        {
+            return data_;
+        }
+
+        constexpr Coord2 size()const noexcept
+        {
+            return size_;
+        }
+
+        constexpr size_t width()const noexcept
+        {
+            return size_.x();
+        }
+
+        constexpr size_t height()const noexcept
+        {
+            return size_.y();
+        }
+
+        constexpr size_t count()const noexcept
+        {
+            return width() * height();
+        }
+
+        constexpr size_t row_align()const noexcept
+        {
+            return row_align_;
+        }
+
+        constexpr Color32& operator[](size_t i)const noexcept
+        {
+            return data_[i % row_align_ + i / row_align_ * row_align_];
+        }
+
+        constexpr Color32& operator[](Coord2 coord)const noexcept
+        {
+            return data_[coord.x() + coord.y() * row_align_];
+        }
+
+        friend void copy(BitmapView dst, BitmapView src)
+        {
+            for(size_t i : std::views::iota(0uz, dst.height()))
+            {
+                memcpy(dst.row(i), src.row(i), dst.width() * sizeof(Color32));
+            }
+        }
+
+    private:
+        constexpr Color32* row(size_t i) const noexcept
+        {
+            return &data_[row_align_ * i];
+        }
+
+        Color32* data_;
+        Coord2 size_;
+        size_t row_align_;
+    };
+
+    // Smallest rect holding every pixel with non-zero alpha, empty when there is none.
+    struct BitmapRect
+    {
+        Coord2 position;
+        Coord2 size;
+    };
+
+    inline BitmapRect alpha_bounds(BitmapView bitmap) noexcept
+    {
+        size_t x0 = bitmap.width(), y0 = bitmap.height(), x1 = 0, y1 = 0;
+        for (size_t y = 0; y < bitmap.height(); y++)
+        {
+            for (size_t x = 0; x < bitmap.width(); x++)
+            {
+                if (bitmap[Coord2{ x, y }].a() != 0)
+                {
+                    x0 = std::min(x0, x);
+                    x1 = std::max(x1, x + 1);
+                    y0 = std::min(y0, y);
+                    y1 = y + 1;
+                }
+            }
+        }
+        if (x1 <= x0)
+        {
+            return { Coord2{ 0uz, 0uz }, Coord2{ 0uz, 0uz } };
+        }
+        return { Coord2{ x0, y0 }, Coord2{ x1 - x0, y1 - y0 } };
+    }
+
+    // 64-bit hash of the visible pixels and the size, used to find identical frames.
+    inline uint64_t hash_pixels(BitmapView bitmap) noexcept
+    {
+        constexpr uint64_t prime = 0x100000001b3;
+        uint64_t hash = 0xcbf29ce484222325 ^ (bitmap.width() * prime + bitmap.height());
+        for (size_t y = 0; y < bitmap.height(); y++)
+        {
+            const Color32* row = &bitmap[Coord2{ 0uz, y }];
+            for (size_t x = 0; x < bitmap.width(); x++)
+            {
+                hash = (hash ^ pack_unorm4x8(row[x])) * prime;
+            }
+        }
+        return hash ^ (hash >> 29);
+    }
+
+    inline bool equal_pixels(BitmapView a, BitmapView b) noexcept
+    {
+        if (a.width() != b.width() || a.height() != b.height())
+        {
+            return false;
+        }
+        for (size_t y = 0; y < a.height(); y++)
+        {
+            if (std::memcmp(&a[Coord2{ 0uz, y }], &b[Coord2{ 0uz, y }], a.width() * sizeof(Color32)) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,363 @@
+#pragma once
+#include <span>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+#include <renderer/worker_pool.hpp>
+
+namespace adttil
+{
+    enum class BlockFormat : uint32_t
+    {
+        none,
+        // BC7 mode 6 only: one RGBA subset, 7-bit endpoints with a shared bit, 4-bit indices.
+        bc7,
+        // DXT5: RGB565 endpoints with 2-bit indices plus an interpolated 8-bit alpha block.
+        bc3,
+    };
+
+    inline constexpr size_t block_extent = 4;
+    inline constexpr size_t block_bytes = 16;
+
+    inline VkFormat vk_format(BlockFormat format) noexcept
+    {
+        switch (format)
+        {
+        case BlockFormat::bc7: return VK_FORMAT_BC7_UNORM_BLOCK;
+        case BlockFormat::bc3: return VK_FORMAT_BC3_UNORM_BLOCK;
+        default:               return VK_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+
+    // Bytes of a `size` image in `format`, size rounded up to whole blocks.
+    inline size_t compressed_size(Coord2 size, BlockFormat format) noexcept
+    {
+        if (format == BlockFormat::none)
+        {
+            return size.x() * size.y() * sizeof(Color32);
+        }
+        return (size.x() + block_extent - 1) / block_extent * ((size.y() + block_extent - 1) / block_extent) * block_bytes;
+    }
+
+    namespace detail
+    {
+        // Appends `count` bits of `value` to a 128-bit little endian block.
+        struct BitWriter
+        {
+            uint8_t* out;
+            size_t   at = 0;
+
+            void write(uint32_t value, size_t count) noexcept
+            {
+                for (size_t i = 0; i < count; i++, at++)
+                {
+                    out[at >> 3] |= (uint8_t)(((value >> i) & 1) << (at & 7));
+                }
+            }
+        };
+
+        // Principal axis of the block by power iteration on the covariance of `channels` channels,
+        // returned as the texels projecting lowest and highest onto it.
+        inline void principal_endpoints(const float (&texels)[16][4], size_t channels, float (&low)[4], float (&high)[4]) noexcept
+        {
+            float mean[4] = {};
+            for (const auto& texel : texels)
+            {
+                for (size_t c = 0; c < channels; c++)
+                {
+                    mean[c] += texel[c] / 16.0f;
+                }
+            }
+            float covariance[4][4] = {};
+            for (const auto& texel : texels)
+            {
+                for (size_t i = 0; i < channels; i++)
+                {
+                    for (size_t j = 0; j < channels; j++)
+                    {
+                        covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+                    }
+                }
+            }
+            float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            for (int iteration = 0; iteration < 8; iteration++)
+            {
+                float next[4] = {};
+                float length = 0.0f;
+                for (size_t i = 0; i < channels; i++)
+                {
+                    for (size_t j = 0; j < channels; j++)
+                    {
+                        next[i] += covariance[i][j] * axis[j];
+                    }
+                    length = std::max(length, std::abs(next[i]));
+                }
+                if (length < 1e-6f)
+                {
+                    break;
+                }
+                for (size_t i = 0; i < channels; i++)
+                {
+                    axis[i] = next[i] / length;
+                }
+            }
+
+            float min_t = 1e30f, max_t = -1e30f;
+            for (const auto& texel : texels)
+            {
+                float t = 0.0f;
+                for (size_t c = 0; c < channels; c++)
+                {
+                    t += (texel[c] - mean[c]) * axis[c];
+                }
+                min_t = std::min(min_t, t);
+                max_t = std::max(max_t, t);
+            }
+            float norm = 0.0f;
+            for (size_t c = 0; c < channels; c++)
+            {
+                norm += axis[c] * axis[c];
+            }
+            norm = norm > 0.0f ? norm : 1.0f;
+            for (size_t c = 0; c < channels; c++)
+            {
+                low[c] = std::clamp(mean[c] + axis[c] * min_t / norm, 0.0f, 255.0f);
+                high[c] = std::clamp(mean[c] + axis[c] * max_t / norm, 0.0f, 255.0f);
+            }
+        }
+
+        inline void load_block(BitmapView page, Coord2 origin, float (&texels)[16][4]) noexcept
+        {
+            for (size_t y = 0; y < block_extent; y++)
+            {
+                for (size_t x = 0; x < block_extent; x++)
+                {
+                    // Blocks past the page edge repeat the last texel.
+                    const size_t px = std::min(origin.x() + x, page.width() - 1);
+                    const size_t py = std::min(origin.y() + y, page.height() - 1);
+                    const Color32 color = page[Coord2{ px, py }];
+                    texels[y * 4 + x][0] = color.r();
+                    texels[y * 4 + x][1] = color.g();
+                    texels[y * 4 + x][2] = color.b();
+                    texels[y * 4 + x][3] = color.a();
+                }
+            }
+        }
+
+        inline void encode_bc7_mode6(const float (&texels)[16][4], uint8_t* out) noexcept
+        {
+            static constexpr int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+            float low[4], high[4];
+            principal_endpoints(texels, 4, low, high);
+
+            // Each endpoint has one shared low bit; keep whichever is closer over all channels.
+            int endpoints[2][4];
+            int pbits[2];
+            const float* ends[2] = { low, high };
+            for (int e = 0; e < 2; e++)
+            {
+                float best = 1e30f;
+                for (int p = 0; p < 2; p++)
+                {
+                    int quantized[4];
+                    float error = 0.0f;
+                    for (int c = 0; c < 4; c++)
+                    {
+                        quantized[c] = std::clamp((int)std::lround((ends[e][c] - p) / 2.0f), 0, 127);
+                        const float value = (float)(quantized[c] << 1 | p);
+                        error += (value - ends[e][c]) * (value - ends[e][c]);
+                    }
+                    if (error < best)
+                    {
+                        best = error;
+                        pbits[e] = p;
+                        std::ranges::copy(quantized, endpoints[e]);
+                    }
+                }
+            }
+
+            int palette[16][4];
+            for (int i = 0; i < 16; i++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    const int e0 = endpoints[0][c] << 1 | pbits[0];
+                    const int e1 = endpoints[1][c] << 1 | pbits[1];
+                    palette[i][c] = ((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6;
+                }
+            }
+            int indices[16];
+            for (int t = 0; t < 16; t++)
+            {
+                int best = INT32_MAX;
+                for (int i = 0; i < 16; i++)
+                {
+                    int error = 0;
+                    for (int c = 0; c < 4; c++)
+                    {
+                        const int d = palette[i][c] - (int)texels[t][c];
+                        error += d * d;
+                    }
+                    if (error < best)
+                    {
+                        best = error;
+                        indices[t] = i;
+                    }
+                }
+            }
+            // The anchor index has an implicit top bit of zero.
+            if (indices[0] >= 8)
+            {
+                std::swap(endpoints[0], endpoints[1]);
+                std::swap(pbits[0], pbits[1]);
+                for (int& index : indices)
+                {
+                    index = 15 - index;
+                }
+            }
+
+            std::memset(out, 0, block_bytes);
+            BitWriter writer{ out };
+            writer.write(1u << 6, 7);
+            for (int c = 0; c < 4; c++)
+            {
+                writer.write((uint32_t)endpoints[0][c], 7);
+                writer.write((uint32_t)endpoints[1][c], 7);
+            }
+            writer.write((uint32_t)pbits[0], 1);
+            writer.write((uint32_t)pbits[1], 1);
+            writer.write((uint32_t)indices[0], 3);
+            for (int t = 1; t < 16; t++)
+            {
+                writer.write((uint32_t)indices[t], 4);
+            }
+        }
+
+        inline void encode_bc3(const float (&texels)[16][4], uint8_t* out) noexcept
+        {
+            std::memset(out, 0, block_bytes);
+
+            // Alpha: eight interpolated values between the extremes.
+            float alpha_min = 255.0f, alpha_max = 0.0f;
+            for (const auto& texel : texels)
+            {
+                alpha_min = std::min(alpha_min, texel[3]);
+                alpha_max = std::max(alpha_max, texel[3]);
+            }
+            const int a0 = (int)alpha_max;
+            const int a1 = (int)alpha_min;
+            out[0] = (uint8_t)a0;
+            out[1] = (uint8_t)a1;
+            int alpha_palette[8] = { a0, a1 };
+            for (int i = 1; i < 7; i++)
+            {
+                alpha_palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+            }
+            BitWriter alpha_writer{ out + 2 };
+            for (const auto& texel : texels)
+            {
+                int best = INT32_MAX, index = 0;
+                for (int i = 0; i < 8; i++)
+                {
+                    const int error = std::abs(alpha_palette[i] - (int)texel[3]);
+                    if (error < best)
+                    {
+                        best = error;
+                        index = i;
+                    }
+                }
+                alpha_writer.write((uint32_t)index, 3);
+            }
+
+            // Color: always the four color mode in BC3, regardless of endpoint order.
+            float low[4], high[4];
+            principal_endpoints(texels, 3, low, high);
+            const auto to565 = [](const float (&color)[4])
+            {
+                return (uint16_t)(std::lround(color[0] * 31.0f / 255.0f) << 11 | std::lround(color[1] * 63.0f / 255.0f) << 5 | std::lround(color[2] * 31.0f / 255.0f));
+            };
+            const auto from565 = [](uint16_t value, int (&color)[3])
+            {
+                color[0] = (value >> 11 & 31) * 255 / 31;
+                color[1] = (value >> 5 & 63) * 255 / 63;
+                color[2] = (value & 31) * 255 / 31;
+            };
+            const uint16_t c0 = to565(high);
+            const uint16_t c1 = to565(low);
+            int palette[4][3];
+            from565(c0, palette[0]);
+            from565(c1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            std::memcpy(out + 8, &c0, 2);
+            std::memcpy(out + 10, &c1, 2);
+            BitWriter color_writer{ out + 12 };
+            for (const auto& texel : texels)
+            {
+                int best = INT32_MAX, index = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    int error = 0;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        const int d = palette[i][c] - (int)texel[c];
+                        error += d * d;
+                    }
+                    if (error < best)
+                    {
+                        best = error;
+                        index = i;
+                    }
+                }
+                color_writer.write((uint32_t)index, 2);
+            }
+        }
+    }
+
+    // Encodes the blocks of `page` covered by `rect` into `out`, which holds the whole page in
+    // row major block order. The rect is widened to block boundaries; rows of blocks run in
+    // parallel on `pool`.
+    inline void compress_rect(BitmapView page, BitmapRect rect, BlockFormat format, std::span<std::byte> out, WorkerPool& pool)
+    {
+        const size_t blocks_x = (page.width() + block_extent - 1) / block_extent;
+        const size_t bx0 = rect.position.x() / block_extent;
+        const size_t by0 = rect.position.y() / block_extent;
+        const size_t bx1 = std::min(blocks_x, (rect.position.x() + rect.size.x() + block_extent - 1) / block_extent);
+        const size_t by1 = std::min((page.height() + block_extent - 1) / block_extent, (rect.position.y() + rect.size.y() + block_extent - 1) / block_extent);
+        if (format == BlockFormat::none || bx1 <= bx0 || by1 <= by0)
+        {
+            return;
+        }
+        pool.parallel_for(by1 - by0, [&](size_t row)
+        {
+            const size_t by = by0 + row;
+            for (size_t bx = bx0; bx < bx1; bx++)
+            {
+                float texels[16][4];
+                detail::load_block(page, Coord2{ bx * block_extent, by * block_extent }, texels);
+                auto* block = (uint8_t*)out.data() + (by * blocks_x + bx) * block_bytes;
+                if (format == BlockFormat::bc7)
+                {
+                    detail::encode_bc7_mode6(texels, block);
+                }
+                else
+                {
+                    detail::encode_bc3(texels, block);
+                }
+            }
+        });
+    }
+
+    inline void compress_page(BitmapView page, BlockFormat format, std::span<std::byte> out, WorkerPool& pool)
+    {
+        compress_rect(page, { Coord2{ 0uz, 0uz }, page.size() }, format, out, pool);
+    }
+}
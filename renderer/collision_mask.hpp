@@ -0,0 +1,165 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ADTTIL_MASK_SSE2 1
+#endif
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+
+namespace adttil
+{
+    // Solid pixels of a sprite, one bit each: pixel (x, y) is bit x % 64 of word x / 64 of row y.
+    // Every row ends with a zero word, so a 64-bit window may start at any pixel of the row.
+    class CollisionMask
+    {
+    public:
+        CollisionMask() = default;
+
+        // Pixels of `bitmap` whose alpha reaches `threshold` are solid.
+        CollisionMask(BitmapView bitmap, uint8_t threshold)
+        : size_{ bitmap.size() }
+        , stride_{ row_words(bitmap.width()) }
+        , words_(stride_ * bitmap.height())
+        {
+            for (size_t y = 0; y < bitmap.height(); y++)
+            {
+                const Color32* row = &bitmap[Coord2{ 0uz, y }];
+                uint64_t* bits = words_.data() + y * stride_;
+                for (size_t x = 0; x < bitmap.width(); x++)
+                {
+                    bits[x / 64] |= (uint64_t)(row[x].a() >= threshold) << (x % 64);
+                }
+            }
+        }
+
+        // Takes rows laid out as row_words(size.x()) words each, e.g. as baked into a cache.
+        CollisionMask(Coord2 size, std::span<const uint64_t> words)
+        : size_{ size }
+        , stride_{ row_words(size.x()) }
+        , words_(words.begin(), words.end())
+        {}
+
+        // Words per row of a mask `width` pixels wide.
+        static size_t row_words(size_t width) noexcept
+        {
+            return width ? (width + 63) / 64 + 1 : 0;
+        }
+
+        Coord2 size() const noexcept
+        {
+            return size_;
+        }
+
+        std::span<const uint64_t> words() const noexcept
+        {
+            return words_;
+        }
+
+        const uint64_t* row(size_t y) const noexcept
+        {
+            return words_.data() + y * stride_;
+        }
+
+        bool operator[](Coord2 coord) const noexcept
+        {
+            return row(coord.y())[coord.x() / 64] >> (coord.x() % 64) & 1;
+        }
+
+        size_t solid_count() const noexcept
+        {
+            size_t count = 0;
+            for (uint64_t word : words_)
+            {
+                count += (size_t)std::popcount(word);
+            }
+            return count;
+        }
+
+    private:
+        Coord2 size_;
+        size_t stride_ = 0;
+        std::vector<uint64_t> words_;
+    };
+
+    namespace detail
+    {
+        // 64 pixels of `row` starting at pixel `bit`.
+        inline uint64_t mask_window(const uint64_t* row, size_t bit) noexcept
+        {
+            const size_t word = bit / 64, shift = bit % 64;
+            return shift ? row[word] >> shift | row[word + 1] << (64 - shift) : row[word];
+        }
+
+        // Whether `count` pixels of row `a` from `a_bit` and of row `b` from `b_bit` share a
+        // solid one, 128 pixels per step.
+        inline bool rows_overlap(const uint64_t* a, size_t a_bit, const uint64_t* b, size_t b_bit, size_t count) noexcept
+        {
+            size_t i = 0;
+#ifdef ADTTIL_MASK_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const auto window = [](const uint64_t* row, size_t bit)
+            {
+                // Lanes shift by the same amount; a shift by 64 clears the high part when aligned.
+                const __m128i low = _mm_loadu_si128((const __m128i*)(row + bit / 64));
+                const __m128i high = _mm_loadu_si128((const __m128i*)(row + bit / 64 + 1));
+                return _mm_or_si128(_mm_srl_epi64(low, _mm_cvtsi32_si128((int)(bit % 64))),
+                    _mm_sll_epi64(high, _mm_cvtsi32_si128((int)(64 - bit % 64))));
+            };
+            // A step reads the two words after the one holding its first pixel. Rows only end with
+            // one zero word, so steps stop 64 pixels early; then the last word read still holds
+            // pixels of the window, and the scalar loop takes the rest.
+            for (; i + 192 <= count; i += 128)
+            {
+                const __m128i both = _mm_and_si128(window(a, a_bit + i), window(b, b_bit + i));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(both, zero)) != 0xffff)
+                {
+                    return true;
+                }
+            }
+#endif
+            for (; i + 64 <= count; i += 64)
+            {
+                if (mask_window(a, a_bit + i) & mask_window(b, b_bit + i))
+                {
+                    return true;
+                }
+            }
+            if (i == count)
+            {
+                return false;
+            }
+            const uint64_t tail = ~0ull >> (64 - (count - i));
+            return (mask_window(a, a_bit + i) & mask_window(b, b_bit + i) & tail) != 0;
+        }
+    }
+
+    // Whether `a`, top left corner at `a_position`, and `b` at `b_position` have a solid pixel
+    // in the same place. Masks whose rects do not intersect are rejected before any bit is read.
+    inline bool overlaps(const CollisionMask& a, Int2 a_position, const CollisionMask& b, Int2 b_position) noexcept
+    {
+        const int64_t x0 = std::max<int64_t>(a_position.x(), b_position.x());
+        const int64_t y0 = std::max<int64_t>(a_position.y(), b_position.y());
+        const int64_t x1 = std::min<int64_t>(a_position.x() + (int64_t)a.size().x(), b_position.x() + (int64_t)b.size().x());
+        const int64_t y1 = std::min<int64_t>(a_position.y() + (int64_t)a.size().y(), b_position.y() + (int64_t)b.size().y());
+        if (x1 <= x0 || y1 <= y0)
+        {
+            return false;
+        }
+        const auto a_bit = (size_t)(x0 - a_position.x()), b_bit = (size_t)(x0 - b_position.x());
+        for (int64_t y = y0; y < y1; y++)
+        {
+            if (detail::rows_overlap(a.row((size_t)(y - a_position.y())), a_bit, b.row((size_t)(y - b_position.y())), b_bit, (size_t)(x1 - x0)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <print>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+
+#define GLFW_INCLUDE_NONE
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <vulkan/vulkan.h>
+
+#include <senluo/geo.hpp>
+
+namespace adttil
+{
+    using Vec2 = senluo::geo::vec<2>;
+    using Vec3 = senluo::geo::vec<3>;
+    using Vec4 = senluo::geo::vec<4>;
+
+    using Coord2 = senluo::geo::vec<2, size_t>;
+    using Coord3 = senluo::geo::vec<3, size_t>;
+    using Coord4 = senluo::geo::vec<4, size_t>;
+
+    using Int2 = senluo::geo::vec<2, int32_t>;
+
+    using Color32 = senluo::geo::vec<4, unsigned char>;
+
+    // Same byte order as GLSL unpackUnorm4x8.
+    constexpr uint32_t pack_unorm4x8(Color32 color) noexcept
+    {
+        return (uint32_t)color.r() | (uint32_t)color.g() << 8 | (uint32_t)color.b() << 16 | (uint32_t)color.a() << 24;
+    }
+
+    // FNV-1a over 8-byte words, for content checks rather than security.
+    inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325) noexcept
+    {
+        constexpr uint64_t prime = 0x100000001b3;
+        const auto* bytes = (const unsigned char*)data;
+        uint64_t hash = seed ^ size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 32;
+        }
+        for (; i < size; i++)
+        {
+            hash = (hash ^ bytes[i]) * prime;
+        }
+        return hash;
+    }
+
+    inline void glfw_error_callback(int error, const char* description)
+    {
+        std::println(stderr, "GLFW Error {}: {}", error, description);
+    }
+
+    inline void check_vk_result(VkResult err)
+    {
+        if (err == 0)
+        {
+            return;
+        }
+        std::println(/*stderr, */"[vulkan] Error: VkResult = {}\n", std::to_underlying(err));
+        if (err < 0)
+        {
+            throw std::exception{ "vk error" };
+        }
+    }
+
+    template<class...Types>
+    inline void print_and_throw(const std::format_string<Types...> msg_fmt, Types&&...args)
+    {
+        std::string message = std::format(msg_fmt, std::forward<Types>(args)...);
+        std::println("{}", message);
+        throw std::runtime_error{ message };
+    }
+
+    inline void set_and_check(VkResult& result, VkResult new_value)
+    {
+        result = new_value;
+        check_vk_result(result);
+    }
+
+    template<class TOn, class F>
+    class OptianalGuard
+    {
+    public:
+        constexpr OptianalGuard(TOn& on, F&& f)
+        : on_{on}
+        , fn_{ std::move(f) }
+        { }
+
+        constexpr ~OptianalGuard()noexcept
+        {
+            if(on_) fn_();
+        }
+
+    private:
+        TOn& on_;
+        F fn_;
+    };
+
+    class NoMoveable
+    {
+    public:
+        constexpr NoMoveable() = default;
+        NoMoveable(NoMoveable&&) = delete;
+    };
+
+    struct DeviceFeatures
+    {
+        uint32_t api_version = VK_API_VERSION_1_0;
+        bool     synchronization2 = false;
+        bool     timeline_semaphore = false;
+    };
+
+    // Handles shared by the subsystems owned by Renderer.
+    struct VulkanContext
+    {
+        VkInstance                   instance;
+        VkPhysicalDevice             physical_device;
+        VkDevice                     device;
+        uint32_t                     queue_family;
+        VkQueue                      queue;
+        const VkAllocationCallbacks* allocator;
+        DeviceFeatures               features;
+    };
+}
@@ -0,0 +1,261 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+#include <renderer/worker_pool.hpp>
+
+namespace adttil
+{
+    namespace detail
+    {
+        inline constexpr float distance_infinity = 1e20f;
+
+        // Squared distance from every sample of `f`, read `stride` apart, to the nearest zero,
+        // in place: the lower envelope of the parabolas rooted at each sample (Felzenszwalb and
+        // Huttenlocher), linear in `count`.
+        inline void distance_transform_1d(float* f, size_t count, size_t stride)
+        {
+            thread_local std::vector<float> values, bounds;
+            thread_local std::vector<size_t> roots;
+            values.resize(count);
+            bounds.resize(count + 1);
+            roots.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                values[i] = f[i * stride];
+            }
+
+            const auto intersection = [&](size_t q, size_t root)
+            {
+                return ((values[q] + (float)(q * q)) - (values[root] + (float)(root * root))) / (2.0f * (float)q - 2.0f * (float)root);
+            };
+            size_t k = 0;
+            roots[0] = 0;
+            bounds[0] = -distance_infinity;
+            bounds[1] = distance_infinity;
+            for (size_t q = 1; q < count; q++)
+            {
+                float s = intersection(q, roots[k]);
+                while (s <= bounds[k])
+                {
+                    k--;
+                    s = intersection(q, roots[k]);
+                }
+                k++;
+                roots[k] = q;
+                bounds[k] = s;
+                bounds[k + 1] = distance_infinity;
+            }
+            k = 0;
+            for (size_t q = 0; q < count; q++)
+            {
+                while (bounds[k + 1] < (float)q)
+                {
+                    k++;
+                }
+                const float offset = (float)q - (float)roots[k];
+                f[q * stride] = offset * offset + values[roots[k]];
+            }
+        }
+    }
+
+    // Signed distance to the alpha edge of a sprite at a fraction of its resolution, covering
+    // its rect grown by `spread` pixels so glows and shadows have room outside the silhouette.
+    // Texel (i, j) samples the point ((i - margin + 0.5) * scale, (j - margin + 0.5) * scale)
+    // of the sprite. Stored as R8 with 0.5 on the edge, higher inside, saturating `spread`
+    // pixels away, so one filtered fetch gives outlines, glows and shadows. A `spread` that is
+    // not positive and finite throws, as every texel would be NaN.
+    class DistanceField
+    {
+    public:
+        DistanceField() = default;
+
+        // Exact Euclidean transform of the pixels whose alpha reaches `threshold`, a row pass
+        // then a column pass. With `pool` the rows, then the columns, are shared out.
+        DistanceField(BitmapView bitmap, size_t scale, float spread, uint8_t threshold = 128, WorkerPool* pool = nullptr)
+        : size_{ field_size(bitmap.size(), scale, spread) }
+        , sprite_size_{ bitmap.size() }
+        , scale_{ scale }
+        , spread_{ spread }
+        , texels_(size_.x() * size_.y())
+        {
+            check_spread(spread);
+            if (texels_.empty())
+            {
+                return;
+            }
+            // Pixels of the sprite, the margin and the partial texels past its right and bottom.
+            const size_t border = margin(scale, spread) * scale;
+            const size_t width = size_.x() * scale, height = size_.y() * scale;
+            // Squared distance to the nearest solid pixel, and to the nearest empty one.
+            std::vector<float> outside(width * height, detail::distance_infinity), inside(width * height, 0.0f);
+            for (size_t y = 0; y < bitmap.height(); y++)
+            {
+                for (size_t x = 0; x < bitmap.width(); x++)
+                {
+                    if (bitmap[Coord2{ x, y }].a() >= threshold)
+                    {
+                        const size_t at = (y + border) * width + x + border;
+                        outside[at] = 0.0f;
+                        inside[at] = detail::distance_infinity;
+                    }
+                }
+            }
+            const auto for_each = [&](size_t count, auto&& body)
+            {
+                if (pool)
+                {
+                    pool->parallel_for(count, body);
+                    return;
+                }
+                for (size_t i = 0; i < count; i++)
+                {
+                    body(i);
+                }
+            };
+            for_each(height, [&](size_t y)
+            {
+                detail::distance_transform_1d(outside.data() + y * width, width, 1);
+                detail::distance_transform_1d(inside.data() + y * width, width, 1);
+            });
+            for_each(width, [&](size_t x)
+            {
+                detail::distance_transform_1d(outside.data() + x, height, width);
+                detail::distance_transform_1d(inside.data() + x, height, width);
+            });
+
+            // Pixel centres sit half a pixel off the edge between solid and empty pixels.
+            const auto signed_distance = [&](size_t x, size_t y)
+            {
+                const size_t at = y * width + x;
+                return outside[at] > 0.0f ? std::sqrt(outside[at]) - 0.5f : 0.5f - std::sqrt(inside[at]);
+            };
+            for (size_t j = 0; j < size_.y(); j++)
+            {
+                for (size_t i = 0; i < size_.x(); i++)
+                {
+                    // Bilinear between the four pixel centres around the texel centre.
+                    const float px = std::max(((float)i + 0.5f) * (float)scale - 0.5f, 0.0f);
+                    const float py = std::max(((float)j + 0.5f) * (float)scale - 0.5f, 0.0f);
+                    const size_t x0 = (size_t)px, y0 = (size_t)py;
+                    const size_t x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+                    const float fx = px - (float)x0, fy = py - (float)y0;
+                    const float top = std::lerp(signed_distance(x0, y0), signed_distance(x1, y0), fx);
+                    const float bottom = std::lerp(signed_distance(x0, y1), signed_distance(x1, y1), fx);
+                    texels_[j * size_.x() + i] = encode(std::lerp(top, bottom, fy));
+                }
+            }
+        }
+
+        // Takes texels as baked into a cache, field_size() of the same arguments.
+        DistanceField(Coord2 sprite_size, size_t scale, float spread, std::span<const uint8_t> texels)
+        : size_{ field_size(sprite_size, scale, spread) }
+        , sprite_size_{ sprite_size }
+        , scale_{ scale }
+        , spread_{ spread }
+        , texels_(texels.begin(), texels.end())
+        {
+            check_spread(spread);
+        }
+
+        static void check_spread(float spread)
+        {
+            if (not (spread > 0.0f) || not std::isfinite(spread))
+            {
+                print_and_throw("distance field spread {} is not a positive number of pixels", spread);
+            }
+        }
+
+        // Texels around the sprite on each side.
+        static size_t margin(size_t scale, float spread) noexcept
+        {
+            return scale ? (size_t)std::ceil(std::max(spread, 0.0f) / (float)scale) : 0;
+        }
+
+        static Coord2 field_size(Coord2 sprite_size, size_t scale, float spread) noexcept
+        {
+            if (scale == 0 || sprite_size.x() == 0 || sprite_size.y() == 0)
+            {
+                return Coord2{ 0uz, 0uz };
+            }
+            const size_t border = margin(scale, spread) * 2;
+            return Coord2{ (sprite_size.x() + scale - 1) / scale + border, (sprite_size.y() + scale - 1) / scale + border };
+        }
+
+        Coord2 size() const noexcept
+        {
+            return size_;
+        }
+
+        // Texels spanned by the sprite grown by margin() * scale() pixels on each side, from the
+        // top left texel. Fractional when the sprite is not a multiple of scale() wide or high:
+        // the partial texels past its right and bottom edges stick out of this extent.
+        Vec2 covered_size() const noexcept
+        {
+            if (texels_.empty())
+            {
+                return Vec2{ 0.0f, 0.0f };
+            }
+            const float border = (float)(margin(scale_, spread_) * scale_ * 2);
+            return Vec2{ ((float)sprite_size_.x() + border) / (float)scale_, ((float)sprite_size_.y() + border) / (float)scale_ };
+        }
+
+        // Sprite pixels per texel.
+        size_t scale() const noexcept
+        {
+            return scale_;
+        }
+
+        float spread() const noexcept
+        {
+            return spread_;
+        }
+
+        std::span<const uint8_t> texels() const noexcept
+        {
+            return texels_;
+        }
+
+        // Signed distance in pixels from `point`, in pixels from the top left of the sprite, to
+        // its edge; negative inside. Exact up to `spread`, beyond which it saturates; a point off
+        // the field adds its distance to the field. An empty sprite is infinitely far.
+        float distance(Vec2 point) const noexcept
+        {
+            if (texels_.empty())
+            {
+                return detail::distance_infinity;
+            }
+            const float border = (float)(margin(scale_, spread_) * scale_);
+            const float u = (point.x() + border) / (float)scale_ - 0.5f, v = (point.y() + border) / (float)scale_ - 0.5f;
+            const float cu = std::clamp(u, 0.0f, (float)(size_.x() - 1)), cv = std::clamp(v, 0.0f, (float)(size_.y() - 1));
+            const size_t x0 = (size_t)cu, y0 = (size_t)cv;
+            const size_t x1 = std::min(x0 + 1, size_.x() - 1), y1 = std::min(y0 + 1, size_.y() - 1);
+            const auto texel = [&](size_t x, size_t y){ return decode(texels_[y * size_.x() + x]); };
+            const float top = std::lerp(texel(x0, y0), texel(x1, y0), cu - (float)x0);
+            const float bottom = std::lerp(texel(x0, y1), texel(x1, y1), cu - (float)x0);
+            return std::lerp(top, bottom, cv - (float)y0) + std::hypot(u - cu, v - cv) * (float)scale_;
+        }
+
+    private:
+        uint8_t encode(float distance) const noexcept
+        {
+            return (uint8_t)std::lround(std::clamp(127.5f - distance / spread_ * 127.5f, 0.0f, 255.0f));
+        }
+
+        float decode(uint8_t texel) const noexcept
+        {
+            return (127.5f - (float)texel) / 127.5f * spread_;
+        }
+
+        Coord2 size_;
+        Coord2 sprite_size_;
+        size_t scale_ = 0;
+        float spread_ = 0.0f;
+        std::vector<uint8_t> texels_;
+    };
+}
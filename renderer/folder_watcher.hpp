@@ -0,0 +1,146 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <filesystem>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace adttil
+{
+    // Reports files of one folder with any of the given extensions, e.g. `{ ".png", ".meta" }` for
+    // AnimManager::update(), that were written, created, renamed or deleted since the last
+    // poll(). Uses inotify on Linux; elsewhere the folder is rescanned at most once per
+    // `interval` and modification times are compared.
+    class FolderWatcher
+    {
+    public:
+        FolderWatcher(std::filesystem::path folder, std::vector<std::string> extensions,
+            std::chrono::milliseconds interval = std::chrono::milliseconds{ 500 })
+        : folder_{ std::move(folder) }
+        , extensions_{ std::move(extensions) }
+        , interval_{ interval }
+        {
+#ifdef __linux__
+            fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (fd_ >= 0 && inotify_add_watch(fd_, folder_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0)
+            {
+                close(fd_);
+                fd_ = -1;
+            }
+            if (fd_ >= 0)
+            {
+                return;
+            }
+#endif
+            times_ = scan();
+        }
+
+        FolderWatcher(const FolderWatcher&) = delete;
+        FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+        ~FolderWatcher() noexcept
+        {
+#ifdef __linux__
+            if (fd_ >= 0)
+            {
+                close(fd_);
+            }
+#endif
+        }
+
+        // Changed paths, each reported once, in no particular order. Never blocks.
+        std::vector<std::filesystem::path> poll()
+        {
+            std::vector<std::filesystem::path> changed;
+#ifdef __linux__
+            if (fd_ >= 0)
+            {
+                alignas(inotify_event) char buffer[4096];
+                ssize_t length;
+                while ((length = read(fd_, buffer, sizeof(buffer))) > 0)
+                {
+                    for (char* at = buffer; at < buffer + length;)
+                    {
+                        const auto* event = (const inotify_event*)at;
+                        if (event->len > 0)
+                        {
+                            add(changed, folder_ / event->name);
+                        }
+                        at += sizeof(inotify_event) + event->len;
+                    }
+                }
+                return changed;
+            }
+#endif
+            const auto now = std::chrono::steady_clock::now();
+            if (now - last_scan_ < interval_)
+            {
+                return changed;
+            }
+            last_scan_ = now;
+
+            auto times = scan();
+            for (const auto& [path, time] : times)
+            {
+                auto iter = times_.find(path);
+                if (iter == times_.end() || iter->second != time)
+                {
+                    add(changed, path);
+                }
+            }
+            for (const auto& [path, time] : times_)
+            {
+                if (not times.contains(path))
+                {
+                    add(changed, path);
+                }
+            }
+            times_ = std::move(times);
+            return changed;
+        }
+
+    private:
+        void add(std::vector<std::filesystem::path>& changed, std::filesystem::path path) const
+        {
+            if (watched(path) && std::ranges::find(changed, path) == changed.end())
+            {
+                changed.push_back(std::move(path));
+            }
+        }
+
+        bool watched(const std::filesystem::path& path) const
+        {
+            return std::ranges::find(extensions_, path.extension().string()) != extensions_.end();
+        }
+
+        std::unordered_map<std::string, std::filesystem::file_time_type> scan() const
+        {
+            std::unordered_map<std::string, std::filesystem::file_time_type> times;
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(folder_, error))
+            {
+                if (watched(entry.path()))
+                {
+                    times.emplace(entry.path().string(), entry.last_write_time(error));
+                }
+            }
+            return times;
+        }
+
+        std::filesystem::path folder_;
+        std::vector<std::string> extensions_;
+        std::chrono::milliseconds interval_;
+        std::chrono::steady_clock::time_point last_scan_ = {};
+        std::unordered_map<std::string, std::filesystem::file_time_type> times_;
+#ifdef __linux__
+        int fd_ = -1;
+#endif
+    };
+}
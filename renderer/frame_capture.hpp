@@ -0,0 +1,366 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <optional>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+
+#include <renderer/common.hpp>
+#include <renderer/gpu_resource.hpp>
+#include <renderer/submit_batcher.hpp>
+
+namespace adttil
+{
+    // Copies the backbuffer into a ring of host visible readback buffers without stalling the
+    // frame. Finished copies are detected by polling the SubmitBatcher serial of the frame that
+    // recorded them and are written out on a background encoder thread. When every slot is busy
+    // the frame is dropped instead of waiting.
+    class FrameCapture : NoMoveable
+    {
+    public:
+        FrameCapture(const VulkanContext& context, SubmitBatcher& batcher,
+            uint32_t width, uint32_t height, VkFormat format, bool supported, uint32_t slot_count = 3)
+        : context_{ context }
+        , batcher_{ batcher }
+        , width_{ width }
+        , height_{ height }
+        , format_{ format }
+        , supported_{ supported && bytes_per_pixel(format) == 4 }
+        , slots_(supported_ ? slot_count : 0)
+        {
+            for (Slot& slot : slots_)
+            {
+                check_vk_result(create_buffer(context_, (VkDeviceSize)width_ * height_ * 4,
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                    slot.buffer));
+            }
+            encoder_ = std::jthread{ [this](std::stop_token stop){ encode_loop(stop); } };
+        }
+
+        // The device must be idle: pending copies are handed to the encoder before it is joined.
+        ~FrameCapture() noexcept
+        {
+            poll();
+            {
+                std::lock_guard lock{ jobs_mutex_ };
+                encoder_.request_stop();
+            }
+            jobs_cv_.notify_all();
+            encoder_.join();
+            for (Slot& slot : slots_)
+            {
+                destroy_buffer(context_, slot.buffer);
+            }
+        }
+
+        bool supported() const noexcept
+        {
+            return supported_;
+        }
+
+        // Writes the next presented frame to `path` as an uncompressed 32-bit TGA.
+        void screenshot(std::filesystem::path path)
+        {
+            if (not supported_)
+            {
+                std::println("frame capture is not supported by this swapchain");
+                return;
+            }
+            screenshot_requests_.push_back(std::move(path));
+        }
+
+        // Appends every presented frame to `path` as raw 8-bit BGRA/RGBA rows, e.g. for
+        // `ffmpeg -f rawvideo -pixel_format bgra -video_size WxH -i path`. Starting again before
+        // the frames of the previous recording have been read back waits for them.
+        void start_recording(std::filesystem::path path)
+        {
+            if (not supported_ || recording_)
+            {
+                return;
+            }
+            if (closing_)
+            {
+                batcher_.wait_for(slots_[pending_.back()].serial);
+                poll();
+            }
+            std::println("recording {}x{} {} frames to {}", width_, height_, is_bgra() ? "bgra" : "rgba", path.string());
+            recording_ = true;
+            push_job({ JobKind::open_recording, 0, std::move(path) });
+        }
+
+        // The file is closed once the frames recorded so far have been handed to the encoder.
+        void stop_recording()
+        {
+            if (not recording_)
+            {
+                return;
+            }
+            recording_ = false;
+            closing_ = true;
+            poll();
+        }
+
+        bool recording() const noexcept
+        {
+            return recording_;
+        }
+
+        uint64_t dropped_frames() const noexcept
+        {
+            return dropped_frames_;
+        }
+
+        // Records the backbuffer copy after the render pass has ended. The image is expected in
+        // PRESENT_SRC_KHR layout and is returned to it.
+        void record(VkCommandBuffer command_buffer, VkImage backbuffer)
+        {
+            if (not recording_ && screenshot_requests_.empty())
+            {
+                return;
+            }
+            auto slot = std::ranges::find(slots_, SlotState::free, [](const Slot& s){ return s.state.load(); });
+            if (slot == slots_.end())
+            {
+                ++dropped_frames_;
+                return;
+            }
+
+            VkImageMemoryBarrier image_barrier = {};
+            image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            image_barrier.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.image = backbuffer;
+            image_barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            vkCmdPipelineBarrier(command_buffer,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr, 1, &image_barrier);
+
+            VkBufferImageCopy region = {};
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            region.imageExtent = { width_, height_, 1 };
+            vkCmdCopyImageToBuffer(command_buffer, backbuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                slot->buffer.buffer, 1, &region);
+
+            image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            image_barrier.dstAccessMask = 0;
+            image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            image_barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            VkBufferMemoryBarrier buffer_barrier = {};
+            buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            buffer_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            buffer_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            buffer_barrier.buffer = slot->buffer.buffer;
+            buffer_barrier.size = VK_WHOLE_SIZE;
+            vkCmdPipelineBarrier(command_buffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                0, 0, nullptr, 1, &buffer_barrier, 1, &image_barrier);
+
+            slot->serial = batcher_.pending_serial();
+            slot->record = recording_;
+            slot->screenshot.reset();
+            if (not screenshot_requests_.empty())
+            {
+                slot->screenshot = std::move(screenshot_requests_.front());
+                screenshot_requests_.pop_front();
+            }
+            slot->state = SlotState::pending;
+            pending_.push_back((size_t)(slot - slots_.begin()));
+        }
+
+        // Hands the copies whose frames have finished on the GPU to the encoder thread, oldest
+        // first. Slots are reused as a ring, so a newer frame may finish before an older one is
+        // seen; it waits at the back of the queue to keep the recording in order.
+        void poll()
+        {
+            while (not pending_.empty() && batcher_.is_complete(slots_[pending_.front()].serial))
+            {
+                const size_t index = pending_.front();
+                pending_.pop_front();
+                Slot& slot = slots_[index];
+                invalidate_buffer(context_, slot.buffer);
+                slot.state = SlotState::encoding;
+                push_job({ JobKind::frame, index, {} });
+            }
+            if (closing_ && std::ranges::none_of(pending_, [&](size_t i){ return slots_[i].record; }))
+            {
+                closing_ = false;
+                push_job({ JobKind::close_recording, 0, {} });
+            }
+        }
+
+    private:
+        enum class SlotState
+        {
+            free,
+            pending,
+            encoding,
+        };
+
+        struct Slot
+        {
+            GpuBuffer                            buffer;
+            std::atomic<SlotState>               state = SlotState::free;
+            uint64_t                             serial = 0;
+            bool                                 record = false;
+            std::optional<std::filesystem::path> screenshot;
+        };
+
+        enum class JobKind
+        {
+            frame,
+            open_recording,
+            close_recording,
+        };
+
+        struct Job
+        {
+            JobKind               kind;
+            size_t                slot;
+            std::filesystem::path path;
+        };
+
+        static uint32_t bytes_per_pixel(VkFormat format) noexcept
+        {
+            switch (format)
+            {
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+                return 4;
+            default:
+                return 0;
+            }
+        }
+
+        bool is_bgra() const noexcept
+        {
+            return format_ == VK_FORMAT_B8G8R8A8_UNORM || format_ == VK_FORMAT_B8G8R8A8_SRGB;
+        }
+
+        void push_job(Job job)
+        {
+            {
+                std::lock_guard lock{ jobs_mutex_ };
+                jobs_.push_back(std::move(job));
+            }
+            jobs_cv_.notify_one();
+        }
+
+        void encode_loop(std::stop_token stop)
+        {
+            std::ofstream recording;
+            while (true)
+            {
+                Job job;
+                {
+                    std::unique_lock lock{ jobs_mutex_ };
+                    jobs_cv_.wait(lock, [&]{ return stop.stop_requested() || not jobs_.empty(); });
+                    if (jobs_.empty())
+                    {
+                        return;
+                    }
+                    job = std::move(jobs_.front());
+                    jobs_.pop_front();
+                }
+
+                switch (job.kind)
+                {
+                case JobKind::open_recording:
+                    recording.open(job.path, std::ios::binary | std::ios::trunc);
+                    break;
+                case JobKind::close_recording:
+                    recording.close();
+                    break;
+                case JobKind::frame:
+                {
+                    Slot& slot = slots_[job.slot];
+                    const auto* pixels = (const char*)slot.buffer.mapped;
+                    const size_t byte_count = (size_t)width_ * height_ * 4;
+                    if (slot.record && recording.is_open())
+                    {
+                        recording.write(pixels, byte_count);
+                    }
+                    if (slot.screenshot)
+                    {
+                        write_tga(*slot.screenshot, pixels);
+                    }
+                    slot.state = SlotState::free;
+                    break;
+                }
+                }
+            }
+        }
+
+        void write_tga(const std::filesystem::path& path, const char* pixels) const
+        {
+            std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+            if (not file)
+            {
+                std::println("failed to open {} for screenshot", path.string());
+                return;
+            }
+
+            unsigned char header[18] = {};
+            header[2] = 2;                                  // uncompressed true color
+            header[12] = (unsigned char)(width_ & 0xff);
+            header[13] = (unsigned char)(width_ >> 8);
+            header[14] = (unsigned char)(height_ & 0xff);
+            header[15] = (unsigned char)(height_ >> 8);
+            header[16] = 32;                                // bits per pixel
+            header[17] = 0x28;                              // 8 alpha bits, top-left origin
+            file.write((const char*)header, sizeof(header));
+
+            const size_t row_bytes = (size_t)width_ * 4;
+            if (is_bgra())
+            {
+                file.write(pixels, row_bytes * height_);
+                return;
+            }
+            std::vector<char> row(row_bytes);
+            for (uint32_t y = 0; y < height_; y++)
+            {
+                std::memcpy(row.data(), pixels + y * row_bytes, row_bytes);
+                for (size_t x = 0; x < row_bytes; x += 4)
+                {
+                    std::swap(row[x], row[x + 2]);
+                }
+                file.write(row.data(), row_bytes);
+            }
+        }
+
+        VulkanContext  context_;
+        SubmitBatcher& batcher_;
+        uint32_t       width_;
+        uint32_t       height_;
+        VkFormat       format_;
+        bool           supported_;
+
+        std::vector<Slot> slots_;
+        // Indices of the pending slots in the order their copies were recorded.
+        std::deque<size_t> pending_;
+        std::deque<std::filesystem::path> screenshot_requests_;
+        bool recording_ = false;
+        // Set by stop_recording() until the last recorded frame has been queued before the close.
+        bool closing_ = false;
+        uint64_t dropped_frames_ = 0;
+
+        std::mutex jobs_mutex_;
+        std::condition_variable jobs_cv_;
+        std::deque<Job> jobs_;
+        std::jthread encoder_;
+    };
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+
+#include <renderer/common.hpp>
+#include <renderer/anim_id.hpp>
+
+namespace adttil
+{
+    // Combat state bits of a frame, the phases of idea/动作系统.md.
+    inline constexpr uint8_t frame_windup     = 1 << 0;
+    inline constexpr uint8_t frame_active     = 1 << 1;
+    inline constexpr uint8_t frame_recovery   = 1 << 2;
+    inline constexpr uint8_t frame_invincible = 1 << 3;
+
+    enum class FrameMetaKind : uint32_t
+    {
+        duration,
+        pivot,
+        flags,
+        hitbox,
+        hurtbox,
+        event,
+    };
+
+    // One line of a sidecar, applied to frames [first, last] of `clip`. Flags and boxes add up;
+    // for the other properties the last line wins.
+    struct FrameMetaRule
+    {
+        AnimId        clip;
+        uint32_t      first;
+        uint32_t      last;
+        FrameMetaKind kind;
+        // Bits for flags.
+        uint32_t      bits = 0;
+        // Seconds for duration, x and y for pivot, x, y, width and height for boxes.
+        float         values[4] = {};
+        // Name of the event, whose id is anim_id(event).
+        std::string   event;
+    };
+
+    // Per frame data of a clip, written next to its PNGs as `<clip>.meta`, e.g.
+    //
+    //     duration 0.05
+    //     pivot 32 60
+    //     0-2 windup
+    //     3-4 active
+    //     3-4 hitbox 40 20 24 16
+    //     *   hurtbox 20 8 24 52
+    //     5-7 recovery
+    //     6-7 invincible
+    //     3   event hit
+    //
+    // A line starts with a frame index within the clip, an inclusive range or `*`; without one
+    // it applies to every frame. Positions are pixels of the untrimmed image, y down. `#` starts
+    // a comment. Malformed lines are reported and skipped.
+    inline std::vector<FrameMetaRule> parse_frame_meta(std::string_view text, AnimId clip, std::string_view file_name)
+    {
+        constexpr std::string_view blanks = " \t\r";
+        std::vector<FrameMetaRule> rules;
+        size_t line_number = 0;
+        while (not text.empty())
+        {
+            const size_t end = std::min(text.find('\n'), text.size());
+            std::string_view line = text.substr(0, end);
+            line = line.substr(0, line.find('#'));
+            text.remove_prefix(std::min(end + 1, text.size()));
+            line_number++;
+
+            std::vector<std::string_view> tokens;
+            while (true)
+            {
+                const size_t begin = line.find_first_not_of(blanks);
+                if (begin == std::string_view::npos)
+                {
+                    break;
+                }
+                line.remove_prefix(begin);
+                const size_t length = std::min(line.find_first_of(blanks), line.size());
+                tokens.push_back(line.substr(0, length));
+                line.remove_prefix(length);
+            }
+            if (tokens.empty())
+            {
+                continue;
+            }
+
+            const auto number = [](std::string_view token, auto& value)
+            {
+                auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+                return error == std::errc{} && end == token.data() + token.size();
+            };
+            const auto fail = [&](std::string_view message)
+            {
+                std::println("{}:{}: {}", file_name, line_number, message);
+            };
+
+            FrameMetaRule rule{ clip, 0, UINT32_MAX, FrameMetaKind::flags };
+            size_t at = 0;
+            if (tokens[0] == "*")
+            {
+                at = 1;
+            }
+            else if (tokens[0][0] >= '0' && tokens[0][0] <= '9')
+            {
+                const size_t dash = tokens[0].find('-');
+                if (not number(tokens[0].substr(0, dash), rule.first)
+                    || not number(dash == std::string_view::npos ? tokens[0] : tokens[0].substr(dash + 1), rule.last)
+                    || rule.last < rule.first)
+                {
+                    fail("bad frame range");
+                    continue;
+                }
+                at = 1;
+            }
+            if (at == tokens.size())
+            {
+                fail("missing property");
+                continue;
+            }
+
+            const std::string_view key = tokens[at];
+            const std::span<const std::string_view> args{ tokens.begin() + at + 1, tokens.end() };
+            size_t value_count = 0;
+            if (key == "duration")
+            {
+                rule.kind = FrameMetaKind::duration;
+                value_count = 1;
+            }
+            else if (key == "pivot")
+            {
+                rule.kind = FrameMetaKind::pivot;
+                value_count = 2;
+            }
+            else if (key == "hitbox" || key == "hurtbox")
+            {
+                rule.kind = key == "hitbox" ? FrameMetaKind::hitbox : FrameMetaKind::hurtbox;
+                value_count = 4;
+            }
+            else if (key == "windup" || key == "active" || key == "recovery" || key == "invincible")
+            {
+                rule.bits = key == "windup" ? frame_windup : key == "active" ? frame_active : key == "recovery" ? frame_recovery : frame_invincible;
+            }
+            else if (key == "event")
+            {
+                if (args.size() != 1)
+                {
+                    fail("event takes one name");
+                    continue;
+                }
+                rule.kind = FrameMetaKind::event;
+                rule.event = args[0];
+            }
+            else
+            {
+                fail(std::format("unknown property {}", key));
+                continue;
+            }
+
+            if (rule.kind != FrameMetaKind::event)
+            {
+                bool valid = args.size() == value_count;
+                for (size_t i = 0; valid && i < value_count; i++)
+                {
+                    // from_chars accepts "nan" and "inf", which would poison the clip timeline.
+                    valid = number(args[i], rule.values[i]) && std::isfinite(rule.values[i]);
+                }
+                if (not valid)
+                {
+                    fail(std::format("expected {} numbers after {}", value_count, key));
+                    continue;
+                }
+                if (rule.kind == FrameMetaKind::duration && not (rule.values[0] > 0.0f))
+                {
+                    fail("duration must be positive");
+                    continue;
+                }
+                if ((rule.kind == FrameMetaKind::hitbox || rule.kind == FrameMetaKind::hurtbox)
+                    && not (rule.values[2] > 0.0f && rule.values[3] > 0.0f))
+                {
+                    // An empty or inverted rect would never, or always wrongly, overlap.
+                    fail("box size must be positive");
+                    continue;
+                }
+            }
+            rules.push_back(std::move(rule));
+        }
+        return rules;
+    }
+}
@@ -0,0 +1,374 @@
+#pragma once
+#include <span>
+#include <iterator>
+
+#include <renderer/common.hpp>
+
+namespace adttil
+{
+    struct GpuBuffer
+    {
+        VkBuffer       buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize   size = 0;
+        void*          mapped = nullptr;
+        bool           coherent = true;
+    };
+
+    // Returns UINT32_MAX when no memory type satisfies `required`. Types that also have the
+    // `preferred` flags win over those that only meet the requirement.
+    inline uint32_t find_memory_type(const VulkanContext& context, uint32_t type_bits,
+        VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0)
+    {
+        VkPhysicalDeviceMemoryProperties properties;
+        vkGetPhysicalDeviceMemoryProperties(context.physical_device, &properties);
+
+        uint32_t fallback = UINT32_MAX;
+        for (uint32_t i = 0; i < properties.memoryTypeCount; i++)
+        {
+            const VkMemoryPropertyFlags flags = properties.memoryTypes[i].propertyFlags;
+            if (not (type_bits & (1u << i)) || (flags & required) != required)
+                continue;
+            if ((flags & preferred) == preferred)
+                return i;
+            if (fallback == UINT32_MAX)
+                fallback = i;
+        }
+        return fallback;
+    }
+
+    // Host visible buffers are persistently mapped.
+    inline VkResult create_buffer(const VulkanContext& context, VkDeviceSize size, VkBufferUsageFlags usage,
+        VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, GpuBuffer& out)
+    {
+        out = {};
+        out.size = size;
+
+        VkBufferCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = size;
+        info.usage = usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VkResult err = vkCreateBuffer(context.device, &info, context.allocator, &out.buffer);
+        if(err) return err;
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(context.device, out.buffer, &requirements);
+        const uint32_t type = find_memory_type(context, requirements.memoryTypeBits, required, preferred);
+        if (type == UINT32_MAX)
+        {
+            vkDestroyBuffer(context.device, out.buffer, context.allocator);
+            out.buffer = VK_NULL_HANDLE;
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        }
+
+        VkMemoryAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = requirements.size;
+        alloc_info.memoryTypeIndex = type;
+        err = vkAllocateMemory(context.device, &alloc_info, context.allocator, &out.memory);
+        if (not err)
+            err = vkBindBufferMemory(context.device, out.buffer, out.memory, 0);
+        if (not err && (required & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+            err = vkMapMemory(context.device, out.memory, 0, VK_WHOLE_SIZE, 0, &out.mapped);
+        if (err)
+        {
+            vkFreeMemory(context.device, out.memory, context.allocator);
+            vkDestroyBuffer(context.device, out.buffer, context.allocator);
+            out = {};
+            return err;
+        }
+
+        VkPhysicalDeviceMemoryProperties properties;
+        vkGetPhysicalDeviceMemoryProperties(context.physical_device, &properties);
+        out.coherent = properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        return err;
+    }
+
+    inline void destroy_buffer(const VulkanContext& context, GpuBuffer& buffer) noexcept
+    {
+        if (buffer.mapped)
+            vkUnmapMemory(context.device, buffer.memory);
+        vkDestroyBuffer(context.device, buffer.buffer, context.allocator);
+        vkFreeMemory(context.device, buffer.memory, context.allocator);
+        buffer = {};
+    }
+
+    struct GpuImage
+    {
+        VkImage        image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView    view = VK_NULL_HANDLE;
+        VkFormat       format = VK_FORMAT_UNDEFINED;
+        VkExtent2D     extent = {};
+        uint32_t       mip_levels = 1;
+        uint32_t       layers = 1;
+    };
+
+    // Device local, optimal tiling, with a view over every mip level and layer. `flags` go to the
+    // image, e.g. VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT for views in another format.
+    inline VkResult create_image(const VulkanContext& context, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage,
+        uint32_t mip_levels, uint32_t layers, VkImageViewType view_type, GpuImage& out, VkImageCreateFlags flags = 0)
+    {
+        out = {};
+        out.format = format;
+        out.extent = extent;
+        out.mip_levels = mip_levels;
+        out.layers = layers;
+
+        VkImageCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        info.flags = flags;
+        info.imageType = VK_IMAGE_TYPE_2D;
+        info.format = format;
+        info.extent = { extent.width, extent.height, 1 };
+        info.mipLevels = mip_levels;
+        info.arrayLayers = layers;
+        info.samples = VK_SAMPLE_COUNT_1_BIT;
+        info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        info.usage = usage;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkResult err = vkCreateImage(context.device, &info, context.allocator, &out.image);
+        if(err) return err;
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(context.device, out.image, &requirements);
+        VkMemoryAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize = requirements.size;
+        alloc_info.memoryTypeIndex = find_memory_type(context, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        err = alloc_info.memoryTypeIndex == UINT32_MAX ? VK_ERROR_OUT_OF_DEVICE_MEMORY
+            : vkAllocateMemory(context.device, &alloc_info, context.allocator, &out.memory);
+        if (not err)
+            err = vkBindImageMemory(context.device, out.image, out.memory, 0);
+        if (not err)
+        {
+            VkImageViewCreateInfo view_info = {};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = out.image;
+            view_info.viewType = view_type;
+            view_info.format = format;
+            view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, layers };
+            err = vkCreateImageView(context.device, &view_info, context.allocator, &out.view);
+        }
+        if (err)
+        {
+            vkFreeMemory(context.device, out.memory, context.allocator);
+            vkDestroyImage(context.device, out.image, context.allocator);
+            out = {};
+        }
+        return err;
+    }
+
+    inline void destroy_image(const VulkanContext& context, GpuImage& image) noexcept
+    {
+        vkDestroyImageView(context.device, image.view, context.allocator);
+        vkDestroyImage(context.device, image.image, context.allocator);
+        vkFreeMemory(context.device, image.memory, context.allocator);
+        image = {};
+    }
+
+    inline VkResult create_sampler(const VulkanContext& context, VkFilter filter, VkSamplerMipmapMode mipmap_mode, VkSampler& out)
+    {
+        VkSamplerCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        info.magFilter = filter;
+        info.minFilter = filter;
+        info.mipmapMode = mipmap_mode;
+        info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        info.minLod = 0.0f;
+        info.maxLod = VK_LOD_CLAMP_NONE;
+        info.maxAnisotropy = 1.0f;
+        return vkCreateSampler(context.device, &info, context.allocator, &out);
+    }
+
+    // Makes device writes visible to the host for non-coherent mappings.
+    inline void invalidate_buffer(const VulkanContext& context, const GpuBuffer& buffer)
+    {
+        if (buffer.coherent)
+            return;
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = buffer.memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        check_vk_result(vkInvalidateMappedMemoryRanges(context.device, 1, &range));
+    }
+
+    // Makes host writes visible to the device for non-coherent mappings.
+    inline void flush_buffer(const VulkanContext& context, const GpuBuffer& buffer)
+    {
+        if (buffer.coherent)
+            return;
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = buffer.memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        check_vk_result(vkFlushMappedMemoryRanges(context.device, 1, &range));
+    }
+
+    // SPIR-V is embedded at build time, see the shader step in CMakeLists.txt.
+    inline VkResult create_shader_module(const VulkanContext& context, std::span<const uint32_t> code, VkShaderModule& out)
+    {
+        VkShaderModuleCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        info.codeSize = code.size_bytes();
+        info.pCode = code.data();
+        return vkCreateShaderModule(context.device, &info, context.allocator, &out);
+    }
+
+    inline VkResult create_compute_pipeline(const VulkanContext& context, std::span<const uint32_t> code,
+        VkPipelineLayout layout, VkPipeline& out)
+    {
+        VkShaderModule module;
+        VkResult err = create_shader_module(context, code, module);
+        if(err) return err;
+
+        VkComputePipelineCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        info.stage.module = module;
+        info.stage.pName = "main";
+        info.layout = layout;
+        err = vkCreateComputePipelines(context.device, VK_NULL_HANDLE, 1, &info, context.allocator, &out);
+        vkDestroyShaderModule(context.device, module, context.allocator);
+        return err;
+    }
+
+    // Triangle list without depth, with dynamic viewport and scissor. Vertex data, if any, is
+    // fetched from storage buffers so there is no vertex input state. `blends` holds one state per
+    // colour attachment of the subpass.
+    inline VkResult create_graphics_pipeline(const VulkanContext& context,
+        std::span<const uint32_t> vertex_code, std::span<const uint32_t> fragment_code,
+        VkPipelineLayout layout, VkRenderPass render_pass, uint32_t subpass,
+        std::span<const VkPipelineColorBlendAttachmentState> blends, VkPipeline& out)
+    {
+        VkShaderModule modules[2] = {};
+        VkResult err = create_shader_module(context, vertex_code, modules[0]);
+        if (not err)
+            err = create_shader_module(context, fragment_code, modules[1]);
+        if (err)
+        {
+            vkDestroyShaderModule(context.device, modules[0], context.allocator);
+            return err;
+        }
+
+        VkPipelineShaderStageCreateInfo stages[2] = {};
+        stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[0].module = modules[0];
+        stages[0].pName = "main";
+        stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        stages[1].module = modules[1];
+        stages[1].pName = "main";
+
+        VkPipelineVertexInputStateCreateInfo vertex_info = {};
+        vertex_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+        VkPipelineInputAssemblyStateCreateInfo ia_info = {};
+        ia_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        ia_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        VkPipelineViewportStateCreateInfo viewport_info = {};
+        viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport_info.viewportCount = 1;
+        viewport_info.scissorCount = 1;
+
+        VkPipelineRasterizationStateCreateInfo raster_info = {};
+        raster_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        raster_info.polygonMode = VK_POLYGON_MODE_FILL;
+        raster_info.cullMode = VK_CULL_MODE_NONE;
+        raster_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        raster_info.lineWidth = 1.0f;
+
+        VkPipelineMultisampleStateCreateInfo ms_info = {};
+        ms_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        ms_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineDepthStencilStateCreateInfo depth_info = {};
+        depth_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+
+        VkPipelineColorBlendStateCreateInfo blend_info = {};
+        blend_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        blend_info.attachmentCount = (uint32_t)blends.size();
+        blend_info.pAttachments = blends.data();
+
+        VkDynamicState dynamic_states[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dynamic_state = {};
+        dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state.dynamicStateCount = (uint32_t)std::size(dynamic_states);
+        dynamic_state.pDynamicStates = dynamic_states;
+
+        VkGraphicsPipelineCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        info.stageCount = 2;
+        info.pStages = stages;
+        info.pVertexInputState = &vertex_info;
+        info.pInputAssemblyState = &ia_info;
+        info.pViewportState = &viewport_info;
+        info.pRasterizationState = &raster_info;
+        info.pMultisampleState = &ms_info;
+        info.pDepthStencilState = &depth_info;
+        info.pColorBlendState = &blend_info;
+        info.pDynamicState = &dynamic_state;
+        info.layout = layout;
+        info.renderPass = render_pass;
+        info.subpass = subpass;
+        err = vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &info, context.allocator, &out);
+        vkDestroyShaderModule(context.device, modules[1], context.allocator);
+        vkDestroyShaderModule(context.device, modules[0], context.allocator);
+        return err;
+    }
+
+    inline VkResult create_graphics_pipeline(const VulkanContext& context,
+        std::span<const uint32_t> vertex_code, std::span<const uint32_t> fragment_code,
+        VkPipelineLayout layout, VkRenderPass render_pass, uint32_t subpass,
+        const VkPipelineColorBlendAttachmentState& blend, VkPipeline& out)
+    {
+        return create_graphics_pipeline(context, vertex_code, fragment_code, layout, render_pass, subpass, { &blend, 1 }, out);
+    }
+
+    inline void set_viewport_and_scissor(VkCommandBuffer command_buffer, uint32_t width, uint32_t height)
+    {
+        VkViewport viewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
+        VkRect2D scissor = { { 0, 0 }, { width, height } };
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    }
+
+    inline void image_barrier(VkCommandBuffer command_buffer, VkImage image,
+        VkImageLayout old_layout, VkImageLayout new_layout,
+        VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+        VkPipelineStageFlags dst_stage, VkAccessFlags dst_access,
+        VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS })
+    {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = src_access;
+        barrier.dstAccessMask = dst_access;
+        barrier.oldLayout = old_layout;
+        barrier.newLayout = new_layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = range;
+        vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    inline void memory_barrier(VkCommandBuffer command_buffer,
+        VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+        VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+    {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = src_access;
+        barrier.dstAccessMask = dst_access;
+        vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+}
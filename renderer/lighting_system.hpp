@@ -0,0 +1,456 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstring>
+
+#include <renderer/common.hpp>
+#include <renderer/gpu_resource.hpp>
+
+namespace adttil
+{
+    namespace shaders
+    {
+        inline constexpr uint32_t lighting_tiled_comp[] = {
+#include <shaders/lighting_tiled.comp.spv.inc>
+        };
+        inline constexpr uint32_t fullscreen_vert[] = {
+#include <shaders/fullscreen.vert.spv.inc>
+        };
+        inline constexpr uint32_t lighting_composite_frag[] = {
+#include <shaders/lighting_composite.frag.spv.inc>
+        };
+    }
+
+    // Position and radius in framebuffer pixels. `height` lifts the light off the sprite plane,
+    // which controls how strongly normal maps pick it up.
+    struct PointLight
+    {
+        Vec2    position;
+        float   radius = 128.0f;
+        float   height = 32.0f;
+        Color32 color = { 255, 200, 140, 255 };
+        float   intensity = 1.0f;
+    };
+
+    // Deferred 2D lighting. Sprites draw albedo and normal/emissive data into an offscreen G-buffer
+    // through the callback given to set_gbuffer_pass, as SpriteBatch does for sprites drawn with
+    // SpriteStyle::lit; a compute pass then culls the frame's point lights into 16x16 pixel tiles
+    // and shades each tile against its own list. The lit image is composited into the main render
+    // pass under everything else, so the cost of a light is its tile coverage rather than another
+    // pass over every sprite.
+    class LightingSystem : NoMoveable
+    {
+    public:
+        static constexpr uint32_t tile_size = 16;
+
+        LightingSystem(const VulkanContext& context, VkRenderPass render_pass, uint32_t frame_count,
+            VkExtent2D extent, uint32_t max_lights = 4096)
+        : context_{ context }
+        , frame_count_{ frame_count }
+        , extent_{ extent }
+        , max_lights_{ max_lights }
+        {
+            VkResult result;
+
+            set_and_check(result, create_targets());
+            OptianalGuard _{ result, [&]{ destroy_targets(); } };
+
+            set_and_check(result, create_descriptors());
+            OptianalGuard _{ result, [&]{ destroy_descriptors(); } };
+
+            set_and_check(result, create_pipelines(render_pass));
+        }
+
+        ~LightingSystem() noexcept
+        {
+            destroy_pipelines();
+            destroy_descriptors();
+            destroy_targets();
+        }
+
+        // Render pass sprite pipelines must be compatible with to draw into the G-buffer.
+        // Attachment 0 is albedo with straight alpha, attachment 1 holds the tangent space normal
+        // in rg (0.5 being flat) and emissive strength in b.
+        VkRenderPass gbuffer_render_pass() const noexcept
+        {
+            return gbuffer_pass_;
+        }
+
+        // `draw` records into the G-buffer pass; `has_content` tells whether it would draw anything
+        // this frame, the whole lighting pass is skipped otherwise.
+        void set_gbuffer_pass(std::function<void(VkCommandBuffer)> draw, std::function<bool()> has_content)
+        {
+            draw_gbuffer_ = std::move(draw);
+            has_gbuffer_content_ = std::move(has_content);
+        }
+
+        void set_ambient(Vec3 ambient) noexcept
+        {
+            ambient_ = ambient;
+        }
+
+        // Lights are collected for the next rendered frame only.
+        void add_light(const PointLight& light)
+        {
+            if (lights_.size() >= max_lights_)
+            {
+                return;
+            }
+            const float scale = light.intensity / 255.0f;
+            GpuLight gpu = {};
+            gpu.position[0] = light.position.x();
+            gpu.position[1] = light.position.y();
+            gpu.radius = light.radius;
+            gpu.height = light.height;
+            gpu.color[0] = light.color.r() * scale;
+            gpu.color[1] = light.color.g() * scale;
+            gpu.color[2] = light.color.b() * scale;
+            lights_.push_back(gpu);
+        }
+
+        // G-buffer pass plus tiled culling and accumulation. Recorded outside of any render pass;
+        // does nothing when the G-buffer would stay empty this frame, as lights have nothing to
+        // shade then.
+        void record(VkCommandBuffer command_buffer, uint32_t frame)
+        {
+            active_ = draw_gbuffer_ && has_gbuffer_content_ && has_gbuffer_content_();
+            if (not active_)
+            {
+                lights_.clear();
+                return;
+            }
+
+            {
+                VkClearValue clear_values[2] = {};
+                clear_values[1].color = { { 0.5f, 0.5f, 0.0f, 0.0f } };
+                VkRenderPassBeginInfo info = {};
+                info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                info.renderPass = gbuffer_pass_;
+                info.framebuffer = gbuffer_framebuffer_;
+                info.renderArea.extent = extent_;
+                info.clearValueCount = 2;
+                info.pClearValues = clear_values;
+                vkCmdBeginRenderPass(command_buffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+                set_viewport_and_scissor(command_buffer, extent_.width, extent_.height);
+                draw_gbuffer_(command_buffer);
+                vkCmdEndRenderPass(command_buffer);
+            }
+
+            const uint32_t base = (frame % frame_count_) * max_lights_;
+            std::memcpy((GpuLight*)lights_buffer_.mapped + base, lights_.data(), lights_.size() * sizeof(GpuLight));
+            flush_buffer(context_, lights_buffer_);
+
+            // The previous composite is done reading, the old contents are not needed
+            image_barrier(command_buffer, lit_.image,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+            Constants constants = {};
+            constants.ambient[0] = ambient_.x();
+            constants.ambient[1] = ambient_.y();
+            constants.ambient[2] = ambient_.z();
+            constants.light_base = base;
+            constants.light_count = (uint32_t)lights_.size();
+            constants.width = extent_.width;
+            constants.height = extent_.height;
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, tiled_pipeline_);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_layout_, 0, 1, &compute_set_, 0, nullptr);
+            vkCmdPushConstants(command_buffer, compute_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+            vkCmdDispatch(command_buffer,
+                (extent_.width + tile_size - 1) / tile_size,
+                (extent_.height + tile_size - 1) / tile_size, 1);
+
+            image_barrier(command_buffer, lit_.image,
+                VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+            lights_.clear();
+        }
+
+        // Blends the lit image into the main render pass; record before anything drawn on top.
+        void record_composite(VkCommandBuffer command_buffer)
+        {
+            if (not active_)
+            {
+                return;
+            }
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composite_pipeline_);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, composite_layout_, 0, 1, &composite_set_, 0, nullptr);
+            set_viewport_and_scissor(command_buffer, extent_.width, extent_.height);
+            vkCmdDraw(command_buffer, 3, 1, 0, 0);
+        }
+
+    private:
+        // Layout mirrors shaders/lighting_tiled.comp
+        struct GpuLight
+        {
+            float position[2];
+            float radius;
+            float height;
+            float color[3];
+            float pad;
+        };
+        static_assert(sizeof(GpuLight) == 32);
+
+        struct Constants
+        {
+            float    ambient[4];
+            uint32_t light_base;
+            uint32_t light_count;
+            uint32_t width;
+            uint32_t height;
+        };
+
+        static constexpr VkFormat albedo_format = VK_FORMAT_R8G8B8A8_UNORM;
+        static constexpr VkFormat normal_emissive_format = VK_FORMAT_R8G8B8A8_UNORM;
+        static constexpr VkFormat lit_format = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+        VkResult create_targets()
+        {
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_targets(); } };
+
+            const VkImageUsageFlags gbuffer_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            set_and_check(result, create_image(context_, extent_, albedo_format, gbuffer_usage, 1, 1, VK_IMAGE_VIEW_TYPE_2D, albedo_));
+            set_and_check(result, create_image(context_, extent_, normal_emissive_format, gbuffer_usage, 1, 1, VK_IMAGE_VIEW_TYPE_2D, normal_emissive_));
+            set_and_check(result, create_image(context_, extent_, lit_format,
+                VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1, 1, VK_IMAGE_VIEW_TYPE_2D, lit_));
+            set_and_check(result, create_buffer(context_, sizeof(GpuLight) * max_lights_ * frame_count_,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, lights_buffer_));
+            set_and_check(result, create_sampler(context_, VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST, sampler_));
+
+            VkAttachmentDescription attachments[2] = {};
+            for (VkAttachmentDescription& attachment : attachments)
+            {
+                attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+                attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            }
+            attachments[0].format = albedo_format;
+            attachments[1].format = normal_emissive_format;
+            VkAttachmentReference color_attachments[2] = {
+                { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+                { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+            };
+            VkSubpassDescription subpass = {};
+            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+            subpass.colorAttachmentCount = 2;
+            subpass.pColorAttachments = color_attachments;
+            VkSubpassDependency dependencies[2] = {};
+            dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+            dependencies[0].dstSubpass = 0;
+            dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            dependencies[0].srcAccessMask = 0;
+            dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependencies[1].srcSubpass = 0;
+            dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+            dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            VkRenderPassCreateInfo pass_info = {};
+            pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+            pass_info.attachmentCount = 2;
+            pass_info.pAttachments = attachments;
+            pass_info.subpassCount = 1;
+            pass_info.pSubpasses = &subpass;
+            pass_info.dependencyCount = 2;
+            pass_info.pDependencies = dependencies;
+            set_and_check(result, vkCreateRenderPass(context_.device, &pass_info, context_.allocator, &gbuffer_pass_));
+
+            VkImageView views[2] = { albedo_.view, normal_emissive_.view };
+            VkFramebufferCreateInfo buff_info = {};
+            buff_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            buff_info.renderPass = gbuffer_pass_;
+            buff_info.attachmentCount = 2;
+            buff_info.pAttachments = views;
+            buff_info.width = extent_.width;
+            buff_info.height = extent_.height;
+            buff_info.layers = 1;
+            set_and_check(result, vkCreateFramebuffer(context_.device, &buff_info, context_.allocator, &gbuffer_framebuffer_));
+            return result;
+        }
+
+        void destroy_targets() noexcept
+        {
+            vkDestroyFramebuffer(context_.device, gbuffer_framebuffer_, context_.allocator);
+            vkDestroyRenderPass(context_.device, gbuffer_pass_, context_.allocator);
+            vkDestroySampler(context_.device, sampler_, context_.allocator);
+            destroy_buffer(context_, lights_buffer_);
+            destroy_image(context_, lit_);
+            destroy_image(context_, normal_emissive_);
+            destroy_image(context_, albedo_);
+        }
+
+        VkResult create_descriptors()
+        {
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_descriptors(); } };
+
+            {
+                VkDescriptorSetLayoutBinding bindings[4] = {};
+                bindings[0] = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+                bindings[1] = { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+                bindings[2] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+                bindings[3] = { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+                VkDescriptorSetLayoutCreateInfo info = {};
+                info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                info.bindingCount = 4;
+                info.pBindings = bindings;
+                set_and_check(result, vkCreateDescriptorSetLayout(context_.device, &info, context_.allocator, &compute_set_layout_));
+            }
+            {
+                VkDescriptorSetLayoutBinding binding = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+                VkDescriptorSetLayoutCreateInfo info = {};
+                info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+                info.bindingCount = 1;
+                info.pBindings = &binding;
+                set_and_check(result, vkCreateDescriptorSetLayout(context_.device, &info, context_.allocator, &composite_set_layout_));
+            }
+            {
+                VkPushConstantRange range = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Constants) };
+                VkPipelineLayoutCreateInfo info = {};
+                info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                info.setLayoutCount = 1;
+                info.pSetLayouts = &compute_set_layout_;
+                info.pushConstantRangeCount = 1;
+                info.pPushConstantRanges = &range;
+                set_and_check(result, vkCreatePipelineLayout(context_.device, &info, context_.allocator, &compute_layout_));
+                info.pSetLayouts = &composite_set_layout_;
+                info.pushConstantRangeCount = 0;
+                set_and_check(result, vkCreatePipelineLayout(context_.device, &info, context_.allocator, &composite_layout_));
+            }
+
+            VkDescriptorPoolSize pool_sizes[] =
+            {
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 },
+                { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+            };
+            VkDescriptorPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pool_info.maxSets = 2;
+            pool_info.poolSizeCount = (uint32_t)std::size(pool_sizes);
+            pool_info.pPoolSizes = pool_sizes;
+            set_and_check(result, vkCreateDescriptorPool(context_.device, &pool_info, context_.allocator, &descriptor_pool_));
+
+            VkDescriptorSetLayout layouts[2] = { compute_set_layout_, composite_set_layout_ };
+            VkDescriptorSet sets[2];
+            VkDescriptorSetAllocateInfo alloc_info = {};
+            alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            alloc_info.descriptorPool = descriptor_pool_;
+            alloc_info.descriptorSetCount = 2;
+            alloc_info.pSetLayouts = layouts;
+            set_and_check(result, vkAllocateDescriptorSets(context_.device, &alloc_info, sets));
+            compute_set_ = sets[0];
+            composite_set_ = sets[1];
+
+            VkDescriptorImageInfo albedo_info = { sampler_, albedo_.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            VkDescriptorImageInfo normal_info = { sampler_, normal_emissive_.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            VkDescriptorImageInfo lit_storage_info = { VK_NULL_HANDLE, lit_.view, VK_IMAGE_LAYOUT_GENERAL };
+            VkDescriptorImageInfo lit_sampled_info = { sampler_, lit_.view, VK_IMAGE_LAYOUT_GENERAL };
+            VkDescriptorBufferInfo lights_info = { lights_buffer_.buffer, 0, VK_WHOLE_SIZE };
+
+            VkWriteDescriptorSet writes[5] = {};
+            for (VkWriteDescriptorSet& write : writes)
+            {
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.descriptorCount = 1;
+            }
+            writes[0].dstSet = compute_set_;
+            writes[0].dstBinding = 0;
+            writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[0].pImageInfo = &albedo_info;
+            writes[1].dstSet = compute_set_;
+            writes[1].dstBinding = 1;
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[1].pImageInfo = &normal_info;
+            writes[2].dstSet = compute_set_;
+            writes[2].dstBinding = 2;
+            writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writes[2].pImageInfo = &lit_storage_info;
+            writes[3].dstSet = compute_set_;
+            writes[3].dstBinding = 3;
+            writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[3].pBufferInfo = &lights_info;
+            writes[4].dstSet = composite_set_;
+            writes[4].dstBinding = 0;
+            writes[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[4].pImageInfo = &lit_sampled_info;
+            vkUpdateDescriptorSets(context_.device, (uint32_t)std::size(writes), writes, 0, nullptr);
+            return result;
+        }
+
+        void destroy_descriptors() noexcept
+        {
+            vkDestroyDescriptorPool(context_.device, descriptor_pool_, context_.allocator);
+            vkDestroyPipelineLayout(context_.device, composite_layout_, context_.allocator);
+            vkDestroyPipelineLayout(context_.device, compute_layout_, context_.allocator);
+            vkDestroyDescriptorSetLayout(context_.device, composite_set_layout_, context_.allocator);
+            vkDestroyDescriptorSetLayout(context_.device, compute_set_layout_, context_.allocator);
+        }
+
+        VkResult create_pipelines(VkRenderPass render_pass)
+        {
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_pipelines(); } };
+            set_and_check(result, create_compute_pipeline(context_, shaders::lighting_tiled_comp, compute_layout_, tiled_pipeline_));
+
+            VkPipelineColorBlendAttachmentState blend = {};
+            blend.blendEnable = VK_TRUE;
+            blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blend.colorBlendOp = VK_BLEND_OP_ADD;
+            blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blend.alphaBlendOp = VK_BLEND_OP_ADD;
+            blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            set_and_check(result, create_graphics_pipeline(context_, shaders::fullscreen_vert, shaders::lighting_composite_frag,
+                composite_layout_, render_pass, 0, blend, composite_pipeline_));
+            return result;
+        }
+
+        void destroy_pipelines() noexcept
+        {
+            vkDestroyPipeline(context_.device, composite_pipeline_, context_.allocator);
+            vkDestroyPipeline(context_.device, tiled_pipeline_, context_.allocator);
+        }
+
+        VulkanContext context_;
+        uint32_t frame_count_;
+        VkExtent2D extent_;
+        uint32_t max_lights_;
+
+        GpuImage albedo_;
+        GpuImage normal_emissive_;
+        GpuImage lit_;
+        GpuBuffer lights_buffer_;
+        VkSampler sampler_ = VK_NULL_HANDLE;
+        VkRenderPass gbuffer_pass_ = VK_NULL_HANDLE;
+        VkFramebuffer gbuffer_framebuffer_ = VK_NULL_HANDLE;
+
+        VkDescriptorSetLayout compute_set_layout_ = VK_NULL_HANDLE;
+        VkDescriptorSetLayout composite_set_layout_ = VK_NULL_HANDLE;
+        VkPipelineLayout compute_layout_ = VK_NULL_HANDLE;
+        VkPipelineLayout composite_layout_ = VK_NULL_HANDLE;
+        VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+        VkDescriptorSet compute_set_ = VK_NULL_HANDLE;
+        VkDescriptorSet composite_set_ = VK_NULL_HANDLE;
+
+        VkPipeline tiled_pipeline_ = VK_NULL_HANDLE;
+        VkPipeline composite_pipeline_ = VK_NULL_HANDLE;
+
+        std::function<void(VkCommandBuffer)> draw_gbuffer_;
+        std::function<bool()> has_gbuffer_content_;
+        std::vector<GpuLight> lights_;
+        Vec3 ambient_ = { 0.15f, 0.15f, 0.2f };
+        bool active_ = false;
+    };
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <filesystem>
+#include <span>
+#include <utility>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace adttil
+{
+    // Read only view of a whole file mapped into memory. Pages are copy on write, so writes
+    // through bytes() stay private to the process and never reach the file.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+
+        explicit MappedFile(const std::filesystem::path& path)
+        {
+#ifdef _WIN32
+            HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                return;
+            }
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            {
+                HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+                if (mapping)
+                {
+                    data_ = (std::byte*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+                    size_ = data_ ? (size_t)size.QuadPart : 0;
+                    CloseHandle(mapping);
+                }
+            }
+            CloseHandle(file);
+#else
+            const int file = open(path.c_str(), O_RDONLY);
+            if (file < 0)
+            {
+                return;
+            }
+            struct stat info;
+            if (fstat(file, &info) == 0 && info.st_size > 0)
+            {
+                void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+                if (data != MAP_FAILED)
+                {
+                    data_ = (std::byte*)data;
+                    size_ = (size_t)info.st_size;
+                }
+            }
+            close(file);
+#endif
+        }
+
+        MappedFile(MappedFile&& other) noexcept
+        : data_{ std::exchange(other.data_, nullptr) }
+        , size_{ std::exchange(other.size_, 0) }
+        {}
+
+        MappedFile& operator=(MappedFile&& other) noexcept
+        {
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            return *this;
+        }
+
+        ~MappedFile() noexcept
+        {
+            if (not data_)
+            {
+                return;
+            }
+#ifdef _WIN32
+            UnmapViewOfFile(data_);
+#else
+            munmap(data_, size_);
+#endif
+        }
+
+        bool is_open() const noexcept
+        {
+            return data_ != nullptr;
+        }
+
+        std::span<std::byte> bytes() const noexcept
+        {
+            return { data_, size_ };
+        }
+
+    private:
+        std::byte* data_ = nullptr;
+        size_t     size_ = 0;
+    };
+}
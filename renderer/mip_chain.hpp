@@ -0,0 +1,171 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ADTTIL_MIP_SSE2 1
+#endif
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+#include <renderer/pixel_convert.hpp>
+
+namespace adttil
+{
+    namespace detail
+    {
+        // Box filter of four texels in `encoding`: colours are decoded to straight linear values
+        // and weighted by alpha, so transparent gutter texels neither darken nor tint the result,
+        // which is encoded back the same way. Linear premultiplied texels already hold linear
+        // colour times alpha behind their sRGB encoding. Every step is ordered as in
+        // average_quads(), so both give the same texels.
+        inline Color32 average_quad(Color32 a, Color32 b, Color32 c, Color32 d, PixelEncoding encoding) noexcept
+        {
+            const auto& decode = srgb_decode_table();
+            const auto& encode = srgb_encode_table();
+            const Color32 texels[4] = { a, b, c, d };
+            const bool linear_premultiplied = encoding.linear && encoding.premultiplied;
+            const bool srgb_premultiplied = encoding.premultiplied && not encoding.linear;
+            float sum[4] = {};
+            for (const Color32& texel : texels)
+            {
+                const float alpha = (float)texel.a() * (1.0f / 255.0f);
+                // Undoes sRGB premultiplication; the bias makes the truncation match c * 255 / a.
+                const float unpremultiply = texel.a() ? 255.0f / (float)texel.a() : 0.0f;
+                const unsigned char channels[3] = { texel.r(), texel.g(), texel.b() };
+                for (size_t i = 0; i < 3; i++)
+                {
+                    const size_t index = srgb_premultiplied ? (size_t)std::min((float)channels[i] * unpremultiply + 0.001f, 255.0f) : channels[i];
+                    sum[i] += linear_premultiplied ? decode[index] : decode[index] * alpha;
+                }
+                sum[3] += alpha;
+            }
+            const float alpha = sum[3] * 0.25f;
+            if (not (alpha > 0.0f))
+            {
+                return Color32{ 0, 0, 0, 0 };
+            }
+            const float reciprocal = 1.0f / alpha;
+            unsigned char out[3];
+            for (size_t i = 0; i < 3; i++)
+            {
+                const float average = sum[i] * 0.25f;
+                const float target = linear_premultiplied ? std::min(average, alpha) : std::min(average * reciprocal, 1.0f);
+                const float stored = encode[(size_t)(target * 4095.0f + 0.5f)];
+                out[i] = (unsigned char)(srgb_premultiplied ? stored * alpha + 0.5f : stored);
+            }
+            return Color32{ out[0], out[1], out[2], (unsigned char)(alpha * 255.0f + 0.5f) };
+        }
+
+#ifdef ADTTIL_MIP_SSE2
+        // average_quad() of four adjacent output texels, whose footprints are the eight texels
+        // from `top` and from `bottom`, returned packed. Registers hold one channel of all four,
+        // so weighting, unpremultiplying and rounding run on whole registers; only the sRGB table
+        // reads are per lane, as SSE2 has no gather.
+        inline __m128i average_quads(const Color32* top, const Color32* bottom, PixelEncoding encoding) noexcept
+        {
+            const auto& decode = srgb_decode_table();
+            const auto& encode = srgb_encode_table();
+            const bool linear_premultiplied = encoding.linear && encoding.premultiplied;
+            const bool srgb_premultiplied = encoding.premultiplied && not encoding.linear;
+
+            const auto columns = [](const Color32* row, int shuffle)
+            {
+                const __m128 low = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)row));
+                const __m128 high = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row + 4)));
+                return shuffle == 0 ? _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)))
+                    : _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+            };
+            // In the order of average_quad(): top left, top right, bottom left, bottom right.
+            const __m128i texels[4] = { columns(top, 0), columns(top, 1), columns(bottom, 0), columns(bottom, 1) };
+            const __m128i byte = _mm_set1_epi32(0xff);
+            const __m128 zero = _mm_setzero_ps();
+            const auto lookup = [](const auto& table, __m128i index)
+            {
+                alignas(16) int32_t lanes[4];
+                _mm_store_si128((__m128i*)lanes, index);
+                alignas(16) float values[4] = { (float)table[lanes[0]], (float)table[lanes[1]], (float)table[lanes[2]], (float)table[lanes[3]] };
+                return _mm_load_ps(values);
+            };
+
+            __m128 sum[4] = { zero, zero, zero, zero };
+            for (const __m128i texel : texels)
+            {
+                const __m128 stored_alpha = _mm_cvtepi32_ps(_mm_srli_epi32(texel, 24));
+                const __m128 alpha = _mm_mul_ps(stored_alpha, _mm_set1_ps(1.0f / 255.0f));
+                const __m128 unpremultiply = _mm_and_ps(_mm_div_ps(_mm_set1_ps(255.0f), stored_alpha), _mm_cmpgt_ps(stored_alpha, zero));
+                for (int i = 0; i < 3; i++)
+                {
+                    __m128i index = _mm_and_si128(_mm_srli_epi32(texel, 8 * i), byte);
+                    if (srgb_premultiplied)
+                    {
+                        const __m128 straight = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(index), unpremultiply), _mm_set1_ps(0.001f));
+                        index = _mm_cvttps_epi32(_mm_min_ps(straight, _mm_set1_ps(255.0f)));
+                    }
+                    const __m128 linear = lookup(decode, index);
+                    sum[i] = _mm_add_ps(sum[i], linear_premultiplied ? linear : _mm_mul_ps(linear, alpha));
+                }
+                sum[3] = _mm_add_ps(sum[3], alpha);
+            }
+
+            const __m128 alpha = _mm_mul_ps(sum[3], _mm_set1_ps(0.25f));
+            const __m128 reciprocal = _mm_div_ps(_mm_set1_ps(1.0f), alpha);
+            const __m128 half = _mm_set1_ps(0.5f);
+            __m128i packed = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(alpha, _mm_set1_ps(255.0f)), half));
+            packed = _mm_slli_epi32(packed, 24);
+            for (int i = 0; i < 3; i++)
+            {
+                const __m128 average = _mm_mul_ps(sum[i], _mm_set1_ps(0.25f));
+                const __m128 target = linear_premultiplied ? _mm_min_ps(average, alpha) : _mm_min_ps(_mm_mul_ps(average, reciprocal), _mm_set1_ps(1.0f));
+                // Fully transparent lanes divide by zero; they are cleared below.
+                const __m128 clamped = _mm_max_ps(_mm_min_ps(target, _mm_set1_ps(1.0f)), zero);
+                __m128 stored = lookup(encode, _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(4095.0f)), half)));
+                if (srgb_premultiplied)
+                {
+                    stored = _mm_add_ps(_mm_mul_ps(stored, alpha), half);
+                }
+                packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(stored), 8 * i));
+            }
+            return _mm_and_si128(packed, _mm_castps_si128(_mm_cmpgt_ps(alpha, zero)));
+        }
+#endif
+    }
+
+    // Extent of mip `level` of a `size` image.
+    inline Coord2 mip_size(Coord2 size, size_t level) noexcept
+    {
+        return Coord2{ std::max(size.x() >> level, 1uz), std::max(size.y() >> level, 1uz) };
+    }
+
+    // Fills `rect` of `dst`, in dst pixels, from the 2x2 footprints in `src`, one level above.
+    // Sources with an odd extent repeat their last row or column.
+    inline void downsample_rect(BitmapView src, BitmapView dst, BitmapRect rect, PixelEncoding encoding = {}) noexcept
+    {
+        const size_t x1 = std::min(rect.position.x() + rect.size.x(), dst.width());
+        const size_t y1 = std::min(rect.position.y() + rect.size.y(), dst.height());
+        for (size_t y = rect.position.y(); y < y1; y++)
+        {
+            const size_t sy0 = std::min(y * 2, src.height() - 1);
+            const size_t sy1 = std::min(y * 2 + 1, src.height() - 1);
+            size_t x = rect.position.x();
+#ifdef ADTTIL_MIP_SSE2
+            // Four texels at a time while their footprints need no clamping.
+            for (; x + 4 <= x1 && x * 2 + 8 <= src.width(); x += 4)
+            {
+                _mm_storeu_si128((__m128i*)&dst[Coord2{ x, y }],
+                    detail::average_quads(&src[Coord2{ x * 2, sy0 }], &src[Coord2{ x * 2, sy1 }], encoding));
+            }
+#endif
+            for (; x < x1; x++)
+            {
+                const size_t sx0 = std::min(x * 2, src.width() - 1);
+                const size_t sx1 = std::min(x * 2 + 1, src.width() - 1);
+                dst[Coord2{ x, y }] = detail::average_quad(
+                    src[Coord2{ sx0, sy0 }], src[Coord2{ sx1, sy0 }],
+                    src[Coord2{ sx0, sy1 }], src[Coord2{ sx1, sy1 }], encoding);
+            }
+        }
+    }
+}
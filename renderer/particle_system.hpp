@@ -0,0 +1,463 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <cstddef>
+
+#include <renderer/common.hpp>
+#include <renderer/gpu_resource.hpp>
+
+namespace adttil
+{
+    namespace shaders
+    {
+        inline constexpr uint32_t particle_reset_comp[] = {
+#include <shaders/particle_reset.comp.spv.inc>
+        };
+        inline constexpr uint32_t particle_emit_comp[] = {
+#include <shaders/particle_emit.comp.spv.inc>
+        };
+        inline constexpr uint32_t particle_prepare_comp[] = {
+#include <shaders/particle_prepare.comp.spv.inc>
+        };
+        inline constexpr uint32_t particle_simulate_comp[] = {
+#include <shaders/particle_simulate.comp.spv.inc>
+        };
+        inline constexpr uint32_t particle_vert[] = {
+#include <shaders/particle.vert.spv.inc>
+        };
+        inline constexpr uint32_t particle_frag[] = {
+#include <shaders/particle.frag.spv.inc>
+        };
+    }
+
+    // Positions and speeds are in framebuffer pixels, y pointing down; angles in radians.
+    struct ParticleEmitterDesc
+    {
+        Vec2    direction = { 0.0f, -1.0f };
+        float   spread = 3.14159265f;
+        float   speed_min = 50.0f;
+        float   speed_max = 200.0f;
+        float   life_min = 0.3f;
+        float   life_max = 0.8f;
+        float   size_begin = 6.0f;
+        float   size_end = 0.0f;
+        Color32 color_begin = { 255, 220, 120, 255 };
+        Color32 color_end = { 255, 60, 0, 0 };
+        float   gravity = 400.0f;
+        float   drag = 1.0f;
+    };
+
+    using ParticleEmitterId = uint32_t;
+
+    // Particles live entirely on the GPU: emitter parameters sit in a storage buffer, bursts
+    // requested on the CPU during a frame pop indices from a dead list, the simulation consumes
+    // one alive list and appends survivors to the other, and the survivors are drawn with a single
+    // indirect instanced draw. The CPU never learns how many particles are alive.
+    class ParticleSystem : NoMoveable
+    {
+    public:
+        ParticleSystem(const VulkanContext& context, VkRenderPass render_pass, uint32_t frame_count,
+            uint32_t max_particles = 1u << 18, uint32_t max_emitters = 256, uint32_t max_bursts = 1024)
+        : context_{ context }
+        , frame_count_{ frame_count }
+        , max_particles_{ max_particles }
+        , max_emitters_{ max_emitters }
+        , max_bursts_{ max_bursts }
+        {
+            VkResult result;
+
+            set_and_check(result, create_buffers());
+            OptianalGuard _{ result, [&]{ destroy_buffers(); } };
+
+            set_and_check(result, create_descriptors());
+            OptianalGuard _{ result, [&]{ destroy_descriptors(); } };
+
+            set_and_check(result, create_pipelines(render_pass));
+        }
+
+        ~ParticleSystem() noexcept
+        {
+            destroy_pipelines();
+            destroy_descriptors();
+            destroy_buffers();
+        }
+
+        ParticleEmitterId create_emitter(const ParticleEmitterDesc& desc)
+        {
+            if (emitter_count_ >= max_emitters_)
+            {
+                print_and_throw("too many particle emitters, max is {}", max_emitters_);
+            }
+
+            GpuEmitter emitter = {};
+            emitter.direction[0] = desc.direction.x();
+            emitter.direction[1] = desc.direction.y();
+            emitter.spread = desc.spread;
+            emitter.speed_min = desc.speed_min;
+            emitter.speed_max = desc.speed_max;
+            emitter.life_min = desc.life_min;
+            emitter.life_max = desc.life_max;
+            emitter.size_begin = desc.size_begin;
+            emitter.size_end = desc.size_end;
+            emitter.color_begin = pack_unorm4x8(desc.color_begin);
+            emitter.color_end = pack_unorm4x8(desc.color_end);
+            emitter.gravity = desc.gravity;
+            emitter.drag = desc.drag;
+
+            // Slots are written once and never reused, so in-flight frames are never disturbed
+            std::memcpy((GpuEmitter*)emitters_.mapped + emitter_count_, &emitter, sizeof(emitter));
+            flush_buffer(context_, emitters_);
+            return emitter_count_++;
+        }
+
+        // Spawns `count` particles at `position` on the next rendered frame, along the emitter's
+        // direction.
+        void emit(ParticleEmitterId emitter, Vec2 position, uint32_t count)
+        {
+            emit(emitter, position, Vec2{ 0.0f, 0.0f }, count);
+        }
+
+        // As above, overriding the emitter's direction, e.g. with the direction of a strike.
+        void emit(ParticleEmitterId emitter, Vec2 position, Vec2 direction, uint32_t count)
+        {
+            if (emitter >= emitter_count_ || count == 0 || bursts_.size() >= max_bursts_)
+            {
+                return;
+            }
+            count = std::min(count, max_particles_ - std::min(max_particles_, emit_total_));
+            if (count == 0)
+            {
+                return;
+            }
+
+            GpuBurst burst = {};
+            burst.emitter = emitter;
+            burst.count = count;
+            burst.offset = emit_total_;
+            burst.seed = ++seed_ * 2654435761u;
+            burst.position[0] = position.x();
+            burst.position[1] = position.y();
+            burst.direction[0] = direction.x();
+            burst.direction[1] = direction.y();
+            bursts_.push_back(burst);
+            emit_total_ += count;
+        }
+
+        // Runs emission and simulation. Must be recorded outside of a render pass, before
+        // record_draw of the same frame. `frame` selects the burst region and must not be in flight.
+        void record_compute(VkCommandBuffer command_buffer, uint32_t frame, float dt)
+        {
+            // Previous frame's draw and simulation against this frame's writes
+            memory_barrier(command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1, &descriptor_set_, 0, nullptr);
+
+            Constants constants = {};
+            constants.dt = dt;
+            constants.current = current_;
+            constants.max_particles = max_particles_;
+
+            if (not initialized_)
+            {
+                push_constants(command_buffer, constants);
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, reset_pipeline_);
+                vkCmdDispatch(command_buffer, (max_particles_ + 63) / 64, 1, 1);
+                compute_barrier(command_buffer);
+                initialized_ = true;
+            }
+
+            if (not bursts_.empty())
+            {
+                const uint32_t base = (frame % frame_count_) * max_bursts_;
+                std::memcpy((GpuBurst*)bursts_buffer_.mapped + base, bursts_.data(), bursts_.size() * sizeof(GpuBurst));
+                flush_buffer(context_, bursts_buffer_);
+
+                constants.burst_count = (uint32_t)bursts_.size();
+                constants.burst_base = base;
+                constants.emit_total = emit_total_;
+                push_constants(command_buffer, constants);
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, emit_pipeline_);
+                vkCmdDispatch(command_buffer, (emit_total_ + 63) / 64, 1, 1);
+                compute_barrier(command_buffer);
+
+                bursts_.clear();
+                emit_total_ = 0;
+            }
+
+            push_constants(command_buffer, constants);
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, prepare_pipeline_);
+            vkCmdDispatch(command_buffer, 1, 1, 1);
+            memory_barrier(command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, simulate_pipeline_);
+            vkCmdDispatchIndirect(command_buffer, counters_.buffer, offsetof(GpuCounters, dispatch));
+
+            memory_barrier(command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+            // Survivors were appended to the other list, which is what gets drawn and simulated next
+            current_ = 1 - current_;
+        }
+
+        // Draws the alive particles inside the render pass the system was created with.
+        void record_draw(VkCommandBuffer command_buffer, uint32_t width, uint32_t height)
+        {
+            if (not initialized_)
+            {
+                return;
+            }
+            Constants constants = {};
+            constants.current = current_;
+            constants.max_particles = max_particles_;
+            constants.viewport[0] = (float)width;
+            constants.viewport[1] = (float)height;
+
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw_pipeline_);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &descriptor_set_, 0, nullptr);
+            push_constants(command_buffer, constants);
+            set_viewport_and_scissor(command_buffer, width, height);
+            vkCmdDrawIndirect(command_buffer, counters_.buffer, offsetof(GpuCounters, draw), 1, sizeof(VkDrawIndirectCommand));
+        }
+
+    private:
+        // Layouts mirror shaders/particle_common.glsl
+        struct GpuEmitter
+        {
+            float    direction[2];
+            float    spread;
+            float    speed_min;
+            float    speed_max;
+            float    life_min;
+            float    life_max;
+            float    size_begin;
+            float    size_end;
+            uint32_t color_begin;
+            uint32_t color_end;
+            float    gravity;
+            float    drag;
+            uint32_t pad;
+        };
+        static_assert(sizeof(GpuEmitter) == 56);
+
+        struct GpuBurst
+        {
+            uint32_t emitter;
+            uint32_t count;
+            uint32_t offset;
+            uint32_t seed;
+            float    position[2];
+            float    direction[2];
+        };
+        static_assert(sizeof(GpuBurst) == 32);
+
+        struct GpuCounters
+        {
+            int32_t                   alive_count[2];
+            int32_t                   dead_count;
+            uint32_t                  pad;
+            VkDrawIndirectCommand     draw;
+            VkDispatchIndirectCommand dispatch;
+        };
+
+        struct Constants
+        {
+            float    dt;
+            uint32_t current;
+            uint32_t burst_count;
+            uint32_t burst_base;
+            uint32_t emit_total;
+            uint32_t max_particles;
+            float    viewport[2];
+        };
+
+        static constexpr VkDeviceSize particle_size = 48;
+
+        VkResult create_buffers()
+        {
+            const VkBufferUsageFlags storage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            const VkMemoryPropertyFlags device_local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            const VkMemoryPropertyFlags host_visible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_buffers(); } };
+            set_and_check(result, create_buffer(context_, particle_size * max_particles_, storage, device_local, 0, particles_));
+            set_and_check(result, create_buffer(context_, sizeof(uint32_t) * 2 * max_particles_, storage, device_local, 0, alive_lists_));
+            set_and_check(result, create_buffer(context_, sizeof(uint32_t) * max_particles_, storage, device_local, 0, dead_list_));
+            set_and_check(result, create_buffer(context_, sizeof(GpuCounters),
+                storage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, device_local, 0, counters_));
+            set_and_check(result, create_buffer(context_, sizeof(GpuEmitter) * max_emitters_, storage,
+                host_visible, device_local | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, emitters_));
+            set_and_check(result, create_buffer(context_, sizeof(GpuBurst) * max_bursts_ * frame_count_, storage,
+                host_visible, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, bursts_buffer_));
+            return result;
+        }
+
+        void destroy_buffers() noexcept
+        {
+            destroy_buffer(context_, bursts_buffer_);
+            destroy_buffer(context_, emitters_);
+            destroy_buffer(context_, counters_);
+            destroy_buffer(context_, dead_list_);
+            destroy_buffer(context_, alive_lists_);
+            destroy_buffer(context_, particles_);
+        }
+
+        VkResult create_descriptors()
+        {
+            const GpuBuffer* buffers[] = { &particles_, &alive_lists_, &dead_list_, &counters_, &emitters_, &bursts_buffer_ };
+            constexpr uint32_t binding_count = (uint32_t)std::size(buffers);
+
+            VkDescriptorSetLayoutBinding bindings[binding_count] = {};
+            for (uint32_t i = 0; i < binding_count; i++)
+            {
+                bindings[i].binding = i;
+                bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                bindings[i].descriptorCount = 1;
+                bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+            }
+            VkDescriptorSetLayoutCreateInfo layout_info = {};
+            layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_info.bindingCount = binding_count;
+            layout_info.pBindings = bindings;
+            VkResult err = vkCreateDescriptorSetLayout(context_.device, &layout_info, context_.allocator, &set_layout_);
+            if(err) return err;
+
+            VkPushConstantRange range = {};
+            range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+            range.size = sizeof(Constants);
+            VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+            pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipeline_layout_info.setLayoutCount = 1;
+            pipeline_layout_info.pSetLayouts = &set_layout_;
+            pipeline_layout_info.pushConstantRangeCount = 1;
+            pipeline_layout_info.pPushConstantRanges = &range;
+            err = vkCreatePipelineLayout(context_.device, &pipeline_layout_info, context_.allocator, &pipeline_layout_);
+            if(err) return err;
+
+            VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, binding_count };
+            VkDescriptorPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pool_info.maxSets = 1;
+            pool_info.poolSizeCount = 1;
+            pool_info.pPoolSizes = &pool_size;
+            err = vkCreateDescriptorPool(context_.device, &pool_info, context_.allocator, &descriptor_pool_);
+            if(err) return err;
+
+            VkDescriptorSetAllocateInfo alloc_info = {};
+            alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            alloc_info.descriptorPool = descriptor_pool_;
+            alloc_info.descriptorSetCount = 1;
+            alloc_info.pSetLayouts = &set_layout_;
+            err = vkAllocateDescriptorSets(context_.device, &alloc_info, &descriptor_set_);
+            if(err) return err;
+
+            VkDescriptorBufferInfo buffer_infos[binding_count] = {};
+            VkWriteDescriptorSet writes[binding_count] = {};
+            for (uint32_t i = 0; i < binding_count; i++)
+            {
+                buffer_infos[i] = { buffers[i]->buffer, 0, VK_WHOLE_SIZE };
+                writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet = descriptor_set_;
+                writes[i].dstBinding = i;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[i].pBufferInfo = &buffer_infos[i];
+            }
+            vkUpdateDescriptorSets(context_.device, binding_count, writes, 0, nullptr);
+            return err;
+        }
+
+        void destroy_descriptors() noexcept
+        {
+            vkDestroyDescriptorPool(context_.device, descriptor_pool_, context_.allocator);
+            vkDestroyPipelineLayout(context_.device, pipeline_layout_, context_.allocator);
+            vkDestroyDescriptorSetLayout(context_.device, set_layout_, context_.allocator);
+        }
+
+        VkResult create_pipelines(VkRenderPass render_pass)
+        {
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_pipelines(); } };
+            set_and_check(result, create_compute_pipeline(context_, shaders::particle_reset_comp, pipeline_layout_, reset_pipeline_));
+            set_and_check(result, create_compute_pipeline(context_, shaders::particle_emit_comp, pipeline_layout_, emit_pipeline_));
+            set_and_check(result, create_compute_pipeline(context_, shaders::particle_prepare_comp, pipeline_layout_, prepare_pipeline_));
+            set_and_check(result, create_compute_pipeline(context_, shaders::particle_simulate_comp, pipeline_layout_, simulate_pipeline_));
+
+            // Additive, the hit effects are sparks and glows
+            VkPipelineColorBlendAttachmentState blend = {};
+            blend.blendEnable = VK_TRUE;
+            blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            blend.colorBlendOp = VK_BLEND_OP_ADD;
+            blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            blend.alphaBlendOp = VK_BLEND_OP_ADD;
+            blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            set_and_check(result, create_graphics_pipeline(context_, shaders::particle_vert, shaders::particle_frag,
+                pipeline_layout_, render_pass, 0, blend, draw_pipeline_));
+            return result;
+        }
+
+        void destroy_pipelines() noexcept
+        {
+            vkDestroyPipeline(context_.device, draw_pipeline_, context_.allocator);
+            vkDestroyPipeline(context_.device, simulate_pipeline_, context_.allocator);
+            vkDestroyPipeline(context_.device, prepare_pipeline_, context_.allocator);
+            vkDestroyPipeline(context_.device, emit_pipeline_, context_.allocator);
+            vkDestroyPipeline(context_.device, reset_pipeline_, context_.allocator);
+        }
+
+        void push_constants(VkCommandBuffer command_buffer, const Constants& constants) const
+        {
+            vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+                0, sizeof(Constants), &constants);
+        }
+
+        static void compute_barrier(VkCommandBuffer command_buffer)
+        {
+            memory_barrier(command_buffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        }
+
+        VulkanContext context_;
+        uint32_t frame_count_;
+        uint32_t max_particles_;
+        uint32_t max_emitters_;
+        uint32_t max_bursts_;
+
+        GpuBuffer particles_;
+        GpuBuffer alive_lists_;
+        GpuBuffer dead_list_;
+        GpuBuffer counters_;
+        GpuBuffer emitters_;
+        GpuBuffer bursts_buffer_;
+
+        VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+        VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+        VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+        VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+
+        VkPipeline reset_pipeline_ = VK_NULL_HANDLE;
+        VkPipeline emit_pipeline_ = VK_NULL_HANDLE;
+        VkPipeline prepare_pipeline_ = VK_NULL_HANDLE;
+        VkPipeline simulate_pipeline_ = VK_NULL_HANDLE;
+        VkPipeline draw_pipeline_ = VK_NULL_HANDLE;
+
+        uint32_t emitter_count_ = 0;
+        std::vector<GpuBurst> bursts_;
+        uint32_t emit_total_ = 0;
+        uint32_t seed_ = 0;
+        uint32_t current_ = 0;
+        bool initialized_ = false;
+    };
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ADTTIL_PIXEL_SSE2 1
+#endif
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+
+namespace adttil
+{
+    // How colour channels of stored pixels are to be interpreted. PNGs decode as straight alpha
+    // sRGB, both flags false. Colour is always stored sRGB encoded, as 8 bits are too few for
+    // linear values; `linear` pages are sampled through sRGB views instead, so shaders read and
+    // filter linear light, and premultiplication then happens in linear light before encoding.
+    struct PixelEncoding
+    {
+        bool premultiplied = false;
+        bool linear = false;
+    };
+
+    namespace detail
+    {
+        inline float srgb_to_linear(float value) noexcept
+        {
+            return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        inline float linear_to_srgb(float value) noexcept
+        {
+            return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        }
+
+        inline const std::array<float, 256>& srgb_decode_table() noexcept
+        {
+            static const std::array<float, 256> table = []
+            {
+                std::array<float, 256> values;
+                for (size_t i = 0; i < values.size(); i++)
+                {
+                    values[i] = srgb_to_linear((float)i / 255.0f);
+                }
+                return values;
+            }();
+            return table;
+        }
+
+        // Linear values quantized to 12 bits are enough to round trip every 8-bit sRGB value.
+        inline const std::array<uint8_t, 4096>& srgb_encode_table() noexcept
+        {
+            static const std::array<uint8_t, 4096> table = []
+            {
+                std::array<uint8_t, 4096> values;
+                for (size_t i = 0; i < values.size(); i++)
+                {
+                    values[i] = (uint8_t)std::lround(linear_to_srgb((float)i / 4095.0f) * 255.0f);
+                }
+                return values;
+            }();
+            return table;
+        }
+
+        // c * a / 255 rounded, for every colour channel of `count` pixels; alpha is kept.
+        inline void premultiply_row(Color32* row, size_t count) noexcept
+        {
+            size_t x = 0;
+#ifdef ADTTIL_PIXEL_SSE2
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bias = _mm_set1_epi16(128);
+            const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+            for (; x + 4 <= count; x += 4)
+            {
+                const __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x));
+                const auto scale = [&](__m128i wide)
+                {
+                    __m128i alpha = _mm_shufflelo_epi16(wide, _MM_SHUFFLE(3, 3, 3, 3));
+                    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+                    const __m128i product = _mm_add_epi16(_mm_mullo_epi16(wide, alpha), bias);
+                    return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+                };
+                const __m128i low = scale(_mm_unpacklo_epi8(pixels, zero));
+                const __m128i high = scale(_mm_unpackhi_epi8(pixels, zero));
+                const __m128i result = _mm_packus_epi16(low, high);
+                _mm_storeu_si128((__m128i*)(row + x), _mm_or_si128(_mm_andnot_si128(alpha_mask, result), _mm_and_si128(alpha_mask, pixels)));
+            }
+#endif
+            for (; x < count; x++)
+            {
+                Color32& pixel = row[x];
+                for (unsigned char* channel : { &pixel.r(), &pixel.g(), &pixel.b() })
+                {
+                    const uint32_t product = (uint32_t)*channel * pixel.a() + 128;
+                    *channel = (unsigned char)((product + (product >> 8)) >> 8);
+                }
+            }
+        }
+
+        // Premultiplies `count` pixels in linear light and encodes the result back to sRGB; alpha
+        // is kept. The SSE2 path computes the same floats, only the table reads are per lane.
+        inline void premultiply_linear_row(Color32* row, size_t count) noexcept
+        {
+            const auto& decode = srgb_decode_table();
+            const auto& encode = srgb_encode_table();
+            size_t x = 0;
+#ifdef ADTTIL_PIXEL_SSE2
+            const __m128i byte = _mm_set1_epi32(0xff);
+            const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+            for (; x + 4 <= count; x += 4)
+            {
+                const __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x));
+                const __m128 alpha = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(pixels, 24)), _mm_set1_ps(1.0f / 255.0f));
+                __m128i result = _mm_and_si128(pixels, alpha_mask);
+                for (int i = 0; i < 3; i++)
+                {
+                    alignas(16) int32_t lanes[4];
+                    _mm_store_si128((__m128i*)lanes, _mm_and_si128(_mm_srli_epi32(pixels, 8 * i), byte));
+                    const __m128 linear = _mm_setr_ps(decode[lanes[0]], decode[lanes[1]], decode[lanes[2]], decode[lanes[3]]);
+                    const __m128 scaled = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(linear, alpha), _mm_set1_ps(4095.0f)), _mm_set1_ps(0.5f));
+                    _mm_store_si128((__m128i*)lanes, _mm_cvttps_epi32(scaled));
+                    const __m128i encoded = _mm_setr_epi32(encode[lanes[0]], encode[lanes[1]], encode[lanes[2]], encode[lanes[3]]);
+                    result = _mm_or_si128(result, _mm_slli_epi32(encoded, 8 * i));
+                }
+                _mm_storeu_si128((__m128i*)(row + x), result);
+            }
+#endif
+            for (; x < count; x++)
+            {
+                Color32& pixel = row[x];
+                const float alpha = pixel.a() * (1.0f / 255.0f);
+                for (unsigned char* channel : { &pixel.r(), &pixel.g(), &pixel.b() })
+                {
+                    *channel = encode[(size_t)(decode[*channel] * alpha * 4095.0f + 0.5f)];
+                }
+            }
+        }
+    }
+
+    // Converts straight alpha sRGB pixels, as decoded from PNG, to `target` in place, row by row.
+    // Only premultiplication changes the pixels: in the stored sRGB space, or for linear targets
+    // in linear light, re-encoded to sRGB.
+    inline void convert_pixels(BitmapView bitmap, PixelEncoding target) noexcept
+    {
+        if (not target.premultiplied)
+        {
+            return;
+        }
+        for (size_t y = 0; y < bitmap.height(); y++)
+        {
+            Color32* row = &bitmap[Coord2{ 0uz, y }];
+            if (target.linear)
+            {
+                detail::premultiply_linear_row(row, bitmap.width());
+            }
+            else
+            {
+                detail::premultiply_row(row, bitmap.width());
+            }
+        }
+    }
+
+    // Fraction of `rect` whose alpha, multiplied by `scale`, reaches the alpha test `reference`.
+    inline float alpha_coverage(BitmapView bitmap, BitmapRect rect, float reference, float scale = 1.0f) noexcept
+    {
+        size_t passed = 0;
+        for (size_t y = rect.position.y(); y < rect.position.y() + rect.size.y(); y++)
+        {
+            for (size_t x = rect.position.x(); x < rect.position.x() + rect.size.x(); x++)
+            {
+                passed += bitmap[Coord2{ x, y }].a() * scale >= reference * 255.0f;
+            }
+        }
+        const size_t count = rect.size.x() * rect.size.y();
+        return count ? (float)passed / (float)count : 0.0f;
+    }
+
+    // Scales the alpha of `rect` so that `coverage` of it passes the alpha test `reference`, so
+    // alpha tested sprites do not thin out in smaller mips. Premultiplied colour is scaled along,
+    // in linear light when it was premultiplied there.
+    inline void preserve_alpha_coverage(BitmapView bitmap, BitmapRect rect, float coverage, float reference, PixelEncoding encoding) noexcept
+    {
+        const auto& decode = detail::srgb_decode_table();
+        const auto& encode = detail::srgb_encode_table();
+        // Smallest scale reaching the coverage; coverage only changes in whole texels.
+        float low = 0.0f, high = 4.0f;
+        for (int iteration = 0; iteration < 12; iteration++)
+        {
+            const float middle = (low + high) * 0.5f;
+            if (alpha_coverage(bitmap, rect, reference, middle) < coverage)
+            {
+                low = middle;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        const float scale = high;
+        for (size_t y = rect.position.y(); y < rect.position.y() + rect.size.y(); y++)
+        {
+            for (size_t x = rect.position.x(); x < rect.position.x() + rect.size.x(); x++)
+            {
+                Color32& pixel = bitmap[Coord2{ x, y }];
+                // Colour follows the alpha as stored, rounded, so it stays in proportion to it.
+                const auto alpha = (unsigned char)std::lround(std::min(pixel.a() * scale, 255.0f));
+                if (encoding.premultiplied && pixel.a() != 0)
+                {
+                    const float ratio = (float)alpha / pixel.a();
+                    for (unsigned char* channel : { &pixel.r(), &pixel.g(), &pixel.b() })
+                    {
+                        *channel = encoding.linear ? encode[(size_t)(std::min(decode[*channel] * ratio, 1.0f) * 4095.0f + 0.5f)]
+                            : (unsigned char)std::min(std::lround(*channel * ratio), 255l);
+                    }
+                }
+                pixel.a() = alpha;
+            }
+        }
+    }
+}
@@ -0,0 +1,372 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+#include <renderer/pixel_convert.hpp>
+
+namespace adttil
+{
+    // Storage format of a clip's pages, from widest to narrowest texel.
+    enum class PixelFormat : uint32_t
+    {
+        rgba8,
+        // 4 bits per channel, packed as B4G4R4A4, the 16-bit layout every Vulkan device samples.
+        rgba4444,
+        // Opaque only.
+        rgb565,
+        // Alpha of a white sprite; the colour comes from the vertex tint.
+        r8,
+        // Index into a palette of up to 256 colours, looked up by the shader with texelFetch.
+        palette8,
+    };
+
+    inline size_t pixel_bytes(PixelFormat format) noexcept
+    {
+        switch (format)
+        {
+        case PixelFormat::rgba4444:
+        case PixelFormat::rgb565:   return 2;
+        case PixelFormat::r8:
+        case PixelFormat::palette8: return 1;
+        default:                    return sizeof(Color32);
+        }
+    }
+
+    inline VkFormat vk_format(PixelFormat format) noexcept
+    {
+        switch (format)
+        {
+        case PixelFormat::rgba4444: return VK_FORMAT_B4G4R4A4_UNORM_PACK16;
+        case PixelFormat::rgb565:   return VK_FORMAT_R5G6B5_UNORM_PACK16;
+        case PixelFormat::r8:       return VK_FORMAT_R8_UNORM;
+        case PixelFormat::palette8: return VK_FORMAT_R8_UINT;
+        default:                    return VK_FORMAT_R8G8B8A8_UNORM;
+        }
+    }
+
+    // Swizzle turning an R8 mask back into `encoding`'s white sprite.
+    inline VkComponentMapping mask_components(PixelEncoding encoding) noexcept
+    {
+        const VkComponentSwizzle color = encoding.premultiplied ? VK_COMPONENT_SWIZZLE_R : VK_COMPONENT_SWIZZLE_ONE;
+        return { color, color, color, VK_COMPONENT_SWIZZLE_R };
+    }
+
+    // Up to 256 colours; index 0 is always transparent black, which every fully transparent
+    // texel maps to regardless of its colour channels.
+    class Palette
+    {
+    public:
+        static constexpr size_t max_colors = 256;
+
+        Palette()
+        : colors_{ Color32{ 0, 0, 0, 0 } }
+        {
+            indices_.emplace(0u, (uint8_t)0);
+        }
+
+        std::span<const Color32> colors() const noexcept
+        {
+            return colors_;
+        }
+
+        size_t size() const noexcept
+        {
+            return colors_.size();
+        }
+
+        // Adds `color` unless present; false when the palette is full.
+        bool add(Color32 color)
+        {
+            if (color.a() == 0 || indices_.contains(key(color)))
+            {
+                return true;
+            }
+            if (colors_.size() == max_colors)
+            {
+                return false;
+            }
+            indices_.emplace(key(color), (uint8_t)colors_.size());
+            colors_.push_back(color);
+            return true;
+        }
+
+        bool contains(Color32 color) const noexcept
+        {
+            return color.a() == 0 || indices_.contains(key(color));
+        }
+
+        // Exact entry of `color`, or the nearest one for colours the palette lacks, such as
+        // averages in smaller mips.
+        uint8_t index(Color32 color) const noexcept
+        {
+            if (color.a() == 0)
+            {
+                return 0;
+            }
+            if (auto iter = indices_.find(key(color)); iter != indices_.end())
+            {
+                return iter->second;
+            }
+            uint8_t best = 0;
+            int best_error = INT32_MAX;
+            for (size_t i = 0; i < colors_.size(); i++)
+            {
+                const Color32 entry = colors_[i];
+                const int dr = entry.r() - color.r(), dg = entry.g() - color.g(), db = entry.b() - color.b(), da = entry.a() - color.a();
+                const int error = dr * dr + dg * dg + db * db + da * da;
+                if (error < best_error)
+                {
+                    best_error = error;
+                    best = (uint8_t)i;
+                }
+            }
+            return best;
+        }
+
+        // Replaces the colours, index 0 included, e.g. for a palette swapped character variant.
+        // Extra colours are dropped.
+        void assign(std::span<const Color32> colors)
+        {
+            const size_t count = std::min(colors.size(), max_colors);
+            colors_.assign(colors.begin(), colors.begin() + count);
+            indices_.clear();
+            for (size_t i = 0; i < colors_.size(); i++)
+            {
+                indices_.try_emplace(key(colors_[i]), (uint8_t)i);
+            }
+        }
+
+    private:
+        static uint32_t key(Color32 color) noexcept
+        {
+            return (uint32_t)color.r() | (uint32_t)color.g() << 8 | (uint32_t)color.b() << 16 | (uint32_t)color.a() << 24;
+        }
+
+        std::vector<Color32> colors_;
+        std::unordered_map<uint32_t, uint8_t> indices_;
+    };
+
+    namespace detail
+    {
+        inline uint32_t quantize(unsigned char value, uint32_t max) noexcept
+        {
+            return (value * max + 127) / 255;
+        }
+
+        inline unsigned char expand(uint32_t value, uint32_t max) noexcept
+        {
+            return (unsigned char)((value * 255 + max / 2) / max);
+        }
+
+        inline uint16_t pack_4444(Color32 color) noexcept
+        {
+            return (uint16_t)(quantize(color.b(), 15) << 12 | quantize(color.g(), 15) << 8 | quantize(color.r(), 15) << 4 | quantize(color.a(), 15));
+        }
+
+        inline Color32 unpack_4444(uint16_t value) noexcept
+        {
+            return Color32{ expand(value >> 4 & 15, 15), expand(value >> 8 & 15, 15), expand(value >> 12 & 15, 15), expand(value & 15, 15) };
+        }
+
+        inline uint16_t pack_565(Color32 color) noexcept
+        {
+            return (uint16_t)(quantize(color.r(), 31) << 11 | quantize(color.g(), 63) << 5 | quantize(color.b(), 31));
+        }
+
+        inline Color32 unpack_565(uint16_t value) noexcept
+        {
+            return Color32{ expand(value >> 11 & 31, 31), expand(value >> 5 & 63, 63), expand(value & 31, 31), 255 };
+        }
+
+        // Stored colour channel of white at `alpha`: the r8 swizzle hands the GPU alpha itself,
+        // which for linear encodings is linear light behind an sRGB encoding.
+        inline unsigned char premultiplied_white(unsigned char alpha, PixelEncoding encoding) noexcept
+        {
+            if (not encoding.premultiplied)
+            {
+                return 255;
+            }
+            return encoding.linear ? srgb_encode_table()[(size_t)std::lround(alpha * (4095.0f / 255.0f))] : alpha;
+        }
+
+        // Largest channel difference; colour is ignored where both are fully transparent.
+        inline int channel_error(Color32 a, Color32 b) noexcept
+        {
+            const int alpha = std::abs(a.a() - b.a());
+            if (a.a() == 0 && b.a() == 0)
+            {
+                return 0;
+            }
+            return std::max({ alpha, std::abs(a.r() - b.r()), std::abs(a.g() - b.g()), std::abs(a.b() - b.b()) });
+        }
+    }
+
+    // Decodes one texel of `format` back to RGBA8 in `encoding`.
+    inline Color32 decode_pixel(PixelFormat format, const std::byte* texel, PixelEncoding encoding = {}, const Palette* palette = nullptr) noexcept
+    {
+        uint16_t packed = 0;
+        switch (format)
+        {
+        case PixelFormat::rgba4444:
+            std::memcpy(&packed, texel, sizeof(packed));
+            return detail::unpack_4444(packed);
+        case PixelFormat::rgb565:
+            std::memcpy(&packed, texel, sizeof(packed));
+            return detail::unpack_565(packed);
+        case PixelFormat::r8:
+        {
+            const auto alpha = (unsigned char)*texel;
+            const unsigned char white = detail::premultiplied_white(alpha, encoding);
+            return Color32{ white, white, white, alpha };
+        }
+        case PixelFormat::palette8:
+        {
+            const auto index = (size_t)*texel;
+            return palette && index < palette->size() ? palette->colors()[index] : Color32{ 0, 0, 0, 0 };
+        }
+        default:
+        {
+            Color32 color;
+            std::memcpy(&color, texel, sizeof(color));
+            return color;
+        }
+        }
+    }
+
+    inline void encode_pixel(PixelFormat format, Color32 color, std::byte* texel, const Palette* palette = nullptr) noexcept
+    {
+        uint16_t packed = 0;
+        switch (format)
+        {
+        case PixelFormat::rgba4444:
+            packed = detail::pack_4444(color);
+            std::memcpy(texel, &packed, sizeof(packed));
+            break;
+        case PixelFormat::rgb565:
+            packed = detail::pack_565(color);
+            std::memcpy(texel, &packed, sizeof(packed));
+            break;
+        case PixelFormat::r8:
+            *texel = (std::byte)color.a();
+            break;
+        case PixelFormat::palette8:
+            *texel = (std::byte)(palette ? palette->index(color) : 0);
+            break;
+        default:
+            std::memcpy(texel, &color, sizeof(color));
+            break;
+        }
+    }
+
+    // Bytes of a `size` image in `format`.
+    inline size_t format_size(Coord2 size, PixelFormat format) noexcept
+    {
+        return size.x() * size.y() * pixel_bytes(format);
+    }
+
+    // Encodes `rect` of the RGBA8 `page` into `out`, which holds the whole page in `format` with
+    // rows back to back. Palette pages take the palette of the frame owning the rect.
+    inline void encode_rect(BitmapView page, BitmapRect rect, PixelFormat format, std::span<std::byte> out, const Palette* palette = nullptr) noexcept
+    {
+        const size_t texel = pixel_bytes(format);
+        const size_t x1 = std::min(rect.position.x() + rect.size.x(), page.width());
+        const size_t y1 = std::min(rect.position.y() + rect.size.y(), page.height());
+        for (size_t y = rect.position.y(); y < y1; y++)
+        {
+            std::byte* row = out.data() + y * page.width() * texel;
+            for (size_t x = rect.position.x(); x < x1; x++)
+            {
+                encode_pixel(format, page[Coord2{ x, y }], row + x * texel, palette);
+            }
+        }
+    }
+
+    struct FormatChoice
+    {
+        PixelFormat format = PixelFormat::rgba8;
+        // Colours of palette8 clips, empty otherwise.
+        Palette     palette;
+    };
+
+    // Narrowest format storing every pixel of `frames` within `tolerance` per channel: white
+    // masks become r8, up to 255 distinct visible colours palette8 (always exact), then opaque
+    // content rgb565 and the rest rgba4444 when they stay within the tolerance. The 16-bit
+    // formats have no sRGB views, so linear encodings skip them.
+    inline FormatChoice choose_format(std::span<const BitmapView> frames, PixelEncoding encoding, int tolerance = 0)
+    {
+        bool mask = true;
+        bool opaque = true;
+        int error_565 = 0;
+        int error_4444 = 0;
+        Palette palette;
+        bool fits_palette = true;
+        for (const BitmapView& frame : frames)
+        {
+            for (size_t y = 0; y < frame.height(); y++)
+            {
+                for (size_t x = 0; x < frame.width(); x++)
+                {
+                    const Color32 color = frame[Coord2{ x, y }];
+                    opaque = opaque && color.a() == 255;
+                    if (color.a() != 0)
+                    {
+                        const int white = detail::premultiplied_white(color.a(), encoding);
+                        mask = mask && std::abs(color.r() - white) <= tolerance && std::abs(color.g() - white) <= tolerance && std::abs(color.b() - white) <= tolerance;
+                        fits_palette = fits_palette && palette.add(color);
+                    }
+                    error_565 = std::max(error_565, detail::channel_error(color, detail::unpack_565(detail::pack_565(color))));
+                    error_4444 = std::max(error_4444, detail::channel_error(color, detail::unpack_4444(detail::pack_4444(color))));
+                }
+            }
+        }
+
+        if (mask)
+        {
+            return { PixelFormat::r8 };
+        }
+        if (fits_palette)
+        {
+            return { PixelFormat::palette8, std::move(palette) };
+        }
+        if (encoding.linear)
+        {
+            return { PixelFormat::rgba8 };
+        }
+        if (opaque && error_565 <= tolerance)
+        {
+            return { PixelFormat::rgb565 };
+        }
+        if (error_4444 <= tolerance)
+        {
+            return { PixelFormat::rgba4444 };
+        }
+        return { PixelFormat::rgba8 };
+    }
+
+    // Whether `frame` can join a clip stored as `format` without exceeding `tolerance`.
+    inline bool fits_format(BitmapView frame, PixelFormat format, PixelEncoding encoding, int tolerance, const Palette* palette = nullptr) noexcept
+    {
+        for (size_t y = 0; y < frame.height(); y++)
+        {
+            for (size_t x = 0; x < frame.width(); x++)
+            {
+                const Color32 color = frame[Coord2{ x, y }];
+                std::byte texel[sizeof(Color32)];
+                encode_pixel(format, color, texel, palette);
+                const bool exact = format != PixelFormat::palette8 || (palette && palette->contains(color));
+                if (not exact || detail::channel_error(color, decode_pixel(format, texel, encoding, palette)) > tolerance)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
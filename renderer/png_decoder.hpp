@@ -0,0 +1,371 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+#include <stb_image/stb_image.h>
+
+#include <renderer/common.hpp>
+#include <renderer/bitmap.hpp>
+
+namespace adttil
+{
+    // PNG reader that writes pixels straight into memory chosen by the caller: a trimmed frame, an
+    // atlas slot or a mapped staging buffer, in any row pitch. Only the inflated scanlines are
+    // buffered, and that buffer is kept for the next file, so one decoder per thread decodes a
+    // whole folder without allocating per file. crop() copies part of them into another decoder
+    // when the pixels are needed again later, so no file has to be inflated twice.
+    //
+    // Handles non-interlaced 8-bit images of every colour type, with tRNS transparency, exactly
+    // as stb_image decodes them. open() returns false for anything else, 16-bit or interlaced
+    // files for instance, which the caller then hands to stb_image.
+    class PngDecoder
+    {
+    public:
+        // Parses and inflates `bytes`, which only need to stay alive during the call.
+        bool open(std::span<const std::byte> bytes)
+        {
+            static constexpr unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+            size_ = Coord2{ 0uz, 0uz };
+            if (bytes.size() < sizeof(signature) || std::memcmp(bytes.data(), signature, sizeof(signature)) != 0)
+            {
+                return false;
+            }
+
+            std::span<const std::byte> idat;
+            bool split_idat = false;
+            bool header = false;
+            palette_size_ = 0;
+            has_key_ = false;
+            for (size_t at = sizeof(signature); at + 12 <= bytes.size();)
+            {
+                const uint32_t length = read_be32(bytes.data() + at);
+                if (length > bytes.size() - at - 12)
+                {
+                    return false;
+                }
+                const char* type = (const char*)bytes.data() + at + 4;
+                const std::span<const std::byte> data = bytes.subspan(at + 8, length);
+                at += 12 + length;
+
+                if (std::memcmp(type, "IHDR", 4) == 0)
+                {
+                    if (length < 13 || not parse_header(data))
+                    {
+                        return false;
+                    }
+                    header = true;
+                }
+                else if (std::memcmp(type, "PLTE", 4) == 0)
+                {
+                    palette_size_ = std::min<size_t>(length / 3, 256);
+                    for (size_t i = 0; i < palette_size_; i++)
+                    {
+                        palette_[i] = Color32{ (unsigned char)data[i * 3], (unsigned char)data[i * 3 + 1], (unsigned char)data[i * 3 + 2], 255 };
+                    }
+                }
+                else if (std::memcmp(type, "tRNS", 4) == 0)
+                {
+                    parse_transparency(data);
+                }
+                else if (std::memcmp(type, "IDAT", 4) == 0)
+                {
+                    // A single IDAT, the usual case, is inflated in place; split ones are joined.
+                    if (idat.empty() && not split_idat)
+                    {
+                        idat = data;
+                        continue;
+                    }
+                    if (not split_idat)
+                    {
+                        joined_.assign(idat.begin(), idat.end());
+                        split_idat = true;
+                    }
+                    joined_.insert(joined_.end(), data.begin(), data.end());
+                }
+                else if (std::memcmp(type, "IEND", 4) == 0)
+                {
+                    break;
+                }
+                else if (std::memcmp(type, "CgBI", 4) == 0)
+                {
+                    // Apple's byte swapped variant, which stb_image converts.
+                    return false;
+                }
+            }
+            if (split_idat)
+            {
+                idat = joined_;
+            }
+            if (not header || idat.empty() || (color_type_ == color_indexed && palette_size_ == 0))
+            {
+                return false;
+            }
+
+            const size_t stride = row_bytes_ + 1;
+            const size_t inflated_size = stride * size_.y();
+            if (inflated_size > (size_t)INT32_MAX || idat.size() > (size_t)INT32_MAX)
+            {
+                return false;
+            }
+            rows_.resize(inflated_size);
+            const int inflated = stbi_zlib_decode_buffer((char*)rows_.data(), (int)rows_.size(), (const char*)idat.data(), (int)idat.size());
+            if (inflated != (int)inflated_size || not unfilter())
+            {
+                size_ = Coord2{ 0uz, 0uz };
+                return false;
+            }
+            return true;
+        }
+
+        // Takes pixels decoded elsewhere, e.g. by stb_image, so alpha_bounds(), read() and crop()
+        // serve them like an opened file.
+        void assign(BitmapView rgba)
+        {
+            size_ = rgba.size();
+            color_type_ = color_rgba;
+            channels_ = 4;
+            row_bytes_ = size_.x() * 4;
+            palette_size_ = 0;
+            has_key_ = false;
+            rows_.resize((row_bytes_ + 1) * size_.y());
+            for (size_t y = 0; y < size_.y(); y++)
+            {
+                rows_[y * (row_bytes_ + 1)] = 0;
+                std::memcpy(rows_.data() + y * (row_bytes_ + 1) + 1, &rgba[Coord2{ 0uz, y }], row_bytes_);
+            }
+        }
+
+        // Copies `rect` of the image into `out`, still in the stored format, so that read() of `out`
+        // serves it from the origin. `out` holds just those scanlines, allocated to fit.
+        void crop(BitmapRect rect, PngDecoder& out) const
+        {
+            out.size_ = rect.size;
+            out.color_type_ = color_type_;
+            out.channels_ = channels_;
+            out.row_bytes_ = rect.size.x() * channels_;
+            std::copy_n(palette_, palette_size_, out.palette_);
+            out.palette_size_ = palette_size_;
+            out.has_key_ = has_key_;
+            out.key_ = key_;
+            out.rows_.assign((out.row_bytes_ + 1) * rect.size.y(), 0);
+            for (size_t y = 0; y < rect.size.y(); y++)
+            {
+                std::memcpy(out.rows_.data() + y * (out.row_bytes_ + 1) + 1, scanline(rect.position.y() + y) + rect.position.x() * channels_, out.row_bytes_);
+            }
+            out.joined_ = {};
+        }
+
+        Coord2 size() const noexcept
+        {
+            return size_;
+        }
+
+        // Same result as alpha_bounds() of the decoded image, found without writing it anywhere.
+        BitmapRect alpha_bounds() const noexcept
+        {
+            const bool has_alpha = color_type_ == color_gray_alpha || color_type_ == color_rgba || color_type_ == color_indexed || has_key_;
+            if (not has_alpha)
+            {
+                return { Coord2{ 0uz, 0uz }, size_ };
+            }
+            size_t x0 = size_.x(), y0 = size_.y(), x1 = 0, y1 = 0;
+            for (size_t y = 0; y < size_.y(); y++)
+            {
+                const uint8_t* row = scanline(y);
+                for (size_t x = 0; x < size_.x(); x++)
+                {
+                    if (texel(row, x).a() != 0)
+                    {
+                        x0 = std::min(x0, x);
+                        x1 = std::max(x1, x + 1);
+                        y0 = std::min(y0, y);
+                        y1 = y + 1;
+                    }
+                }
+            }
+            if (x1 <= x0)
+            {
+                return { Coord2{ 0uz, 0uz }, Coord2{ 0uz, 0uz } };
+            }
+            return { Coord2{ x0, y0 }, Coord2{ x1 - x0, y1 - y0 } };
+        }
+
+        // Writes `rect` of the image as straight alpha RGBA8 into `target`, which has its size.
+        void read(BitmapRect rect, BitmapView target) const noexcept
+        {
+            for (size_t y = 0; y < rect.size.y(); y++)
+            {
+                const uint8_t* row = scanline(rect.position.y() + y);
+                Color32* out = &target[Coord2{ 0uz, y }];
+                if (color_type_ == color_rgba)
+                {
+                    std::memcpy(out, row + rect.position.x() * 4, rect.size.x() * sizeof(Color32));
+                    continue;
+                }
+                for (size_t x = 0; x < rect.size.x(); x++)
+                {
+                    out[x] = texel(row, rect.position.x() + x);
+                }
+            }
+        }
+
+    private:
+        static constexpr uint8_t color_gray = 0;
+        static constexpr uint8_t color_rgb = 2;
+        static constexpr uint8_t color_indexed = 3;
+        static constexpr uint8_t color_gray_alpha = 4;
+        static constexpr uint8_t color_rgba = 6;
+
+        static uint32_t read_be32(const std::byte* at) noexcept
+        {
+            return (uint32_t)at[0] << 24 | (uint32_t)at[1] << 16 | (uint32_t)at[2] << 8 | (uint32_t)at[3];
+        }
+
+        bool parse_header(std::span<const std::byte> data) noexcept
+        {
+            const uint32_t width = read_be32(data.data());
+            const uint32_t height = read_be32(data.data() + 4);
+            const auto bit_depth = (uint8_t)data[8];
+            color_type_ = (uint8_t)data[9];
+            const auto compression = (uint8_t)data[10], filter = (uint8_t)data[11], interlace = (uint8_t)data[12];
+            switch (color_type_)
+            {
+            case color_gray:
+            case color_indexed:    channels_ = 1; break;
+            case color_gray_alpha: channels_ = 2; break;
+            case color_rgb:        channels_ = 3; break;
+            case color_rgba:       channels_ = 4; break;
+            default:               return false;
+            }
+            if (width == 0 || height == 0 || width > (1u << 24) || height > (1u << 24)
+                || bit_depth != 8 || compression != 0 || filter != 0 || interlace != 0)
+            {
+                return false;
+            }
+            size_ = Coord2{ (size_t)width, (size_t)height };
+            row_bytes_ = width * channels_;
+            return true;
+        }
+
+        void parse_transparency(std::span<const std::byte> data) noexcept
+        {
+            if (color_type_ == color_indexed)
+            {
+                for (size_t i = 0; i < std::min(data.size(), palette_size_); i++)
+                {
+                    palette_[i].a() = (unsigned char)data[i];
+                }
+            }
+            // 16-bit samples; for 8-bit images the low byte holds the value.
+            else if (color_type_ == color_gray && data.size() >= 2)
+            {
+                has_key_ = true;
+                key_ = Color32{ (unsigned char)data[1], (unsigned char)data[1], (unsigned char)data[1], 255 };
+            }
+            else if (color_type_ == color_rgb && data.size() >= 6)
+            {
+                has_key_ = true;
+                key_ = Color32{ (unsigned char)data[1], (unsigned char)data[3], (unsigned char)data[5], 255 };
+            }
+        }
+
+        // Reverses the per row filters in place; the filter byte of each row is left as is.
+        bool unfilter() noexcept
+        {
+            const size_t stride = row_bytes_ + 1;
+            const size_t bpp = channels_;
+            for (size_t y = 0; y < size_.y(); y++)
+            {
+                uint8_t* row = rows_.data() + y * stride;
+                const uint8_t filter = row[0];
+                uint8_t* current = row + 1;
+                const uint8_t* previous = y ? current - stride : nullptr;
+                switch (filter)
+                {
+                case 0:
+                    break;
+                case 1:
+                    for (size_t i = bpp; i < row_bytes_; i++)
+                    {
+                        current[i] += current[i - bpp];
+                    }
+                    break;
+                case 2:
+                    for (size_t i = 0; previous && i < row_bytes_; i++)
+                    {
+                        current[i] += previous[i];
+                    }
+                    break;
+                case 3:
+                    for (size_t i = 0; i < row_bytes_; i++)
+                    {
+                        const unsigned left = i >= bpp ? current[i - bpp] : 0;
+                        const unsigned up = previous ? previous[i] : 0;
+                        current[i] += (uint8_t)((left + up) / 2);
+                    }
+                    break;
+                case 4:
+                    for (size_t i = 0; i < row_bytes_; i++)
+                    {
+                        const int left = i >= bpp ? current[i - bpp] : 0;
+                        const int up = previous ? previous[i] : 0;
+                        const int up_left = previous && i >= bpp ? previous[i - bpp] : 0;
+                        const int estimate = left + up - up_left;
+                        const int distance_left = std::abs(estimate - left), distance_up = std::abs(estimate - up), distance_up_left = std::abs(estimate - up_left);
+                        current[i] += (uint8_t)(distance_left <= distance_up && distance_left <= distance_up_left ? left : distance_up <= distance_up_left ? up : up_left);
+                    }
+                    break;
+                default:
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        const uint8_t* scanline(size_t y) const noexcept
+        {
+            return rows_.data() + y * (row_bytes_ + 1) + 1;
+        }
+
+        Color32 texel(const uint8_t* row, size_t x) const noexcept
+        {
+            Color32 color;
+            switch (color_type_)
+            {
+            case color_gray:
+                color = Color32{ row[x], row[x], row[x], 255 };
+                break;
+            case color_gray_alpha:
+                return Color32{ row[x * 2], row[x * 2], row[x * 2], row[x * 2 + 1] };
+            case color_indexed:
+                return row[x] < palette_size_ ? palette_[row[x]] : Color32{ 0, 0, 0, 255 };
+            case color_rgb:
+                color = Color32{ row[x * 3], row[x * 3 + 1], row[x * 3 + 2], 255 };
+                break;
+            default:
+                return Color32{ row[x * 4], row[x * 4 + 1], row[x * 4 + 2], row[x * 4 + 3] };
+            }
+            if (has_key_ && color.r() == key_.r() && color.g() == key_.g() && color.b() == key_.b())
+            {
+                color.a() = 0;
+            }
+            return color;
+        }
+
+        Coord2 size_;
+        uint8_t color_type_ = 0;
+        size_t channels_ = 0;
+        size_t row_bytes_ = 0;
+        Color32 palette_[256];
+        size_t palette_size_ = 0;
+        bool has_key_ = false;
+        Color32 key_;
+        // Inflated scanlines, each behind its filter byte, and split IDAT payloads joined.
+        std::vector<uint8_t> rows_;
+        std::vector<std::byte> joined_;
+    };
+}
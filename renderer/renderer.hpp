@@ -8,82 +8,28 @@
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <optional>
 
 #include <stb_image/stb_image.h>
 
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_vulkan.h>
-#define GLFW_INCLUDE_NONE
-#define GLFW_INCLUDE_VULKAN
-#include <GLFW/glfw3.h>
-#include <vulkan/vulkan.h>
 
-#include <senluo/geo.hpp>
+#include <renderer/common.hpp>
+#include <renderer/submit_batcher.hpp>
+#include <renderer/frame_capture.hpp>
+#include <renderer/particle_system.hpp>
+#include <renderer/lighting_system.hpp>
+#include <renderer/world_text.hpp>
+#include <renderer/sprite_batch.hpp>
+#include <renderer/bitmap.hpp>
+#include <renderer/anim_manager.hpp>
+#include <renderer/anim_residency.hpp>
 
 namespace adttil
 {
-    using Vec2 = senluo::geo::vec<2>;
-    using Vec3 = senluo::geo::vec<3>;
-    using Vec4 = senluo::geo::vec<4>;
-
-    using Coord2 = senluo::geo::vec<2, size_t>;
-    using Coord3 = senluo::geo::vec<3, size_t>;
-    using Coord4 = senluo::geo::vec<4, size_t>;
-
-    using Color32 = senluo::geo::vec<4, unsigned char>;
-
-    inline void glfw_error_callback(int error, const char* description)
-    {
-        std::println(stderr, "GLFW Error {}: {}", error, description);
-    }
-
-    inline void check_vk_result(VkResult err)
-    {
-        if (err == 0)
-        {
-            return;
-        }
-        std::println(/*stderr, */"[vulkan] Error: VkResult = {}\n", std::to_underlying(err));
-        if (err < 0)
-        {
-            throw std::exception{ "vk error" };
-        }
-    }
-
-    template<class...Types>
-    inline void print_and_throw(const std::format_string<Types...> msg_fmt, Types&&...args)
-    {
-        std::println(msg_fmt, std::forward<Types>(args)...);
-        throw std::exception{};
-    }
-
-    template<class TOn, class F>
-    class OptianalGuard
-    {
-    public:
-        constexpr OptianalGuard(TOn& on, F&& f)
-        : on_{on}
-        , fn_{ std::move(f) }
-        { }
-
-        constexpr ~OptianalGuard()noexcept
-        {
-            if(on_) fn_();
-        }
-
-    private:
-        TOn& on_;
-        F fn_;
-    };
-
-    class NoMoveable
-    {
-    public:
-        constexpr NoMoveable() = default;
-        NoMoveable(NoMoveable&&) = delete;
-    };
-
     class Renderer : NoMoveable
     {
     public:
@@ -111,6 +57,9 @@ namespace adttil
             set_and_check(result, create_device());
             OptianalGuard _{ result, [&]{ destroy_device(); } };
 
+            set_and_check(result, create_submit_batcher());
+            OptianalGuard _{ result, [&]{ destroy_submit_batcher(); } };
+
             set_and_check(result, create_descriptor_pool());
             OptianalGuard _{ result, [&]{ destroy_descriptor_pool(); } };
 
@@ -126,6 +75,21 @@ namespace adttil
             set_and_check(result, create_frames());
             OptianalGuard _{ result, [&]{ destroy_frames(); } };
 
+            set_and_check(result, create_frame_capture());
+            OptianalGuard _{ result, [&]{ destroy_frame_capture(); } };
+
+            set_and_check(result, create_particle_system());
+            OptianalGuard _{ result, [&]{ destroy_particle_system(); } };
+
+            set_and_check(result, create_lighting_system());
+            OptianalGuard _{ result, [&]{ destroy_lighting_system(); } };
+
+            set_and_check(result, create_sprite_batch());
+            OptianalGuard _{ result, [&]{ destroy_sprite_batch(); } };
+
+            set_and_check(result, create_world_text());
+            OptianalGuard _{ result, [&]{ destroy_world_text(); } };
+
             // Setup Dear ImGui context
             IMGUI_CHECKVERSION();
             ImGui::CreateContext();
@@ -164,11 +128,17 @@ namespace adttil
             ImGui_ImplGlfw_Shutdown();
             ImGui::DestroyContext();
 
+            destroy_world_text();
+            destroy_sprite_batch();
+            destroy_lighting_system();
+            destroy_particle_system();
+            destroy_frame_capture();
             destroy_frames();
             destroy_render_pass();
             destroy_swapchain();
             destroy_surface();
             destroy_descriptor_pool();
+            destroy_submit_batcher();
             destroy_device();
             destroy_instance();
 
@@ -227,6 +197,10 @@ namespace adttil
                 err = vkBeginCommandBuffer(fd.command_buffer, &info);
                 check_vk_result(err);
             }
+            particle_system_->record_compute(fd.command_buffer, frame_index_, ImGui::GetIO().DeltaTime);
+            sprite_batch_->record_upload(fd.command_buffer, frame_index_);
+            lighting_system_->record(fd.command_buffer, frame_index_);
+            world_text_->record_upload(fd.command_buffer, frame_index_);
             {
                 VkRenderPassBeginInfo info = {};
                 info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -246,28 +220,27 @@ namespace adttil
                 vkCmdBeginRenderPass(fd.command_buffer, &info, VK_SUBPASS_CONTENTS_INLINE);
             }
         
+            lighting_system_->record_composite(fd.command_buffer);
+            particle_system_->record_draw(fd.command_buffer, width_, height_);
+            sprite_batch_->record_draw(fd.command_buffer, frame_index_, width_, height_);
+            world_text_->record_draw(fd.command_buffer, frame_index_, width_, height_);
+
             // Record dear imgui primitives into command buffer
             ImGui_ImplVulkan_RenderDrawData(draw_data, fd.command_buffer);
         
-            // Submit command buffer
+            // Submit command buffer, together with anything else batched for this frame
             vkCmdEndRenderPass(fd.command_buffer);
+            frame_capture_->record(fd.command_buffer, backbuffers_[frame_index_]);
             {
-                VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-                VkSubmitInfo info = {};
-                info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-                info.waitSemaphoreCount = 1;
-                info.pWaitSemaphores = &image_acquired_semaphore;
-                info.pWaitDstStageMask = &wait_stage;
-                info.commandBufferCount = 1;
-                info.pCommandBuffers = &fd.command_buffer;
-                info.signalSemaphoreCount = 1;
-                info.pSignalSemaphores = &render_complete_semaphore;
-            
                 err = vkEndCommandBuffer(fd.command_buffer);
                 check_vk_result(err);
-                err = vkQueueSubmit(queue_, 1, &info, fd.fence);
-                check_vk_result(err);
+
+                submit_batcher_->wait(queue_, image_acquired_semaphore, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+                submit_batcher_->add(queue_, fd.command_buffer);
+                submit_batcher_->signal(queue_, render_complete_semaphore, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+                submit_batcher_->flush(fd.fence);
             }
+            frame_capture_->poll();
 
             //present
             VkPresentInfoKHR info = {};
@@ -287,6 +260,42 @@ namespace adttil
             semaphore_index_ = (semaphore_index_ + 1) % image_count_; // Now we can use the next set of semaphores
         }
 
+        VulkanContext context() const noexcept
+        {
+            return { instance_, physical_device_, device_, queue_family_, queue_, allocator_, features_ };
+        }
+
+        // Command buffers and semaphores added here are submitted with the frame's own work.
+        SubmitBatcher& submit_batcher() noexcept
+        {
+            return *submit_batcher_;
+        }
+
+        FrameCapture& frame_capture() noexcept
+        {
+            return *frame_capture_;
+        }
+
+        ParticleSystem& particle_system() noexcept
+        {
+            return *particle_system_;
+        }
+
+        LightingSystem& lighting_system() noexcept
+        {
+            return *lighting_system_;
+        }
+
+        SpriteBatch& sprite_batch() noexcept
+        {
+            return *sprite_batch_;
+        }
+
+        WorldText& world_text() noexcept
+        {
+            return *world_text_;
+        }
+
     private:
         struct Frame
         {
@@ -305,6 +314,20 @@ namespace adttil
         {
             VkInstanceCreateInfo create_info = {};
             create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+
+            // Ask for the newest API the loader offers, up to 1.3, so the device can expose core
+            // synchronization2 and timeline semaphores
+            VkApplicationInfo app_info = {};
+            app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+            app_info.pApplicationName = "furong326game1";
+            app_info.apiVersion = VK_API_VERSION_1_0;
+            if (auto enumerate_version = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"))
+            {
+                enumerate_version(&app_info.apiVersion);
+                app_info.apiVersion = std::min(app_info.apiVersion, (uint32_t)VK_API_VERSION_1_3);
+            }
+            instance_api_version_ = app_info.apiVersion;
+            create_info.pApplicationInfo = &app_info;
         
             // Enumerate available extensions
             uint32_t properties_count;
@@ -381,6 +404,49 @@ namespace adttil
             if (IsExtensionAvailable(properties, VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME))
                 device_extensions.push_back(VK_KHR_PORTABILITY_SUBSET_EXTENSION_NAME);
         #endif
+            const auto available_extensions = properties
+                | std::views::transform([](const VkExtensionProperties& p){ return std::string_view{ p.extensionName }; });
+
+            // Timeline semaphores are core in 1.2 and synchronization2 in 1.3; older devices may
+            // still offer them as KHR extensions. Both are optional, SubmitBatcher falls back.
+            VkPhysicalDeviceProperties device_properties;
+            vkGetPhysicalDeviceProperties(physical_device_, &device_properties);
+            features_.api_version = std::min(instance_api_version_, device_properties.apiVersion);
+
+            VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features = {};
+            timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+            VkPhysicalDeviceSynchronization2Features sync2_features = {};
+            sync2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+            VkPhysicalDeviceFeatures2 features = {};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            // Only structs whose core version or extension the device has may be chained, both
+            // for the query and for vkCreateDevice.
+            const auto chain = [&](bool timeline, bool sync2){
+                timeline_features.pNext = nullptr;
+                sync2_features.pNext = timeline ? &timeline_features : nullptr;
+                features.pNext = sync2 ? (void*)&sync2_features : timeline ? (void*)&timeline_features : nullptr;
+            };
+
+            const bool has_timeline = features_.api_version >= VK_API_VERSION_1_2
+                || std::ranges::contains(available_extensions, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            const bool has_sync2 = features_.api_version >= VK_API_VERSION_1_3
+                || std::ranges::contains(available_extensions, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+            if (instance_api_version_ >= VK_API_VERSION_1_1 && (has_timeline || has_sync2))
+            {
+                chain(has_timeline, has_sync2);
+                vkGetPhysicalDeviceFeatures2(physical_device_, &features);
+            }
+            features_.timeline_semaphore = has_timeline && timeline_features.timelineSemaphore;
+            features_.synchronization2 = has_sync2 && sync2_features.synchronization2;
+            if (features_.timeline_semaphore && features_.api_version < VK_API_VERSION_1_2)
+                device_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            if (features_.synchronization2 && features_.api_version < VK_API_VERSION_1_3)
+                device_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+            // Only the two feature bits are wanted, not every core feature the query reported
+            features.features = {};
+            timeline_features.timelineSemaphore = features_.timeline_semaphore;
+            sync2_features.synchronization2 = features_.synchronization2;
+            chain(features_.timeline_semaphore, features_.synchronization2);
     
             const float queue_priority[] = { 1.0f };
             VkDeviceQueueCreateInfo queue_info[1] = {};
@@ -394,6 +460,8 @@ namespace adttil
             create_info.pQueueCreateInfos = queue_info;
             create_info.enabledExtensionCount = (uint32_t)device_extensions.size();
             create_info.ppEnabledExtensionNames = device_extensions.data();
+            if (features_.timeline_semaphore || features_.synchronization2)
+                create_info.pNext = &features;
             VkResult err = vkCreateDevice(physical_device_, &create_info, allocator_, &device_);
             if(err) return err;
             vkGetDeviceQueue(device_, queue_family_, 0, &queue_);
@@ -402,19 +470,26 @@ namespace adttil
 
         VkResult create_descriptor_pool()
         {
+            // The font plus one ImGui texture per atlas page.
             VkDescriptorPoolSize pool_sizes[] =
             {
-                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1024 },
             };
             VkDescriptorPoolCreateInfo pool_info = {};
             pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
             pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-            pool_info.maxSets = 1;
+            pool_info.maxSets = 1024;
             pool_info.poolSizeCount = (std::uint32_t)std::ranges::size(pool_sizes);
             pool_info.pPoolSizes = pool_sizes;
             return vkCreateDescriptorPool(device_, &pool_info, allocator_, &descriptor_pool_);
         }
 
+        VkResult create_submit_batcher()
+        {
+            submit_batcher_.emplace(context());
+            return VK_SUCCESS;
+        }
+
         VkResult create_surface()
         {
             VkResult err = glfwCreateWindowSurface(instance_, window_, allocator_, &surface_);
@@ -465,6 +540,11 @@ namespace adttil
             else if (cap.maxImageCount != 0 && info.minImageCount > cap.maxImageCount)
                 info.minImageCount = cap.maxImageCount;
 
+            // Needed to copy the backbuffer out for FrameCapture
+            if (cap.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+                info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            swapchain_usage_ = info.imageUsage;
+
             if (cap.currentExtent.width == 0xffffffff)
             {
                 info.imageExtent.width = width_ = w;
@@ -610,6 +690,69 @@ namespace adttil
             return result;
         }
 
+        VkResult create_frame_capture()
+        {
+            const bool supported = swapchain_usage_ & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            frame_capture_.emplace(context(), *submit_batcher_, width_, height_, surface_format_.format, supported);
+            return VK_SUCCESS;
+        }
+
+        void destroy_frame_capture() noexcept
+        {
+            frame_capture_.reset();
+        }
+
+        VkResult create_particle_system()
+        {
+            particle_system_.emplace(context(), render_pass_, image_count_);
+            return VK_SUCCESS;
+        }
+
+        void destroy_particle_system() noexcept
+        {
+            particle_system_.reset();
+        }
+
+        VkResult create_lighting_system()
+        {
+            lighting_system_.emplace(context(), render_pass_, image_count_, VkExtent2D{ width_, height_ });
+            return VK_SUCCESS;
+        }
+
+        void destroy_lighting_system() noexcept
+        {
+            lighting_system_.reset();
+        }
+
+        VkResult create_sprite_batch()
+        {
+            sprite_batch_.emplace(context(), render_pass_, image_count_, lighting_system_->gbuffer_render_pass());
+            lighting_system_->set_gbuffer_pass(
+                [this](VkCommandBuffer command_buffer){ sprite_batch_->record_gbuffer(command_buffer, frame_index_, width_, height_); },
+                [this]{ return sprite_batch_->has_lit(); });
+            return VK_SUCCESS;
+        }
+
+        void destroy_sprite_batch() noexcept
+        {
+            if (lighting_system_)
+            {
+                lighting_system_->set_gbuffer_pass({}, {});
+            }
+            sprite_batch_.reset();
+        }
+
+        VkResult create_world_text()
+        {
+            world_text_.emplace(context(), render_pass_, image_count_);
+            return VK_SUCCESS;
+        }
+
+        void destroy_world_text() noexcept
+        {
+            world_text_.reset();
+        }
+
         void destroy_frames() noexcept
         {
             for(const auto[img_view, frame_buff, cmd_pool, cmd_buff, fence, img_acq, rnd_cpl] : frames_)
@@ -644,6 +787,11 @@ namespace adttil
             vkDestroyDescriptorPool(device_, descriptor_pool_, allocator_);
         }
 
+        void destroy_submit_batcher() noexcept
+        {
+            submit_batcher_.reset();
+        }
+
         void destroy_device() noexcept
         {
             vkDestroyDevice(device_, allocator_);
@@ -654,12 +802,6 @@ namespace adttil
             vkDestroyInstance(instance_, allocator_);
         }
 
-        static void set_and_check(VkResult& result, VkResult new_value)
-        {
-            result = new_value;
-            check_vk_result(result);
-        }
-        
         static VkPhysicalDevice select_physical_device(VkInstance instance)
         {
             uint32_t gpu_count;
@@ -780,12 +922,16 @@ namespace adttil
         GLFWwindow* window_;
 
         const VkAllocationCallbacks* allocator_ = nullptr;
+        uint32_t instance_api_version_ = VK_API_VERSION_1_0;
         VkInstance instance_;
 
         VkPhysicalDevice physical_device_;
         uint32_t queue_family_;
         VkDevice device_;
         VkQueue queue_;
+        DeviceFeatures features_;
+
+        std::optional<SubmitBatcher> submit_batcher_;
 
         VkDescriptorPool descriptor_pool_;
 
@@ -796,133 +942,19 @@ namespace adttil
         uint32_t width_;
         uint32_t height_;
         VkSwapchainKHR swapchain_;
+        VkImageUsageFlags swapchain_usage_;
         uint32_t image_count_;
         VkImage backbuffers_[16] = {};
 
         VkRenderPass render_pass_;
 
         std::vector<Frame> frames_;
+        std::optional<FrameCapture> frame_capture_;
+        std::optional<ParticleSystem> particle_system_;
+        std::optional<LightingSystem> lighting_system_;
+        std::optional<SpriteBatch> sprite_batch_;
+        std::optional<WorldText> world_text_;
         uint32_t frame_index_ = 0;
         uint32_t semaphore_index_ = 0;
     };
-
-    class BitmapView
-    {
-    public:
-        constexpr BitmapView(Color32* data, Coord2 size, size_t row_align) noexcept
-        : data_{ data }
-        , size_{ size }
-        , row_align_{ row_align }
-        {}
-
-        constexpr BitmapView(Color32* data, Coord2 size) noexcept
-        : BitmapView{ data, size, size.x() }
-        {}
-
-        constexpr Color32* data()const noexcept
-        {
-            return data_;
-        }
-
-        constexpr Coord2 size()const noexcept
-        {
-            return size_;
-        }
-
-        constexpr size_t width()const noexcept
-        {
-            return size_.x();
-        }
-
-        constexpr size_t height()const noexcept
-        {
-            return size_.y();
-        }
-
-        constexpr size_t count()const noexcept
-        {
-            return width() * height();
-        }
-
-        constexpr size_t row_align()const noexcept
-        {
-            return row_align_;
-        }
-
-        constexpr Color32& operator[](size_t i)const noexcept
-        {
-            return data_[i % row_align_ + i / row_align_ * row_align_];
-        }
-
-        constexpr Color32& operator[](Coord2 coord)const noexcept
-        {
-            return data_[coord.x() + coord.y() * row_align_];
-        }
-
-        friend void copy(BitmapView dst, BitmapView src)
-        {
-            for(size_t i : std::views::iota(0uz, dst.height()))
-            {
-                memcpy(dst.row(i), src.row(i), dst.width() * sizeof(Color32));
-            }
-        }
-
-    private:
-        constexpr Color32* row(size_t i) const noexcept
-        {
-            return &data_[row_align_ * i];
-        }
-
-        Color32* data_;
-        Coord2 size_;
-        size_t row_align_;
-    };
-
-    class AnimManager
-    {
-    public:
-        AnimManager(const char* anim_folder_path)
-        {
-            namespace fs = std::filesystem;
-
-            auto files = fs::directory_iterator(anim_folder_path)
-                        | std::views::filter([](auto& file){ return file.path().extension() == ".png" ;})
-                        | std::views::transform([](auto& file){ return file.path().string(); })
-                        | std::ranges::to<std::vector>();
-
-            uint32_t width = 0;
-            uint32_t height = 0;
-            for (const auto& file : files) 
-            {
-                int w, h, c;
-                if(not stbi_info(file.c_str(), &w, &h, &c))
-                {
-                    continue;
-                }
-                width = std::max(width, (uint32_t)w);
-                height += h;
-            }
-
-            std::vector<Color32> textures_data(width * height);
-            uint32_t offset = 0;
-            for (const auto& file : files) 
-            {
-                int w, h, c;
-                auto pixels = (Color32*)stbi_load(file.c_str(), &w, &h, &c, 4);
-                if(not pixels)
-                {
-                    continue;
-                }
-                Coord2 size{ (size_t)w, (size_t)h };
-                copy(BitmapView{ textures_data.data() + offset, size, width }, BitmapView{ pixels, size });
-                offset += size.y() * width;
-            }
-
-
-        }
-
-    private:
-        std::unordered_map<std::string, uint32_t> textures;
-
-    };
 }
\ No newline at end of file
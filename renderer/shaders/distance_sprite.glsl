@@ -0,0 +1,31 @@
+// Effects from the distance fields of AnimManager frames, see AnimManager::distance_atlas() and
+// FrameTable::field_rects. The field rect covers exactly the trimmed frame grown by
+// AnimManager::distance_field_margin() pixels on every side, so the quad is drawn that much
+// larger and `local` runs over it from 0 to 1. Texels hold 0.5 on the edge, more inside, and
+// reach 0 or 1 `spread` pixels away.
+
+// Signed distance in pixels at `local`, negative inside.
+float sprite_distance(sampler2DArray fields, vec4 field_rect, uint layer, vec2 local, float spread)
+{
+    vec2 uv = mix(field_rect.xy, field_rect.zw, local);
+    return (0.5 - texture(fields, vec3(uv, layer)).r) * 2.0 * spread;
+}
+
+// Coverage of an outline `width` pixels wide around the silhouette, antialiased over a pixel.
+float sprite_outline(float distance, float width)
+{
+    return clamp(width + 0.5 - distance, 0.0, 1.0) * clamp(distance + 0.5, 0.0, 1.0);
+}
+
+// Glow fading from the edge to `radius` pixels out.
+float sprite_glow(float distance, float radius)
+{
+    float t = clamp(distance / radius, 0.0, 1.0);
+    return distance > 0.0 ? (1.0 - t) * (1.0 - t) : 0.0;
+}
+
+// Soft shadow from the field sampled at the shadow's offset, `softness` pixels wide.
+float sprite_shadow(float offset_distance, float softness)
+{
+    return 1.0 - smoothstep(-softness, softness, offset_distance);
+}
@@ -0,0 +1,17 @@
+// Palette lookup for palette8 frames of AnimManager, see AnimManager::Sprite::palette. Indices are
+// fetched unfiltered from the R8_UINT page array, then row `palette` of the palette image, bound
+// through its array view, turns them into colours.
+
+vec4 sample_palette(usampler2DArray indices, sampler2DArray palettes, vec2 uv, uint layer, uint palette, int level)
+{
+    ivec2 size = textureSize(indices, level).xy;
+    ivec2 texel = clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1);
+    uint index = texelFetch(indices, ivec3(texel, layer), level).r;
+    return texelFetch(palettes, ivec3(index, palette, 0), 0);
+}
+
+// Mip level matching the screen space footprint of `uv`; fragment shaders only.
+int palette_level(usampler2DArray indices, vec2 uv)
+{
+    return max(int(textureQueryLod(indices, uv).y + 0.5), 0);
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in vec4 in_color;
+layout(location = 1) in vec2 in_uv;
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+    float falloff = 1.0 - smoothstep(0.5, 1.0, length(in_uv));
+    out_color = vec4(in_color.rgb, in_color.a * falloff);
+}
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#include "particle_common.glsl"
+
+layout(location = 0) out vec4 out_color;
+layout(location = 1) out vec2 out_uv;
+
+// Expands each alive particle into a screen aligned quad; positions are in framebuffer pixels.
+void main()
+{
+    const vec2 corners[6] = vec2[](
+        vec2(-1, -1), vec2(1, -1), vec2(1, 1),
+        vec2(-1, -1), vec2(1, 1), vec2(-1, 1));
+
+    uint index = alive[alive_index(pc.current, gl_InstanceIndex)];
+    Particle p = particles[index];
+    float t = clamp(p.age / p.life, 0.0, 1.0);
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 position = p.position + corner * mix(p.size_begin, p.size_end, t) * 0.5;
+
+    gl_Position = vec4(position / pc.viewport * 2.0 - 1.0, 0.0, 1.0);
+    out_color = mix(unpackUnorm4x8(p.color_begin), unpackUnorm4x8(p.color_end), t);
+    out_uv = corner;
+}
@@ -0,0 +1,90 @@
+// Shared by every particle pass; layouts mirror the Gpu* structs in particle_system.hpp.
+
+struct Particle
+{
+    vec2  position;
+    vec2  velocity;
+    float age;
+    float life;
+    float size_begin;
+    float size_end;
+    uint  color_begin;
+    uint  color_end;
+    float gravity;
+    float drag;
+};
+
+struct Emitter
+{
+    vec2  direction;
+    float spread;
+    float speed_min;
+    float speed_max;
+    float life_min;
+    float life_max;
+    float size_begin;
+    float size_end;
+    uint  color_begin;
+    uint  color_end;
+    float gravity;
+    float drag;
+    uint  pad;
+};
+
+struct Burst
+{
+    uint emitter;
+    uint count;
+    uint offset;
+    uint seed;
+    vec2 position;
+    vec2 direction;
+};
+
+layout(set = 0, binding = 0, std430) buffer Particles { Particle particles[]; };
+layout(set = 0, binding = 1, std430) buffer AliveLists { uint alive[]; };
+layout(set = 0, binding = 2, std430) buffer DeadList { uint dead[]; };
+layout(set = 0, binding = 3, std430) buffer Counters
+{
+    int  alive_count[2];
+    int  dead_count;
+    uint counters_pad;
+    uint draw_vertex_count;
+    uint draw_instance_count;
+    uint draw_first_vertex;
+    uint draw_first_instance;
+    uint dispatch_x;
+    uint dispatch_y;
+    uint dispatch_z;
+};
+layout(set = 0, binding = 4, std430) readonly buffer Emitters { Emitter emitters[]; };
+layout(set = 0, binding = 5, std430) readonly buffer Bursts { Burst bursts[]; };
+
+layout(push_constant) uniform Constants
+{
+    float dt;
+    uint  current;
+    uint  burst_count;
+    uint  burst_base;
+    uint  emit_total;
+    uint  max_particles;
+    vec2  viewport;
+} pc;
+
+uint alive_index(uint list, uint i)
+{
+    return list * pc.max_particles + i;
+}
+
+uint pcg_hash(uint v)
+{
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float random01(inout uint seed)
+{
+    seed = pcg_hash(seed);
+    return float(seed) / 4294967295.0;
+}
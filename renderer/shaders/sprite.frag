@@ -0,0 +1,13 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "palette_sprite.glsl"
+#include "distance_sprite.glsl"
+#include "sprite_common.glsl"
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+    out_color = shade_sprite(instances[in_instance]);
+}
@@ -0,0 +1,61 @@
+#version 450
+
+// Layout mirrors GpuSpriteInstance in sprite_batch.hpp.
+struct SpriteInstance
+{
+    vec2 position;
+    vec2 size;
+    vec4 uv;
+    vec4 field_rect;
+    vec2 inset;
+    vec2 shadow_offset;
+    uint layer;
+    uint tint;
+    uint palette;
+    uint field_layer;
+    uint outline_color;
+    uint glow_color;
+    uint shadow_color;
+    float outline_width;
+    float glow_radius;
+    float shadow_softness;
+    float spread;
+    float emissive;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Instances { SpriteInstance instances[]; };
+
+layout(push_constant) uniform Constants
+{
+    vec2 viewport;
+    uint instance_base;
+    uint flags;
+} pc;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out vec2 out_local;
+layout(location = 2) out vec2 out_inner;
+layout(location = 3) out vec4 out_tint;
+layout(location = 4) flat out uint out_instance;
+
+// The quad covers the frame grown by `inset` of itself on each side when effects are drawn;
+// `out_inner` runs from 0 to 1 over the frame itself, `out_local` over the whole quad.
+void main()
+{
+    const vec2 corners[6] = vec2[](
+        vec2(0, 0), vec2(1, 0), vec2(1, 1),
+        vec2(0, 0), vec2(1, 1), vec2(0, 1));
+
+    uint instance = pc.instance_base + gl_InstanceIndex;
+    SpriteInstance sprite = instances[instance];
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 position = sprite.position + corner * sprite.size;
+    vec2 inner = (corner - sprite.inset) / (1.0 - 2.0 * sprite.inset);
+
+    gl_Position = vec4(position / pc.viewport * 2.0 - 1.0, 0.0, 1.0);
+    out_uv = mix(sprite.uv.xy, sprite.uv.zw, inner);
+    out_local = corner;
+    out_inner = inner;
+    out_tint = unpackUnorm4x8(sprite.tint);
+    out_instance = instance;
+}
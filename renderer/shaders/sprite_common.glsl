@@ -0,0 +1,116 @@
+// Shared by sprite.frag and sprite_gbuffer.frag. Include after palette_sprite.glsl and
+// distance_sprite.glsl.
+
+// Layout mirrors GpuSpriteInstance in sprite_batch.hpp.
+struct SpriteInstance
+{
+    vec2 position;
+    vec2 size;
+    vec4 uv;
+    vec4 field_rect;
+    vec2 inset;
+    vec2 shadow_offset;
+    uint layer;
+    uint tint;
+    uint palette;
+    uint field_layer;
+    uint outline_color;
+    uint glow_color;
+    uint shadow_color;
+    float outline_width;
+    float glow_radius;
+    float shadow_softness;
+    float spread;
+    float emissive;
+};
+
+// Flags of the batch, see SpriteBatch.
+const uint sprite_premultiplied = 1;
+const uint sprite_linear = 2;
+const uint sprite_palette = 4;
+const uint sprite_field = 8;
+const uint sprite_lit = 16;
+
+layout(set = 0, binding = 0, std430) readonly buffer Instances { SpriteInstance instances[]; };
+layout(set = 0, binding = 1) uniform sampler2DArray pages;
+layout(set = 0, binding = 2) uniform usampler2DArray index_pages;
+layout(set = 0, binding = 3) uniform sampler2DArray palettes;
+layout(set = 0, binding = 4) uniform sampler2DArray fields;
+
+layout(push_constant) uniform Constants
+{
+    vec2 viewport;
+    uint instance_base;
+    uint flags;
+} pc;
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 1) in vec2 in_local;
+layout(location = 2) in vec2 in_inner;
+layout(location = 3) in vec4 in_tint;
+layout(location = 4) flat in uint in_instance;
+
+vec3 linear_to_srgb(vec3 color)
+{
+    return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, greaterThan(color, vec3(0.0031308)));
+}
+
+// Premultiplied `top` over premultiplied `bottom`.
+vec4 over(vec4 top, vec4 bottom)
+{
+    return top + bottom * (1.0 - top.a);
+}
+
+// Straight alpha `color` with its alpha scaled by `coverage`, premultiplied.
+vec4 effect(vec4 color, float coverage)
+{
+    float alpha = color.a * coverage;
+    return vec4(color.rgb * alpha, alpha);
+}
+
+// The swapchain is UNORM, so colour leaves sRGB encoded; linear pages are sampled through sRGB
+// views and encoded again here. Premultiplied pages keep their alpha multiplied in, which the
+// pipeline's ONE, ONE_MINUS_SRC_ALPHA blend expects. Palette batches read indices instead.
+// Field batches draw the shadow, glow and outline of the frame behind it.
+vec4 shade_sprite(SpriteInstance sprite)
+{
+    bool premultiplied = (pc.flags & sprite_premultiplied) != 0;
+
+    // Sampled everywhere so derivatives stay defined, then cut to the frame's own rect.
+    vec4 color;
+    if ((pc.flags & sprite_palette) != 0)
+    {
+        color = sample_palette(index_pages, palettes, in_uv, sprite.layer, sprite.palette, palette_level(index_pages, in_uv));
+    }
+    else
+    {
+        color = texture(pages, vec3(in_uv, sprite.layer));
+    }
+    bool inside = all(greaterThanEqual(in_inner, vec2(0.0))) && all(lessThanEqual(in_inner, vec2(1.0)));
+    color *= inside ? 1.0 : 0.0;
+    if ((pc.flags & sprite_linear) != 0)
+    {
+        vec3 straight = premultiplied ? color.rgb / max(color.a, 1e-6) : color.rgb;
+        color.rgb = linear_to_srgb(clamp(straight, 0.0, 1.0)) * (premultiplied ? color.a : 1.0);
+    }
+    color *= premultiplied ? vec4(in_tint.rgb * in_tint.a, in_tint.a) : in_tint;
+
+    if ((pc.flags & sprite_field) != 0)
+    {
+        float distance = sprite_distance(fields, sprite.field_rect, sprite.field_layer, in_local, sprite.spread);
+        vec2 shadow_local = clamp(in_local - sprite.shadow_offset, vec2(0.0), vec2(1.0));
+        float shadow_distance = sprite_distance(fields, sprite.field_rect, sprite.field_layer, shadow_local, sprite.spread);
+
+        vec4 behind = effect(unpackUnorm4x8(sprite.shadow_color), sprite_shadow(shadow_distance, sprite.shadow_softness));
+        behind = over(effect(unpackUnorm4x8(sprite.glow_color), sprite_glow(distance, sprite.glow_radius)), behind);
+        behind = over(effect(unpackUnorm4x8(sprite.outline_color), sprite_outline(distance, sprite.outline_width)), behind);
+
+        vec4 front = premultiplied ? color : vec4(color.rgb * color.a, color.a);
+        color = over(front, behind);
+        if (!premultiplied)
+        {
+            color.rgb /= max(color.a, 1e-6);
+        }
+    }
+    return color;
+}
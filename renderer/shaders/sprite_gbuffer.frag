@@ -0,0 +1,24 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "palette_sprite.glsl"
+#include "distance_sprite.glsl"
+#include "sprite_common.glsl"
+
+// Attachments of LightingSystem::gbuffer_render_pass().
+layout(location = 0) out vec4 out_albedo;
+layout(location = 1) out vec4 out_normal_emissive;
+
+// Lit sprites are flat: the normal stays (0.5, 0.5) and only the emissive strength varies. Both
+// attachments blend with SRC_ALPHA, ONE_MINUS_SRC_ALPHA, so albedo leaves as straight alpha.
+void main()
+{
+    SpriteInstance sprite = instances[in_instance];
+    vec4 color = shade_sprite(sprite);
+    if ((pc.flags & sprite_premultiplied) != 0)
+    {
+        color.rgb /= max(color.a, 1e-6);
+    }
+    out_albedo = color;
+    out_normal_emissive = vec4(0.5, 0.5, sprite.emissive, color.a);
+}
@@ -0,0 +1,23 @@
+#version 450
+
+layout(set = 0, binding = 1) uniform sampler2D sdf_atlas;
+
+layout(location = 0) in vec2 in_uv;
+layout(location = 1) in vec4 in_color;
+layout(location = 2) in vec4 in_outline_color;
+layout(location = 3) in float in_outline;
+layout(location = 0) out vec4 out_color;
+
+// The atlas stores distance with the glyph edge at 0.5; the screen space derivative keeps the
+// edge one pixel wide at any scale.
+void main()
+{
+    float distance = texture(sdf_atlas, in_uv).r;
+    float width = max(fwidth(distance) * 0.75, 1e-4);
+    float fill = smoothstep(0.5 - width, 0.5 + width, distance);
+    float outline_edge = 0.5 - in_outline;
+    float outline = smoothstep(outline_edge - width, outline_edge + width, distance);
+
+    vec4 color = mix(in_outline_color, in_color, fill);
+    out_color = vec4(color.rgb, color.a * max(fill, in_outline > 0.0 ? outline : 0.0));
+}
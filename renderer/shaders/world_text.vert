@@ -0,0 +1,50 @@
+#version 450
+
+// Layout mirrors GpuGlyphInstance in world_text.hpp.
+struct GlyphInstance
+{
+    vec2 offset;
+    vec2 size;
+    vec4 uv;
+    uint color;
+    uint outline_color;
+    float outline;
+    float pad;
+    vec2 anchor;
+    vec2 pad2;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer Instances { GlyphInstance instances[]; };
+
+layout(push_constant) uniform Constants
+{
+    vec2 viewport;
+    uint instance_base;
+    uint pad;
+    // World to framebuffer pixels, one row of a 2x3 matrix each.
+    vec4 view_x;
+    vec4 view_y;
+} pc;
+
+layout(location = 0) out vec2 out_uv;
+layout(location = 1) out vec4 out_color;
+layout(location = 2) out vec4 out_outline_color;
+layout(location = 3) out float out_outline;
+
+void main()
+{
+    const vec2 corners[6] = vec2[](
+        vec2(0, 0), vec2(1, 0), vec2(1, 1),
+        vec2(0, 0), vec2(1, 1), vec2(0, 1));
+
+    GlyphInstance glyph = instances[pc.instance_base + gl_InstanceIndex];
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 anchor = vec2(dot(pc.view_x.xyz, vec3(glyph.anchor, 1.0)), dot(pc.view_y.xyz, vec3(glyph.anchor, 1.0)));
+    vec2 position = anchor + glyph.offset + corner * glyph.size;
+
+    gl_Position = vec4(position / pc.viewport * 2.0 - 1.0, 0.0, 1.0);
+    out_uv = mix(glyph.uv.xy, glyph.uv.zw, corner);
+    out_color = unpackUnorm4x8(glyph.color);
+    out_outline_color = unpackUnorm4x8(glyph.outline_color);
+    out_outline = glyph.outline;
+}
@@ -0,0 +1,483 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include <renderer/common.hpp>
+#include <renderer/gpu_resource.hpp>
+#include <renderer/anim_manager.hpp>
+
+namespace adttil
+{
+    namespace shaders
+    {
+        inline constexpr uint32_t sprite_vert[] = {
+#include <shaders/sprite.vert.spv.inc>
+        };
+        inline constexpr uint32_t sprite_frag[] = {
+#include <shaders/sprite.frag.spv.inc>
+        };
+        inline constexpr uint32_t sprite_gbuffer_frag[] = {
+#include <shaders/sprite_gbuffer.frag.spv.inc>
+        };
+    }
+
+    struct SpriteStyle
+    {
+        // Multiplies the sampled colour, as straight alpha.
+        Color32 tint = { 255, 255, 255, 255 };
+        // Framebuffer pixels per sprite pixel, around the pivot; a negative x mirrors the sprite.
+        Vec2    scale = Vec2{ 1.0f, 1.0f };
+        // Effects drawn behind the frame from its distance field, for atlases baked with
+        // AtlasOptions::distance_field_scale. Colours are straight alpha; a transparent one
+        // turns its effect off. Sizes are sprite pixels, and reach at most the field spread.
+        Color32 outline_color = { 0, 0, 0, 0 };
+        float   outline_width = 1.0f;
+        Color32 glow_color = { 0, 0, 0, 0 };
+        float   glow_radius = 6.0f;
+        Color32 shadow_color = { 0, 0, 0, 0 };
+        Vec2    shadow_offset = Vec2{ 2.0f, 3.0f };
+        float   shadow_softness = 2.0f;
+        // Drawn into the G-buffer of the LightingSystem instead of the main render pass, so point
+        // lights shade it. `emissive` adds light of the sprite's own colour, 1 being fully lit.
+        bool    lit = false;
+        float   emissive = 0.0f;
+
+        bool has_effects() const noexcept
+        {
+            return outline_color.a() > 0 || glow_color.a() > 0 || shadow_color.a() > 0;
+        }
+    };
+
+    // Frames of AnimManager atlases drawn in the scene. Sprites queued with draw() are instances
+    // of one storage buffer, and consecutive sprites on the same image with the same encoding
+    // share a draw, so keep sprites of one atlas together. Premultiplied atlases are blended with
+    // ONE, ONE_MINUS_SRC_ALPHA, straight ones with SRC_ALPHA, ONE_MINUS_SRC_ALPHA. Frames uploaded
+    // as palette indices are resolved through AnimManager::palette_atlas() in the shader. With
+    // effects the quad grows by AnimManager::distance_field_margin() so they fit around the frame.
+    // Lit sprites go to the G-buffer through record_gbuffer(), given `gbuffer_render_pass`.
+    class SpriteBatch : NoMoveable
+    {
+    public:
+        SpriteBatch(const VulkanContext& context, VkRenderPass render_pass, uint32_t frame_count,
+            VkRenderPass gbuffer_render_pass = VK_NULL_HANDLE, uint32_t max_sprites = 16384, uint32_t max_batches = 1024)
+        : context_{ context }
+        , frame_count_{ frame_count }
+        , max_sprites_{ max_sprites }
+        , max_batches_{ max_batches }
+        {
+            VkResult result;
+
+            set_and_check(result, create_resources());
+            OptianalGuard _{ result, [&]{ destroy_resources(); } };
+
+            set_and_check(result, create_pipelines(render_pass, gbuffer_render_pass));
+        }
+
+        ~SpriteBatch() noexcept
+        {
+            destroy_pipelines();
+            destroy_resources();
+        }
+
+        // Queues frame table entry `frame` of `anim` with its pivot at `position`, in framebuffer
+        // pixels. Frames that are empty or not uploaded yet are skipped. `anim` must keep its GPU
+        // atlas until the frame is recorded.
+        void draw(const AnimManager& anim, uint32_t frame, Vec2 position, const SpriteStyle& style = {})
+        {
+            const std::optional<AnimManager::Sprite> sprite = anim.sprite(frame);
+            if (not sprite || sprite->size.x == 0.0f || sprite->size.y == 0.0f || instances_.size() >= max_sprites_)
+            {
+                return;
+            }
+            const uint32_t layer = anim.frame_table().layers[frame];
+            const AtlasTexture* atlas = anim.gpu_atlas(layer);
+            const PixelEncoding encoding = anim.encoding();
+            uint32_t flags = (encoding.premultiplied ? sprite_premultiplied : 0) | (encoding.linear ? sprite_linear : 0);
+            if (style.lit && gbuffer_pipeline_)
+            {
+                flags |= sprite_lit;
+            }
+
+            // Every binding needs a valid image; the ones the batch does not read get any that fits.
+            Batch batch = {};
+            const AtlasTexture* fields = anim.distance_atlas();
+            const bool effects = style.has_effects() && fields && frame < anim.frame_table().field_rects.size()
+                && anim.distance_fields()[frame].size().x() > 0;
+            if (effects)
+            {
+                flags |= sprite_field;
+            }
+            if (atlas->format() == VK_FORMAT_R8_UINT)
+            {
+                const AtlasTexture* palettes = anim.palette_atlas();
+                if (not palettes || sprite->palette == AnimManager::no_palette)
+                {
+                    return;
+                }
+                flags |= sprite_palette;
+                batch.images[0] = { palettes->sampler(), palettes->array_view(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+                batch.images[1] = { atlas->sampler(), atlas->array_view(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+                batch.images[2] = batch.images[0];
+                batch.images[3] = batch.images[0];
+            }
+            else
+            {
+                batch.images[0] = { atlas->sampler(), atlas->array_view(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+                batch.images[1] = { index_sampler_, dummy_indices_.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+                batch.images[2] = batch.images[0];
+                batch.images[3] = batch.images[0];
+            }
+            if (effects)
+            {
+                batch.images[3] = { fields->sampler(), fields->array_view(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            }
+            batch.flags = flags;
+            batch.first = (uint32_t)instances_.size();
+            if (batches_.empty() || not batches_.back().same_images(batch))
+            {
+                if (batches_.size() >= max_batches_)
+                {
+                    return;
+                }
+                batches_.push_back(batch);
+            }
+
+            // Sprite pixels, grown by the field margin when effects are drawn.
+            const float margin = effects ? anim.distance_field_margin() : 0.0f;
+            const float width = sprite->size.x + 2.0f * margin, height = sprite->size.y + 2.0f * margin;
+            GpuSpriteInstance instance = {};
+            instance.position[0] = position.x() - (sprite->pivot.x + margin) * style.scale.x();
+            instance.position[1] = position.y() - (sprite->pivot.y + margin) * style.scale.y();
+            instance.size[0] = width * style.scale.x();
+            instance.size[1] = height * style.scale.y();
+            instance.inset[0] = margin / width;
+            instance.inset[1] = margin / height;
+            instance.uv[0] = sprite->uv0.x;
+            instance.uv[1] = sprite->uv0.y;
+            instance.uv[2] = sprite->uv1.x;
+            instance.uv[3] = sprite->uv1.y;
+            instance.layer = layer - anim.first_layer(layer);
+            instance.tint = pack_unorm4x8(style.tint);
+            instance.palette = flags & sprite_palette ? sprite->palette : 0;
+            if (effects)
+            {
+                const Vec4& rect = anim.frame_table().field_rects[frame];
+                instance.field_rect[0] = rect.x();
+                instance.field_rect[1] = rect.y();
+                instance.field_rect[2] = rect.z();
+                instance.field_rect[3] = rect.w();
+                instance.field_layer = anim.frame_table().field_layers[frame];
+                instance.spread = anim.distance_fields()[frame].spread();
+                // The quad mirrors with the scale, the shadow must not.
+                instance.shadow_offset[0] = style.shadow_offset.x() / width * (style.scale.x() < 0.0f ? -1.0f : 1.0f);
+                instance.shadow_offset[1] = style.shadow_offset.y() / height * (style.scale.y() < 0.0f ? -1.0f : 1.0f);
+                instance.outline_color = pack_unorm4x8(style.outline_color);
+                instance.glow_color = pack_unorm4x8(style.glow_color);
+                instance.shadow_color = pack_unorm4x8(style.shadow_color);
+                instance.outline_width = style.outline_width;
+                // The shader divides by both.
+                instance.glow_radius = std::max(style.glow_radius, 1e-3f);
+                instance.shadow_softness = std::max(style.shadow_softness, 1e-3f);
+            }
+            instance.emissive = style.emissive;
+            instances_.push_back(instance);
+            batches_.back().count++;
+        }
+
+        // True when record_gbuffer() has sprites to draw this frame.
+        bool has_lit() const noexcept
+        {
+            return std::ranges::any_of(batches_, [](const Batch& batch){ return batch.flags & sprite_lit; });
+        }
+
+        // Copies the queued instances and clears the placeholder index image on first use. The
+        // first call of a frame, before record_gbuffer() and record_draw(); recorded outside of a
+        // render pass.
+        void record_upload(VkCommandBuffer command_buffer, uint32_t frame)
+        {
+            // The frame's previous submission is complete, so are the sets it used.
+            const uint32_t slot = frame % frame_count_;
+            check_vk_result(vkResetDescriptorPool(context_.device, descriptor_pools_[slot], 0));
+            if (not instances_.empty())
+            {
+                std::memcpy((GpuSpriteInstance*)instance_buffer_.mapped + slot * max_sprites_, instances_.data(),
+                    instances_.size() * sizeof(GpuSpriteInstance));
+                flush_buffer(context_, instance_buffer_);
+            }
+
+            if (dummy_ready_)
+            {
+                return;
+            }
+            image_barrier(command_buffer, dummy_indices_.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            const VkClearColorValue zero = {};
+            const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            vkCmdClearColorImage(command_buffer, dummy_indices_.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &zero, 1, &range);
+            image_barrier(command_buffer, dummy_indices_.image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+            dummy_ready_ = true;
+        }
+
+        // Draws the lit sprites queued since the last frame, inside LightingSystem's G-buffer pass.
+        void record_gbuffer(VkCommandBuffer command_buffer, uint32_t frame, uint32_t width, uint32_t height)
+        {
+            record_batches(command_buffer, frame, width, height, true);
+        }
+
+        // Draws the other sprites queued with draw() since the last frame, one draw per batch.
+        void record_draw(VkCommandBuffer command_buffer, uint32_t frame, uint32_t width, uint32_t height)
+        {
+            record_batches(command_buffer, frame, width, height, false);
+            instances_.clear();
+            batches_.clear();
+        }
+
+    private:
+        // Mirrors the constants of shaders/sprite_common.glsl.
+        static constexpr uint32_t sprite_premultiplied = 1;
+        static constexpr uint32_t sprite_linear = 2;
+        static constexpr uint32_t sprite_palette = 4;
+        static constexpr uint32_t sprite_field = 8;
+        static constexpr uint32_t sprite_lit = 16;
+
+        void record_batches(VkCommandBuffer command_buffer, uint32_t frame, uint32_t width, uint32_t height, bool lit)
+        {
+            if (instances_.empty() || not dummy_ready_)
+            {
+                return;
+            }
+
+            const uint32_t slot = frame % frame_count_;
+            const uint32_t base = slot * max_sprites_;
+            set_viewport_and_scissor(command_buffer, width, height);
+            VkPipeline bound = VK_NULL_HANDLE;
+            for (const Batch& batch : batches_)
+            {
+                if (((batch.flags & sprite_lit) != 0) != lit)
+                {
+                    continue;
+                }
+                const VkDescriptorSet descriptor_set = allocate_set(descriptor_pools_[slot], batch);
+                const VkPipeline pipeline = lit ? gbuffer_pipeline_
+                    : batch.flags & sprite_premultiplied ? premultiplied_pipeline_ : straight_pipeline_;
+                if (pipeline != bound)
+                {
+                    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                    bound = pipeline;
+                }
+                Constants constants = {};
+                constants.viewport[0] = (float)width;
+                constants.viewport[1] = (float)height;
+                constants.instance_base = base + batch.first;
+                constants.flags = batch.flags;
+                vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &descriptor_set, 0, nullptr);
+                vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                    0, sizeof(constants), &constants);
+                vkCmdDraw(command_buffer, 6, batch.count, 0, 0);
+            }
+        }
+
+        // Instances [first, first + count) drawn with the same images: colour pages, index pages,
+        // palettes and distance fields.
+        struct Batch
+        {
+            VkDescriptorImageInfo images[4];
+            uint32_t              flags;
+            uint32_t              first;
+            uint32_t              count;
+
+            bool same_images(const Batch& other) const noexcept
+            {
+                return flags == other.flags && std::ranges::equal(images, other.images, [](const auto& a, const auto& b)
+                {
+                    return a.imageView == b.imageView && a.sampler == b.sampler;
+                });
+            }
+        };
+
+        // Layout mirrors shaders/sprite.vert
+        struct GpuSpriteInstance
+        {
+            float    position[2];
+            float    size[2];
+            float    uv[4];
+            float    field_rect[4];
+            float    inset[2];
+            float    shadow_offset[2];
+            uint32_t layer;
+            uint32_t tint;
+            uint32_t palette;
+            uint32_t field_layer;
+            uint32_t outline_color;
+            uint32_t glow_color;
+            uint32_t shadow_color;
+            float    outline_width;
+            float    glow_radius;
+            float    shadow_softness;
+            float    spread;
+            float    emissive;
+        };
+        static_assert(sizeof(GpuSpriteInstance) == 112);
+
+        struct Constants
+        {
+            float    viewport[2];
+            uint32_t instance_base;
+            uint32_t flags;
+        };
+
+        VkDescriptorSet allocate_set(VkDescriptorPool pool, const Batch& batch)
+        {
+            VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+            VkDescriptorSetAllocateInfo alloc_info = {};
+            alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            alloc_info.descriptorPool = pool;
+            alloc_info.descriptorSetCount = 1;
+            alloc_info.pSetLayouts = &set_layout_;
+            check_vk_result(vkAllocateDescriptorSets(context_.device, &alloc_info, &descriptor_set));
+
+            VkDescriptorBufferInfo buffer_info = { instance_buffer_.buffer, 0, VK_WHOLE_SIZE };
+            VkWriteDescriptorSet writes[2] = {};
+            writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[0].dstSet = descriptor_set;
+            writes[0].dstBinding = 0;
+            writes[0].descriptorCount = 1;
+            writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[0].pBufferInfo = &buffer_info;
+            writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[1].dstSet = descriptor_set;
+            writes[1].dstBinding = 1;
+            writes[1].descriptorCount = (uint32_t)std::size(batch.images);
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[1].pImageInfo = batch.images;
+            vkUpdateDescriptorSets(context_.device, 2, writes, 0, nullptr);
+            return descriptor_set;
+        }
+
+        VkResult create_resources()
+        {
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_resources(); } };
+
+            set_and_check(result, create_buffer(context_, sizeof(GpuSpriteInstance) * max_sprites_ * frame_count_,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instance_buffer_));
+            // Bound as index pages by batches without palette frames.
+            set_and_check(result, create_image(context_, { 1, 1 }, VK_FORMAT_R8_UINT,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1, 1, VK_IMAGE_VIEW_TYPE_2D_ARRAY, dummy_indices_));
+            set_and_check(result, create_sampler(context_, VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST, index_sampler_));
+
+            VkDescriptorSetLayoutBinding bindings[5] = {};
+            bindings[0] = { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+            bindings[1] = { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+            bindings[2] = { 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+            bindings[3] = { 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+            bindings[4] = { 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+            VkDescriptorSetLayoutCreateInfo layout_info = {};
+            layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_info.bindingCount = (uint32_t)std::size(bindings);
+            layout_info.pBindings = bindings;
+            set_and_check(result, vkCreateDescriptorSetLayout(context_.device, &layout_info, context_.allocator, &set_layout_));
+
+            VkPushConstantRange range = { VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(Constants) };
+            VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+            pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipeline_layout_info.setLayoutCount = 1;
+            pipeline_layout_info.pSetLayouts = &set_layout_;
+            pipeline_layout_info.pushConstantRangeCount = 1;
+            pipeline_layout_info.pPushConstantRanges = &range;
+            set_and_check(result, vkCreatePipelineLayout(context_.device, &pipeline_layout_info, context_.allocator, &pipeline_layout_));
+
+            // One pool per frame in flight, reset when the frame is recorded again.
+            VkDescriptorPoolSize pool_sizes[] =
+            {
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_batches_ },
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_batches_ * 4 },
+            };
+            VkDescriptorPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pool_info.maxSets = max_batches_;
+            pool_info.poolSizeCount = (uint32_t)std::size(pool_sizes);
+            pool_info.pPoolSizes = pool_sizes;
+            descriptor_pools_.resize(frame_count_, VK_NULL_HANDLE);
+            for (VkDescriptorPool& pool : descriptor_pools_)
+            {
+                set_and_check(result, vkCreateDescriptorPool(context_.device, &pool_info, context_.allocator, &pool));
+            }
+            return result;
+        }
+
+        void destroy_resources() noexcept
+        {
+            for (VkDescriptorPool pool : descriptor_pools_)
+            {
+                vkDestroyDescriptorPool(context_.device, pool, context_.allocator);
+            }
+            descriptor_pools_.clear();
+            vkDestroyPipelineLayout(context_.device, pipeline_layout_, context_.allocator);
+            vkDestroyDescriptorSetLayout(context_.device, set_layout_, context_.allocator);
+            vkDestroySampler(context_.device, index_sampler_, context_.allocator);
+            destroy_image(context_, dummy_indices_);
+            destroy_buffer(context_, instance_buffer_);
+        }
+
+        VkResult create_pipelines(VkRenderPass render_pass, VkRenderPass gbuffer_render_pass)
+        {
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_pipelines(); } };
+
+            VkPipelineColorBlendAttachmentState blend = {};
+            blend.blendEnable = VK_TRUE;
+            blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blend.colorBlendOp = VK_BLEND_OP_ADD;
+            blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blend.alphaBlendOp = VK_BLEND_OP_ADD;
+            blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            set_and_check(result, create_graphics_pipeline(context_, shaders::sprite_vert, shaders::sprite_frag,
+                pipeline_layout_, render_pass, 0, blend, straight_pipeline_));
+            if (gbuffer_render_pass)
+            {
+                // Albedo and normal/emissive both blend by the sprite's straight alpha.
+                const VkPipelineColorBlendAttachmentState blends[2] = { blend, blend };
+                set_and_check(result, create_graphics_pipeline(context_, shaders::sprite_vert, shaders::sprite_gbuffer_frag,
+                    pipeline_layout_, gbuffer_render_pass, 0, blends, gbuffer_pipeline_));
+            }
+            blend.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            set_and_check(result, create_graphics_pipeline(context_, shaders::sprite_vert, shaders::sprite_frag,
+                pipeline_layout_, render_pass, 0, blend, premultiplied_pipeline_));
+            return result;
+        }
+
+        void destroy_pipelines() noexcept
+        {
+            vkDestroyPipeline(context_.device, gbuffer_pipeline_, context_.allocator);
+            vkDestroyPipeline(context_.device, premultiplied_pipeline_, context_.allocator);
+            vkDestroyPipeline(context_.device, straight_pipeline_, context_.allocator);
+        }
+
+        VulkanContext context_;
+        uint32_t frame_count_;
+        uint32_t max_sprites_;
+        uint32_t max_batches_;
+
+        GpuBuffer instance_buffer_;
+        GpuImage dummy_indices_;
+        VkSampler index_sampler_ = VK_NULL_HANDLE;
+        bool dummy_ready_ = false;
+        VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+        VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> descriptor_pools_;
+        VkPipeline straight_pipeline_ = VK_NULL_HANDLE;
+        VkPipeline premultiplied_pipeline_ = VK_NULL_HANDLE;
+        VkPipeline gbuffer_pipeline_ = VK_NULL_HANDLE;
+
+        std::vector<GpuSpriteInstance> instances_;
+        std::vector<Batch> batches_;
+    };
+}
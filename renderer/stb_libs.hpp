@@ -0,0 +1,16 @@
+#pragma once
+// Private copies of the stb libraries vendored with imgui. imgui_draw.cpp compiles its own static
+// instances, so the implementations here are static as well and never clash at link time.
+// Rect pack comes first so stb_truetype uses it instead of its built-in fallback packer.
+
+#ifndef STB_RECT_PACK_IMPLEMENTATION
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imgui/imstb_rectpack.h>
+#endif
+
+#ifndef STB_TRUETYPE_IMPLEMENTATION
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include <imgui/imstb_truetype.h>
+#endif
@@ -0,0 +1,362 @@
+#pragma once
+#include <vector>
+#include <ranges>
+#include <algorithm>
+
+#include <renderer/common.hpp>
+
+namespace adttil
+{
+    // Collects command buffers and semaphore operations over a frame and hands them to the
+    // driver as one vkQueueSubmit2 per queue. Every flush is numbered with a serial; with timeline
+    // semaphores the serial is signaled on the GPU, otherwise every queue of the flush signals a
+    // fence and the serial completes once all of them have.
+    class SubmitBatcher : NoMoveable
+    {
+    public:
+        SubmitBatcher(const VulkanContext& context)
+        : context_{ context }
+        {
+            const VkDevice device = context_.device;
+            const bool core13 = context_.features.api_version >= VK_API_VERSION_1_3;
+            const bool core12 = context_.features.api_version >= VK_API_VERSION_1_2;
+            if (context_.features.synchronization2)
+            {
+                queue_submit2_ = (PFN_vkQueueSubmit2)vkGetDeviceProcAddr(device, core13 ? "vkQueueSubmit2" : "vkQueueSubmit2KHR");
+            }
+            if (context_.features.timeline_semaphore)
+            {
+                get_semaphore_counter_value_ = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device,
+                    core12 ? "vkGetSemaphoreCounterValue" : "vkGetSemaphoreCounterValueKHR");
+                wait_semaphores_ = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, core12 ? "vkWaitSemaphores" : "vkWaitSemaphoresKHR");
+            }
+        }
+
+        ~SubmitBatcher() noexcept
+        {
+            for (const Batch& batch : batches_)
+            {
+                vkDestroySemaphore(context_.device, batch.timeline, context_.allocator);
+            }
+            for (const VkFence fence : owned_fences_)
+            {
+                vkDestroyFence(context_.device, fence, context_.allocator);
+            }
+        }
+
+        bool uses_submit2() const noexcept
+        {
+            return queue_submit2_ != nullptr;
+        }
+
+        bool uses_timeline() const noexcept
+        {
+            return get_semaphore_counter_value_ != nullptr && wait_semaphores_ != nullptr;
+        }
+
+        // Serial that the next flush will carry.
+        uint64_t pending_serial() const noexcept
+        {
+            return serial_ + 1;
+        }
+
+        void add(VkQueue queue, VkCommandBuffer command_buffer)
+        {
+            VkCommandBufferSubmitInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+            info.commandBuffer = command_buffer;
+            batch(queue).command_buffers.push_back(info);
+        }
+
+        void wait(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags2 stage, uint64_t value = 0)
+        {
+            batch(queue).waits.push_back(semaphore_info(semaphore, stage, value));
+        }
+
+        void signal(VkQueue queue, VkSemaphore semaphore, VkPipelineStageFlags2 stage, uint64_t value = 0)
+        {
+            batch(queue).signals.push_back(semaphore_info(semaphore, stage, value));
+        }
+
+        // Submits everything collected since the last flush. The fence, if any, is signaled by the
+        // last queue submitted; without timeline semaphores every queue of the flush also signals
+        // a fence of the batcher, so completion never depends on a fence its owner may reset.
+        // Returns the serial of this flush.
+        uint64_t flush(VkFence fence = VK_NULL_HANDLE)
+        {
+            const uint64_t serial = ++serial_;
+
+            auto active = batches_ | std::views::filter([](const Batch& b){ return not b.empty(); });
+            const auto last = std::ranges::distance(active);
+            if (last == 0)
+            {
+                // Nothing to wait for but the flushes before it: the serial completes with the
+                // newest of them, or right away.
+                if (pending_fences_.empty())
+                {
+                    completed_serial_ = serial;
+                }
+                else
+                {
+                    pending_fences_.back().serial = serial;
+                }
+                return serial;
+            }
+
+            std::vector<VkFence> fences;
+            for (auto index = 0; Batch& queue_batch : active)
+            {
+                VkFence batch_fence = ++index == last ? fence : VK_NULL_HANDLE;
+                if (uses_timeline())
+                {
+                    queue_batch.signals.push_back(semaphore_info(queue_batch.timeline, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, serial));
+                    queue_batch.last_serial = serial;
+                }
+                else if (batch_fence == VK_NULL_HANDLE)
+                {
+                    batch_fence = acquire_fence();
+                    fences.push_back(batch_fence);
+                }
+
+                check_vk_result(uses_submit2() ? submit2(queue_batch, batch_fence) : submit(queue_batch, batch_fence));
+                if (not uses_timeline() && batch_fence == fence)
+                {
+                    // An empty submit signals its fence once all earlier work on the queue is done.
+                    fences.push_back(acquire_fence());
+                    check_vk_result(vkQueueSubmit(queue_batch.queue, 0, nullptr, fences.back()));
+                }
+                queue_batch.clear();
+            }
+
+            if (not uses_timeline())
+            {
+                pending_fences_.push_back({ std::move(fences), serial });
+            }
+            return serial;
+        }
+
+        // Never reports a serial as complete before its GPU work, and that of every serial before
+        // it, has finished.
+        bool is_complete(uint64_t serial)
+        {
+            return completed_serial() >= serial;
+        }
+
+        uint64_t completed_serial()
+        {
+            if (uses_timeline())
+            {
+                uint64_t completed = serial_;
+                for (const Batch& batch : batches_)
+                {
+                    if (batch.last_serial == 0)
+                    {
+                        continue;
+                    }
+                    uint64_t value = 0;
+                    check_vk_result(get_semaphore_counter_value_(context_.device, batch.timeline, &value));
+                    if (value < batch.last_serial)
+                    {
+                        completed = std::min(completed, value);
+                    }
+                }
+                return completed_serial_ = completed;
+            }
+
+            // Flushes complete in order: a later one on another queue may finish first, but its
+            // serial would then claim the earlier flush as complete too.
+            auto done = std::ranges::find_if_not(pending_fences_, [&](const PendingFence& pending){
+                return std::ranges::all_of(pending.fences, [&](VkFence fence){ return vkGetFenceStatus(context_.device, fence) == VK_SUCCESS; });
+            });
+            for (const PendingFence& pending : std::ranges::subrange(pending_fences_.begin(), done))
+            {
+                completed_serial_ = pending.serial;
+                free_fences_.append_range(pending.fences);
+            }
+            pending_fences_.erase(pending_fences_.begin(), done);
+            return completed_serial_;
+        }
+
+        // Returns once is_complete(serial) holds; `serial` must have been flushed.
+        void wait_for(uint64_t serial)
+        {
+            if (is_complete(serial))
+            {
+                return;
+            }
+            if (uses_timeline())
+            {
+                for (const Batch& batch : batches_)
+                {
+                    const uint64_t value = std::min(serial, batch.last_serial);
+                    VkSemaphoreWaitInfo info = {};
+                    info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+                    info.semaphoreCount = 1;
+                    info.pSemaphores = &batch.timeline;
+                    info.pValues = &value;
+                    check_vk_result(wait_semaphores_(context_.device, &info, UINT64_MAX));
+                }
+                return;
+            }
+            for (const PendingFence& pending : pending_fences_)
+            {
+                check_vk_result(vkWaitForFences(context_.device, (uint32_t)pending.fences.size(), pending.fences.data(), VK_TRUE, UINT64_MAX));
+                if (pending.serial >= serial)
+                {
+                    break;
+                }
+            }
+            completed_serial();
+        }
+
+    private:
+        struct Batch
+        {
+            VkQueue                                queue;
+            VkSemaphore                            timeline;
+            uint64_t                               last_serial;
+            std::vector<VkCommandBufferSubmitInfo> command_buffers;
+            std::vector<VkSemaphoreSubmitInfo>     waits;
+            std::vector<VkSemaphoreSubmitInfo>     signals;
+
+            bool empty() const noexcept
+            {
+                return command_buffers.empty() && waits.empty() && signals.empty();
+            }
+
+            void clear() noexcept
+            {
+                command_buffers.clear();
+                waits.clear();
+                signals.clear();
+            }
+        };
+
+        // The batcher fences of one flush, one per queue it submitted to. `serial` moves on to the
+        // empty flushes made after it.
+        struct PendingFence
+        {
+            std::vector<VkFence> fences;
+            uint64_t             serial;
+        };
+
+        static VkSemaphoreSubmitInfo semaphore_info(VkSemaphore semaphore, VkPipelineStageFlags2 stage, uint64_t value)
+        {
+            VkSemaphoreSubmitInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+            info.semaphore = semaphore;
+            info.value = value;
+            info.stageMask = stage;
+            return info;
+        }
+
+        Batch& batch(VkQueue queue)
+        {
+            auto iter = std::ranges::find(batches_, queue, &Batch::queue);
+            if (iter != batches_.end())
+            {
+                return *iter;
+            }
+
+            Batch batch = {};
+            batch.queue = queue;
+            if (uses_timeline())
+            {
+                VkSemaphoreTypeCreateInfo type_info = {};
+                type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+                type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+                type_info.initialValue = 0;
+                VkSemaphoreCreateInfo info = {};
+                info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+                info.pNext = &type_info;
+                check_vk_result(vkCreateSemaphore(context_.device, &info, context_.allocator, &batch.timeline));
+            }
+            return batches_.emplace_back(std::move(batch));
+        }
+
+        VkFence acquire_fence()
+        {
+            if (not free_fences_.empty())
+            {
+                const VkFence fence = free_fences_.back();
+                free_fences_.pop_back();
+                check_vk_result(vkResetFences(context_.device, 1, &fence));
+                return fence;
+            }
+            VkFenceCreateInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            VkFence fence;
+            check_vk_result(vkCreateFence(context_.device, &info, context_.allocator, &fence));
+            owned_fences_.push_back(fence);
+            return fence;
+        }
+
+        VkResult submit2(const Batch& batch, VkFence fence) const
+        {
+            VkSubmitInfo2 info = {};
+            info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+            info.waitSemaphoreInfoCount = (uint32_t)batch.waits.size();
+            info.pWaitSemaphoreInfos = batch.waits.data();
+            info.commandBufferInfoCount = (uint32_t)batch.command_buffers.size();
+            info.pCommandBufferInfos = batch.command_buffers.data();
+            info.signalSemaphoreInfoCount = (uint32_t)batch.signals.size();
+            info.pSignalSemaphoreInfos = batch.signals.data();
+            return queue_submit2_(batch.queue, 1, &info, fence);
+        }
+
+        // Classic path: the same batch expressed through VkSubmitInfo. Legacy stage flags occupy
+        // the low 32 bits of VkPipelineStageFlags2, so narrowing them is lossless.
+        VkResult submit(const Batch& batch, VkFence fence) const
+        {
+            const auto semaphores = [](const auto& infos){
+                return infos | std::views::transform(&VkSemaphoreSubmitInfo::semaphore) | std::ranges::to<std::vector>();
+            };
+            const auto values = [](const auto& infos){
+                return infos | std::views::transform(&VkSemaphoreSubmitInfo::value) | std::ranges::to<std::vector>();
+            };
+            const auto wait_stages = batch.waits
+                | std::views::transform([](const auto& w){ return (VkPipelineStageFlags)w.stageMask; })
+                | std::ranges::to<std::vector>();
+            const auto command_buffers = batch.command_buffers
+                | std::views::transform(&VkCommandBufferSubmitInfo::commandBuffer)
+                | std::ranges::to<std::vector>();
+            const auto wait_semaphores = semaphores(batch.waits);
+            const auto signal_semaphores = semaphores(batch.signals);
+            const auto wait_values = values(batch.waits);
+            const auto signal_values = values(batch.signals);
+
+            VkTimelineSemaphoreSubmitInfo timeline_info = {};
+            timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timeline_info.waitSemaphoreValueCount = (uint32_t)wait_values.size();
+            timeline_info.pWaitSemaphoreValues = wait_values.data();
+            timeline_info.signalSemaphoreValueCount = (uint32_t)signal_values.size();
+            timeline_info.pSignalSemaphoreValues = signal_values.data();
+
+            VkSubmitInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            info.pNext = uses_timeline() ? &timeline_info : nullptr;
+            info.waitSemaphoreCount = (uint32_t)wait_semaphores.size();
+            info.pWaitSemaphores = wait_semaphores.data();
+            info.pWaitDstStageMask = wait_stages.data();
+            info.commandBufferCount = (uint32_t)command_buffers.size();
+            info.pCommandBuffers = command_buffers.data();
+            info.signalSemaphoreCount = (uint32_t)signal_semaphores.size();
+            info.pSignalSemaphores = signal_semaphores.data();
+            return vkQueueSubmit(batch.queue, 1, &info, fence);
+        }
+
+        VulkanContext context_;
+
+        PFN_vkQueueSubmit2              queue_submit2_ = nullptr;
+        PFN_vkGetSemaphoreCounterValue  get_semaphore_counter_value_ = nullptr;
+        PFN_vkWaitSemaphores            wait_semaphores_ = nullptr;
+
+        std::vector<Batch> batches_;
+        uint64_t serial_ = 0;
+        uint64_t completed_serial_ = 0;
+
+        std::vector<PendingFence> pending_fences_;
+        std::vector<VkFence> owned_fences_;
+        std::vector<VkFence> free_fences_;
+    };
+}
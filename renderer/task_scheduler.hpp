@@ -0,0 +1,620 @@
+#pragma once
+#include <coroutine>
+#include <optional>
+#include <variant>
+#include <exception>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stop_token>
+#include <queue>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <type_traits>
+
+#include <renderer/common.hpp>
+#include <renderer/worker_pool.hpp>
+
+namespace adttil
+{
+    // Where a task continues after `co_await scheduler.on(queue)`.
+    enum class TaskQueue
+    {
+        // Threads of the scheduler itself for blocking file reads, so they never hold up decoding.
+        io,
+        // WorkerPool threads, for CPU bound decoding and packing.
+        worker,
+        // The render thread, inside TaskScheduler::run_render(): Vulkan uploads and other state
+        // that is not thread safe.
+        render,
+    };
+
+    // Queued steps of higher priority run first, equal ones in the order they were queued.
+    enum class TaskPriority : uint32_t
+    {
+        // Streaming ahead of need, e.g. the next level.
+        background,
+        normal,
+        // Something on screen waits for it, e.g. a loading screen.
+        urgent,
+    };
+
+    // Thrown at the next suspension point of a cancelled task, unwinding it.
+    class TaskCancelled : public std::exception
+    {
+    public:
+        const char* what() const noexcept override
+        {
+            return "task cancelled";
+        }
+    };
+
+    class TaskScheduler;
+
+    // Shared by a spawned task and every task it awaits.
+    struct TaskContext
+    {
+        TaskScheduler*  scheduler = nullptr;
+        TaskPriority    priority = TaskPriority::normal;
+        std::stop_token stop;
+    };
+
+    namespace detail
+    {
+        struct TaskPromiseBase
+        {
+            // Resumes the awaiting task, if any, without growing the stack.
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                template<class P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> self) noexcept
+                {
+                    const std::coroutine_handle<> continuation = self.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept
+                {
+                }
+            };
+
+            std::suspend_always initial_suspend() const noexcept
+            {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() const noexcept
+            {
+                return {};
+            }
+
+            void unhandled_exception() noexcept
+            {
+                error = std::current_exception();
+            }
+
+            const TaskContext*      context = nullptr;
+            std::coroutine_handle<> continuation;
+            std::exception_ptr      error;
+        };
+
+        template<class T>
+        struct TaskPromise : TaskPromiseBase
+        {
+            template<class U>
+            void return_value(U&& value)
+            {
+                result.emplace(std::forward<U>(value));
+            }
+
+            T take()
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+                return std::move(*result);
+            }
+
+            std::optional<T> result;
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase
+        {
+            void return_void() const noexcept
+            {
+            }
+
+            void take() const
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+    }
+
+    // Lazily started coroutine producing a T. It runs when awaited by another task, or when
+    // handed to TaskScheduler::spawn(), and inherits the priority and cancellation of whatever
+    // spawned the outermost task.
+    template<class T = void>
+    class [[nodiscard]] Task
+    {
+    public:
+        struct promise_type : detail::TaskPromise<T>
+        {
+            Task get_return_object() noexcept
+            {
+                return Task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+            }
+        };
+
+        Task() = default;
+
+        Task(Task&& other) noexcept
+        : handle_{ std::exchange(other.handle_, {}) }
+        {
+        }
+
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                handle_ = std::exchange(other.handle_, {});
+            }
+            return *this;
+        }
+
+        ~Task() noexcept
+        {
+            reset();
+        }
+
+        // Starts the task; the awaiting one continues with its result or exception.
+        auto operator co_await() && noexcept
+        {
+            return Awaiter{ handle_ };
+        }
+
+    private:
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            template<class P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> parent) noexcept
+            {
+                handle.promise().context = parent.promise().context;
+                handle.promise().continuation = parent;
+                return handle;
+            }
+
+            T await_resume()
+            {
+                return handle.promise().take();
+            }
+        };
+
+        explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+        : handle_{ handle }
+        {
+        }
+
+        void reset() noexcept
+        {
+            if (handle_)
+            {
+                std::exchange(handle_, {}).destroy();
+            }
+        }
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    namespace detail
+    {
+        template<class T>
+        struct SpawnedState
+        {
+            using Value = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+            std::stop_source     stop;
+            TaskContext          context;
+            std::atomic<bool>    done = false;
+            std::optional<Value> result;
+            std::exception_ptr   error;
+        };
+
+        // Outermost coroutine of a spawned task: starts at once and frees itself when done.
+        struct SpawnedTask
+        {
+            struct promise_type
+            {
+                template<class... Args>
+                explicit promise_type(const TaskContext* context, Args&...) noexcept
+                : context{ context }
+                {
+                }
+
+                SpawnedTask get_return_object() const noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never initial_suspend() const noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() const noexcept
+                {
+                    return {};
+                }
+
+                void return_void() const noexcept
+                {
+                }
+
+                void unhandled_exception() const noexcept
+                {
+                    std::terminate();
+                }
+
+                const TaskContext* context;
+            };
+        };
+    }
+
+    // Result of TaskScheduler::spawn(), polled from the render thread, e.g. once per frame by a
+    // loading screen. Dropping it leaves the task running.
+    template<class T = void>
+    class TaskHandle
+    {
+    public:
+        TaskHandle() = default;
+
+        bool valid() const noexcept
+        {
+            return state_ != nullptr;
+        }
+
+        bool ready() const noexcept
+        {
+            return state_ && state_->done.load(std::memory_order_acquire);
+        }
+
+        // The task stops at its next suspension point by throwing TaskCancelled; steps already
+        // running finish first.
+        void cancel() noexcept
+        {
+            if (state_)
+            {
+                state_->stop.request_stop();
+            }
+        }
+
+        bool cancel_requested() const noexcept
+        {
+            return state_ && state_->stop.stop_requested();
+        }
+
+        // Only once ready(). Rethrows what the task threw, TaskCancelled when it was cancelled.
+        decltype(auto) get() const
+        {
+            if (state_->error)
+            {
+                std::rethrow_exception(state_->error);
+            }
+            if constexpr (not std::is_void_v<T>)
+            {
+                return (*state_->result);
+            }
+        }
+
+    private:
+        friend class TaskScheduler;
+
+        explicit TaskHandle(std::shared_ptr<detail::SpawnedState<T>> state) noexcept
+        : state_{ std::move(state) }
+        {
+        }
+
+        std::shared_ptr<detail::SpawnedState<T>> state_;
+    };
+
+    // Runs tasks across I/O threads, the worker pool and the render thread. A task moves between
+    // them with `co_await scheduler.on(queue)`; queued steps are taken by priority. Tasks must
+    // only suspend on the scheduler's queues or on other tasks.
+    //
+    // On destruction every task still queued is resumed with TaskCancelled, on the destroying
+    // thread for the render queue, so none is left suspended.
+    class TaskScheduler : NoMoveable
+    {
+    public:
+        class ScheduleAwaiter
+        {
+        public:
+            ScheduleAwaiter(TaskScheduler& scheduler, TaskQueue queue) noexcept
+            : scheduler_{ scheduler }
+            , queue_{ queue }
+            {
+            }
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            template<class P>
+            bool await_suspend(std::coroutine_handle<P> handle)
+            {
+                context_ = handle.promise().context;
+                if (cancelled())
+                {
+                    return false;
+                }
+                scheduler_.enqueue(queue_, handle, context_ ? context_->priority : TaskPriority::normal);
+                return true;
+            }
+
+            void await_resume() const
+            {
+                if (cancelled())
+                {
+                    throw TaskCancelled{};
+                }
+            }
+
+        private:
+            bool cancelled() const noexcept
+            {
+                return scheduler_.stopping_.load(std::memory_order_relaxed) || (context_ && context_->stop.stop_requested());
+            }
+
+            TaskScheduler&     scheduler_;
+            TaskQueue          queue_;
+            const TaskContext* context_ = nullptr;
+        };
+
+        explicit TaskScheduler(WorkerPool& pool = WorkerPool::shared(), size_t io_thread_count = 2)
+        : pool_{ pool }
+        {
+            io_threads_.reserve(io_thread_count);
+            for (size_t i = 0; i < io_thread_count; i++)
+            {
+                io_threads_.emplace_back([this]{ io_loop(); });
+            }
+        }
+
+        ~TaskScheduler() noexcept
+        {
+            {
+                std::lock_guard lock{ mutex_ };
+                stopping_ = true;
+            }
+            io_ready_.notify_all();
+            io_threads_.clear();
+
+            std::unique_lock lock{ mutex_ };
+            while (true)
+            {
+                Queue* queue = std::ranges::find_if(queues_, [](const Queue& q){ return not q.empty(); });
+                if (queue != std::ranges::end(queues_))
+                {
+                    const std::coroutine_handle<> handle = queue->top().handle;
+                    queue->pop();
+                    lock.unlock();
+                    handle.resume();
+                    lock.lock();
+                    continue;
+                }
+                if (spawned_ == 0 && posted_ == 0)
+                {
+                    break;
+                }
+                idle_.wait(lock);
+            }
+        }
+
+        WorkerPool& pool() noexcept
+        {
+            return pool_;
+        }
+
+        // Awaitable moving the awaiting task to `queue`. Throws TaskCancelled on resumption when
+        // the task was cancelled meanwhile, or right away when it already was.
+        ScheduleAwaiter on(TaskQueue queue) noexcept
+        {
+            return ScheduleAwaiter{ *this, queue };
+        }
+
+        // Runs `task` with `priority`, on the calling thread up to its first suspension point.
+        template<class T>
+        TaskHandle<T> spawn(Task<T> task, TaskPriority priority = TaskPriority::normal)
+        {
+            auto state = std::make_shared<detail::SpawnedState<T>>();
+            state->context = { this, priority, state->stop.get_token() };
+            {
+                std::lock_guard lock{ mutex_ };
+                ++spawned_;
+            }
+            run_spawned(&state->context, std::move(task), state);
+            return TaskHandle<T>{ std::move(state) };
+        }
+
+        // Called by the render thread, e.g. once per frame: runs the steps queued for it until
+        // none are left or `budget` has passed, so uploads cannot stall a frame. Returns the
+        // number of steps run.
+        size_t run_render(std::chrono::microseconds budget = std::chrono::microseconds::max())
+        {
+            const auto start = std::chrono::steady_clock::now();
+            size_t count = 0;
+            while (count == 0 || std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start) < budget)
+            {
+                std::coroutine_handle<> handle;
+                {
+                    std::lock_guard lock{ mutex_ };
+                    Queue& queue = queues_[(size_t)TaskQueue::render];
+                    if (queue.empty())
+                    {
+                        break;
+                    }
+                    handle = queue.top().handle;
+                    queue.pop();
+                }
+                handle.resume();
+                count++;
+            }
+            return count;
+        }
+
+        // Spawned tasks that have not finished yet.
+        size_t active_count() const
+        {
+            std::lock_guard lock{ mutex_ };
+            return spawned_;
+        }
+
+        size_t queued_count(TaskQueue queue) const
+        {
+            std::lock_guard lock{ mutex_ };
+            return queues_[(size_t)queue].size();
+        }
+
+    private:
+        struct Job
+        {
+            std::coroutine_handle<> handle;
+            TaskPriority            priority;
+            uint64_t                sequence;
+
+            // Heap order: the highest priority, then the oldest, on top.
+            bool operator<(const Job& other) const noexcept
+            {
+                return priority != other.priority ? priority < other.priority : sequence > other.sequence;
+            }
+        };
+
+        using Queue = std::priority_queue<Job>;
+
+        template<class T>
+        static detail::SpawnedTask run_spawned(const TaskContext*, Task<T> task, std::shared_ptr<detail::SpawnedState<T>> state)
+        {
+            try
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    co_await std::move(task);
+                    state->result.emplace();
+                }
+                else
+                {
+                    state->result.emplace(co_await std::move(task));
+                }
+            }
+            catch (...)
+            {
+                state->error = std::current_exception();
+            }
+            state->done.store(true, std::memory_order_release);
+            TaskScheduler& scheduler = *state->context.scheduler;
+            std::lock_guard lock{ scheduler.mutex_ };
+            --scheduler.spawned_;
+            scheduler.idle_.notify_all();
+        }
+
+        void enqueue(TaskQueue queue, std::coroutine_handle<> handle, TaskPriority priority)
+        {
+            {
+                std::lock_guard lock{ mutex_ };
+                queues_[(size_t)queue].push({ handle, priority, sequence_++ });
+                if (queue == TaskQueue::worker)
+                {
+                    ++posted_;
+                }
+            }
+            switch (queue)
+            {
+            case TaskQueue::io:
+                io_ready_.notify_one();
+                break;
+            case TaskQueue::worker:
+                // Every post runs whichever step is most urgent by the time a worker gets to it.
+                pool_.submit([this]{ run_worker_step(); });
+                break;
+            default:
+                break;
+            }
+        }
+
+        void run_worker_step()
+        {
+            std::coroutine_handle<> handle;
+            {
+                std::lock_guard lock{ mutex_ };
+                Queue& queue = queues_[(size_t)TaskQueue::worker];
+                if (not queue.empty())
+                {
+                    handle = queue.top().handle;
+                    queue.pop();
+                }
+            }
+            if (handle)
+            {
+                handle.resume();
+            }
+            std::lock_guard lock{ mutex_ };
+            --posted_;
+            idle_.notify_all();
+        }
+
+        void io_loop()
+        {
+            while (true)
+            {
+                std::coroutine_handle<> handle;
+                {
+                    std::unique_lock lock{ mutex_ };
+                    Queue& queue = queues_[(size_t)TaskQueue::io];
+                    io_ready_.wait(lock, [&]{ return stopping_ || not queue.empty(); });
+                    // Left over steps are cancelled by the destructor.
+                    if (stopping_)
+                    {
+                        return;
+                    }
+                    handle = queue.top().handle;
+                    queue.pop();
+                }
+                handle.resume();
+            }
+        }
+
+        WorkerPool& pool_;
+        mutable std::mutex mutex_;
+        std::condition_variable io_ready_;
+        std::condition_variable idle_;
+        Queue queues_[3];
+        uint64_t sequence_ = 0;
+        // Worker posts not yet run, and spawned tasks not yet finished; both keep `this` alive.
+        size_t posted_ = 0;
+        size_t spawned_ = 0;
+        std::atomic<bool> stopping_ = false;
+        std::vector<std::jthread> io_threads_;
+    };
+}
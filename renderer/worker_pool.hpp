@@ -0,0 +1,162 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+
+#include <renderer/common.hpp>
+
+namespace adttil
+{
+    // Fixed set of background threads for CPU bound asset work such as image decoding.
+    class WorkerPool : NoMoveable
+    {
+    public:
+        explicit WorkerPool(size_t thread_count = default_thread_count())
+        {
+            threads_.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; i++)
+            {
+                threads_.emplace_back([this](std::stop_token stop){ work_loop(stop); });
+            }
+        }
+
+        ~WorkerPool() noexcept
+        {
+            {
+                std::lock_guard lock{ tasks_mutex_ };
+                for (std::jthread& thread : threads_)
+                {
+                    thread.request_stop();
+                }
+            }
+            tasks_cv_.notify_all();
+            threads_.clear();
+        }
+
+        // Pool shared by loaders that are not given one explicitly.
+        static WorkerPool& shared()
+        {
+            static WorkerPool pool{};
+            return pool;
+        }
+
+        static size_t default_thread_count() noexcept
+        {
+            return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        }
+
+        size_t thread_count() const noexcept
+        {
+            return threads_.size();
+        }
+
+        void submit(std::function<void()> task)
+        {
+            {
+                std::lock_guard lock{ tasks_mutex_ };
+                tasks_.push_back(std::move(task));
+            }
+            tasks_cv_.notify_one();
+        }
+
+        // Calls `body(i)` for every i in [0, count) and returns once all calls have finished. The
+        // calling thread takes indices too, so nested calls from a worker cannot deadlock. The
+        // first exception thrown by `body` is rethrown here after the remaining indices are skipped.
+        template<class F>
+        void parallel_for(size_t count, F&& body)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+
+            auto state = std::make_shared<ForState>();
+            state->count = count;
+            const auto run = [&body](ForState& s)
+            {
+                for (size_t i = s.next++; i < s.count; i = s.next++)
+                {
+                    try
+                    {
+                        body(i);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard lock{ s.mutex };
+                        if (not s.error)
+                        {
+                            s.error = std::current_exception();
+                        }
+                        s.next = s.count;
+                    }
+                }
+            };
+
+            // Helpers that only start after every index is taken return without touching `body`.
+            const size_t helpers = std::min(count - 1, threads_.size());
+            for (size_t i = 0; i < helpers; i++)
+            {
+                submit([state, run]
+                {
+                    ++state->active;
+                    run(*state);
+                    if (--state->active == 0)
+                    {
+                        std::lock_guard lock{ state->mutex };
+                        state->done.notify_all();
+                    }
+                });
+            }
+
+            run(*state);
+            std::unique_lock lock{ state->mutex };
+            state->done.wait(lock, [&]{ return state->active == 0; });
+            if (state->error)
+            {
+                std::rethrow_exception(state->error);
+            }
+        }
+
+    private:
+        struct ForState
+        {
+            size_t                  count = 0;
+            std::atomic<size_t>     next = 0;
+            std::atomic<size_t>     active = 0;
+            std::mutex              mutex;
+            std::condition_variable done;
+            std::exception_ptr      error;
+        };
+
+        void work_loop(std::stop_token stop)
+        {
+            while (true)
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock{ tasks_mutex_ };
+                    tasks_cv_.wait(lock, [&]{ return stop.stop_requested() || not tasks_.empty(); });
+                    if (stop.stop_requested())
+                    {
+                        return;
+                    }
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::mutex tasks_mutex_;
+        std::condition_variable tasks_cv_;
+        std::deque<std::function<void()>> tasks_;
+        std::vector<std::jthread> threads_;
+    };
+}
@@ -0,0 +1,526 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <ranges>
+#include <unordered_map>
+#include <string_view>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cmath>
+
+#include <renderer/common.hpp>
+#include <renderer/gpu_resource.hpp>
+#include <renderer/stb_libs.hpp>
+
+namespace adttil
+{
+    namespace shaders
+    {
+        inline constexpr uint32_t world_text_vert[] = {
+#include <shaders/world_text.vert.spv.inc>
+        };
+        inline constexpr uint32_t world_text_frag[] = {
+#include <shaders/world_text.frag.spv.inc>
+        };
+    }
+
+    enum class TextAlign
+    {
+        left,
+        center,
+    };
+
+    struct TextStyle
+    {
+        float     size = 24.0f;
+        Color32   color = { 255, 255, 255, 255 };
+        Color32   outline_color = { 0, 0, 0, 255 };
+        // Outline width in distance field units, 0 to disable, at most about 0.4.
+        float     outline = 0.15f;
+        TextAlign align = TextAlign::center;
+    };
+
+    // Maps the world positions given to WorldText::draw() to framebuffer pixels:
+    // `x_axis * x + y_axis * y + origin`. The default makes world units framebuffer pixels; a
+    // camera panning by `p` and zooming by `z` is `{ { z, 0 }, { 0, z }, -p * z }`.
+    struct WorldView
+    {
+        Vec2 x_axis = Vec2{ 1.0f, 0.0f };
+        Vec2 y_axis = Vec2{ 0.0f, 1.0f };
+        Vec2 origin = Vec2{ 0.0f, 0.0f };
+    };
+
+    // Text drawn in the scene, for damage numbers and name plates. Glyphs are rasterized once as
+    // signed distance fields at a fixed size into a single-channel atlas packed with stb_rect_pack,
+    // so any on-screen size reuses the same atlas entry. All text of a frame is one instanced draw,
+    // anchored at world positions the vertex shader projects through the WorldView.
+    class WorldText : NoMoveable
+    {
+    public:
+        WorldText(const VulkanContext& context, VkRenderPass render_pass, uint32_t frame_count,
+            uint32_t atlas_size = 1024, uint32_t max_glyphs = 16384)
+        : context_{ context }
+        , frame_count_{ frame_count }
+        , atlas_size_{ atlas_size }
+        , max_glyphs_{ max_glyphs }
+        , atlas_pixels_(atlas_size * atlas_size)
+        , pack_nodes_(atlas_size)
+        {
+            VkResult result;
+
+            set_and_check(result, create_resources());
+            OptianalGuard _{ result, [&]{ destroy_resources(); } };
+
+            set_and_check(result, create_pipeline(render_pass));
+            reset_atlas();
+        }
+
+        ~WorldText() noexcept
+        {
+            vkDestroyPipeline(context_.device, pipeline_, context_.allocator);
+            destroy_resources();
+        }
+
+        // `sdf_height` is the pixel height glyphs are rasterized at; `spread` the distance range in
+        // pixels, which bounds the outline width.
+        void load_font(const std::filesystem::path& path, float sdf_height = 48.0f, int spread = 6)
+        {
+            std::ifstream file{ path, std::ios::binary };
+            font_data_.assign(std::istreambuf_iterator<char>{ file }, {});
+            if (font_data_.empty() || not stbtt_InitFont(&font_, (const unsigned char*)font_data_.data(),
+                stbtt_GetFontOffsetForIndex((const unsigned char*)font_data_.data(), 0)))
+            {
+                font_data_.clear();
+                print_and_throw("failed to load font {}", path.string());
+            }
+
+            sdf_height_ = sdf_height;
+            spread_ = spread;
+            scale_ = stbtt_ScaleForPixelHeight(&font_, sdf_height);
+            reset_atlas();
+        }
+
+        // `position` is the baseline origin in world units: the left end for left aligned text,
+        // the middle for centered text. Only the origin follows the view; the glyphs keep
+        // `style.size` in framebuffer pixels, so text stays readable at any zoom.
+        void draw(std::string_view utf8, Vec2 position, const TextStyle& style = {})
+        {
+            if (font_data_.empty())
+            {
+                return;
+            }
+
+            const float factor = style.size / sdf_height_;
+            float x = 0.0f;
+            const size_t first = instances_.size();
+            int previous = 0;
+            for (size_t i = 0; i < utf8.size() && instances_.size() < max_glyphs_;)
+            {
+                const int codepoint = decode_utf8(utf8, i);
+                const Glyph* glyph = find_glyph(codepoint);
+                if (not glyph)
+                {
+                    continue;
+                }
+                if (previous)
+                {
+                    x += stbtt_GetCodepointKernAdvance(&font_, previous, codepoint) * scale_ * factor;
+                }
+                previous = codepoint;
+
+                if (glyph->width > 0)
+                {
+                    GpuGlyphInstance instance = {};
+                    instance.anchor[0] = position.x();
+                    instance.anchor[1] = position.y();
+                    instance.offset[0] = x + glyph->offset[0] * factor;
+                    instance.offset[1] = glyph->offset[1] * factor;
+                    instance.size[0] = glyph->width * factor;
+                    instance.size[1] = glyph->height * factor;
+                    set_uv(instance, *glyph);
+                    instance.color = pack_unorm4x8(style.color);
+                    instance.outline_color = pack_unorm4x8(style.outline_color);
+                    instance.outline = style.outline;
+                    instances_.push_back(instance);
+                    instance_codepoints_.push_back(codepoint);
+                }
+                x += glyph->advance * factor;
+            }
+
+            if (style.align == TextAlign::center)
+            {
+                for (GpuGlyphInstance& instance : instances_ | std::views::drop(first))
+                {
+                    instance.offset[0] -= x * 0.5f;
+                }
+            }
+        }
+
+        // The view used by the next record_draw(), for all text of the frame.
+        void set_view(const WorldView& view) noexcept
+        {
+            view_ = view;
+        }
+
+        // Uploads glyphs rasterized since the last frame. Recorded outside of a render pass.
+        void record_upload(VkCommandBuffer command_buffer, uint32_t frame)
+        {
+            if (dirty_max_[0] <= dirty_min_[0] || dirty_max_[1] <= dirty_min_[1])
+            {
+                return;
+            }
+
+            const uint32_t x = dirty_min_[0];
+            const uint32_t y = dirty_min_[1];
+            const uint32_t width = dirty_max_[0] - x;
+            const uint32_t height = dirty_max_[1] - y;
+            const VkDeviceSize base = (VkDeviceSize)(frame % frame_count_) * atlas_size_ * atlas_size_;
+            auto* staging = (unsigned char*)staging_.mapped + base;
+            for (uint32_t row = 0; row < height; row++)
+            {
+                std::memcpy(staging + row * width, &atlas_pixels_[(y + row) * atlas_size_ + x], width);
+            }
+            flush_buffer(context_, staging_);
+
+            image_barrier(command_buffer, atlas_.image,
+                atlas_uploaded_ ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            VkBufferImageCopy region = {};
+            region.bufferOffset = base;
+            region.bufferRowLength = width;
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            region.imageOffset = { (int32_t)x, (int32_t)y, 0 };
+            region.imageExtent = { width, height, 1 };
+            vkCmdCopyBufferToImage(command_buffer, staging_.buffer, atlas_.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            image_barrier(command_buffer, atlas_.image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+            atlas_uploaded_ = true;
+            dirty_min_[0] = dirty_min_[1] = atlas_size_;
+            dirty_max_[0] = dirty_max_[1] = 0;
+        }
+
+        // Draws everything queued with draw() since the last frame in one instanced draw.
+        void record_draw(VkCommandBuffer command_buffer, uint32_t frame, uint32_t width, uint32_t height)
+        {
+            if (instances_.empty() || not atlas_uploaded_)
+            {
+                instances_.clear();
+                instance_codepoints_.clear();
+                return;
+            }
+
+            const uint32_t base = (frame % frame_count_) * max_glyphs_;
+            std::memcpy((GpuGlyphInstance*)instance_buffer_.mapped + base, instances_.data(), instances_.size() * sizeof(GpuGlyphInstance));
+            flush_buffer(context_, instance_buffer_);
+
+            Constants constants = {};
+            constants.viewport[0] = (float)width;
+            constants.viewport[1] = (float)height;
+            constants.instance_base = base;
+            constants.view_x[0] = view_.x_axis.x();
+            constants.view_x[1] = view_.y_axis.x();
+            constants.view_x[2] = view_.origin.x();
+            constants.view_y[0] = view_.x_axis.y();
+            constants.view_y[1] = view_.y_axis.y();
+            constants.view_y[2] = view_.origin.y();
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &descriptor_set_, 0, nullptr);
+            vkCmdPushConstants(command_buffer, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+            set_viewport_and_scissor(command_buffer, width, height);
+            vkCmdDraw(command_buffer, 6, (uint32_t)instances_.size(), 0, 0);
+            instances_.clear();
+            instance_codepoints_.clear();
+        }
+
+    private:
+        // Atlas placement and metrics in atlas pixels, offset relative to the baseline origin.
+        struct Glyph
+        {
+            uint32_t x;
+            uint32_t y;
+            uint32_t width;
+            uint32_t height;
+            float    offset[2];
+            float    advance;
+        };
+
+        // Layout mirrors shaders/world_text.vert
+        struct GpuGlyphInstance
+        {
+            // Framebuffer pixels from the projected anchor to the top left corner.
+            float    offset[2];
+            float    size[2];
+            float    uv[4];
+            uint32_t color;
+            uint32_t outline_color;
+            float    outline;
+            float    pad;
+            // World position of the baseline origin.
+            float    anchor[2];
+            float    pad2[2];
+        };
+        static_assert(sizeof(GpuGlyphInstance) == 64);
+
+        // Rows of the WorldView as a 2x3 matrix, padded to vec4.
+        struct Constants
+        {
+            float    viewport[2];
+            uint32_t instance_base;
+            uint32_t pad;
+            float    view_x[4];
+            float    view_y[4];
+        };
+
+        static int decode_utf8(std::string_view text, size_t& i)
+        {
+            const auto byte = [&](size_t at){ return at < text.size() ? (unsigned char)text[at] : 0u; };
+            const unsigned c = byte(i);
+            if (c < 0x80)
+            {
+                i += 1;
+                return (int)c;
+            }
+            if ((c & 0xe0) == 0xc0)
+            {
+                i += 2;
+                return (int)((c & 0x1f) << 6 | (byte(i - 1) & 0x3f));
+            }
+            if ((c & 0xf0) == 0xe0)
+            {
+                i += 3;
+                return (int)((c & 0x0f) << 12 | (byte(i - 2) & 0x3f) << 6 | (byte(i - 1) & 0x3f));
+            }
+            i += 4;
+            return (int)((c & 0x07) << 18 | (byte(i - 3) & 0x3f) << 12 | (byte(i - 2) & 0x3f) << 6 | (byte(i - 1) & 0x3f));
+        }
+
+        void set_uv(GpuGlyphInstance& instance, const Glyph& glyph) const noexcept
+        {
+            instance.uv[0] = (float)glyph.x / atlas_size_;
+            instance.uv[1] = (float)glyph.y / atlas_size_;
+            instance.uv[2] = (float)(glyph.x + glyph.width) / atlas_size_;
+            instance.uv[3] = (float)(glyph.y + glyph.height) / atlas_size_;
+        }
+
+        // Rasterizes the glyph on first use. When the atlas is full it is cleared, refilled with
+        // the glyphs already queued this frame and then the new one.
+        const Glyph* find_glyph(int codepoint)
+        {
+            if (auto iter = glyphs_.find(codepoint); iter != glyphs_.end())
+            {
+                return &iter->second;
+            }
+
+            int advance, bearing;
+            stbtt_GetCodepointHMetrics(&font_, codepoint, &advance, &bearing);
+            Glyph glyph = {};
+            glyph.advance = advance * scale_;
+
+            int w = 0, h = 0, xoff = 0, yoff = 0;
+            unsigned char* sdf = stbtt_GetCodepointSDF(&font_, scale_, codepoint, spread_, 128,
+                128.0f / spread_, &w, &h, &xoff, &yoff);
+            if (sdf)
+            {
+                stbrp_rect rect = {};
+                rect.w = w + 1;
+                rect.h = h + 1;
+                if (not stbrp_pack_rects(&packer_, &rect, 1) && not repacking_)
+                {
+                    repack_queued();
+                    rect.was_packed = stbrp_pack_rects(&packer_, &rect, 1);
+                }
+                if (not rect.was_packed)
+                {
+                    stbtt_FreeSDF(sdf, nullptr);
+                    return nullptr;
+                }
+
+                glyph.x = rect.x;
+                glyph.y = rect.y;
+                glyph.width = w;
+                glyph.height = h;
+                glyph.offset[0] = (float)xoff;
+                glyph.offset[1] = (float)yoff;
+                for (int row = 0; row < h; row++)
+                {
+                    std::memcpy(&atlas_pixels_[(rect.y + row) * atlas_size_ + rect.x], sdf + row * w, w);
+                }
+                stbtt_FreeSDF(sdf, nullptr);
+                mark_dirty(glyph.x, glyph.y, glyph.x + w, glyph.y + h);
+            }
+            return &glyphs_.emplace(codepoint, glyph).first->second;
+        }
+
+        // Queued instances point into the atlas by UV, so a reset in the middle of a frame moves
+        // their glyphs into the fresh atlas. Those that no longer fit are hidden for the frame.
+        void repack_queued()
+        {
+            repacking_ = true;
+            reset_atlas();
+            for (size_t i = 0; i < instances_.size(); i++)
+            {
+                if (const Glyph* glyph = find_glyph(instance_codepoints_[i]); glyph && glyph->width > 0)
+                {
+                    set_uv(instances_[i], *glyph);
+                }
+                else
+                {
+                    instances_[i].size[0] = instances_[i].size[1] = 0.0f;
+                }
+            }
+            repacking_ = false;
+        }
+
+        void reset_atlas()
+        {
+            glyphs_.clear();
+            std::ranges::fill(atlas_pixels_, (unsigned char)0);
+            stbrp_init_target(&packer_, (int)atlas_size_, (int)atlas_size_, pack_nodes_.data(), (int)pack_nodes_.size());
+            mark_dirty(0, 0, atlas_size_, atlas_size_);
+        }
+
+        void mark_dirty(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+        {
+            dirty_min_[0] = std::min(dirty_min_[0], x0);
+            dirty_min_[1] = std::min(dirty_min_[1], y0);
+            dirty_max_[0] = std::max(dirty_max_[0], x1);
+            dirty_max_[1] = std::max(dirty_max_[1], y1);
+        }
+
+        VkResult create_resources()
+        {
+            VkResult result = VK_SUCCESS;
+            OptianalGuard _{ result, [&]{ destroy_resources(); } };
+
+            set_and_check(result, create_image(context_, { atlas_size_, atlas_size_ }, VK_FORMAT_R8_UNORM,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 1, 1, VK_IMAGE_VIEW_TYPE_2D, atlas_));
+            set_and_check(result, create_buffer(context_, (VkDeviceSize)atlas_size_ * atlas_size_ * frame_count_,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_));
+            set_and_check(result, create_buffer(context_, sizeof(GpuGlyphInstance) * max_glyphs_ * frame_count_,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instance_buffer_));
+            set_and_check(result, create_sampler(context_, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_NEAREST, sampler_));
+
+            VkDescriptorSetLayoutBinding bindings[2] = {};
+            bindings[0] = { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+            bindings[1] = { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+            VkDescriptorSetLayoutCreateInfo layout_info = {};
+            layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layout_info.bindingCount = 2;
+            layout_info.pBindings = bindings;
+            set_and_check(result, vkCreateDescriptorSetLayout(context_.device, &layout_info, context_.allocator, &set_layout_));
+
+            VkPushConstantRange range = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Constants) };
+            VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+            pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipeline_layout_info.setLayoutCount = 1;
+            pipeline_layout_info.pSetLayouts = &set_layout_;
+            pipeline_layout_info.pushConstantRangeCount = 1;
+            pipeline_layout_info.pPushConstantRanges = &range;
+            set_and_check(result, vkCreatePipelineLayout(context_.device, &pipeline_layout_info, context_.allocator, &pipeline_layout_));
+
+            VkDescriptorPoolSize pool_sizes[] =
+            {
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+            };
+            VkDescriptorPoolCreateInfo pool_info = {};
+            pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            pool_info.maxSets = 1;
+            pool_info.poolSizeCount = (uint32_t)std::size(pool_sizes);
+            pool_info.pPoolSizes = pool_sizes;
+            set_and_check(result, vkCreateDescriptorPool(context_.device, &pool_info, context_.allocator, &descriptor_pool_));
+
+            VkDescriptorSetAllocateInfo alloc_info = {};
+            alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            alloc_info.descriptorPool = descriptor_pool_;
+            alloc_info.descriptorSetCount = 1;
+            alloc_info.pSetLayouts = &set_layout_;
+            set_and_check(result, vkAllocateDescriptorSets(context_.device, &alloc_info, &descriptor_set_));
+
+            VkDescriptorBufferInfo buffer_info = { instance_buffer_.buffer, 0, VK_WHOLE_SIZE };
+            VkDescriptorImageInfo image_info = { sampler_, atlas_.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            VkWriteDescriptorSet writes[2] = {};
+            writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[0].dstSet = descriptor_set_;
+            writes[0].dstBinding = 0;
+            writes[0].descriptorCount = 1;
+            writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[0].pBufferInfo = &buffer_info;
+            writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[1].dstSet = descriptor_set_;
+            writes[1].dstBinding = 1;
+            writes[1].descriptorCount = 1;
+            writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            writes[1].pImageInfo = &image_info;
+            vkUpdateDescriptorSets(context_.device, 2, writes, 0, nullptr);
+            return result;
+        }
+
+        void destroy_resources() noexcept
+        {
+            vkDestroyDescriptorPool(context_.device, descriptor_pool_, context_.allocator);
+            vkDestroyPipelineLayout(context_.device, pipeline_layout_, context_.allocator);
+            vkDestroyDescriptorSetLayout(context_.device, set_layout_, context_.allocator);
+            vkDestroySampler(context_.device, sampler_, context_.allocator);
+            destroy_buffer(context_, instance_buffer_);
+            destroy_buffer(context_, staging_);
+            destroy_image(context_, atlas_);
+        }
+
+        VkResult create_pipeline(VkRenderPass render_pass)
+        {
+            VkPipelineColorBlendAttachmentState blend = {};
+            blend.blendEnable = VK_TRUE;
+            blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blend.colorBlendOp = VK_BLEND_OP_ADD;
+            blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            blend.alphaBlendOp = VK_BLEND_OP_ADD;
+            blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            return create_graphics_pipeline(context_, shaders::world_text_vert, shaders::world_text_frag,
+                pipeline_layout_, render_pass, 0, blend, pipeline_);
+        }
+
+        VulkanContext context_;
+        uint32_t frame_count_;
+        uint32_t atlas_size_;
+        uint32_t max_glyphs_;
+
+        GpuImage atlas_;
+        GpuBuffer staging_;
+        GpuBuffer instance_buffer_;
+        VkSampler sampler_ = VK_NULL_HANDLE;
+        VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+        VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+        VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+        VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+        VkPipeline pipeline_ = VK_NULL_HANDLE;
+
+        std::vector<char> font_data_;
+        stbtt_fontinfo font_ = {};
+        float sdf_height_ = 48.0f;
+        int spread_ = 6;
+        float scale_ = 1.0f;
+
+        std::vector<unsigned char> atlas_pixels_;
+        std::vector<stbrp_node> pack_nodes_;
+        stbrp_context packer_ = {};
+        std::unordered_map<int, Glyph> glyphs_;
+        uint32_t dirty_min_[2] = {};
+        uint32_t dirty_max_[2] = {};
+        bool atlas_uploaded_ = false;
+        bool repacking_ = false;
+
+        std::vector<GpuGlyphInstance> instances_;
+        std::vector<int> instance_codepoints_;
+        WorldView view_;
+    };
+}
@@ -0,0 +1,141 @@
+// Round trips the pack codec and the pack file: lz_compress() output on inputs that hit every
+// length encoding decodes back exactly, hand made blocks decode to known bytes, malformed
+// blocks are refused, and a written pack maps back with the same entries.
+#include <print>
+#include <vector>
+#include <string>
+#include <span>
+#include <random>
+#include <filesystem>
+
+#include <renderer/asset_pack.hpp>
+
+namespace
+{
+    size_t failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (not condition)
+        {
+            std::println("FAILED: {}", what);
+            ++failures;
+        }
+    }
+
+    std::vector<std::byte> bytes(std::initializer_list<int> values)
+    {
+        std::vector<std::byte> out;
+        for (int value : values)
+        {
+            out.push_back((std::byte)value);
+        }
+        return out;
+    }
+
+    bool round_trips(std::span<const std::byte> input)
+    {
+        const std::vector<std::byte> packed = adttil::lz_compress(input);
+        std::vector<std::byte> unpacked(input.size());
+        return adttil::lz_decompress(packed, unpacked) && std::ranges::equal(unpacked, input);
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 44 };
+
+    // Empty and shorter than a match, incompressible noise, runs that decode as overlapping
+    // matches, and literal and match lengths past 15 and 15 + 255 that need extra length bytes.
+    std::vector<std::vector<std::byte>> inputs = { {}, bytes({ 1 }), bytes({ 1, 2, 3 }), bytes({ 7, 7, 7, 7, 7 }) };
+    for (size_t size : { 16uz, 300uz, 70000uz })
+    {
+        std::vector<std::byte> noise(size);
+        std::ranges::generate(noise, [&]{ return (std::byte)random(); });
+        inputs.push_back(noise);
+        inputs.push_back(std::vector<std::byte>(size, std::byte{ 0x5a }));
+    }
+    std::vector<std::byte> mixed;
+    for (int block = 0; block < 200; block++)
+    {
+        const size_t literals = random() % 600, repeat = random() % 400;
+        for (size_t i = 0; i < literals; i++)
+        {
+            mixed.push_back((std::byte)random());
+        }
+        const size_t distance = 1 + random() % std::max<size_t>(mixed.size(), 1);
+        for (size_t i = 0; i < repeat && distance <= mixed.size(); i++)
+        {
+            mixed.push_back(mixed[mixed.size() - distance]);
+        }
+    }
+    inputs.push_back(mixed);
+    for (const std::vector<std::byte>& input : inputs)
+    {
+        if (not round_trips(input))
+        {
+            std::println("FAILED: round trip of {} bytes", input.size());
+            ++failures;
+        }
+    }
+    check(adttil::lz_compress(std::vector<std::byte>(70000, std::byte{ 0x5a })).size() < 400, "a long run compresses");
+
+    // Three literals, then a match of 6 at offset 3 that overlaps what it copies.
+    const std::vector<std::byte> block = bytes({ 0x32, 'a', 'b', 'c', 3, 0 });
+    std::vector<std::byte> out(9);
+    check(adttil::lz_decompress(block, out) && std::ranges::equal(out, bytes({ 'a', 'b', 'c', 'a', 'b', 'c', 'a', 'b', 'c' })), "known block");
+    // 15 + 3 literals through an extra length byte.
+    std::vector<std::byte> long_literals = bytes({ 0xf0, 3 });
+    for (int i = 0; i < 18; i++)
+    {
+        long_literals.push_back((std::byte)i);
+    }
+    out.assign(18, std::byte{});
+    check(adttil::lz_decompress(long_literals, out) && out[17] == std::byte{ 17 }, "extended literal length");
+
+    out.assign(9, std::byte{});
+    check(not adttil::lz_decompress(bytes({ 0x32, 'a', 'b', 'c', 0, 0 }), out), "offset 0 is refused");
+    check(not adttil::lz_decompress(bytes({ 0x32, 'a', 'b', 'c', 4, 0 }), out), "offset before the start is refused");
+    check(not adttil::lz_decompress(bytes({ 0x32, 'a', 'b', 'c', 3 }), out), "truncated offset is refused");
+    check(not adttil::lz_decompress(bytes({ 0x40, 'a', 'b', 'c' }), out), "truncated literals are refused");
+    out.assign(8, std::byte{});
+    check(not adttil::lz_decompress(block, out), "output shorter than the content is refused");
+    out.assign(10, std::byte{});
+    check(not adttil::lz_decompress(block, out), "output longer than the content is refused");
+
+    // A pack compresses an entry only when asked and when that saves space.
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "adttil_asset_pack_test.pack";
+    const std::vector<std::byte> run(300, std::byte{ 0x5a });
+    std::vector<std::byte> noise(5000);
+    std::ranges::generate(noise, [&]{ return (std::byte)random(); });
+    std::vector<adttil::AssetPack::Input> pack_inputs = {
+        { "anims/hero/run_000.png", run, 11, true },
+        { "anims/hero/idle_000.png", noise, 12, true },
+        { "fonts/bold.ttf", mixed, 13, false },
+    };
+    check(adttil::AssetPack::write(path, pack_inputs), "pack written");
+    {
+        const adttil::AssetPack pack{ path };
+        check(pack.is_open(), "pack opened");
+        check(pack.entries().size() == 3 && pack.entries_with_prefix("anims/hero/").size() == 2, "pack index");
+        std::vector<std::byte> storage;
+        for (const adttil::AssetPack::Input& input : pack_inputs)
+        {
+            const adttil::AssetPack::Entry* entry = pack.find(input.name);
+            check(entry && std::ranges::equal(pack.read(*entry, storage), input.content) && entry->mtime == input.mtime, "pack entry content");
+            check(entry && entry->hash == adttil::hash_bytes(input.content.data(), input.content.size()), "pack entry hash");
+        }
+        check(pack.find("anims/hero/run_000.png")->compression == adttil::PackCompression::lz, "run is stored compressed");
+        check(pack.find("anims/hero/idle_000.png")->compression == adttil::PackCompression::none, "noise is stored as is");
+        check(pack.find("fonts/bold.ttf")->compression == adttil::PackCompression::none, "uncompressed input is stored as is");
+        check(not pack.find("anims/hero"), "a prefix is not an entry");
+    }
+    std::filesystem::remove(path);
+
+    if (failures)
+    {
+        std::println("{} checks failed", failures);
+        return 1;
+    }
+    std::println("all asset pack checks passed");
+}
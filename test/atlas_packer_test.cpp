@@ -0,0 +1,275 @@
+// Checks the atlas layouts: packed rects, with their gutters, stay inside their page, on the
+// alignment grid and clear of each other and of the free rects, pages spill and groups stay apart,
+// and AtlasFreeList allocations keep the same guarantees and give all space back when released.
+#include <print>
+#include <vector>
+#include <span>
+#include <random>
+
+#include <renderer/atlas_packer.hpp>
+
+namespace
+{
+    using adttil::Coord2;
+    using adttil::BitmapRect;
+    using adttil::AtlasOptions;
+    using adttil::AtlasLayout;
+    using adttil::AtlasFreeList;
+
+    size_t failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (not condition)
+        {
+            std::println("FAILED: {}", what);
+            ++failures;
+        }
+    }
+
+    bool intersect(const BitmapRect& a, const BitmapRect& b)
+    {
+        return a.position.x() < b.position.x() + b.size.x() && b.position.x() < a.position.x() + a.size.x()
+            && a.position.y() < b.position.y() + b.size.y() && b.position.y() < a.position.y() + a.size.y();
+    }
+
+    size_t area(std::span<const BitmapRect> rects)
+    {
+        size_t total = 0;
+        for (const BitmapRect& rect : rects)
+        {
+            total += rect.size.x() * rect.size.y();
+        }
+        return total;
+    }
+
+    // A placed rect with its extrusion, padding and alignment, as it occupies the page.
+    struct Placed
+    {
+        uint32_t   layer;
+        BitmapRect footprint;
+    };
+
+    Placed footprint(uint32_t layer, Coord2 position, Coord2 size, const AtlasOptions& options)
+    {
+        const size_t border = options.extrude * 2 + options.padding, alignment = adttil::atlas_alignment(options);
+        return { layer, { Coord2{ position.x() - options.extrude, position.y() - options.extrude },
+            Coord2{ adttil::align_up(size.x() + border, alignment), adttil::align_up(size.y() + border, alignment) } } };
+    }
+
+    // Every footprint inside `page`, on the grid and apart from the others and from free space.
+    bool check_placement(std::span<const Placed> placed, Coord2 page, size_t alignment, const std::vector<std::vector<BitmapRect>>& free_rects, const char* what)
+    {
+        for (size_t i = 0; i < placed.size(); i++)
+        {
+            const BitmapRect& rect = placed[i].footprint;
+            if (rect.position.x() + rect.size.x() > page.x() || rect.position.y() + rect.size.y() > page.y()
+                || rect.position.x() % alignment || rect.position.y() % alignment)
+            {
+                std::println("FAILED: {}: rect {} is off the page or the grid", what, i);
+                ++failures;
+                return false;
+            }
+            for (size_t j = i + 1; j < placed.size(); j++)
+            {
+                if (placed[j].layer == placed[i].layer && intersect(rect, placed[j].footprint))
+                {
+                    std::println("FAILED: {}: rects {} and {} overlap", what, i, j);
+                    ++failures;
+                    return false;
+                }
+            }
+            if (placed[i].layer < free_rects.size())
+            {
+                for (const BitmapRect& free : free_rects[placed[i].layer])
+                {
+                    if (intersect(rect, free))
+                    {
+                        std::println("FAILED: {}: rect {} overlaps free space", what, i);
+                        ++failures;
+                        return false;
+                    }
+                }
+            }
+        }
+        for (const std::vector<BitmapRect>& rects : free_rects)
+        {
+            for (size_t i = 0; i < rects.size(); i++)
+            {
+                for (size_t j = i + 1; j < rects.size(); j++)
+                {
+                    if (intersect(rects[i], rects[j]))
+                    {
+                        std::println("FAILED: {}: free rects overlap", what);
+                        ++failures;
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<Coord2> random_sizes(std::mt19937& random, size_t count, size_t largest)
+    {
+        std::vector<Coord2> sizes(count);
+        for (Coord2& size : sizes)
+        {
+            // A few empty frames, which take no space.
+            size = random() % 20 ? Coord2{ 1 + random() % largest, 1 + random() % largest } : Coord2{ 0uz, 0uz };
+        }
+        return sizes;
+    }
+
+    std::vector<Placed> placements(const AtlasLayout& layout, std::span<const Coord2> sizes, const AtlasOptions& options)
+    {
+        std::vector<Placed> placed;
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            if (sizes[i].x() && sizes[i].y())
+            {
+                placed.push_back(footprint(layout.layers[i], layout.positions[i], sizes[i], options));
+            }
+        }
+        return placed;
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 38 };
+
+    // Single pages under several gutters and alignments.
+    for (int round = 0; round < 40; round++)
+    {
+        AtlasOptions options;
+        options.padding = random() % 4;
+        options.extrude = random() % 3;
+        options.power_of_two = random() % 2;
+        options.square = random() % 4 == 0;
+        options.mip_levels = 1 + random() % 3;
+        options.compression = random() % 3 == 0 ? adttil::BlockFormat::bc7 : adttil::BlockFormat::none;
+        const std::vector<Coord2> sizes = random_sizes(random, 1 + random() % 120, 1 + random() % 80);
+        AtlasLayout layout;
+        if (not adttil::pack_atlas(sizes, options, layout))
+        {
+            check(false, "layout packs");
+            continue;
+        }
+        check(layout.page_count == 1 && layout.free_rects.size() == 1, "small layout takes one page");
+        check(not options.square || layout.size.x() == layout.size.y(), "square layout");
+        check(not options.power_of_two || (std::has_single_bit(layout.size.x()) && std::has_single_bit(layout.size.y())), "power of two layout");
+        check(layout.efficiency > 0.0 && layout.efficiency <= 1.0, "efficiency");
+        check_placement(placements(layout, sizes, options), layout.size, adttil::atlas_alignment(options), layout.free_rects, "single page");
+    }
+
+    // Content past max_size spills onto further pages, up to max_pages.
+    AtlasOptions small;
+    small.max_size = 128;
+    const std::vector<Coord2> many = random_sizes(random, 200, 40);
+    AtlasLayout spilled;
+    check(adttil::pack_atlas(many, small, spilled) && spilled.page_count > 1 && spilled.size == Coord2{ 128uz, 128uz }, "layout spills onto pages");
+    check_placement(placements(spilled, many, small), spilled.size, 1, spilled.free_rects, "spilled pages");
+    small.max_pages = spilled.page_count - 1;
+    check(not adttil::pack_atlas(many, small, spilled), "past max_pages fails");
+    const Coord2 huge[] = { Coord2{ 200uz, 10uz } };
+    check(not adttil::pack_atlas(huge, small, spilled), "a rect larger than any page fails");
+
+    // Groups never share a page.
+    AtlasOptions grouped;
+    grouped.max_size = 256;
+    const std::vector<Coord2> group_sizes = random_sizes(random, 150, 50);
+    std::vector<uint32_t> groups(group_sizes.size());
+    for (uint32_t& group : groups)
+    {
+        group = random() % 3 * 2;
+    }
+    AtlasLayout group_layout;
+    check(adttil::pack_atlas_groups(group_sizes, groups, grouped, group_layout), "groups pack");
+    check(group_layout.page_groups.size() == group_layout.page_count, "every page has a group");
+    for (size_t i = 0; i < group_sizes.size(); i++)
+    {
+        if (group_sizes[i].x() && group_sizes[i].y() && group_layout.page_groups[group_layout.layers[i]] != groups[i])
+        {
+            std::println("FAILED: rect {} of group {} is on a page of group {}", i, groups[i], group_layout.page_groups[group_layout.layers[i]]);
+            ++failures;
+        }
+    }
+    check_placement(placements(group_layout, group_sizes, grouped), group_layout.size, 1, group_layout.free_rects, "grouped pages");
+
+    // Allocations from the free space of a layout, then everything released again.
+    for (int round = 0; round < 20; round++)
+    {
+        AtlasOptions options;
+        options.padding = random() % 3;
+        options.extrude = random() % 2;
+        options.mip_levels = 1 + random() % 2;
+        const std::vector<Coord2> sizes = random_sizes(random, 30, 60);
+        AtlasLayout layout;
+        adttil::pack_atlas(sizes, options, layout);
+        layout.free_rects[0].push_back({ Coord2{ 0uz, layout.size.y() }, Coord2{ layout.size.x(), layout.size.y() } });
+        const Coord2 page{ layout.size.x(), layout.size.y() * 2 };
+        AtlasFreeList free_list{ layout.free_rects, options };
+        const size_t free_area = area(free_list.pages()[0]);
+
+        std::vector<Placed> placed = placements(layout, sizes, options);
+        std::vector<std::pair<Placed, Coord2>> allocated;
+        for (int attempt = 0; attempt < 300; attempt++)
+        {
+            const Coord2 size{ 1 + random() % 30, 1 + random() % 30 };
+            if (auto slot = free_list.allocate(size))
+            {
+                check(slot->first == 0, "allocation on the only page");
+                placed.push_back(footprint(slot->first, slot->second, size, options));
+                allocated.push_back({ placed.back(), size });
+            }
+            // Some rects go again right away, so released space is reused.
+            if (not allocated.empty() && random() % 4 == 0)
+            {
+                const size_t victim = random() % allocated.size();
+                const auto [victim_placed, victim_size] = allocated[victim];
+                free_list.release(victim_placed.layer, Coord2{ victim_placed.footprint.position.x() + options.extrude, victim_placed.footprint.position.y() + options.extrude }, victim_size);
+                std::erase_if(placed, [&](const Placed& other){ return other.footprint.position == victim_placed.footprint.position && other.layer == victim_placed.layer; });
+                allocated.erase(allocated.begin() + victim);
+            }
+        }
+        check(not allocated.empty(), "free list allocates");
+        if (not check_placement(placed, page, adttil::atlas_alignment(options), free_list.pages(), "free list"))
+        {
+            continue;
+        }
+        for (const auto& [slot, size] : allocated)
+        {
+            free_list.release(slot.layer, Coord2{ slot.footprint.position.x() + options.extrude, slot.footprint.position.y() + options.extrude }, size);
+        }
+        check(area(free_list.pages()[0]) == free_area, "releasing everything gives back all free space");
+        check_placement(placements(layout, sizes, options), page, adttil::atlas_alignment(options), free_list.pages(), "released");
+    }
+
+    // A free list of grouped pages only allocates on pages of the requested group.
+    AtlasFreeList group_list{ group_layout.free_rects, grouped, group_layout.page_groups };
+    if (auto slot = group_list.allocate(Coord2{ 4uz, 4uz }, 2))
+    {
+        check(group_layout.page_groups[slot->first] == 2, "allocation on a page of its group");
+    }
+    check(not group_list.allocate(Coord2{ 4uz, 4uz }, 1), "no pages of an unused group");
+
+    // Extrusion repeats the edge pixels outwards, corners included.
+    std::vector<adttil::Color32> pixels(6 * 6, adttil::Color32{ 0, 0, 0, 0 });
+    const adttil::BitmapView atlas{ pixels.data(), Coord2{ 6uz, 6uz } };
+    atlas[Coord2{ 2uz, 2uz }] = adttil::Color32{ 1, 0, 0, 255 };
+    atlas[Coord2{ 3uz, 2uz }] = adttil::Color32{ 2, 0, 0, 255 };
+    atlas[Coord2{ 2uz, 3uz }] = adttil::Color32{ 3, 0, 0, 255 };
+    atlas[Coord2{ 3uz, 3uz }] = adttil::Color32{ 4, 0, 0, 255 };
+    adttil::extrude_edges(atlas, Coord2{ 2uz, 2uz }, Coord2{ 2uz, 2uz }, 2);
+    check(atlas[Coord2{ 0uz, 0uz }].r() == 1 && atlas[Coord2{ 5uz, 0uz }].r() == 2 && atlas[Coord2{ 0uz, 5uz }].r() == 3 && atlas[Coord2{ 5uz, 5uz }].r() == 4,
+        "extruded corners");
+    check(atlas[Coord2{ 2uz, 0uz }].r() == 1 && atlas[Coord2{ 5uz, 3uz }].r() == 4, "extruded edges");
+
+    if (failures)
+    {
+        std::println("{} checks failed", failures);
+        return 1;
+    }
+    std::println("all atlas packer checks passed");
+}
@@ -0,0 +1,259 @@
+// Decodes the output of compress_page() and compress_rect() with a reference BC7 mode 6 and BC3
+// decoder written from the format specs, and bounds the error: solid and two colour blocks come
+// back within the endpoint precision, ramps stay under a small RMS error also on pages that end in
+// partial blocks, and a rect only rewrites its own blocks.
+#include <print>
+#include <vector>
+#include <span>
+#include <random>
+#include <cmath>
+
+#include <renderer/block_compress.hpp>
+
+namespace
+{
+    using adttil::Color32;
+    using adttil::Coord2;
+    using adttil::BitmapView;
+    using adttil::BlockFormat;
+
+    size_t failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (not condition)
+        {
+            std::println("FAILED: {}", what);
+            ++failures;
+        }
+    }
+
+    uint32_t read_bits(const uint8_t* block, size_t& at, size_t count)
+    {
+        uint32_t value = 0;
+        for (size_t i = 0; i < count; i++, at++)
+        {
+            value |= (uint32_t)(block[at >> 3] >> (at & 7) & 1) << i;
+        }
+        return value;
+    }
+
+    // Only mode 6 is decoded; any other mode fails the test.
+    bool decode_bc7(const uint8_t* block, Color32 (&texels)[16])
+    {
+        size_t at = 0;
+        if (read_bits(block, at, 7) != 1u << 6)
+        {
+            return false;
+        }
+        int endpoints[2][4];
+        for (int c = 0; c < 4; c++)
+        {
+            endpoints[0][c] = (int)read_bits(block, at, 7);
+            endpoints[1][c] = (int)read_bits(block, at, 7);
+        }
+        for (auto& endpoint : endpoints)
+        {
+            const int pbit = (int)read_bits(block, at, 1);
+            for (int& value : endpoint)
+            {
+                value = value << 1 | pbit;
+            }
+        }
+        static constexpr int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+        for (int t = 0; t < 16; t++)
+        {
+            const int weight = weights[read_bits(block, at, t == 0 ? 3 : 4)];
+            for (int c = 0; c < 4; c++)
+            {
+                texels[t][c] = (unsigned char)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+            }
+        }
+        return true;
+    }
+
+    bool decode_bc3(const uint8_t* block, Color32 (&texels)[16])
+    {
+        const int a0 = block[0], a1 = block[1];
+        int alphas[8] = { a0, a1 };
+        for (int i = 1; i < 7; i++)
+        {
+            alphas[i + 1] = a0 > a1 ? ((7 - i) * a0 + i * a1) / 7 : i < 5 ? ((5 - i) * a0 + i * a1) / 5 : i == 5 ? 0 : 255;
+        }
+        const auto expand = [](uint16_t value, int (&color)[3])
+        {
+            const int r = value >> 11 & 31, g = value >> 5 & 63, b = value & 31;
+            color[0] = r << 3 | r >> 2;
+            color[1] = g << 2 | g >> 4;
+            color[2] = b << 3 | b >> 2;
+        };
+        int colors[4][3];
+        expand((uint16_t)(block[8] | block[9] << 8), colors[0]);
+        expand((uint16_t)(block[10] | block[11] << 8), colors[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            colors[2][c] = (2 * colors[0][c] + colors[1][c]) / 3;
+            colors[3][c] = (colors[0][c] + 2 * colors[1][c]) / 3;
+        }
+        size_t alpha_at = 16, color_at = 96;
+        for (Color32& texel : texels)
+        {
+            const int* color = colors[read_bits(block, color_at, 2)];
+            texel = Color32{ (unsigned char)color[0], (unsigned char)color[1], (unsigned char)color[2], (unsigned char)alphas[read_bits(block, alpha_at, 3)] };
+        }
+        return true;
+    }
+
+    // Decodes every block of a page in `format` back into `size` pixels.
+    bool decode_page(std::span<const std::byte> blocks, Coord2 size, BlockFormat format, std::vector<Color32>& pixels)
+    {
+        pixels.assign(size.x() * size.y(), Color32{});
+        const size_t blocks_x = (size.x() + 3) / 4;
+        for (size_t by = 0; by * 4 < size.y(); by++)
+        {
+            for (size_t bx = 0; bx < blocks_x; bx++)
+            {
+                Color32 texels[16];
+                const auto* block = (const uint8_t*)blocks.data() + (by * blocks_x + bx) * adttil::block_bytes;
+                if (not (format == BlockFormat::bc7 ? decode_bc7(block, texels) : decode_bc3(block, texels)))
+                {
+                    return false;
+                }
+                for (size_t t = 0; t < 16; t++)
+                {
+                    const size_t x = bx * 4 + t % 4, y = by * 4 + t / 4;
+                    if (x < size.x() && y < size.y())
+                    {
+                        pixels[y * size.x() + x] = texels[t];
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    struct Error
+    {
+        int    max[4] = {};
+        double rms = 0.0;
+    };
+
+    Error measure(std::span<const Color32> expected, std::span<const Color32> decoded)
+    {
+        Error error;
+        double sum = 0.0;
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                const int d = std::abs((int)expected[i][c] - (int)decoded[i][c]);
+                error.max[c] = std::max(error.max[c], d);
+                sum += d * d;
+            }
+        }
+        error.rms = std::sqrt(sum / (double)(expected.size() * 4));
+        return error;
+    }
+
+    Error round_trip(std::vector<Color32>& pixels, Coord2 size, BlockFormat format, adttil::WorkerPool& pool, const char* what)
+    {
+        std::vector<std::byte> blocks(adttil::compressed_size(size, format));
+        adttil::compress_page(BitmapView{ pixels.data(), size }, format, blocks, pool);
+        std::vector<Color32> decoded;
+        if (not decode_page(blocks, size, format, decoded))
+        {
+            std::println("FAILED: {} does not decode", what);
+            ++failures;
+            return Error{ { 255, 255, 255, 255 }, 255.0 };
+        }
+        return measure(pixels, decoded);
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 40 };
+    adttil::WorkerPool pool{ 2 };
+
+    check(adttil::compressed_size(Coord2{ 5uz, 9uz }, BlockFormat::bc7) == 2 * 3 * 16, "size rounds up to whole blocks");
+    check(adttil::compressed_size(Coord2{ 5uz, 9uz }, BlockFormat::none) == 5 * 9 * 4, "uncompressed size");
+
+    // Solid blocks: BC7 endpoints are off by at most the bit they share across channels, BC3
+    // keeps alpha exact and colour within the 565 step.
+    for (int round = 0; round < 200; round++)
+    {
+        const Color32 color{ (unsigned char)random(), (unsigned char)random(), (unsigned char)random(), (unsigned char)random() };
+        std::vector<Color32> pixels(16, color);
+        const Error bc7 = round_trip(pixels, Coord2{ 4uz, 4uz }, BlockFormat::bc7, pool, "solid bc7");
+        check(std::ranges::max(bc7.max) <= 1, "solid bc7 block is within the shared bit");
+        const Error bc3 = round_trip(pixels, Coord2{ 4uz, 4uz }, BlockFormat::bc3, pool, "solid bc3");
+        check(bc3.max[0] <= 5 && bc3.max[1] <= 3 && bc3.max[2] <= 5 && bc3.max[3] == 0, "solid bc3 block is within the 565 step");
+    }
+
+    // Two colours on a line: the endpoints land on them up to the shared bit.
+    for (int round = 0; round < 200; round++)
+    {
+        const Color32 first{ (unsigned char)random(), (unsigned char)random(), (unsigned char)random(), (unsigned char)random() };
+        const Color32 second{ (unsigned char)random(), (unsigned char)random(), (unsigned char)random(), (unsigned char)random() };
+        std::vector<Color32> pixels(16);
+        for (Color32& pixel : pixels)
+        {
+            pixel = random() % 2 ? first : second;
+        }
+        const Error bc7 = round_trip(pixels, Coord2{ 4uz, 4uz }, BlockFormat::bc7, pool, "two colour bc7");
+        check(std::ranges::max(bc7.max) <= 1, "two colour bc7 block is within the shared bit");
+    }
+
+    // Diagonal ramps between two random colours with a little noise, on pages that end in
+    // partial blocks. One endpoint line per block fits a ramp; it cannot fit two independent
+    // ones, so those are left out.
+    for (Coord2 size : { Coord2{ 64uz, 64uz }, Coord2{ 37uz, 21uz }, Coord2{ 3uz, 2uz } })
+    {
+        std::vector<Color32> pixels(size.x() * size.y());
+        const Color32 from{ (unsigned char)random(), (unsigned char)random(), (unsigned char)random(), (unsigned char)random() };
+        const Color32 to{ (unsigned char)random(), (unsigned char)random(), (unsigned char)random(), (unsigned char)random() };
+        for (size_t y = 0; y < size.y(); y++)
+        {
+            for (size_t x = 0; x < size.x(); x++)
+            {
+                const float t = (float)(x + y) / (float)(size.x() + size.y() - 2);
+                Color32& pixel = pixels[y * size.x() + x];
+                for (int c = 0; c < 4; c++)
+                {
+                    const float value = (float)from[c] + ((float)to[c] - (float)from[c]) * t + (float)(random() % 7) - 3.0f;
+                    pixel[c] = (unsigned char)std::clamp(std::lround(value), 0l, 255l);
+                }
+            }
+        }
+        const Error bc7 = round_trip(pixels, size, BlockFormat::bc7, pool, "gradient bc7");
+        const Error bc3 = round_trip(pixels, size, BlockFormat::bc3, pool, "gradient bc3");
+        if (bc7.rms > 3.0 || bc3.rms > 5.0)
+        {
+            std::println("FAILED: {}x{} gradient, rms error {} in bc7 and {} in bc3", size.x(), size.y(), bc7.rms, bc3.rms);
+            ++failures;
+        }
+    }
+
+    // A rect rewrites the blocks it touches and leaves the rest alone.
+    const Coord2 page_size{ 16uz, 16uz };
+    std::vector<Color32> page(page_size.x() * page_size.y(), Color32{ 10, 20, 30, 40 });
+    std::vector<std::byte> blocks(adttil::compressed_size(page_size, BlockFormat::bc7), std::byte{ 0xcd });
+    adttil::compress_rect(BitmapView{ page.data(), page_size }, { Coord2{ 5uz, 3uz }, Coord2{ 4uz, 2uz } }, BlockFormat::bc7, blocks, pool);
+    for (size_t block = 0; block < 16; block++)
+    {
+        const bool touched = (block % 4 == 1 || block % 4 == 2) && block / 4 < 2;
+        const bool written = std::ranges::any_of(std::span{ blocks }.subspan(block * 16, 16), [](std::byte value){ return value != std::byte{ 0xcd }; });
+        if (touched != written)
+        {
+            std::println("FAILED: block {} of the rect {}", block, touched ? "was not written" : "was overwritten");
+            ++failures;
+        }
+    }
+
+    if (failures)
+    {
+        std::println("{} checks failed", failures);
+        return 1;
+    }
+    std::println("all block compression checks passed");
+}
@@ -0,0 +1,89 @@
+// Checks CollisionMask::overlaps() against a pixel by pixel test on random masks and offsets.
+// Widths up to several hundred pixels take the 128-bit path; masks sized exactly to their rows
+// let a sanitizer catch reads past the last row.
+#include <print>
+#include <vector>
+#include <random>
+
+#include <renderer/collision_mask.hpp>
+
+namespace
+{
+    using adttil::Color32;
+    using adttil::Coord2;
+    using adttil::Int2;
+    using adttil::BitmapView;
+    using adttil::CollisionMask;
+
+    bool brute_force(const CollisionMask& a, Int2 a_position, const CollisionMask& b, Int2 b_position)
+    {
+        for (size_t y = 0; y < a.size().y(); y++)
+        {
+            for (size_t x = 0; x < a.size().x(); x++)
+            {
+                const int64_t bx = (int64_t)x + a_position.x() - b_position.x(), by = (int64_t)y + a_position.y() - b_position.y();
+                if (bx < 0 || by < 0 || bx >= (int64_t)b.size().x() || by >= (int64_t)b.size().y())
+                {
+                    continue;
+                }
+                if (a[Coord2{ x, y }] && b[Coord2{ (size_t)bx, (size_t)by }])
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Sparse masks, so that many placements overlap in their rects but not in their pixels.
+    CollisionMask random_mask(std::mt19937& random, Coord2 size, uint32_t solid_per_mille)
+    {
+        std::vector<Color32> pixels(size.x() * size.y());
+        for (Color32& pixel : pixels)
+        {
+            pixel = Color32{ 0, 0, 0, (unsigned char)(random() % 1000 < solid_per_mille ? 200 : random() % 100) };
+        }
+        return CollisionMask{ BitmapView{ pixels.data(), size }, 128 };
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 49 };
+    size_t failures = 0, hits = 0;
+    for (int round = 0; round < 4000; round++)
+    {
+        const Coord2 a_size{ 1 + random() % (round % 4 == 0 ? 450 : 90), 1 + random() % 12 };
+        const Coord2 b_size{ 1 + random() % (round % 3 == 0 ? 450 : 90), 1 + random() % 12 };
+        const CollisionMask a = random_mask(random, a_size, 1 + random() % 60);
+        const CollisionMask b = random_mask(random, b_size, 1 + random() % 60);
+        // Mostly placements whose rects intersect.
+        const Int2 a_position{ (int32_t)(random() % 64) - 32, (int32_t)(random() % 8) - 4 };
+        const Int2 b_position{ a_position.x() + (int32_t)(random() % (a_size.x() + b_size.x())) - (int32_t)b_size.x(), (int32_t)(random() % 8) - 4 };
+
+        const bool expected = brute_force(a, a_position, b, b_position);
+        hits += expected;
+        if (adttil::overlaps(a, a_position, b, b_position) != expected || adttil::overlaps(b, b_position, a, a_position) != expected)
+        {
+            std::println("FAILED: {}x{} at ({}, {}) against {}x{} at ({}, {}), expected {}", a_size.x(), a_size.y(), a_position.x(), a_position.y(),
+                b_size.x(), b_size.y(), b_position.x(), b_position.y(), expected);
+            ++failures;
+        }
+    }
+
+    // Rows taken back from words(), as from a cache, behave the same.
+    const CollisionMask mask = random_mask(random, Coord2{ 300uz, 5uz }, 30);
+    const CollisionMask copy{ mask.size(), mask.words() };
+    if (copy.solid_count() != mask.solid_count() || not adttil::overlaps(copy, Int2{ 0, 0 }, mask, Int2{ 0, 0 }) != (mask.solid_count() == 0))
+    {
+        std::println("FAILED: mask rebuilt from its words");
+        ++failures;
+    }
+
+    if (failures)
+    {
+        std::println("{} checks failed", failures);
+        return 1;
+    }
+    std::println("all collision mask checks passed ({} of 4000 placements overlap)", hits);
+}
@@ -0,0 +1,149 @@
+// Checks the Euclidean distance transform behind DistanceField against brute force: the 1D
+// pass on random samples, and whole fields at one texel per pixel, where every texel must
+// encode the naive signed distance of its pixel.
+#include <print>
+#include <vector>
+#include <random>
+#include <cmath>
+
+#include <renderer/distance_field.hpp>
+
+namespace
+{
+    using adttil::Color32;
+    using adttil::Coord2;
+    using adttil::BitmapView;
+    using adttil::DistanceField;
+
+    size_t failures = 0;
+
+    void check_1d(std::mt19937& random, size_t count)
+    {
+        std::vector<float> samples(count);
+        for (float& sample : samples)
+        {
+            sample = random() % 3 == 0 ? 0.0f : random() % 2 ? (float)(random() % 50) : adttil::detail::distance_infinity;
+        }
+        std::vector<float> transformed = samples;
+        adttil::detail::distance_transform_1d(transformed.data(), count, 1);
+        for (size_t q = 0; q < count; q++)
+        {
+            float expected = adttil::detail::distance_infinity;
+            for (size_t p = 0; p < count; p++)
+            {
+                const float offset = (float)q - (float)p;
+                expected = std::min(expected, offset * offset + samples[p]);
+            }
+            if (std::abs(transformed[q] - expected) > 1e-3f * std::max(expected, 1.0f))
+            {
+                std::println("FAILED: 1D transform of {} samples at {}: {} instead of {}", count, q, transformed[q], expected);
+                ++failures;
+                return;
+            }
+        }
+    }
+
+    void check_field(std::mt19937& random, Coord2 size, float spread)
+    {
+        std::vector<Color32> pixels(size.x() * size.y(), Color32{ 0, 0, 0, 0 });
+        const BitmapView bitmap{ pixels.data(), size };
+        // A few random discs, so there are curved edges, holes and separate islands.
+        for (int disc = 0; disc < 3; disc++)
+        {
+            const float cx = (float)(random() % size.x()), cy = (float)(random() % size.y()), radius = 1.0f + (float)(random() % 6);
+            for (size_t y = 0; y < size.y(); y++)
+            {
+                for (size_t x = 0; x < size.x(); x++)
+                {
+                    if (std::hypot((float)x - cx, (float)y - cy) <= radius)
+                    {
+                        bitmap[Coord2{ x, y }].a() = disc == 2 ? 0 : 255;
+                    }
+                }
+            }
+        }
+
+        const DistanceField field{ bitmap, 1, spread };
+        const size_t margin = DistanceField::margin(1, spread);
+        if (field.size() != Coord2{ size.x() + margin * 2, size.y() + margin * 2 })
+        {
+            std::println("FAILED: field size of a {}x{} sprite", size.x(), size.y());
+            ++failures;
+            return;
+        }
+        // Pixels of the grown rect past the sprite count as empty.
+        const auto solid = [&](int64_t x, int64_t y)
+        {
+            return x >= 0 && y >= 0 && x < (int64_t)size.x() && y < (int64_t)size.y() && bitmap[Coord2{ (size_t)x, (size_t)y }].a() >= 128;
+        };
+        const int64_t width = (int64_t)field.size().x(), height = (int64_t)field.size().y(), border = (int64_t)margin;
+        for (int64_t j = 0; j < height; j++)
+        {
+            for (int64_t i = 0; i < width; i++)
+            {
+                const bool inside = solid(i - border, j - border);
+                float nearest = adttil::detail::distance_infinity;
+                for (int64_t y = 0; y < height; y++)
+                {
+                    for (int64_t x = 0; x < width; x++)
+                    {
+                        if (solid(x - border, y - border) != inside)
+                        {
+                            nearest = std::min(nearest, std::hypot((float)(x - i), (float)(y - j)));
+                        }
+                    }
+                }
+                const float expected = inside ? 0.5f - nearest : nearest - 0.5f;
+                const auto encoded = (int)std::lround(std::clamp(127.5f - expected / spread * 127.5f, 0.0f, 255.0f));
+                const int texel = field.texels()[j * width + i];
+                if (std::abs(texel - encoded) > 1)
+                {
+                    std::println("FAILED: {}x{} sprite, spread {}, texel ({}, {}) is {} instead of {}", size.x(), size.y(), spread, i, j, texel, encoded);
+                    ++failures;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 50 };
+    for (size_t count : { 1uz, 2uz, 3uz, 7uz, 64uz, 257uz })
+    {
+        for (int round = 0; round < 20; round++)
+        {
+            check_1d(random, count);
+        }
+    }
+    for (int round = 0; round < 30; round++)
+    {
+        check_field(random, Coord2{ 1 + random() % 24, 1 + random() % 24 }, 1.0f + (float)(random() % 8));
+    }
+
+    // An empty sprite is far from everything; a bad spread is rejected.
+    std::vector<Color32> empty(16, Color32{ 0, 0, 0, 0 });
+    const DistanceField none{ BitmapView{ empty.data(), Coord2{ 4uz, 4uz } }, 1, 4.0f };
+    if (not std::ranges::all_of(none.texels(), [](uint8_t texel){ return texel == 0; }))
+    {
+        std::println("FAILED: field of an empty sprite");
+        ++failures;
+    }
+    try
+    {
+        DistanceField::check_spread(0.0f);
+        std::println("FAILED: a spread of 0 was accepted");
+        ++failures;
+    }
+    catch (const std::exception&)
+    {
+    }
+
+    if (failures)
+    {
+        std::println("{} checks failed", failures);
+        return 1;
+    }
+    std::println("all distance field checks passed");
+}
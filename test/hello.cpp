@@ -9,6 +9,48 @@ int main()
     
     auto& io = ImGui::GetIO();
 
+    auto& particles = renderer.particle_system();
+    const auto sparks = particles.create_emitter({});
+
+    auto& text = renderer.world_text();
+    // Damage numbers need a bold system font; without one they are left out.
+    bool has_font = false;
+    for (const char* font : { "C:/Windows/Fonts/arialbd.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans-Bold.ttf",
+        "/System/Library/Fonts/Supplemental/Arial Bold.ttf" })
+    {
+        if (not std::filesystem::exists(font))
+            continue;
+        try
+        {
+            text.load_font(font);
+            has_font = true;
+            break;
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+    struct DamageNumber { float x, y, age; int value; };
+    std::vector<DamageNumber> damage_numbers;
+
+    // Every sub folder of anims/ streams in while the loop below keeps rendering.
+    adttil::TaskScheduler scheduler;
+    const auto context = renderer.context();
+    // A set that failed keeps its message and stays listed in the loading window.
+    struct AnimLoad
+    {
+        std::string name;
+        adttil::TaskHandle<std::shared_ptr<adttil::AnimManager>> task;
+        std::shared_ptr<adttil::AnimManager> anim;
+        std::string error;
+    };
+    std::vector<AnimLoad> loads;
+    if (std::filesystem::is_directory("anims"))
+        for (auto& entry : std::filesystem::directory_iterator("anims"))
+            if (entry.is_directory())
+                loads.push_back({ entry.path().filename().string(), scheduler.spawn(
+                    adttil::AnimManager::load_async(scheduler, entry.path(), {}, &context, &renderer.submit_batcher()), adttil::TaskPriority::urgent) });
+
     bool show_another_window = true;
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
@@ -18,6 +60,70 @@ int main()
 
         renderer.new_frame();
 
+        // Uploads of finished loads, a few milliseconds per frame at most.
+        scheduler.run_render(std::chrono::milliseconds(4));
+        for (auto& load : loads)
+        {
+            if (not load.task.ready() || load.anim || not load.error.empty())
+                continue;
+            try
+            {
+                load.anim = load.task.get();
+            }
+            catch (const adttil::TaskCancelled&)
+            {
+                load.error = "cancelled";
+            }
+            catch (const std::exception& e)
+            {
+                load.error = std::format("failed: {}", e.what());
+            }
+        }
+        const auto loaded = std::ranges::count_if(loads, [](auto& load){ return load.task.ready(); });
+        const auto failed = std::ranges::count_if(loads, [](auto& load){ return not load.error.empty(); });
+        if (loaded < std::ssize(loads) || failed > 0)
+        {
+            ImGui::Begin("Loading");
+            ImGui::ProgressBar((float)loaded / loads.size());
+            for (auto& load : loads)
+                ImGui::Text("%s %s", load.name.c_str(), not load.error.empty() ? load.error.c_str() : load.task.ready() ? "done" :
+                    load.task.cancel_requested() ? "cancelling" : "loading");
+            if (loaded < std::ssize(loads) && ImGui::Button("Cancel"))
+                for (auto& load : loads)
+                    load.task.cancel();
+            ImGui::End();
+        }
+
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && not io.WantCaptureMouse)
+        {
+            particles.emit(sparks, { io.MousePos.x, io.MousePos.y }, 2000);
+            if (has_font)
+                damage_numbers.push_back({ io.MousePos.x, io.MousePos.y, 0.0f, 100 + (int)(damage_numbers.size() * 37 % 900) });
+        }
+
+        for (auto& number : damage_numbers)
+        {
+            number.age += io.DeltaTime;
+            const auto alpha = (unsigned char)(255 * std::clamp(1.5f - number.age, 0.0f, 1.0f));
+            text.draw(std::to_string(number.value), { number.x, number.y - number.age * 60.0f },
+                { .size = 32.0f, .color = { 255, 220, 80, alpha }, .outline_color = { 0, 0, 0, alpha } });
+        }
+        std::erase_if(damage_numbers, [](const DamageNumber& number){ return number.age > 1.5f; });
+
+        // Every loaded set plays its first clip along the bottom of the window, lit by the mouse.
+        renderer.lighting_system().add_light({ .position = { io.MousePos.x, io.MousePos.y }, .radius = 256.0f });
+        float sprite_x = 64.0f;
+        for (auto& load : loads)
+        {
+            if (not load.anim)
+                continue;
+            const auto& anim = *load.anim;
+            if (not anim.clips().empty())
+                renderer.sprite_batch().draw(anim, anim.frame_at(anim.clips()[0], (float)ImGui::GetTime()), { sprite_x, io.DisplaySize.y - 32.0f },
+                    { .lit = true });
+            sprite_x += 128.0f;
+        }
+
         {
             static float f = 0.0f;
             static int counter = 0;
@@ -37,6 +143,13 @@ int main()
         
             
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+
+            auto& capture = renderer.frame_capture();
+            if (ImGui::Button("Screenshot"))
+                capture.screenshot("screenshot.tga");
+            ImGui::SameLine();
+            if (ImGui::Button(capture.recording() ? "Stop recording" : "Record"))
+                capture.recording() ? capture.stop_recording() : capture.start_recording("capture.raw");
             ImGui::End();
         }
 
@@ -51,5 +164,10 @@ int main()
 
         // Rendering
         renderer.frame_render(clear_color);
+
+        // Staging buffers of finished uploads are freed once the frame is submitted.
+        for (auto& load : loads)
+            if (load.anim)
+                load.anim->sync_gpu();
     }
 }
\ No newline at end of file
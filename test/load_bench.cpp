@@ -0,0 +1,456 @@
+// Times AnimManager loads of synthetic PNG sets stage by stage and writes the percentiles as JSON.
+//
+//     load_bench [--iterations N] [--out load_bench.json] [--quick]
+//
+// Every set is generated into a temporary folder first. Each iteration loads it from scratch,
+// then prepares an upload by copying all pages into a staging sized buffer, then loads it again
+// from the cache it just wrote. Finally all sets are streamed through an AnimResidency whose
+// budget holds about two of the largest, switching set every frame, so sets keep being evicted
+// and loaded again from their caches.
+#include <print>
+#include <vector>
+#include <array>
+#include <string>
+#include <string_view>
+#include <span>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <numeric>
+#include <numbers>
+#include <thread>
+
+#include <renderer/anim_manager.hpp>
+#include <renderer/anim_residency.hpp>
+
+namespace
+{
+    namespace fs = std::filesystem;
+    using adttil::Color32;
+
+    // Minimal PNG writer: Sub filtered rows, deflated with fixed Huffman codes and greedy matches,
+    // so decoding exercises the same inflate paths as exported art.
+    class PngWriter
+    {
+    public:
+        static bool write(const fs::path& path, std::span<const Color32> pixels, size_t width, size_t height)
+        {
+            std::vector<uint8_t> raw;
+            raw.reserve((width * 4 + 1) * height);
+            for (size_t y = 0; y < height; y++)
+            {
+                const auto* row = (const uint8_t*)(pixels.data() + y * width);
+                raw.push_back(1);
+                for (size_t x = 0; x < width * 4; x++)
+                {
+                    raw.push_back((uint8_t)(row[x] - (x >= 4 ? row[x - 4] : 0)));
+                }
+            }
+
+            std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+            std::vector<uint8_t> header;
+            put_u32(header, (uint32_t)width);
+            put_u32(header, (uint32_t)height);
+            header.insert(header.end(), { 8, 6, 0, 0, 0 });
+            put_chunk(png, "IHDR", header);
+            put_chunk(png, "IDAT", zlib(raw));
+            put_chunk(png, "IEND", {});
+            std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+            file.write((const char*)png.data(), png.size());
+            return (bool)file;
+        }
+
+    private:
+        struct BitWriter
+        {
+            std::vector<uint8_t>& out;
+            uint32_t bits = 0;
+            int count = 0;
+
+            void put(uint32_t value, int length)
+            {
+                bits |= value << count;
+                count += length;
+                for (; count >= 8; count -= 8, bits >>= 8)
+                {
+                    out.push_back((uint8_t)bits);
+                }
+            }
+
+            // Huffman codes are stored from their most significant bit.
+            void put_code(uint32_t code, int length)
+            {
+                uint32_t reversed = 0;
+                for (int i = 0; i < length; i++)
+                {
+                    reversed |= (code >> i & 1) << (length - 1 - i);
+                }
+                put(reversed, length);
+            }
+
+            void flush()
+            {
+                if (count > 0)
+                {
+                    out.push_back((uint8_t)bits);
+                }
+                bits = 0;
+                count = 0;
+            }
+        };
+
+        static constexpr std::array<uint16_t, 29> length_base = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static constexpr std::array<uint8_t, 29> length_extra = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static constexpr std::array<uint16_t, 30> distance_base = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+            1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static constexpr std::array<uint8_t, 30> distance_extra = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        static void put_symbol(BitWriter& writer, uint32_t symbol)
+        {
+            if (symbol < 144)
+            {
+                writer.put_code(0x30 + symbol, 8);
+            }
+            else if (symbol < 256)
+            {
+                writer.put_code(0x190 + symbol - 144, 9);
+            }
+            else if (symbol < 280)
+            {
+                writer.put_code(symbol - 256, 7);
+            }
+            else
+            {
+                writer.put_code(0xc0 + symbol - 280, 8);
+            }
+        }
+
+        static void put_match(BitWriter& writer, size_t length, size_t distance)
+        {
+            const size_t l = std::ranges::upper_bound(length_base, length) - length_base.begin() - 1;
+            put_symbol(writer, 257 + (uint32_t)l);
+            writer.put((uint32_t)(length - length_base[l]), length_extra[l]);
+            const size_t d = std::ranges::upper_bound(distance_base, distance) - distance_base.begin() - 1;
+            writer.put_code((uint32_t)d, 5);
+            writer.put((uint32_t)(distance - distance_base[d]), distance_extra[d]);
+        }
+
+        static std::vector<uint8_t> zlib(std::span<const uint8_t> data)
+        {
+            std::vector<uint8_t> out = { 0x78, 0x01 };
+            BitWriter writer{ out };
+            writer.put(1, 1);
+            writer.put(1, 2);
+            constexpr size_t window = 32768, hash_size = 1 << 15;
+            std::vector<int64_t> head(hash_size, -1);
+            const auto hash = [&](size_t at){ return (data[at] * 506832829u ^ data[at + 1] * 2654435761u ^ data[at + 2]) & (hash_size - 1); };
+            size_t at = 0;
+            while (at < data.size())
+            {
+                size_t length = 0;
+                size_t distance = 0;
+                if (at + 3 <= data.size())
+                {
+                    const size_t key = hash(at);
+                    const int64_t candidate = std::exchange(head[key], (int64_t)at);
+                    if (candidate >= 0 && at - candidate <= window)
+                    {
+                        while (length < 258 && at + length < data.size() && data[candidate + length] == data[at + length])
+                        {
+                            length++;
+                        }
+                        distance = at - candidate;
+                    }
+                }
+                if (length >= 3)
+                {
+                    put_match(writer, length, distance);
+                    at += length;
+                }
+                else
+                {
+                    put_symbol(writer, data[at]);
+                    at++;
+                }
+            }
+            put_symbol(writer, 256);
+            writer.flush();
+
+            uint32_t a = 1, b = 0;
+            for (uint8_t value : data)
+            {
+                a = (a + value) % 65521;
+                b = (b + a) % 65521;
+            }
+            put_u32(out, b << 16 | a);
+            return out;
+        }
+
+        static void put_u32(std::vector<uint8_t>& out, uint32_t value)
+        {
+            out.insert(out.end(), { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value });
+        }
+
+        static void put_chunk(std::vector<uint8_t>& out, const char (&type)[5], std::span<const uint8_t> data)
+        {
+            put_u32(out, (uint32_t)data.size());
+            const size_t start = out.size();
+            out.insert(out.end(), type, type + 4);
+            out.insert(out.end(), data.begin(), data.end());
+            uint32_t crc = 0xffffffff;
+            for (size_t i = start; i < out.size(); i++)
+            {
+                crc ^= out[i];
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = crc >> 1 ^ (0xedb88320 & (0 - (crc & 1)));
+                }
+            }
+            put_u32(out, ~crc);
+        }
+    };
+
+    struct SetSpec
+    {
+        std::string_view name;
+        size_t           count;
+        size_t           width;
+        size_t           height;
+        // Share of each frame covered by the opaque body; the rest stays transparent.
+        double           coverage;
+        // Share of frames that repeat an earlier frame byte for byte.
+        double           duplicate_ratio;
+    };
+
+    // Clips of 8 frames. Each frame is an ellipse of the requested area with a gradient, noise and
+    // an anti-aliased edge, moving a little from frame to frame.
+    void generate_set(const fs::path& folder, const SetSpec& spec)
+    {
+        fs::create_directories(folder);
+        std::mt19937 random{ (uint32_t)spec.count * 7919u + (uint32_t)spec.width };
+        std::uniform_real_distribution<double> unit{ 0.0, 1.0 };
+        std::vector<std::vector<Color32>> written;
+        for (size_t i = 0; i < spec.count; i++)
+        {
+            std::vector<Color32> pixels;
+            if (not written.empty() && unit(random) < spec.duplicate_ratio)
+            {
+                pixels = written[random() % written.size()];
+            }
+            else
+            {
+                pixels.assign(spec.width * spec.height, Color32{ 0, 0, 0, 0 });
+                const double scale = std::sqrt(spec.coverage * 4.0 / std::numbers::pi);
+                const double rx = spec.width * 0.5 * scale, ry = spec.height * 0.5 * scale;
+                const double cx = spec.width * 0.5 + (unit(random) - 0.5) * (spec.width - 2 * std::min(rx, spec.width * 0.5)),
+                             cy = spec.height * 0.5 + (unit(random) - 0.5) * (spec.height - 2 * std::min(ry, spec.height * 0.5));
+                const auto hue = (unsigned char)(random() % 256);
+                for (size_t y = 0; y < spec.height; y++)
+                {
+                    for (size_t x = 0; x < spec.width; x++)
+                    {
+                        const double dx = (x + 0.5 - cx) / rx, dy = (y + 0.5 - cy) / ry;
+                        const double edge = (1.0 - std::sqrt(dx * dx + dy * dy)) * std::min(rx, ry);
+                        if (edge <= 0.0)
+                        {
+                            continue;
+                        }
+                        const auto noise = (unsigned char)(random() % 24);
+                        pixels[y * spec.width + x] = Color32{
+                            (unsigned char)(hue + x * 255 / spec.width / 2 + noise),
+                            (unsigned char)(255 - hue + y * 255 / spec.height / 2),
+                            (unsigned char)(noise * 4),
+                            (unsigned char)std::lround(std::min(edge, 1.0) * 255.0),
+                        };
+                    }
+                }
+            }
+            PngWriter::write(folder / std::format("body{}_{:03}.png", i / 8, i % 8), pixels, spec.width, spec.height);
+            written.push_back(std::move(pixels));
+        }
+    }
+
+    struct Stats
+    {
+        double min = 0, p50 = 0, p90 = 0, p99 = 0, max = 0, mean = 0;
+    };
+
+    // Nearest rank percentiles, in milliseconds.
+    Stats summarize(std::vector<double> samples)
+    {
+        std::ranges::sort(samples);
+        const auto rank = [&](double p){ return samples[(size_t)std::max(std::ceil(p * samples.size()) - 1.0, 0.0)]; };
+        return { samples.front(), rank(0.5), rank(0.9), rank(0.99), samples.back(),
+            std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size() };
+    }
+
+    double milliseconds(std::chrono::nanoseconds duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    // upload_prep is not the AtlasTexture staging path, which needs a device, but a plain copy of
+    // the same bytes standing in for it.
+    constexpr std::array<std::string_view, 8> stage_names = { "probe", "read", "pack", "decode", "copy", "save", "simulated_upload_prep", "cached_load" };
+}
+
+int main(int argc, char** argv)
+{
+    size_t iterations = 10;
+    fs::path output = "load_bench.json";
+    bool quick = false;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc)
+            iterations = std::max(std::stoul(argv[++i]), 1ul);
+        else if (arg == "--out" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "--quick")
+            quick = true;
+        else
+        {
+            std::println("usage: load_bench [--iterations N] [--out load_bench.json] [--quick]");
+            return 1;
+        }
+    }
+
+    const std::vector<SetSpec> specs = quick
+        ? std::vector<SetSpec>{ { "small", 32, 48, 48, 0.5, 0.0 } }
+        : std::vector<SetSpec>{
+            { "small",      64,   48,  48, 0.5, 0.0 },
+            { "many_tiny",  512,  32,  32, 0.6, 0.1 },
+            { "large",      32,  256, 256, 0.6, 0.0 },
+            { "sparse",     128, 128, 128, 0.1, 0.0 },
+            { "dense",      128, 128, 128, 1.0, 0.0 },
+            { "duplicates", 128,  96,  96, 0.5, 0.5 },
+        };
+
+    const fs::path root = fs::temp_directory_path() / "adttil_load_bench";
+    fs::remove_all(root);
+    adttil::WorkerPool& pool = adttil::WorkerPool::shared();
+    std::string json = std::format("{{\n  \"iterations\": {},\n  \"threads\": {},\n  \"sets\": [", iterations, pool.thread_count() + 1);
+    adttil::AnimBudget budget{ 0, 0 };
+    for (size_t s = 0; s < specs.size(); s++)
+    {
+        const SetSpec& spec = specs[s];
+        const fs::path folder = root / spec.name;
+        generate_set(folder, spec);
+
+        std::array<std::vector<double>, stage_names.size()> samples;
+        size_t atlas_bytes = 0, page_count = 0, frame_count = 0;
+        double efficiency = 0.0;
+        std::vector<std::byte> staging;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            fs::remove(folder / "atlas.cache");
+            const adttil::AnimManager anim{ folder.string().c_str(), {}, pool };
+            const adttil::AnimManager::LoadTimings& timings = anim.load_timings();
+            for (size_t stage = 0; const std::chrono::nanoseconds duration : { timings.probe, timings.read, timings.pack, timings.decode, timings.copy, timings.save })
+            {
+                samples[stage++].push_back(milliseconds(duration));
+            }
+
+            // What AtlasTexture does before recording the copy: every level of every page into
+            // one staging buffer.
+            staging.resize(anim.atlas_bytes());
+            auto start = std::chrono::steady_clock::now();
+            size_t offset = 0;
+            for (size_t level = 0; level < anim.mip_levels(); level++)
+            {
+                for (size_t layer = 0; layer < anim.page_count(); layer++)
+                {
+                    const adttil::BitmapView page = anim.page(layer, level);
+                    const size_t bytes = page.width() * page.height() * sizeof(Color32);
+                    std::memcpy(staging.data() + offset, &page[adttil::Coord2{ 0uz, 0uz }], bytes);
+                    offset += bytes;
+                }
+            }
+            samples[6].push_back(milliseconds(std::chrono::steady_clock::now() - start));
+
+            start = std::chrono::steady_clock::now();
+            const adttil::AnimManager cached{ folder.string().c_str(), {}, pool };
+            samples[7].push_back(milliseconds(std::chrono::steady_clock::now() - start));
+            budget.cpu_bytes = std::max(budget.cpu_bytes, cached.memory_bytes() * 2);
+            budget.gpu_bytes = std::max(budget.gpu_bytes, cached.gpu_bytes() * 2);
+
+            atlas_bytes = anim.atlas_bytes();
+            page_count = anim.page_count();
+            frame_count = anim.frames().size();
+            efficiency = anim.efficiency();
+        }
+
+        std::println("{}: {} frames {}x{}, coverage {:.0f}%, {:.0f}% duplicates -> {} pages, {:.1f} MiB",
+            spec.name, spec.count, spec.width, spec.height, spec.coverage * 100, spec.duplicate_ratio * 100, page_count, atlas_bytes / 1048576.0);
+        json += std::format("{}\n    {{\n      \"name\": \"{}\",\n      \"frames\": {},\n      \"width\": {},\n      \"height\": {},\n"
+                            "      \"coverage\": {},\n      \"duplicate_ratio\": {},\n      \"loaded_frames\": {},\n      \"pages\": {},\n"
+                            "      \"atlas_bytes\": {},\n      \"efficiency\": {:.4f},\n      \"stages_ms\": {{",
+            s ? "," : "", spec.name, spec.count, spec.width, spec.height, spec.coverage, spec.duplicate_ratio, frame_count, page_count, atlas_bytes, efficiency);
+        for (size_t stage = 0; stage < stage_names.size(); stage++)
+        {
+            const Stats stats = summarize(samples[stage]);
+            std::println("  {:<22} p50 {:9.3f}  p90 {:9.3f}  p99 {:9.3f}  max {:9.3f} ms", stage_names[stage], stats.p50, stats.p90, stats.p99, stats.max);
+            json += std::format("{}\n        \"{}\": {{ \"min\": {:.4f}, \"p50\": {:.4f}, \"p90\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f}, \"mean\": {:.4f} }}",
+                stage ? "," : "", stage_names[stage], stats.min, stats.p50, stats.p90, stats.p99, stats.max, stats.mean);
+        }
+        json += "\n      }\n    }";
+    }
+    json += "\n  ]";
+
+    {
+        adttil::AnimResidency residency{ root, budget, {}, pool };
+        size_t evictions = 0, failures = 0, peak_cpu_bytes = 0, peak_gpu_bytes = 0;
+        residency.set_evict_callback([&](adttil::AnimResidency::SetId){ ++evictions; });
+        std::vector<double> switches;
+        uint64_t frame = 0;
+        for (size_t iteration = 0; iteration < iterations; iteration++)
+        {
+            for (const SetSpec& spec : specs)
+            {
+                const adttil::AnimResidency::SetId id = *residency.find_set(spec.name);
+                const auto start = std::chrono::steady_clock::now();
+                ++frame;
+                while (not residency.acquire(id, frame))
+                {
+                    residency.update(frame);
+                    if (not residency.error(id).empty())
+                    {
+                        std::println("{}: {}", spec.name, residency.error(id));
+                        residency.retry(id);
+                        ++failures;
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+                residency.update(frame);
+                switches.push_back(milliseconds(std::chrono::steady_clock::now() - start));
+                peak_cpu_bytes = std::max(peak_cpu_bytes, residency.cpu_bytes());
+                peak_gpu_bytes = std::max(peak_gpu_bytes, residency.gpu_bytes());
+            }
+        }
+        const Stats stats = summarize(std::move(switches));
+        std::println("residency: budget {:.1f} MiB cpu / {:.1f} MiB gpu, peak {:.1f} / {:.1f} MiB, {} evictions, {} failed",
+            budget.cpu_bytes / 1048576.0, budget.gpu_bytes / 1048576.0, peak_cpu_bytes / 1048576.0, peak_gpu_bytes / 1048576.0, evictions, failures);
+        std::println("  {:<22} p50 {:9.3f}  p90 {:9.3f}  p99 {:9.3f}  max {:9.3f} ms", "switch", stats.p50, stats.p90, stats.p99, stats.max);
+        json += std::format(",\n  \"residency\": {{\n    \"cpu_budget\": {},\n    \"gpu_budget\": {},\n    \"peak_cpu_bytes\": {},\n"
+                            "    \"peak_gpu_bytes\": {},\n    \"evictions\": {},\n    \"failures\": {},\n"
+                            "    \"switch_ms\": {{ \"min\": {:.4f}, \"p50\": {:.4f}, \"p90\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f}, \"mean\": {:.4f} }}\n  }}",
+            budget.cpu_bytes, budget.gpu_bytes, peak_cpu_bytes, peak_gpu_bytes, evictions, failures,
+            stats.min, stats.p50, stats.p90, stats.p99, stats.max, stats.mean);
+    }
+    json += "\n}\n";
+    fs::remove_all(root);
+
+    std::ofstream file{ output, std::ios::trunc };
+    file << json;
+    if (not file)
+    {
+        std::println("failed to write {}", output.string());
+        return 1;
+    }
+    std::println("results written to {}", output.string());
+}
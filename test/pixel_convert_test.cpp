@@ -0,0 +1,197 @@
+// Checks convert_pixels() against per pixel float references: sRGB premultiplication rounds
+// c * a / 255 exactly for every colour and alpha, linear premultiplication stays within one step
+// of premultiplying in linear light, and the SSE2 rows match the scalar tail bit for bit. Then
+// checks that preserve_alpha_coverage() restores coverage and keeps premultiplied colour in
+// proportion to alpha.
+#include <print>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstring>
+
+#include <renderer/pixel_convert.hpp>
+
+namespace
+{
+    using adttil::Color32;
+    using adttil::Coord2;
+    using adttil::BitmapView;
+    using adttil::BitmapRect;
+    using adttil::PixelEncoding;
+
+    size_t failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (not condition)
+        {
+            std::println("FAILED: {}", what);
+            ++failures;
+        }
+    }
+
+    float srgb_to_linear(int value)
+    {
+        const float x = (float)value / 255.0f;
+        return x <= 0.04045f ? x / 12.92f : std::pow((x + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float linear_to_srgb(float value)
+    {
+        return 255.0f * (value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f);
+    }
+
+    // Every colour channel value against every alpha, on rows whose width leaves an SSE2 tail.
+    std::vector<Color32> all_pairs(size_t& width)
+    {
+        width = 263;
+        std::vector<Color32> pixels;
+        for (int alpha = 0; alpha < 256; alpha++)
+        {
+            for (int value = 0; value < 256; value++)
+            {
+                pixels.push_back(Color32{ (unsigned char)value, (unsigned char)(255 - value), (unsigned char)(value * 7), (unsigned char)alpha });
+            }
+        }
+        pixels.resize((pixels.size() + width - 1) / width * width, Color32{ 0, 0, 0, 0 });
+        return pixels;
+    }
+
+    // Alpha of a soft disc with a few colours, as a sprite edge would have.
+    std::vector<Color32> soft_disc(Coord2 size, std::mt19937& random)
+    {
+        std::vector<Color32> pixels(size.x() * size.y());
+        for (size_t y = 0; y < size.y(); y++)
+        {
+            for (size_t x = 0; x < size.x(); x++)
+            {
+                const float distance = std::hypot((float)x - (float)size.x() / 2, (float)y - (float)size.y() / 2) / ((float)size.x() / 2);
+                const auto alpha = (unsigned char)std::clamp(std::lround((1.0f - distance) * 300.0f), 0l, 255l);
+                pixels[y * size.x() + x] = Color32{ (unsigned char)random(), (unsigned char)random(), (unsigned char)random(), alpha };
+            }
+        }
+        return pixels;
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 42 };
+
+    // Straight alpha targets are left as decoded.
+    size_t width;
+    std::vector<Color32> pixels = all_pairs(width);
+    const std::vector<Color32> source = pixels;
+    const Coord2 size{ width, pixels.size() / width };
+    adttil::convert_pixels(BitmapView{ pixels.data(), size }, PixelEncoding{});
+    adttil::convert_pixels(BitmapView{ pixels.data(), size }, PixelEncoding{ false, true });
+    check(std::memcmp(pixels.data(), source.data(), pixels.size() * sizeof(Color32)) == 0, "straight alpha is not converted");
+
+    adttil::convert_pixels(BitmapView{ pixels.data(), size }, PixelEncoding{ true, false });
+    bool exact = true;
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            exact = exact && pixels[i][c] == std::lround(source[i][c] * source[i].a() / 255.0);
+        }
+        exact = exact && pixels[i].a() == source[i].a();
+    }
+    check(exact, "sRGB premultiplication rounds c * a / 255");
+
+    pixels = source;
+    adttil::convert_pixels(BitmapView{ pixels.data(), size }, PixelEncoding{ true, true });
+    int worst = 0;
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            const float expected = linear_to_srgb(srgb_to_linear(source[i][c]) * source[i].a() / 255.0f);
+            worst = std::max(worst, (int)std::ceil(std::abs(pixels[i][c] - expected) - 0.5f));
+        }
+        check(pixels[i].a() == source[i].a(), "linear premultiplication keeps alpha");
+    }
+    if (worst > 1)
+    {
+        std::println("FAILED: linear premultiplication is {} steps off premultiplying in linear light", worst);
+        ++failures;
+    }
+
+    // One pixel at a time always takes the scalar tail.
+    std::vector<Color32> scalar = source;
+    for (Color32& pixel : scalar)
+    {
+        adttil::detail::premultiply_linear_row(&pixel, 1);
+    }
+    check(std::memcmp(pixels.data(), scalar.data(), pixels.size() * sizeof(Color32)) == 0, "linear rows match the scalar tail");
+    scalar = source;
+    for (Color32& pixel : scalar)
+    {
+        adttil::detail::premultiply_row(&pixel, 1);
+    }
+    pixels = source;
+    adttil::convert_pixels(BitmapView{ pixels.data(), size }, PixelEncoding{ true, false });
+    check(std::memcmp(pixels.data(), scalar.data(), pixels.size() * sizeof(Color32)) == 0, "sRGB rows match the scalar tail");
+
+    // Coverage counts texels at or past the reference.
+    std::vector<Color32> steps = { { 0, 0, 0, 0 }, { 0, 0, 0, 64 }, { 0, 0, 0, 128 }, { 0, 0, 0, 255 } };
+    const BitmapView step_view{ steps.data(), Coord2{ 4uz, 1uz } };
+    const BitmapRect step_rect{ Coord2{ 0uz, 0uz }, Coord2{ 4uz, 1uz } };
+    check(adttil::alpha_coverage(step_view, step_rect, 0.5f) == 0.5f, "coverage at 0.5");
+    check(adttil::alpha_coverage(step_view, step_rect, 0.5f, 2.0f) == 0.75f, "coverage of scaled alpha");
+    check(adttil::alpha_coverage(step_view, BitmapRect{ Coord2{ 0uz, 0uz }, Coord2{ 0uz, 0uz } }, 0.5f) == 0.0f, "coverage of an empty rect");
+
+    // A mip with thinned out alpha gets back the coverage of its base, and premultiplied colour
+    // follows alpha in the space it was premultiplied in.
+    for (PixelEncoding encoding : { PixelEncoding{ false, false }, PixelEncoding{ true, false }, PixelEncoding{ true, true } })
+    {
+        const Coord2 disc_size{ 24uz, 24uz };
+        std::vector<Color32> disc = soft_disc(disc_size, random);
+        adttil::convert_pixels(BitmapView{ disc.data(), disc_size }, encoding);
+        const BitmapRect rect{ Coord2{ 0uz, 0uz }, disc_size };
+        const float coverage = adttil::alpha_coverage(BitmapView{ disc.data(), disc_size }, rect, 0.5f);
+        for (Color32& pixel : disc)
+        {
+            pixel.a() = (unsigned char)(pixel.a() * 3 / 5);
+            for (int c = 0; c < 3 && encoding.premultiplied; c++)
+            {
+                pixel[c] = encoding.linear ? (unsigned char)std::lround(linear_to_srgb(srgb_to_linear(pixel[c]) * 0.6f)) : (unsigned char)(pixel[c] * 3 / 5);
+            }
+        }
+        const std::vector<Color32> thinned = disc;
+        adttil::preserve_alpha_coverage(BitmapView{ disc.data(), disc_size }, rect, coverage, 0.5f, encoding);
+        const float restored = adttil::alpha_coverage(BitmapView{ disc.data(), disc_size }, rect, 0.5f);
+        if (restored < coverage || restored > coverage + 4.0f / (float)(disc_size.x() * disc_size.y()))
+        {
+            std::println("FAILED: coverage {} restored to {}", coverage, restored);
+            ++failures;
+        }
+        int colour_error = 0;
+        for (size_t i = 0; i < disc.size(); i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                int expected = thinned[i][c];
+                if (encoding.premultiplied && thinned[i].a())
+                {
+                    const float ratio = (float)disc[i].a() / thinned[i].a();
+                    expected = (int)std::lround(encoding.linear ? linear_to_srgb(std::min(srgb_to_linear(thinned[i][c]) * ratio, 1.0f))
+                        : std::min(thinned[i][c] * ratio, 255.0f));
+                }
+                colour_error = std::max(colour_error, std::abs(disc[i][c] - expected));
+            }
+        }
+        if (colour_error > 1)
+        {
+            std::println("FAILED: colour is {} steps off alpha after restoring coverage (premultiplied {}, linear {})", colour_error, encoding.premultiplied, encoding.linear);
+            ++failures;
+        }
+    }
+
+    if (failures)
+    {
+        std::println("{} checks failed", failures);
+        return 1;
+    }
+    std::println("all pixel conversion checks passed");
+}
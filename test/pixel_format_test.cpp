@@ -0,0 +1,181 @@
+// Checks the compact clip formats: 565 and 4444 texels round trip within half a quantization
+// step, the palette keeps index 0 transparent and finds exact and nearest entries, and
+// choose_format() and fits_format() pick the narrowest format that holds the content within
+// the tolerance.
+#include <print>
+#include <vector>
+#include <span>
+#include <random>
+
+#include <renderer/pixel_format.hpp>
+
+namespace
+{
+    using adttil::Color32;
+    using adttil::Coord2;
+    using adttil::BitmapView;
+    using adttil::BitmapRect;
+    using adttil::PixelEncoding;
+    using adttil::PixelFormat;
+    using adttil::Palette;
+
+    size_t failures = 0;
+
+    void check(bool condition, const char* what)
+    {
+        if (not condition)
+        {
+            std::println("FAILED: {}", what);
+            ++failures;
+        }
+    }
+
+    Color32 random_color(std::mt19937& random)
+    {
+        return Color32{ (unsigned char)random(), (unsigned char)random(), (unsigned char)random(), (unsigned char)random() };
+    }
+
+    // Largest channel error after a round trip through `format`.
+    int round_trip_error(Color32 color, PixelFormat format)
+    {
+        std::byte texel[sizeof(Color32)];
+        adttil::encode_pixel(format, color, texel);
+        const Color32 decoded = adttil::decode_pixel(format, texel);
+        int error = 0;
+        for (int c = 0; c < 4; c++)
+        {
+            error = std::max(error, std::abs(color[c] - decoded[c]));
+        }
+        return error;
+    }
+
+    PixelFormat choose(std::vector<Color32>& pixels, PixelEncoding encoding = {}, int tolerance = 0)
+    {
+        const BitmapView frames[] = { BitmapView{ pixels.data(), Coord2{ pixels.size(), 1uz } } };
+        return adttil::choose_format(frames, encoding, tolerance).format;
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 43 };
+
+    check(adttil::pixel_bytes(PixelFormat::rgba8) == 4 && adttil::pixel_bytes(PixelFormat::rgb565) == 2 && adttil::pixel_bytes(PixelFormat::palette8) == 1, "texel sizes");
+    check(adttil::format_size(Coord2{ 3uz, 5uz }, PixelFormat::rgba4444) == 30, "format size");
+
+    // Every value of a channel lands within half a step of its nearest quantized value.
+    int error_4444 = 0, error_565 = 0, error_rgba8 = 0;
+    for (int value = 0; value < 256; value++)
+    {
+        const auto v = (unsigned char)value;
+        error_4444 = std::max(error_4444, round_trip_error(Color32{ v, v, v, v }, PixelFormat::rgba4444));
+        error_565 = std::max(error_565, round_trip_error(Color32{ v, v, v, 255 }, PixelFormat::rgb565));
+        error_rgba8 = std::max(error_rgba8, round_trip_error(Color32{ v, (unsigned char)(255 - v), v, (unsigned char)(v / 2) }, PixelFormat::rgba8));
+    }
+    check(error_4444 <= 9 && error_565 <= 5 && error_rgba8 == 0, "round trip within half a quantization step");
+    const Color32 orange{ 255, 136, 0, 255 };
+    std::byte packed[2];
+    adttil::encode_pixel(PixelFormat::rgba4444, orange, packed);
+    check(adttil::decode_pixel(PixelFormat::rgba4444, packed) == orange, "4444 values on the grid are exact");
+
+    // r8 is the alpha of a white sprite, white stored premultiplied when the encoding is.
+    std::byte alpha{ 128 };
+    check(adttil::decode_pixel(PixelFormat::r8, &alpha) == Color32{ 255, 255, 255, 128 }, "r8 straight");
+    check(adttil::decode_pixel(PixelFormat::r8, &alpha, PixelEncoding{ true, false }) == Color32{ 128, 128, 128, 128 }, "r8 premultiplied");
+    const Color32 linear_white = adttil::decode_pixel(PixelFormat::r8, &alpha, PixelEncoding{ true, true });
+    check(linear_white.r() > 128 && linear_white.a() == 128, "r8 premultiplied in linear light encodes brighter");
+
+    // Index 0 is transparent black and takes every invisible texel; the rest come in order.
+    Palette palette;
+    check(palette.size() == 1 && palette.colors()[0] == Color32{ 0, 0, 0, 0 }, "new palette");
+    check(palette.add(Color32{ 9, 9, 9, 0 }) && palette.size() == 1, "invisible colours share index 0");
+    check(palette.add(Color32{ 10, 20, 30, 255 }) && palette.add(Color32{ 200, 0, 0, 128 }) && palette.size() == 3, "colours added");
+    check(palette.index(Color32{ 200, 0, 0, 128 }) == 2 && palette.index(Color32{ 1, 2, 3, 0 }) == 0, "exact index");
+    check(palette.index(Color32{ 12, 18, 30, 250 }) == 1, "nearest index of a missing colour");
+    check(palette.contains(Color32{ 10, 20, 30, 255 }) && not palette.contains(Color32{ 10, 20, 31, 255 }), "contains");
+    for (int i = 0; i < 300; i++)
+    {
+        palette.add(Color32{ (unsigned char)i, (unsigned char)(i >> 8), 77, 255 });
+    }
+    check(palette.size() == Palette::max_colors && not palette.add(Color32{ 1, 1, 1, 1 }), "a full palette refuses new colours");
+
+    const Color32 swapped[] = { Color32{ 0, 0, 0, 0 }, Color32{ 1, 2, 3, 4 } };
+    palette.assign(swapped);
+    check(palette.size() == 2 && palette.index(Color32{ 1, 2, 3, 4 }) == 1, "assigned palette");
+    std::byte index{ 1 };
+    check(adttil::decode_pixel(PixelFormat::palette8, &index, {}, &palette) == Color32{ 1, 2, 3, 4 }, "palette texel");
+    index = std::byte{ 5 };
+    check(adttil::decode_pixel(PixelFormat::palette8, &index, {}, &palette) == Color32{ 0, 0, 0, 0 }, "index past the palette is transparent");
+
+    // The narrowest format that holds the content.
+    std::vector<Color32> mask(64);
+    for (Color32& pixel : mask)
+    {
+        pixel = Color32{ 255, 255, 255, (unsigned char)random() };
+    }
+    check(choose(mask) == PixelFormat::r8, "white sprite is r8");
+    for (Color32& pixel : mask)
+    {
+        pixel.r() = pixel.g() = pixel.b() = pixel.a();
+    }
+    check(choose(mask, PixelEncoding{ true, false }) == PixelFormat::r8 && choose(mask) != PixelFormat::r8, "premultiplied white sprite is r8");
+
+    std::vector<Color32> few(500);
+    for (Color32& pixel : few)
+    {
+        pixel = random() % 4 ? Color32{ (unsigned char)(random() % 40 * 5), 17, 99, 255 } : Color32{ (unsigned char)random(), 0, 0, 0 };
+    }
+    check(choose(few) == PixelFormat::palette8, "few colours are palette8");
+
+    std::vector<Color32> opaque(1000);
+    for (Color32& pixel : opaque)
+    {
+        pixel = random_color(random);
+        pixel.a() = 255;
+    }
+    check(choose(opaque) == PixelFormat::rgba8, "exact opaque content stays rgba8");
+    check(choose(opaque, {}, 5) == PixelFormat::rgb565, "opaque content within the tolerance is rgb565");
+    check(choose(opaque, PixelEncoding{ true, true }, 5) == PixelFormat::rgba8, "linear encodings skip the 16-bit formats");
+
+    std::vector<Color32> translucent(1000);
+    for (Color32& pixel : translucent)
+    {
+        pixel = random_color(random);
+    }
+    check(choose(translucent, {}, 5) == PixelFormat::rgba8, "translucent content past the 4444 step stays rgba8");
+    check(choose(translucent, {}, 9) == PixelFormat::rgba4444, "translucent content within the 4444 step is rgba4444");
+
+    // A later frame joins a clip only if its format and palette hold it.
+    const BitmapView opaque_frame{ opaque.data(), Coord2{ opaque.size(), 1uz } };
+    check(adttil::fits_format(opaque_frame, PixelFormat::rgb565, {}, 5), "opaque frame fits rgb565");
+    check(not adttil::fits_format(opaque_frame, PixelFormat::rgb565, {}, 2), "opaque frame past the tolerance");
+    const BitmapView few_frame{ few.data(), Coord2{ few.size(), 1uz } };
+    const adttil::FormatChoice choice = adttil::choose_format(std::span{ &few_frame, 1uz }, PixelEncoding{});
+    check(choice.format == PixelFormat::palette8, "palette choice");
+    check(adttil::fits_format(few_frame, PixelFormat::palette8, {}, 0, &choice.palette), "frame of the palette fits");
+    check(not adttil::fits_format(opaque_frame, PixelFormat::palette8, {}, 255, &choice.palette), "colours missing from the palette do not fit");
+
+    // encode_rect writes only the texels of its rect.
+    std::vector<Color32> page(8 * 4, Color32{ 255, 0, 0, 255 });
+    std::vector<std::byte> out(adttil::format_size(Coord2{ 8uz, 4uz }, PixelFormat::rgb565), std::byte{ 0 });
+    adttil::encode_rect(BitmapView{ page.data(), Coord2{ 8uz, 4uz } }, BitmapRect{ Coord2{ 2uz, 1uz }, Coord2{ 3uz, 2uz } }, PixelFormat::rgb565, out);
+    size_t written = 0;
+    for (size_t y = 0; y < 4; y++)
+    {
+        for (size_t x = 0; x < 8; x++)
+        {
+            const bool inside = x >= 2 && x < 5 && y >= 1 && y < 3;
+            const bool red = adttil::decode_pixel(PixelFormat::rgb565, &out[(y * 8 + x) * 2]) == Color32{ 255, 0, 0, 255 };
+            written += red;
+            check(inside == red, "encode_rect texel");
+        }
+    }
+    check(written == 6, "encode_rect count");
+
+    if (failures)
+    {
+        std::println("{} checks failed", failures);
+        return 1;
+    }
+    std::println("all pixel format checks passed");
+}
@@ -0,0 +1,283 @@
+// Decodes small generated PNGs with PngDecoder and checks them against the source pixels and
+// against stb_image: every colour type, every row filter, split IDAT chunks, tRNS
+// transparency, alpha bounds and crop().
+#include <print>
+#include <vector>
+#include <span>
+#include <random>
+#include <cstring>
+
+#include <renderer/png_decoder.hpp>
+
+namespace
+{
+    using adttil::Color32;
+    using adttil::Coord2;
+    using adttil::BitmapView;
+    using adttil::BitmapRect;
+    using adttil::PngDecoder;
+
+    int failures = 0;
+
+    void check(bool condition, const char* what, const char* image)
+    {
+        if (not condition)
+        {
+            std::println("FAILED: {} ({})", what, image);
+            ++failures;
+        }
+    }
+
+    void put_u32(std::vector<std::byte>& out, uint32_t value)
+    {
+        for (int shift : { 24, 16, 8, 0 })
+        {
+            out.push_back((std::byte)(value >> shift));
+        }
+    }
+
+    void put_chunk(std::vector<std::byte>& out, const char (&type)[5], std::span<const std::byte> data)
+    {
+        put_u32(out, (uint32_t)data.size());
+        const size_t start = out.size();
+        for (int i = 0; i < 4; i++)
+        {
+            out.push_back((std::byte)type[i]);
+        }
+        out.insert(out.end(), data.begin(), data.end());
+        uint32_t crc = 0xffffffff;
+        for (size_t i = start; i < out.size(); i++)
+        {
+            crc ^= (uint8_t)out[i];
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = crc >> 1 ^ (0xedb88320 & (0 - (crc & 1)));
+            }
+        }
+        put_u32(out, ~crc);
+    }
+
+    // zlib stream of stored blocks: no compression, so the test does not depend on a deflater.
+    std::vector<std::byte> zlib_stored(std::span<const uint8_t> data)
+    {
+        std::vector<std::byte> out = { std::byte{ 0x78 }, std::byte{ 0x01 } };
+        size_t at = 0;
+        do
+        {
+            const size_t length = std::min<size_t>(data.size() - at, 65535);
+            out.push_back((std::byte)(at + length == data.size()));
+            out.push_back((std::byte)(length & 0xff));
+            out.push_back((std::byte)(length >> 8));
+            out.push_back((std::byte)(~length & 0xff));
+            out.push_back((std::byte)(~length >> 8 & 0xff));
+            for (size_t i = 0; i < length; i++)
+            {
+                out.push_back((std::byte)data[at + i]);
+            }
+            at += length;
+        } while (at < data.size());
+        uint32_t a = 1, b = 0;
+        for (uint8_t value : data)
+        {
+            a = (a + value) % 65521;
+            b = (b + a) % 65521;
+        }
+        put_u32(out, b << 16 | a);
+        return out;
+    }
+
+    uint8_t paeth(int left, int up, int up_left)
+    {
+        const int estimate = left + up - up_left;
+        const int distance_left = std::abs(estimate - left), distance_up = std::abs(estimate - up), distance_up_left = std::abs(estimate - up_left);
+        return (uint8_t)(distance_left <= distance_up && distance_left <= distance_up_left ? left : distance_up <= distance_up_left ? up : up_left);
+    }
+
+    struct PngSpec
+    {
+        uint8_t color_type;
+        size_t  channels;
+        size_t  width;
+        size_t  height;
+        // Raw samples, `channels` per pixel.
+        std::vector<uint8_t>  samples;
+        std::vector<uint8_t>  palette;
+        std::vector<uint8_t>  transparency;
+        size_t                idat_chunks = 1;
+        uint8_t               bit_depth = 8;
+    };
+
+    // Row y uses filter y % 5, so every filter is reversed somewhere.
+    std::vector<std::byte> encode_png(const PngSpec& spec)
+    {
+        const size_t row_bytes = spec.width * spec.channels;
+        std::vector<uint8_t> filtered;
+        for (size_t y = 0; y < spec.height; y++)
+        {
+            const uint8_t filter = (uint8_t)(y % 5);
+            filtered.push_back(filter);
+            const uint8_t* row = spec.samples.data() + y * row_bytes;
+            const uint8_t* previous = y ? row - row_bytes : nullptr;
+            for (size_t i = 0; i < row_bytes; i++)
+            {
+                const int left = i >= spec.channels ? row[i - spec.channels] : 0;
+                const int up = previous ? previous[i] : 0;
+                const int up_left = previous && i >= spec.channels ? previous[i - spec.channels] : 0;
+                const int predicted = filter == 1 ? left : filter == 2 ? up : filter == 3 ? (left + up) / 2 : filter == 4 ? paeth(left, up, up_left) : 0;
+                filtered.push_back((uint8_t)(row[i] - predicted));
+            }
+        }
+
+        std::vector<std::byte> png;
+        for (int value : { 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a })
+        {
+            png.push_back((std::byte)value);
+        }
+        std::vector<std::byte> header;
+        put_u32(header, (uint32_t)spec.width);
+        put_u32(header, (uint32_t)spec.height);
+        for (uint8_t value : { spec.bit_depth, spec.color_type, (uint8_t)0, (uint8_t)0, (uint8_t)0 })
+        {
+            header.push_back((std::byte)value);
+        }
+        put_chunk(png, "IHDR", header);
+        if (not spec.palette.empty())
+        {
+            put_chunk(png, "PLTE", std::as_bytes(std::span{ spec.palette }));
+        }
+        if (not spec.transparency.empty())
+        {
+            put_chunk(png, "tRNS", std::as_bytes(std::span{ spec.transparency }));
+        }
+        const std::vector<std::byte> stream = zlib_stored(filtered);
+        const size_t part = (stream.size() + spec.idat_chunks - 1) / spec.idat_chunks;
+        for (size_t at = 0; at < stream.size(); at += part)
+        {
+            put_chunk(png, "IDAT", std::span{ stream }.subspan(at, std::min(part, stream.size() - at)));
+        }
+        put_chunk(png, "IEND", {});
+        return png;
+    }
+
+    // Random samples inside a rect, zero outside, so the image has a transparent margin.
+    PngSpec make_spec(uint8_t color_type, size_t channels, size_t width, size_t height, std::mt19937& random)
+    {
+        PngSpec spec{ color_type, channels, width, height };
+        spec.samples.resize(width * height * channels);
+        for (size_t y = 0; y < height; y++)
+        {
+            for (size_t x = 0; x < width; x++)
+            {
+                const bool inside = x >= width / 4 && x < width - 2 && y >= 3 && y < height - height / 3;
+                for (size_t c = 0; c < channels; c++)
+                {
+                    spec.samples[(y * width + x) * channels + c] = inside ? (uint8_t)(random() % 255 + 1) : 0;
+                }
+            }
+        }
+        return spec;
+    }
+
+    void check_image(const char* name, const PngSpec& spec)
+    {
+        const std::vector<std::byte> png = encode_png(spec);
+        PngDecoder decoder;
+        if (not decoder.open(png))
+        {
+            check(false, "open", name);
+            return;
+        }
+        check(decoder.size() == Coord2{ spec.width, spec.height }, "size", name);
+
+        int w, h, c;
+        auto* expected = (Color32*)stbi_load_from_memory((const stbi_uc*)png.data(), (int)png.size(), &w, &h, &c, 4);
+        check(expected && (size_t)w == spec.width && (size_t)h == spec.height, "stb_image reference", name);
+        if (not expected)
+        {
+            return;
+        }
+        const BitmapView reference{ expected, Coord2{ spec.width, spec.height } };
+
+        std::vector<Color32> pixels(spec.width * spec.height);
+        const BitmapView decoded{ pixels.data(), reference.size() };
+        decoder.read({ Coord2{ 0uz, 0uz }, reference.size() }, decoded);
+        check(std::memcmp(pixels.data(), expected, pixels.size() * sizeof(Color32)) == 0, "pixels match stb_image", name);
+
+        const BitmapRect bounds = decoder.alpha_bounds();
+        const BitmapRect expected_bounds = adttil::alpha_bounds(reference);
+        check(bounds.position == expected_bounds.position && bounds.size == expected_bounds.size, "alpha bounds", name);
+
+        // A crop reads back as the same rect of the full image, even after the source decoder
+        // moved on to another file.
+        PngDecoder cropped;
+        decoder.crop(bounds, cropped);
+        std::mt19937 other{ 7 };
+        decoder.open(encode_png(make_spec(6, 4, 5, 5, other)));
+        std::vector<Color32> trimmed(bounds.size.x() * bounds.size.y());
+        cropped.read({ Coord2{ 0uz, 0uz }, bounds.size }, BitmapView{ trimmed.data(), bounds.size });
+        bool same = true;
+        for (size_t y = 0; y < bounds.size.y(); y++)
+        {
+            same = same && std::memcmp(&trimmed[y * bounds.size.x()], &reference[Coord2{ bounds.position.x(), bounds.position.y() + y }],
+                bounds.size.x() * sizeof(Color32)) == 0;
+        }
+        check(same, "crop", name);
+        check(cropped.alpha_bounds().size == bounds.size, "bounds of the crop", name);
+        stbi_image_free(expected);
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 326 };
+
+    check_image("rgba", make_spec(6, 4, 37, 23, random));
+    check_image("rgb", make_spec(2, 3, 19, 11, random));
+    check_image("gray", make_spec(0, 1, 8, 9, random));
+    check_image("gray alpha", make_spec(4, 2, 33, 14, random));
+
+    PngSpec split = make_spec(6, 4, 300, 120, random);
+    split.idat_chunks = 5;
+    check_image("rgba, split IDAT, several stored blocks", split);
+
+    PngSpec indexed = make_spec(3, 1, 17, 12, random);
+    for (size_t i = 0; i < 256; i++)
+    {
+        indexed.palette.insert(indexed.palette.end(), { (uint8_t)i, (uint8_t)(255 - i), (uint8_t)(i * 7) });
+    }
+    indexed.transparency = { 0, 128, 255 };
+    check_image("indexed with tRNS", indexed);
+
+    PngSpec keyed = make_spec(2, 3, 16, 16, random);
+    keyed.transparency = { 0, 0, 0, 0, 0, 0 };
+    check_image("rgb with tRNS key", keyed);
+
+    PngSpec gray_keyed = make_spec(0, 1, 10, 6, random);
+    gray_keyed.transparency = { 0, 0 };
+    check_image("gray with tRNS key", gray_keyed);
+
+    PngSpec deep = make_spec(6, 8, 4, 4, random);
+    deep.bit_depth = 16;
+    deep.color_type = 6;
+    PngDecoder decoder;
+    check(not decoder.open(encode_png(deep)), "16-bit files are left to stb_image", "rgba16");
+
+    // Pixels decoded by stb_image go through the same alpha_bounds() and crop().
+    std::vector<Color32> pixels(6 * 5, Color32{ 0, 0, 0, 0 });
+    pixels[2 * 6 + 3] = Color32{ 1, 2, 3, 4 };
+    decoder.assign(BitmapView{ pixels.data(), Coord2{ 6uz, 5uz } });
+    const BitmapRect bounds = decoder.alpha_bounds();
+    check(bounds.position == Coord2{ 3uz, 2uz } && bounds.size == Coord2{ 1uz, 1uz }, "bounds of assigned pixels", "assign");
+    PngDecoder cropped;
+    decoder.crop(bounds, cropped);
+    Color32 texel{};
+    cropped.read({ Coord2{ 0uz, 0uz }, bounds.size }, BitmapView{ &texel, bounds.size });
+    check(texel == Color32{ 1, 2, 3, 4 }, "crop of assigned pixels", "assign");
+
+    if (failures)
+    {
+        std::println("{} checks failed", failures);
+        return 1;
+    }
+    std::println("all png decoder checks passed");
+}
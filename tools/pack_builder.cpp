@@ -0,0 +1,65 @@
+// Packs every file below a folder into one asset pack, named by their path relative to the folder
+// with '/' separators, e.g. "anims/hero/attack_000.png".
+//
+//     pack_builder <folder> <output.pack> [--compress]
+//
+// Run the game once on the loose folders first so their atlas.cache files are baked; they are
+// packed uncompressed and AnimManager maps them in place.
+#include <print>
+#include <vector>
+#include <string_view>
+#include <filesystem>
+#include <fstream>
+
+#include <renderer/asset_pack.hpp>
+
+int main(int argc, char** argv)
+{
+    namespace fs = std::filesystem;
+
+    if (argc < 3)
+    {
+        std::println("usage: pack_builder <folder> <output.pack> [--compress]");
+        return 1;
+    }
+    const fs::path root = argv[1];
+    const fs::path output = argv[2];
+    const bool compress = argc > 3 && std::string_view{ argv[3] } == "--compress";
+
+    std::vector<adttil::AssetPack::Input> inputs;
+    size_t total = 0;
+    for (const fs::directory_entry& file : fs::recursive_directory_iterator(root))
+    {
+        // The output usually does not exist yet on the first run; that is not an error.
+        std::error_code error;
+        if (not file.is_regular_file() || fs::equivalent(file.path(), output, error))
+        {
+            continue;
+        }
+        std::ifstream stream{ file.path(), std::ios::binary | std::ios::ate };
+        // tellg() is -1 when the file did not open; sizing the buffer from it would not end well.
+        const std::streamoff size = stream ? (std::streamoff)stream.tellg() : -1;
+        std::vector<std::byte> content(size > 0 ? (size_t)size : 0);
+        if (size >= 0)
+        {
+            stream.seekg(0);
+            stream.read((char*)content.data(), content.size());
+        }
+        if (size < 0 || not stream)
+        {
+            std::println("failed to read {}", file.path().string());
+            return 1;
+        }
+        total += content.size();
+        const bool cache = file.path().filename() == "atlas.cache";
+        inputs.push_back({ fs::relative(file.path(), root).generic_string(), std::move(content),
+            (int64_t)file.last_write_time().time_since_epoch().count(), compress && not cache });
+    }
+
+    if (not adttil::AssetPack::write(output, inputs))
+    {
+        return 1;
+    }
+    std::println("packed {} files, {} bytes, into {} ({} bytes)", inputs.size(), total, output.string(), fs::file_size(output));
+    return 0;
+}